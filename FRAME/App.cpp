@@ -15,6 +15,10 @@
 #include "GUI.h"
 #include "MainGUI.h"
 #include "GameObject.h"
+#include "TextureStreamer.h"
+#include "GLStateCache.h"
+#include <chrono>
+#include <iostream>
 
 CApp::CApp()
 {
@@ -28,6 +32,7 @@ CApp::~CApp()
 //Function:
 GLvoid CApp::init()
 {
+	m_InitStartTime = std::chrono::steady_clock::now();
 	CResourceManager::getOrCreateInstance()->fetchOrCreateGLFWWindow()->init();
 	m_pWindow = CResourceManager::getOrCreateInstance()->fetchOrCreateGLFWWindow()->fetchWindow();
 	m_pResourceManager = CResourceManager::getOrCreateInstance();
@@ -51,6 +56,7 @@ GLvoid CApp::init()
 	{
 		vItem->initV();
 	}
+	m_InitMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_InitStartTime).count();
 }
 
 //************************************************************************************
@@ -62,6 +68,8 @@ GLvoid CApp::update()
 	{
 		__calculateTime();
 		glfwPollEvents();
+		m_pResourceManager->updatePendingModels();
+		m_pResourceManager->fetchOrCreateTextureStreamer()->update();
 		m_pResourceManager->fecthOrCreateMainCamera()->update();
 		m_pResourceManager->fetchOrCreateUBO4ProjectionWorld()->update();
 
@@ -72,67 +80,188 @@ GLvoid CApp::update()
 
 		glClear(GL_COLOR_BUFFER_BIT);
 
-		ElayGraphics::MVector<std::shared_ptr<IRenderPass>> renderPassSets = m_pResourceManager->getRenderPassSet();
-		for (int i = 0; i < renderPassSets.size(); i++)
+		if (m_RunSchedulerBenchmark)
 		{
-			if (renderPassSets[i]->getExecutionOrder() == -1) continue;
-			switch (renderPassSets[i]->getPassType())
-			{
-			case ElayGraphics::ERenderPassType::RenderPassType_Once:
+			__benchmarkRenderPassScheduler();
+			m_RunSchedulerBenchmark = false;
+		}
+		__executeRenderPassPlan();
+
+		if (ElayGraphics::COMPONENT_CONFIG::IS_ENABLE_GUI)
+		{
+			m_pResourceManager->getOrCreateMainGUI()->update();
+			for (auto &vItem : m_pResourceManager->getSubGUISet())
 			{
-				renderPassSets[i]->updateV();
-				renderPassSets[i]->finishExecute();
-				break;
+				vItem->updateV();
 			}
-			case ElayGraphics::ERenderPassType::RenderPassType_Parallel:
+			m_pResourceManager->getOrCreateMainGUI()->lateUpdate();
+		}
+
+		glfwSwapBuffers(m_pWindow);
+		if (!m_IsStartupLogged)
+		{
+			__logStartup();
+			m_IsStartupLogged = true;
+		}
+	}
+}
+
+//************************************************************************************
+//Function: warm when every program came from the binary cache, cold when none did
+GLvoid CApp::__logStartup() const
+{
+	const auto& Stats = CShader::getProgramCacheStats();
+	const double FirstFrameMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_InitStartTime).count();
+	const char* pStartKind = Stats.CacheHitCount == Stats.ProgramCount ? "warm" : (Stats.CacheHitCount == 0 ? "cold" : "partly cached");
+	std::cout << "Startup:: " << pStartKind << ", init " << m_InitMs << " ms, first frame done " << FirstFrameMs << " ms after init began" << std::endl;
+	std::cout << "Startup:: " << Stats.ProgramCount << " programs, " << Stats.CacheHitCount << " from binaries in " << Stats.CacheLoadMs << " ms, "
+		<< Stats.CompiledCount << " compiled" << (GLEW_KHR_parallel_shader_compile ? " in parallel" : "") << " (submit " << Stats.SubmitMs << " ms, waited "
+		<< Stats.WaitMs << " ms), " << Stats.LinkFailureCount << " failed" << std::endl;
+}
+
+//************************************************************************************
+//Function: resolves the pass types the same way the frame loop used to do it every frame
+GLvoid CApp::__compileRenderPassPlan()
+{
+	m_RenderPassPlan.clear();
+	m_PassesToFinish.clear();
+	m_PassesToUndelay.clear();
+
+	const auto& RenderPassSet = m_pResourceManager->getRenderPassSet();
+	for (int i = 0; i < RenderPassSet.size(); i++)
+	{
+		IRenderPass* pPass = RenderPassSet[i].get();
+		if (pPass->getExecutionOrder() == -1) continue;
+		switch (pPass->getPassType())
+		{
+		case ElayGraphics::ERenderPassType::RenderPassType_Once:
+			m_RenderPassPlan.push_back(pPass);
+			m_PassesToFinish.push_back(pPass);
+			break;
+		case ElayGraphics::ERenderPassType::RenderPassType_Parallel:
+		case ElayGraphics::ERenderPassType::RenderPassType_ParallelOnce:
+		{
+			//the passes sharing the execution order of the first one run as one group, whatever their own type
+			const bool IsOnce = pPass->getPassType() == ElayGraphics::ERenderPassType::RenderPassType_ParallelOnce;
+			int j = i;
+			while (j < RenderPassSet.size() && RenderPassSet[j]->getExecutionOrder() == pPass->getExecutionOrder())
 			{
-				int j = i;
-				while (j < renderPassSets.size())
-				{
-					if (renderPassSets[i]->getExecutionOrder() != renderPassSets[j]->getExecutionOrder())break;
-					renderPassSets[j++]->updateV();
-				}
-				i = j - 1;
-				break;
+				m_RenderPassPlan.push_back(RenderPassSet[j].get());
+				if (IsOnce) m_PassesToFinish.push_back(RenderPassSet[j].get());
+				j++;
 			}
+			i = j - 1;
+			break;
+		}
+		case ElayGraphics::ERenderPassType::RenderPassType_Delay:
+			m_PassesToUndelay.push_back(pPass);
+			break;
+		default:
+			m_RenderPassPlan.push_back(pPass);
+			break;
+		}
+	}
+
+	m_RenderPassPlanRevision = IRenderPass::getScheduleRevision();
+	m_IsRenderPassPlanValid = true;
+}
+
+//************************************************************************************
+//Function: retiring Once passes and waking Delay passes moves the schedule revision, so the next frame runs a recompiled plan
+GLvoid CApp::__executeRenderPassPlan()
+{
+	if (!m_IsRenderPassPlanValid || m_RenderPassPlanRevision != IRenderPass::getScheduleRevision())
+		__compileRenderPassPlan();
+
+	//the streamer, the GUI and the loaders bind and enable behind the state cache between two runs of the passes
+	fetchGLStateCache().invalidate();
+	if (m_LogDriverCalls)
+	{
+		//one frame of counted driver calls per pass, see ElayGraphics::SDriverCallCounters
+		const ElayGraphics::SDriverCallCounters FrameStart = fetchDriverCallCounters();
+		for (IRenderPass* pPass : m_RenderPassPlan)
+		{
+			const ElayGraphics::SDriverCallCounters PassStart = fetchDriverCallCounters();
+			pPass->updateV();
+			const ElayGraphics::SDriverCallCounters Delta = fetchDriverCallCounters() - PassStart;
+			std::cout << "DriverCalls::" << pPass->getPassName() << ": " << Delta.total() << " (location queries " << Delta.UniformLocationQueries
+				<< ", uniforms " << Delta.UniformUploads << ", buffer uploads " << Delta.BufferUploads << ", texture binds " << Delta.TextureBinds
+				<< ", program binds " << Delta.ProgramBinds << ", state changes " << Delta.StateChanges << ", draws " << Delta.DrawCalls
+				<< "), " << Delta.FilteredCalls << " redundant filtered" << std::endl;
+		}
+		const ElayGraphics::SDriverCallCounters FrameDelta = fetchDriverCallCounters() - FrameStart;
+		std::cout << "DriverCalls::frame: " << FrameDelta.total() << " issued, " << FrameDelta.FilteredCalls << " redundant filtered by the state cache" << std::endl;
+		m_LogDriverCalls = false;
+	}
+	else
+	{
+		for (IRenderPass* pPass : m_RenderPassPlan)
+			pPass->updateV();
+	}
+
+	for (IRenderPass* pPass : m_PassesToFinish)
+		pPass->finishExecute();
+	for (IRenderPass* pPass : m_PassesToUndelay)
+		pPass->setPassType(ElayGraphics::ERenderPassType::RenderPassType_Normal);
+}
+
+//************************************************************************************
+//Function: scheduling cost alone, no updateV is called: the old per-frame copy and walk of the pass set against the compiled plan
+GLvoid CApp::__benchmarkRenderPassScheduler()
+{
+	using Clock = std::chrono::steady_clock;
+	const int Frames = 10000;
+	size_t OldVisited = 0, PlanVisited = 0;
+
+	auto Start = Clock::now();
+	for (int Frame = 0; Frame < Frames; Frame++)
+	{
+		ElayGraphics::MVector<std::shared_ptr<IRenderPass>> RenderPassSets = m_pResourceManager->getRenderPassSet();
+		for (int i = 0; i < RenderPassSets.size(); i++)
+		{
+			if (RenderPassSets[i]->getExecutionOrder() == -1) continue;
+			switch (RenderPassSets[i]->getPassType())
+			{
+			case ElayGraphics::ERenderPassType::RenderPassType_Parallel:
 			case ElayGraphics::ERenderPassType::RenderPassType_ParallelOnce:
 			{
 				int j = i;
-				while (j < renderPassSets.size())
+				while (j < RenderPassSets.size() && RenderPassSets[i]->getExecutionOrder() == RenderPassSets[j]->getExecutionOrder())
 				{
-					if (renderPassSets[i]->getExecutionOrder() != renderPassSets[j]->getExecutionOrder())break;
-
-					renderPassSets[j++]->updateV();
+					OldVisited += RenderPassSets[j++]->getPassName().size();
 				}
-				while (i < j)
-				{
-					renderPassSets[i++]->finishExecute();
-				}
-				i--;
+				i = j - 1;
 				break;
-
 			}
 			case ElayGraphics::ERenderPassType::RenderPassType_Delay:
-				renderPassSets[i]->setPassType(ElayGraphics::ERenderPassType::RenderPassType_Normal);
 				break;
 			default:
-				renderPassSets[i]->updateV();
+				OldVisited += RenderPassSets[i]->getPassName().size();
 				break;
 			}
 		}
+	}
+	const float OldMs = std::chrono::duration<float, std::milli>(Clock::now() - Start).count();
 
-		if (ElayGraphics::COMPONENT_CONFIG::IS_ENABLE_GUI)
-		{
-			m_pResourceManager->getOrCreateMainGUI()->update();
-			for (auto &vItem : m_pResourceManager->getSubGUISet())
-			{
-				vItem->updateV();
-			}
-			m_pResourceManager->getOrCreateMainGUI()->lateUpdate();
-		}
+	Start = Clock::now();
+	__compileRenderPassPlan();
+	const float CompileMs = std::chrono::duration<float, std::milli>(Clock::now() - Start).count();
 
-		glfwSwapBuffers(m_pWindow);
+	Start = Clock::now();
+	for (int Frame = 0; Frame < Frames; Frame++)
+	{
+		if (!m_IsRenderPassPlanValid || m_RenderPassPlanRevision != IRenderPass::getScheduleRevision())
+			__compileRenderPassPlan();
+		for (IRenderPass* pPass : m_RenderPassPlan)
+			PlanVisited += pPass->getPassName().size();
 	}
+	const float PlanMs = std::chrono::duration<float, std::milli>(Clock::now() - Start).count();
+
+	std::cout << "Render pass scheduler benchmark: " << m_pResourceManager->getRenderPassSet().size() << " passes, " << Frames << " frames" << std::endl;
+	std::cout << "  copy and walk the pass set: " << OldMs * 1000.0f / Frames << " us per frame" << std::endl;
+	std::cout << "  compiled plan:              " << PlanMs * 1000.0f / Frames << " us per frame (compile " << CompileMs * 1000.0f << " us)" << std::endl;
+	if (OldVisited != PlanVisited)
+		std::cerr << "Error::App:: the compiled render pass plan visits other passes than the frame loop" << std::endl;
 }
 
 //************************************************************************************
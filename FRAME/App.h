@@ -3,13 +3,16 @@
 //--------------------------------------------------------------------------------------
 
 #pragma once
+#include <chrono>
 #include <memory>
+#include <vector>
 #include "GLFWWindow.h"
 #include "Singleton.h"
 
 class CShader;
 class CCamera;
 class CResourceManager;
+class IRenderPass;
 
 class CApp : public CSingleton<CApp>
 {
@@ -23,10 +26,16 @@ public:
 	GLdouble getFrameRateInMilliSecond() const;
 	GLdouble getCurrentTime() const;
 	GLuint	 getFramesPerSecond() const;
+	GLvoid	 setSchedulerBenchmark(bool vRunBenchmark) { m_RunSchedulerBenchmark = vRunBenchmark; }
+	GLvoid	 setDriverCallLog(bool vLogDriverCalls) { m_LogDriverCalls = vLogDriverCalls; }
 
 private:
 	CApp();
 	GLvoid __calculateTime();
+	GLvoid __compileRenderPassPlan();
+	GLvoid __executeRenderPassPlan();
+	GLvoid __benchmarkRenderPassScheduler();
+	GLvoid __logStartup() const;
 
 	GLFWwindow  *m_pWindow;
 	GLdouble     m_DeltaTime = 0.0;
@@ -36,4 +45,18 @@ private:
 	GLuint		 m_FramesPerSecond = 0;
 	GLuint		 m_FrameCounter = 0;
 	std::shared_ptr<CResourceManager> m_pResourceManager = nullptr;
+
+	//flat updateV order with Once, Parallel, ParallelOnce and Delay already resolved,
+	//recompiled only when IRenderPass::getScheduleRevision() moves
+	std::vector<IRenderPass*> m_RenderPassPlan;
+	std::vector<IRenderPass*> m_PassesToFinish;		//Once and ParallelOnce passes, retired after the frame
+	std::vector<IRenderPass*> m_PassesToUndelay;	//Delay passes, Normal from the next frame on
+	GLuint	 m_RenderPassPlanRevision = 0;
+	bool	 m_IsRenderPassPlanValid = false;
+	bool	 m_RunSchedulerBenchmark = false;
+	bool	 m_LogDriverCalls = false;
+
+	std::chrono::steady_clock::time_point m_InitStartTime;
+	double	 m_InitMs = 0.0;
+	bool	 m_IsStartupLogged = false;	//after the first frame, which waits for the programs initV left linking
 };
\ No newline at end of file
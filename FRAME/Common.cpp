@@ -16,4 +16,7 @@ int ElayGraphics::WINDOW_KEYWORD::NUM_SAMPLES = 4;
 bool ElayGraphics::WINDOW_KEYWORD::CURSOR_DISABLE = true;
 std::string ElayGraphics::WINDOW_KEYWORD::WINDOW_TITLE = "Graphics";
 
-bool ElayGraphics::COMPONENT_CONFIG::IS_ENABLE_GUI = true;
\ No newline at end of file
+bool ElayGraphics::COMPONENT_CONFIG::IS_ENABLE_GUI = true;
+bool ElayGraphics::COMPONENT_CONFIG::IS_PACK_MESH_VERTICES = false;
+bool ElayGraphics::COMPONENT_CONFIG::IS_COMPRESS_TEXTURES = false;
+bool ElayGraphics::COMPONENT_CONFIG::IS_ALLOW_BC1_TEXTURES = false;
\ No newline at end of file
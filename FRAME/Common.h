@@ -38,6 +38,9 @@ namespace ElayGraphics
 	namespace COMPONENT_CONFIG
 	{
 		extern bool IS_ENABLE_GUI;
+		extern bool IS_PACK_MESH_VERTICES;
+		extern bool IS_COMPRESS_TEXTURES;
+		extern bool IS_ALLOW_BC1_TEXTURES;
 	}
 
 	struct FRAME_DLLEXPORTS STexture
@@ -94,6 +97,12 @@ namespace ElayGraphics
 		{
 			return TextureID < vAnotherTexture.TextureID;
 		}
+
+		//image load/store only sees every slice of a 3D, array or cube texture when it is bound layered
+		GLboolean isLayeredImage() const
+		{
+			return TextureType != ETextureType::Texture2D && TextureType != ETextureType::DepthCubeMap;
+		}
 	};
 
 	struct FRAME_DLLEXPORTS SPointLight
@@ -179,4 +188,32 @@ namespace ElayGraphics
 		RenderPassType_ParallelOnce,     
 		RenderPassType_Delay,     
 	};
+
+	//GL calls issued through CShader, CGLStateCache and the buffer helpers in Utils, cumulative since startup
+	struct SDriverCallCounters
+	{
+		unsigned UniformLocationQueries = 0;
+		unsigned UniformUploads = 0;
+		unsigned BufferUploads = 0;
+		unsigned TextureBinds = 0;
+		unsigned ProgramBinds = 0;
+		unsigned StateChanges = 0;	//framebuffers, viewport, capabilities, depth, cull and blend state, texture unit selects, samplers, image units
+		unsigned DrawCalls = 0;		//a multi-draw counts once
+		unsigned FilteredCalls = 0;	//requests CGLStateCache dropped as redundant, not part of total()
+
+		unsigned total() const { return UniformLocationQueries + UniformUploads + BufferUploads + TextureBinds + ProgramBinds + StateChanges + DrawCalls; }
+		SDriverCallCounters operator-(const SDriverCallCounters& vOther) const
+		{
+			SDriverCallCounters Delta;
+			Delta.UniformLocationQueries = UniformLocationQueries - vOther.UniformLocationQueries;
+			Delta.UniformUploads = UniformUploads - vOther.UniformUploads;
+			Delta.BufferUploads = BufferUploads - vOther.BufferUploads;
+			Delta.TextureBinds = TextureBinds - vOther.TextureBinds;
+			Delta.ProgramBinds = ProgramBinds - vOther.ProgramBinds;
+			Delta.StateChanges = StateChanges - vOther.StateChanges;
+			Delta.DrawCalls = DrawCalls - vOther.DrawCalls;
+			Delta.FilteredCalls = FilteredCalls - vOther.FilteredCalls;
+			return Delta;
+		}
+	};
 }
\ No newline at end of file
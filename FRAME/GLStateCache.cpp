@@ -0,0 +1,320 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) Elay Pu. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "GLStateCache.h"
+#include "PipelineState.h"
+#include "Shader.h"
+#include "Utils.h"
+#include <algorithm>
+
+namespace
+{
+	const GLuint UNKNOWN_OBJECT = 0xFFFFFFFFu;	//never a GL name
+	const GLenum UNKNOWN_ENUM = 0;
+}
+
+CGLStateCache::CGLStateCache()
+{
+	invalidate();
+}
+
+//************************************************************************************
+//Function:
+void CGLStateCache::invalidate()
+{
+	m_Program = UNKNOWN_OBJECT;
+	m_ActiveTextureUnit = UNKNOWN_OBJECT;
+	for (STextureUnit& Unit : m_TextureUnits)
+		Unit = STextureUnit();
+	for (SImageUnit& Unit : m_ImageUnits)
+		Unit = SImageUnit();
+	m_DrawFramebuffer = UNKNOWN_OBJECT;
+	m_ReadFramebuffer = UNKNOWN_OBJECT;
+	m_IsViewportKnown = false;
+	m_Capabilities.clear();
+	m_DepthFunc = UNKNOWN_ENUM;
+	m_DepthMask = -1;
+	m_CullFace = UNKNOWN_ENUM;
+	m_BlendSourceFactor = UNKNOWN_ENUM;
+	m_BlendDestinationFactor = UNKNOWN_ENUM;
+}
+
+//************************************************************************************
+//Function: GL rebinds texture 0 on the units of this context that had a deleted texture, the image units are forgotten
+void CGLStateCache::deleteTextures(GLsizei vCount, const GLuint* vTextures)
+{
+	glDeleteTextures(vCount, vTextures);
+	for (GLsizei i = 0; i < vCount; ++i)
+	{
+		if (vTextures[i] == 0)
+			continue;
+		for (STextureUnit& Unit : m_TextureUnits)
+		{
+			if (Unit.IsTextureKnown && Unit.Texture == vTextures[i])
+				Unit.Texture = 0;
+		}
+		for (SImageUnit& Unit : m_ImageUnits)
+		{
+			if (Unit.IsKnown && Unit.Texture == vTextures[i])
+				Unit = SImageUnit();
+		}
+	}
+}
+
+//************************************************************************************
+//Function: GL reverts a draw or read binding of a deleted framebuffer to the default one
+void CGLStateCache::deleteFramebuffers(GLsizei vCount, const GLuint* vFramebuffers)
+{
+	glDeleteFramebuffers(vCount, vFramebuffers);
+	for (GLsizei i = 0; i < vCount; ++i)
+	{
+		if (vFramebuffers[i] == 0)
+			continue;
+		if (m_DrawFramebuffer == vFramebuffers[i])
+			m_DrawFramebuffer = 0;
+		if (m_ReadFramebuffer == vFramebuffers[i])
+			m_ReadFramebuffer = 0;
+	}
+}
+
+//************************************************************************************
+//Function:
+void CGLStateCache::useProgram(GLuint vProgram)
+{
+	if (__filter(m_Program == vProgram))
+		return;
+	glUseProgram(vProgram);
+	++fetchDriverCallCounters().ProgramBinds;
+	m_Program = vProgram;
+}
+
+//************************************************************************************
+//Function:
+void CGLStateCache::bindTexture(GLuint vUnit, GLenum vTarget, GLuint vTexture)
+{
+	const bool IsTracked = vUnit < MAX_TRACKED_TEXTURE_UNITS;
+	if (IsTracked)
+	{
+		const STextureUnit& Unit = m_TextureUnits[vUnit];
+		if (__filter(Unit.IsTextureKnown && Unit.Target == vTarget && Unit.Texture == vTexture))
+			return;
+	}
+	__selectTextureUnit(vUnit);
+	glBindTexture(vTarget, vTexture);
+	++fetchDriverCallCounters().TextureBinds;
+	if (IsTracked)
+	{
+		STextureUnit& Unit = m_TextureUnits[vUnit];
+		Unit.Target = vTarget;
+		Unit.Texture = vTexture;
+		Unit.IsTextureKnown = true;
+	}
+}
+
+//************************************************************************************
+//Function:
+void CGLStateCache::parkTextureUnit()
+{
+	if (m_ParkedTextureUnit == 0)
+	{
+		GLint UnitCount = 0;
+		glGetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &UnitCount);
+		m_ParkedTextureUnit = static_cast<GLuint>(std::max(UnitCount - 1, static_cast<GLint>(MAX_TRACKED_TEXTURE_UNITS)));
+	}
+	__selectTextureUnit(m_ParkedTextureUnit);
+}
+
+//************************************************************************************
+//Function:
+void CGLStateCache::bindSampler(GLuint vUnit, GLuint vSampler)
+{
+	const bool IsTracked = vUnit < MAX_TRACKED_TEXTURE_UNITS;
+	if (IsTracked && __filter(m_TextureUnits[vUnit].IsSamplerKnown && m_TextureUnits[vUnit].Sampler == vSampler))
+		return;
+	glBindSampler(vUnit, vSampler);
+	++fetchDriverCallCounters().StateChanges;
+	if (IsTracked)
+	{
+		m_TextureUnits[vUnit].Sampler = vSampler;
+		m_TextureUnits[vUnit].IsSamplerKnown = true;
+	}
+}
+
+//************************************************************************************
+//Function:
+void CGLStateCache::bindImageTexture(GLuint vUnit, GLuint vTexture, GLint vLevel, GLboolean vIsLayered, GLint vLayer, GLenum vAccess, GLenum vFormat)
+{
+	SImageUnit Unit;
+	Unit.Texture = vTexture;
+	Unit.Level = vLevel;
+	Unit.IsLayered = vIsLayered;
+	Unit.Layer = vLayer;
+	Unit.Access = vAccess;
+	Unit.Format = vFormat;
+	Unit.IsKnown = true;
+	const bool IsTracked = vUnit < MAX_TRACKED_IMAGE_UNITS;
+	if (IsTracked && __filter(m_ImageUnits[vUnit] == Unit))
+		return;
+	glBindImageTexture(vUnit, vTexture, vLevel, vIsLayered, vLayer, vAccess, vFormat);
+	++fetchDriverCallCounters().StateChanges;
+	if (IsTracked)
+		m_ImageUnits[vUnit] = Unit;
+}
+
+//************************************************************************************
+//Function:
+void CGLStateCache::bindFramebuffer(GLenum vTarget, GLuint vFramebuffer)
+{
+	const bool IsDraw = vTarget != GL_READ_FRAMEBUFFER;
+	const bool IsRead = vTarget != GL_DRAW_FRAMEBUFFER;
+	if (__filter((!IsDraw || m_DrawFramebuffer == vFramebuffer) && (!IsRead || m_ReadFramebuffer == vFramebuffer)))
+		return;
+	glBindFramebuffer(vTarget, vFramebuffer);
+	++fetchDriverCallCounters().StateChanges;
+	if (IsDraw)
+		m_DrawFramebuffer = vFramebuffer;
+	if (IsRead)
+		m_ReadFramebuffer = vFramebuffer;
+}
+
+//************************************************************************************
+//Function:
+void CGLStateCache::setViewport(GLint vX, GLint vY, GLsizei vWidth, GLsizei vHeight)
+{
+	if (__filter(m_IsViewportKnown && m_Viewport[0] == vX && m_Viewport[1] == vY && m_Viewport[2] == vWidth && m_Viewport[3] == vHeight))
+		return;
+	glViewport(vX, vY, vWidth, vHeight);
+	++fetchDriverCallCounters().StateChanges;
+	m_Viewport[0] = vX;
+	m_Viewport[1] = vY;
+	m_Viewport[2] = vWidth;
+	m_Viewport[3] = vHeight;
+	m_IsViewportKnown = true;
+}
+
+//************************************************************************************
+//Function:
+void CGLStateCache::setCapability(GLenum vCapability, bool vIsEnabled)
+{
+	auto Iter = m_Capabilities.find(vCapability);
+	if (__filter(Iter != m_Capabilities.end() && Iter->second == vIsEnabled))
+		return;
+	if (vIsEnabled)
+		glEnable(vCapability);
+	else
+		glDisable(vCapability);
+	++fetchDriverCallCounters().StateChanges;
+	m_Capabilities[vCapability] = vIsEnabled;
+}
+
+//************************************************************************************
+//Function:
+void CGLStateCache::setDepthFunc(GLenum vFunc)
+{
+	if (__filter(m_DepthFunc == vFunc))
+		return;
+	glDepthFunc(vFunc);
+	++fetchDriverCallCounters().StateChanges;
+	m_DepthFunc = vFunc;
+}
+
+//************************************************************************************
+//Function:
+void CGLStateCache::setDepthMask(bool vIsWritten)
+{
+	const GLint DepthMask = vIsWritten ? 1 : 0;
+	if (__filter(m_DepthMask == DepthMask))
+		return;
+	glDepthMask(vIsWritten ? GL_TRUE : GL_FALSE);
+	++fetchDriverCallCounters().StateChanges;
+	m_DepthMask = DepthMask;
+}
+
+//************************************************************************************
+//Function:
+void CGLStateCache::setCullFace(GLenum vFace)
+{
+	if (__filter(m_CullFace == vFace))
+		return;
+	glCullFace(vFace);
+	++fetchDriverCallCounters().StateChanges;
+	m_CullFace = vFace;
+}
+
+//************************************************************************************
+//Function:
+void CGLStateCache::setBlendFunc(GLenum vSourceFactor, GLenum vDestinationFactor)
+{
+	if (__filter(m_BlendSourceFactor == vSourceFactor && m_BlendDestinationFactor == vDestinationFactor))
+		return;
+	glBlendFunc(vSourceFactor, vDestinationFactor);
+	++fetchDriverCallCounters().StateChanges;
+	m_BlendSourceFactor = vSourceFactor;
+	m_BlendDestinationFactor = vDestinationFactor;
+}
+
+//************************************************************************************
+//Function: the functions of a disabled test are left as they are, nothing reads them
+void CGLStateCache::applyPipelineState(const CPipelineState& vPipelineState)
+{
+	const SPipelineStateDesc& Desc = vPipelineState.getDesc();
+	setCapability(GL_DEPTH_TEST, Desc.IsDepthTest);
+	if (Desc.IsDepthTest)
+		setDepthFunc(Desc.DepthFunc);
+	setDepthMask(Desc.IsDepthWrite);
+	setCapability(GL_CULL_FACE, Desc.IsCullFace);
+	if (Desc.IsCullFace)
+		setCullFace(Desc.CullFace);
+	setCapability(GL_BLEND, Desc.IsBlend);
+	if (Desc.IsBlend)
+		setBlendFunc(Desc.BlendSourceFactor, Desc.BlendDestinationFactor);
+	if (Desc.pShader)
+		Desc.pShader->activeShader();
+}
+
+//************************************************************************************
+//Function:
+bool CGLStateCache::getViewport(GLint voViewport[4]) const
+{
+	if (!m_IsViewportKnown)
+		return false;
+	std::copy(m_Viewport, m_Viewport + 4, voViewport);
+	return true;
+}
+
+//************************************************************************************
+//Function:
+bool CGLStateCache::__filter(bool vIsRedundant) const
+{
+	if (vIsRedundant)
+		++fetchDriverCallCounters().FilteredCalls;
+	return vIsRedundant;
+}
+
+//************************************************************************************
+//Function:
+void CGLStateCache::__selectTextureUnit(GLuint vUnit)
+{
+	if (m_ActiveTextureUnit == vUnit)
+		return;
+	glActiveTexture(GL_TEXTURE0 + vUnit);
+	++fetchDriverCallCounters().StateChanges;
+	m_ActiveTextureUnit = vUnit;
+}
+
+//************************************************************************************
+//Function:
+bool CGLStateCache::SImageUnit::operator==(const SImageUnit& vOther) const
+{
+	return IsKnown && vOther.IsKnown && Texture == vOther.Texture && Level == vOther.Level && IsLayered == vOther.IsLayered
+		&& Layer == vOther.Layer && Access == vOther.Access && Format == vOther.Format;
+}
+
+//************************************************************************************
+//Function:
+CGLStateCache& fetchGLStateCache()
+{
+	static CGLStateCache Cache;
+	return Cache;
+}
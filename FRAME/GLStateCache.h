@@ -0,0 +1,94 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) Elay Pu. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+#include <GL/glew.h>
+#include <unordered_map>
+#include "FRAME_EXPORTS.h"
+
+class CPipelineState;
+
+//Shadow of the GL state the passes change every frame: program, texture units, samplers, image units, framebuffers,
+//viewport, capability bits and the depth, cull and blend functions. A request matching the shadow is dropped and
+//counted in SDriverCallCounters::FilteredCalls, anything else is issued and recorded. State starts unknown, and
+//invalidate() makes it unknown again: CApp calls it before the passes of every frame, since the GUI and the loaders
+//change state behind the cache. Textures and framebuffers are deleted through deleteTextures() and deleteFramebuffers(),
+//which forget only the bindings naming them, as their names come back from the next glGen*.
+//Texture binds leave their unit active until parkTextureUnit(), which selects a unit no shader samples, so the
+//glBindTexture of a texture upload elsewhere can't change a unit the shadow trusts. Context thread only.
+class FRAME_DLLEXPORTS CGLStateCache
+{
+public:
+	static const GLuint MAX_TRACKED_TEXTURE_UNITS = 32;	//units above are bound every time
+	static const GLuint MAX_TRACKED_IMAGE_UNITS = 8;
+
+	CGLStateCache();
+
+	CGLStateCache(const CGLStateCache&) = delete;
+	CGLStateCache& operator=(const CGLStateCache&) = delete;
+
+	void invalidate();
+	void deleteTextures(GLsizei vCount, const GLuint* vTextures);
+	void deleteFramebuffers(GLsizei vCount, const GLuint* vFramebuffers);
+
+	void useProgram(GLuint vProgram);
+	void bindTexture(GLuint vUnit, GLenum vTarget, GLuint vTexture);
+	void parkTextureUnit();
+	void bindSampler(GLuint vUnit, GLuint vSampler);
+	void bindImageTexture(GLuint vUnit, GLuint vTexture, GLint vLevel, GLboolean vIsLayered, GLint vLayer, GLenum vAccess, GLenum vFormat);
+	void bindFramebuffer(GLenum vTarget, GLuint vFramebuffer);	//GL_FRAMEBUFFER sets the draw and the read binding
+	void setViewport(GLint vX, GLint vY, GLsizei vWidth, GLsizei vHeight);
+	void setCapability(GLenum vCapability, bool vIsEnabled);
+	void setDepthFunc(GLenum vFunc);
+	void setDepthMask(bool vIsWritten);
+	void setCullFace(GLenum vFace);
+	void setBlendFunc(GLenum vSourceFactor, GLenum vDestinationFactor);
+	void applyPipelineState(const CPipelineState& vPipelineState);	//only what differs from the shadow, then its shader
+
+	bool getViewport(GLint voViewport[4]) const;	//false while the viewport is unknown
+
+private:
+	struct STextureUnit
+	{
+		GLenum Target = 0;
+		GLuint Texture = 0;
+		GLuint Sampler = 0;
+		bool IsTextureKnown = false;
+		bool IsSamplerKnown = false;
+	};
+
+	struct SImageUnit
+	{
+		GLuint Texture = 0;
+		GLint Level = 0;
+		GLboolean IsLayered = GL_FALSE;
+		GLint Layer = 0;
+		GLenum Access = 0;
+		GLenum Format = 0;
+		bool IsKnown = false;
+
+		bool operator==(const SImageUnit& vOther) const;
+	};
+
+	bool __filter(bool vIsRedundant) const;
+	void __selectTextureUnit(GLuint vUnit);
+
+	GLuint m_Program;
+	GLuint m_ActiveTextureUnit;
+	GLuint m_ParkedTextureUnit = 0;		//queried on first use, the last combined texture image unit
+	STextureUnit m_TextureUnits[MAX_TRACKED_TEXTURE_UNITS];
+	SImageUnit m_ImageUnits[MAX_TRACKED_IMAGE_UNITS];
+	GLuint m_DrawFramebuffer;
+	GLuint m_ReadFramebuffer;
+	GLint m_Viewport[4];
+	bool m_IsViewportKnown;
+	std::unordered_map<GLenum, bool> m_Capabilities;	//only the known ones
+	GLenum m_DepthFunc;
+	GLint m_DepthMask;
+	GLenum m_CullFace;
+	GLenum m_BlendSourceFactor;
+	GLenum m_BlendDestinationFactor;
+};
+
+FRAME_DLLEXPORTS CGLStateCache& fetchGLStateCache();
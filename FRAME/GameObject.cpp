@@ -251,6 +251,34 @@ void IGameObject::updateModel(const CShader& vShader) const
 	m_pModel->update(vShader);
 }
 
+//************************************************************************************
+//Function:
+void IGameObject::updateModel(const CShader& vShader, const SLodSelection& vLodSelection) const
+{
+	m_pModel->update(vShader, vLodSelection);
+}
+
+//************************************************************************************
+//Function:
+void IGameObject::updateModel(const CShader& vShader, const std::vector<uint32_t>& vMeshIndices, const SLodSelection& vLodSelection) const
+{
+	m_pModel->update(vShader, vMeshIndices, vLodSelection);
+}
+
+//************************************************************************************
+//Function:
+void IGameObject::appendModelDraws(CMultiDrawBatch& voBatch, const std::vector<uint32_t>& vMeshIndices, const SLodSelection& vLodSelection) const
+{
+	m_pModel->appendDraws(voBatch, vMeshIndices, vLodSelection, m_ModelMatrix);
+}
+
+//************************************************************************************
+//Function:
+void IGameObject::appendModelDraws(CMultiDrawBatch& voBatch, const std::vector<uint32_t>& vMeshIndices, const SLodSelection& vLodSelection, const glm::mat4& vModelMatrix) const
+{
+	m_pModel->appendDraws(voBatch, vMeshIndices, vLodSelection, vModelMatrix);
+}
+
 //************************************************************************************
 //Function:
 std::shared_ptr<CAABB> IGameObject::getAABB() const
@@ -258,6 +286,20 @@ std::shared_ptr<CAABB> IGameObject::getAABB() const
 	return m_pModel->getOrCreateBounding();
 }
 
+//************************************************************************************
+//Function:
+size_t IGameObject::getMeshCount() const
+{
+	return m_pModel ? m_pModel->getMeshCount() : 0;
+}
+
+//************************************************************************************
+//Function:
+std::shared_ptr<CAABB> IGameObject::getMeshAABB(size_t vMeshIndex) const
+{
+	return m_pModel->getOrCreateMeshBounding(vMeshIndex);
+}
+
 //************************************************************************************
 //Function:
 std::vector<glm::vec3> IGameObject::getTriangle()
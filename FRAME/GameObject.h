@@ -7,11 +7,14 @@
 #include <GLM/glm.hpp>
 #include <memory>
 #include <vector>
+#include <cstdint>
 #include "FRAME_EXPORTS.h"
 
 class CModel;
 class CShader;
 class CAABB;
+class CMultiDrawBatch;
+struct SLodSelection;
 
 class FRAME_DLLEXPORTS IGameObject
 {
@@ -53,8 +56,14 @@ public:
 
 	void initModel(CShader& vioShader) const;
 	void updateModel(const CShader& vShader) const;
+	void updateModel(const CShader& vShader, const SLodSelection& vLodSelection) const;
+	void updateModel(const CShader& vShader, const std::vector<uint32_t>& vMeshIndices, const SLodSelection& vLodSelection) const;
+	void appendModelDraws(CMultiDrawBatch& voBatch, const std::vector<uint32_t>& vMeshIndices, const SLodSelection& vLodSelection) const;	//with getModelMatrix()
+	void appendModelDraws(CMultiDrawBatch& voBatch, const std::vector<uint32_t>& vMeshIndices, const SLodSelection& vLodSelection, const glm::mat4& vModelMatrix) const;
 
 	std::shared_ptr<CAABB> getAABB() const;
+	size_t getMeshCount() const;	//0 without a model
+	std::shared_ptr<CAABB> getMeshAABB(size_t vMeshIndex) const;	//in model space
 	std::vector<glm::vec3> getTriangle();
 	bool operator<(const IGameObject& vOtherPass) const;
 
@@ -65,10 +74,10 @@ private:
 	glm::vec3   m_Position;
 	glm::vec3	m_RotationAngle;	//xyzתǶ
 	glm::vec3	m_Scale = glm::vec3(1, 1, 1);
-	glm::mat4	m_ModelMatrix;
-	glm::mat4   m_TranslationMatrix;
-	glm::mat4   m_RotationMatrix;
-	glm::mat4   m_ScaleMatrix;
+	glm::mat4	m_ModelMatrix = glm::mat4(1.0f);
+	glm::mat4   m_TranslationMatrix = glm::mat4(1.0f);
+	glm::mat4   m_RotationMatrix = glm::mat4(1.0f);
+	glm::mat4   m_ScaleMatrix = glm::mat4(1.0f);
 	std::shared_ptr<CModel> m_pModel;
 
 	void __updateModelMatrix();
@@ -0,0 +1,149 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) Elay Pu. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "GeometryArena.h"
+#include "Mesh.h"
+#include "Utils.h"
+#include <algorithm>
+#include <cstddef>
+#include <crtdbg.h>
+
+namespace
+{
+	const SVertexAttribute MESH_VERTEX_ATTRIBUTES[] =
+	{
+		{ 3, GL_FLOAT, GL_FALSE, GL_FALSE, offsetof(SMeshVertex, Position) },
+		{ 3, GL_FLOAT, GL_FALSE, GL_FALSE, offsetof(SMeshVertex, Normal) },
+		{ 2, GL_FLOAT, GL_FALSE, GL_FALSE, offsetof(SMeshVertex, TexCoords) },
+		{ 3, GL_FLOAT, GL_FALSE, GL_FALSE, offsetof(SMeshVertex, Tangent) },
+	};
+
+	const SVertexAttribute PACKED_MESH_VERTEX_ATTRIBUTES[] =
+	{
+		{ 4, GL_UNSIGNED_SHORT, GL_TRUE, GL_FALSE, offsetof(SPackedMeshVertex, Position) },
+		{ 2, GL_SHORT, GL_TRUE, GL_FALSE, offsetof(SPackedMeshVertex, Normal) },
+		{ 2, GL_HALF_FLOAT, GL_FALSE, GL_FALSE, offsetof(SPackedMeshVertex, TexCoords) },
+		{ 2, GL_SHORT, GL_TRUE, GL_FALSE, offsetof(SPackedMeshVertex, Tangent) },
+	};
+
+	size_t getVertexSize(bool vIsVertexPacked)
+	{
+		return vIsVertexPacked ? sizeof(SPackedMeshVertex) : sizeof(SMeshVertex);
+	}
+}
+
+const size_t CGeometryArena::MIN_BUFFER_SIZE;
+
+//************************************************************************************
+//Function: 32-bit ranges are aligned to 4 bytes so FirstIndex can address them in elements
+SGeometryAllocation CGeometryArena::allocate(const GLvoid* vVertices, size_t vVertexCount, bool vIsVertexPacked, const GLvoid* vIndices, size_t vIndexCount, GLenum vIndexType)
+{
+	_ASSERT(vIndexType == GL_UNSIGNED_SHORT || vIndexType == GL_UNSIGNED_INT);
+	SLayout& Layout = m_Layouts[vIsVertexPacked];
+	const size_t VertexSize = getVertexSize(vIsVertexPacked);
+	const size_t IndexSize = vIndexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+	const size_t VertexOffset = Layout.Vertices.Size;
+	const size_t IndexOffset = (m_Indices.Size + IndexSize - 1) / IndexSize * IndexSize;
+
+	const bool IsVertexBufferMoved = __reserve(Layout.Vertices, VertexOffset + vVertexCount * VertexSize);
+	const bool IsIndexBufferMoved = __reserve(m_Indices, IndexOffset + vIndexCount * IndexSize);
+	if (!Layout.VAO)
+	{
+		__createVAO(vIsVertexPacked);
+	}
+	else if (IsVertexBufferMoved)
+	{
+		glBindVertexArray(Layout.VAO);
+		glBindVertexBuffer(0, Layout.Vertices.Buffer, 0, static_cast<GLsizei>(VertexSize));
+		glBindVertexArray(0);
+	}
+	if (IsIndexBufferMoved)
+		__bindIndexBuffer();
+
+	__upload(Layout.Vertices, VertexOffset, vVertexCount * VertexSize, vVertices);
+	__upload(m_Indices, IndexOffset, vIndexCount * IndexSize, vIndices);
+	Layout.Vertices.Size = VertexOffset + vVertexCount * VertexSize;
+	m_Indices.Size = IndexOffset + vIndexCount * IndexSize;
+
+	SGeometryAllocation Allocation;
+	Allocation.BaseVertex = static_cast<GLint>(VertexOffset / VertexSize);
+	Allocation.FirstIndex = static_cast<GLuint>(IndexOffset / IndexSize);
+	Allocation.IndexType = vIndexType;
+	Allocation.IsVertexPacked = vIsVertexPacked;
+	return Allocation;
+}
+
+//************************************************************************************
+//Function: the attribute formats are fixed, reallocating a buffer only rebinds it
+GLvoid CGeometryArena::__createVAO(bool vIsVertexPacked)
+{
+	SLayout& Layout = m_Layouts[vIsVertexPacked];
+	glGenVertexArrays(1, &Layout.VAO);
+	glBindVertexArray(Layout.VAO);
+	const SVertexAttribute* pAttribs = vIsVertexPacked ? PACKED_MESH_VERTEX_ATTRIBUTES : MESH_VERTEX_ATTRIBUTES;
+	const GLuint AttribCount = static_cast<GLuint>(vIsVertexPacked ? sizeof(PACKED_MESH_VERTEX_ATTRIBUTES) / sizeof(SVertexAttribute) : sizeof(MESH_VERTEX_ATTRIBUTES) / sizeof(SVertexAttribute));
+	for (GLuint i = 0; i < AttribCount; ++i)
+	{
+		glEnableVertexAttribArray(i);
+		if (pAttribs[i].IsInteger)
+			glVertexAttribIFormat(i, pAttribs[i].Size, pAttribs[i].Type, pAttribs[i].Offset);
+		else
+			glVertexAttribFormat(i, pAttribs[i].Size, pAttribs[i].Type, pAttribs[i].IsNormalized, pAttribs[i].Offset);
+		glVertexAttribBinding(i, 0);
+	}
+	glBindVertexBuffer(0, Layout.Vertices.Buffer, 0, static_cast<GLsizei>(getVertexSize(vIsVertexPacked)));
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_Indices.Buffer);
+	glBindVertexArray(0);
+}
+
+//************************************************************************************
+//Function: the element array binding is VAO state, both layouts share the index buffer
+GLvoid CGeometryArena::__bindIndexBuffer()
+{
+	for (const SLayout& Layout : m_Layouts)
+	{
+		if (!Layout.VAO)
+			continue;
+		glBindVertexArray(Layout.VAO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_Indices.Buffer);
+	}
+	glBindVertexArray(0);
+}
+
+//************************************************************************************
+//Function: true when the buffer was replaced by a larger one
+bool CGeometryArena::__reserve(SBuffer& vioBuffer, size_t vSize)
+{
+	if (vSize <= vioBuffer.Capacity)
+		return false;
+
+	const size_t Capacity = std::max(std::max(vSize, vioBuffer.Capacity * 2), MIN_BUFFER_SIZE);
+	GLuint Buffer = 0;
+	glGenBuffers(1, &Buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, Buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, Capacity, nullptr, GL_STATIC_DRAW);
+	if (vioBuffer.Buffer)
+	{
+		glBindBuffer(GL_COPY_READ_BUFFER, vioBuffer.Buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, vioBuffer.Size);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glDeleteBuffers(1, &vioBuffer.Buffer);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	vioBuffer.Buffer = Buffer;
+	vioBuffer.Capacity = Capacity;
+	return true;
+}
+
+//************************************************************************************
+//Function:
+GLvoid CGeometryArena::__upload(SBuffer& vioBuffer, size_t vOffset, size_t vSize, const GLvoid* vData)
+{
+	if (vSize == 0)
+		return;
+	glBindBuffer(GL_COPY_WRITE_BUFFER, vioBuffer.Buffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, vOffset, vSize, vData);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	++fetchDriverCallCounters().BufferUploads;
+}
@@ -0,0 +1,58 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) Elay Pu. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+#include <GL/glew.h>
+#include <cstddef>
+
+//Where a mesh lives in the geometry arena. The indices of a mesh stay relative to its first vertex,
+//BaseVertex moves them, so meshes of up to 64K vertices keep their 16-bit indices.
+struct SGeometryAllocation
+{
+	GLint  BaseVertex = 0;
+	GLuint FirstIndex = 0;		//in elements of IndexType
+	GLenum IndexType = GL_UNSIGNED_INT;
+	bool   IsVertexPacked = false;
+};
+
+//Sub-allocates the vertices of every mesh from one buffer per vertex layout (SMeshVertex and SPackedMeshVertex)
+//and their indices from a single buffer holding 16 and 32-bit ranges side by side. Each layout has one VAO,
+//so any set of meshes of one layout and index type is drawn with a single glMultiDrawElementsIndirect.
+//Meshes are never freed, like the per mesh VAOs the arena replaces; a full buffer is reallocated at
+//twice the size and copied on the GPU.
+class CGeometryArena
+{
+public:
+	CGeometryArena() = default;
+
+	SGeometryAllocation allocate(const GLvoid* vVertices, size_t vVertexCount, bool vIsVertexPacked, const GLvoid* vIndices, size_t vIndexCount, GLenum vIndexType);
+
+	GLuint getVAO(bool vIsVertexPacked) const { return m_Layouts[vIsVertexPacked].VAO; }
+	size_t getUsedBytes() const { return m_Layouts[0].Vertices.Size + m_Layouts[1].Vertices.Size + m_Indices.Size; }
+	size_t getCapacityBytes() const { return m_Layouts[0].Vertices.Capacity + m_Layouts[1].Vertices.Capacity + m_Indices.Capacity; }
+
+private:
+	static const size_t MIN_BUFFER_SIZE = 4 << 20;
+
+	struct SBuffer
+	{
+		GLuint Buffer = 0;
+		size_t Size = 0;
+		size_t Capacity = 0;
+	};
+
+	struct SLayout
+	{
+		SBuffer Vertices;
+		GLuint  VAO = 0;
+	};
+
+	SLayout m_Layouts[2];	//indexed by IsVertexPacked
+	SBuffer m_Indices;
+
+	GLvoid __createVAO(bool vIsVertexPacked);
+	GLvoid __bindIndexBuffer();
+	static bool __reserve(SBuffer& vioBuffer, size_t vSize);
+	static GLvoid __upload(SBuffer& vioBuffer, size_t vOffset, size_t vSize, const GLvoid* vData);
+};
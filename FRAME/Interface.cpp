@@ -53,6 +53,20 @@ int ElayGraphics::App::getFramesPerSecond()
 	return CApp::getOrCreateInstance()->getFramesPerSecond();
 }
 
+//************************************************************************************
+//Function:
+void ElayGraphics::App::setSchedulerBenchmark(bool vRunBenchmark)
+{
+	CApp::getOrCreateInstance()->setSchedulerBenchmark(vRunBenchmark);
+}
+
+//************************************************************************************
+//Function:
+void ElayGraphics::App::setDriverCallLog(bool vLogDriverCalls)
+{
+	CApp::getOrCreateInstance()->setDriverCallLog(vLogDriverCalls);
+}
+
 //************************************************************************************
 //Function:
 int ElayGraphics::WINDOW_KEYWORD::getWindowWidth()
@@ -116,6 +130,27 @@ void ElayGraphics::COMPONENT_CONFIG::setIsEnableGUI(bool vIsEnableGUI)
 	IS_ENABLE_GUI = vIsEnableGUI;
 }
 
+//************************************************************************************
+//Function:
+void ElayGraphics::COMPONENT_CONFIG::setIsPackMeshVertices(bool vIsPackMeshVertices)
+{
+	IS_PACK_MESH_VERTICES = vIsPackMeshVertices;
+}
+
+//************************************************************************************
+//Function:
+void ElayGraphics::COMPONENT_CONFIG::setIsCompressTextures(bool vIsCompressTextures)
+{
+	IS_COMPRESS_TEXTURES = vIsCompressTextures;
+}
+
+//************************************************************************************
+//Function:
+void ElayGraphics::COMPONENT_CONFIG::setIsAllowBC1Textures(bool vIsAllowBC1Textures)
+{
+	IS_ALLOW_BC1_TEXTURES = vIsAllowBC1Textures;
+}
+
 //************************************************************************************
 //Function:
 const glm::dvec3& ElayGraphics::Camera::getMainCameraPos()
@@ -246,6 +281,14 @@ const std::shared_ptr<IGameObject>& ElayGraphics::ResourceManager::getGameObject
 	return CResourceManager::getOrCreateInstance()->getGameObjectByName(vGameObjectName);
 }
 
+//************************************************************************************
+//Function:
+std::vector<std::shared_ptr<IGameObject>> ElayGraphics::ResourceManager::getGameObjects()
+{
+	const auto& GameObjectSet = CResourceManager::getOrCreateInstance()->getGameObjectSet();
+	return std::vector<std::shared_ptr<IGameObject>>(GameObjectSet.begin(), GameObjectSet.end());
+}
+
 //************************************************************************************
 //Function:
 void ElayGraphics::ResourceManager::registerSharedData(const std::string& vDataName, boost::any vData)
@@ -281,6 +324,13 @@ const std::shared_ptr<CModel>& ElayGraphics::ResourceManager::getOrCreateModel(c
 	return CResourceManager::getOrCreateInstance()->getOrCreateModel(vModelPath);
 }
 
+//************************************************************************************
+//Function:
+const std::shared_ptr<CModel>& ElayGraphics::ResourceManager::getOrCreateModelAsync(const std::string &vModelPath)
+{
+	return CResourceManager::getOrCreateInstance()->getOrCreateModelAsync(vModelPath);
+}
+
 //************************************************************************************
 //Function:
 GLint ElayGraphics::ResourceManager::getOrCreateScreenQuadVAO()
@@ -302,6 +352,13 @@ const std::shared_ptr<CMainGUI>& ElayGraphics::ResourceManager::getOrCreateMainG
 	return CResourceManager::getOrCreateInstance()->getOrCreateMainGUI();
 }
 
+//************************************************************************************
+//Function:
+const std::shared_ptr<CJobSystem>& ElayGraphics::ResourceManager::getOrCreateJobSystem()
+{
+	return CResourceManager::getOrCreateInstance()->getOrCreateJobSystem();
+}
+
 //************************************************************************************
 //Function:
 const boost::any& ElayGraphics::ResourceManager::getSharedDataByName(const std::string &vDataName)
@@ -316,6 +373,13 @@ void ElayGraphics::ResourceManager::updateSharedDataByName(const std::string& vD
 	CResourceManager::getOrCreateInstance()->updateSharedDataByName(vDataName, vData);
 }
 
+//************************************************************************************
+//Function:
+boost::any* ElayGraphics::ResourceManager::internSharedData(const std::string& vDataName)
+{
+	return CResourceManager::getOrCreateInstance()->internSharedData(vDataName);
+}
+
 //************************************************************************************
 //Function:
 int ElayGraphics::InputManager::getKeyStatus(int vKey)
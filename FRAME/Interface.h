@@ -15,6 +15,7 @@ class IGUI;
 class CModel;
 class CMainGUI;
 class CCamera;
+class CJobSystem;
 
 namespace ElayGraphics
 {
@@ -26,6 +27,8 @@ namespace ElayGraphics
 		FRAME_DLLEXPORTS double getDeltaTime();
 		FRAME_DLLEXPORTS double getCurrentTime();
 		FRAME_DLLEXPORTS double getFrameRateInMilliSecond();
+		FRAME_DLLEXPORTS void   setSchedulerBenchmark(bool vRunBenchmark);	//logs the render pass scheduling cost once, on the next frame
+		FRAME_DLLEXPORTS void   setDriverCallLog(bool vLogDriverCalls);		//logs the counted driver calls of every pass once, on the next frame
 	}
 
 	namespace WINDOW_KEYWORD
@@ -42,6 +45,9 @@ namespace ElayGraphics
 	namespace COMPONENT_CONFIG
 	{
 		FRAME_DLLEXPORTS void setIsEnableGUI(bool vIsEnableGUI);
+		FRAME_DLLEXPORTS void setIsPackMeshVertices(bool vIsPackMeshVertices);	//meshes created afterwards upload SPackedMeshVertex
+		FRAME_DLLEXPORTS void setIsCompressTextures(bool vIsCompressTextures);	//models loaded afterwards upload their textures from the DDS caches MeshConverter writes
+		FRAME_DLLEXPORTS void setIsAllowBC1Textures(bool vIsAllowBC1Textures);	//opaque color textures take BC1 instead of BC7
 	}
 
 	namespace Camera
@@ -73,8 +79,11 @@ namespace ElayGraphics
 		FRAME_DLLEXPORTS int								 getOrCreateScreenQuadVAO();
 		FRAME_DLLEXPORTS int								 getOrCreateCubeVAO();
 		FRAME_DLLEXPORTS const std::shared_ptr<CMainGUI>&	 getOrCreateMainGUI();
+		FRAME_DLLEXPORTS const std::shared_ptr<CJobSystem>&	 getOrCreateJobSystem();
 		FRAME_DLLEXPORTS const std::shared_ptr<IGameObject>& getGameObjectByName(const std::string &vGameObjectName);
+		FRAME_DLLEXPORTS std::vector<std::shared_ptr<IGameObject>> getGameObjects();	//in execution order
 		FRAME_DLLEXPORTS const std::shared_ptr<CModel>&		 getOrCreateModel(const std::string &vModelPath);
+		FRAME_DLLEXPORTS const std::shared_ptr<CModel>&		 getOrCreateModelAsync(const std::string &vModelPath);
 		FRAME_DLLEXPORTS const boost::any&					 getSharedDataByName(const std::string &vDataName);
 
 		FRAME_DLLEXPORTS void registerSharedData(const std::string& vDataName, boost::any vData);
@@ -83,6 +92,7 @@ namespace ElayGraphics
 		FRAME_DLLEXPORTS void registerSubGUI(const std::shared_ptr<IGUI> &vSubGUI);
 
 		FRAME_DLLEXPORTS void updateSharedDataByName(const std::string& vDataName, const boost::any& vData);
+		FRAME_DLLEXPORTS boost::any* internSharedData(const std::string& vDataName);
 
 		template <typename TDataType>
 		TDataType getSharedDataByName(const std::string &vDataName)
@@ -98,6 +108,44 @@ namespace ElayGraphics
 			vioDataChanged = !(LastData == Data);
 			return Data;
 		}
+
+		//Typed handle on one shared data slot. Intern the name once (e.g. in initV) and get/set
+		//skip the map lookup and the copy made by any_cast. The slot is created on demand, so a
+		//handle may be interned before the owning pass registers the data; get() on a slot nobody
+		//registered, or one holding another type, throws boost::bad_any_cast as any_cast does.
+		//A reference returned by get() only lives until the next updateSharedDataByName on the same name.
+		template <typename TDataType>
+		class SharedDataHandle
+		{
+		public:
+			SharedDataHandle() = default;
+			explicit SharedDataHandle(const std::string& vDataName) : m_pData(internSharedData(vDataName)) {}
+
+			bool isValid() const { return m_pData && !m_pData->empty(); }
+
+			const TDataType& get() const
+			{
+				_ASSERT(m_pData);
+				return boost::any_cast<const TDataType&>(*m_pData);
+			}
+
+			void set(const TDataType& vData)
+			{
+				_ASSERT(m_pData);
+				if (m_pData->empty())
+				{
+					*m_pData = vData;
+					return;
+				}
+				boost::any_cast<TDataType&>(*m_pData) = vData;
+			}
+
+			const TDataType& operator*() const { return get(); }
+			const TDataType* operator->() const { return &get(); }
+
+		private:
+			boost::any* m_pData = nullptr;
+		};
 	}
 
 	namespace InputManager
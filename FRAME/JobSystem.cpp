@@ -0,0 +1,173 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) Elay Pu. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "JobSystem.h"
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <crtdbg.h>
+
+namespace
+{
+	const size_t INVALID_WORKER_INDEX = std::numeric_limits<size_t>::max();
+	thread_local size_t t_WorkerIndex = INVALID_WORKER_INDEX;
+}
+
+CJobSystem::CJobSystem(size_t vThreadCount)
+{
+	if (vThreadCount == 0)
+		vThreadCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+
+	m_Queues.reserve(vThreadCount);
+	for (size_t i = 0; i < vThreadCount; ++i)
+		m_Queues.push_back(std::make_unique<SWorkQueue>());
+	m_Workers.reserve(vThreadCount);
+	for (size_t i = 0; i < vThreadCount; ++i)
+		m_Workers.emplace_back(&CJobSystem::__workerLoop, this, i);
+}
+
+CJobSystem::~CJobSystem()
+{
+	{
+		std::lock_guard<std::mutex> Lock(m_WakeMutex);
+		m_IsStopping = true;
+	}
+	m_WakeCondition.notify_all();
+	for (auto& Worker : m_Workers)
+		Worker.join();
+}
+
+//************************************************************************************
+//Function:
+void CJobSystem::submit(const std::shared_ptr<CJobGroup>& vGroup, TJob vJob)
+{
+	_ASSERT(vGroup && vJob);
+	vGroup->m_PendingJobCount++;
+
+	const size_t QueueIndex = t_WorkerIndex != INVALID_WORKER_INDEX ? t_WorkerIndex : m_NextQueue++ % m_Queues.size();
+	{
+		//counted under the queue lock, so __popJob never takes the job before it is counted
+		std::lock_guard<std::mutex> Lock(m_Queues[QueueIndex]->Mutex);
+		m_Queues[QueueIndex]->Jobs.push_back({ vGroup, std::move(vJob) });
+		m_QueuedJobCount++;
+		vGroup->m_QueuedJobCount++;
+	}
+	//taking the locks orders the counts before a sleeper's predicate check, no wakeup is lost
+	{
+		std::lock_guard<std::mutex> Lock(m_WakeMutex);
+	}
+	m_WakeCondition.notify_one();
+	{
+		std::lock_guard<std::mutex> Lock(vGroup->m_WaitMutex);
+	}
+	vGroup->m_WaitCondition.notify_all();
+}
+
+//************************************************************************************
+//Function:
+void CJobSystem::parallelFor(const std::shared_ptr<CJobGroup>& vGroup, size_t vBegin, size_t vEnd, size_t vGrainSize, const std::function<void(size_t, size_t)>& vBody)
+{
+	vGrainSize = std::max<size_t>(1, vGrainSize);
+	for (size_t Begin = vBegin; Begin < vEnd; Begin += vGrainSize)
+	{
+		const size_t End = std::min(vEnd, Begin + vGrainSize);
+		submit(vGroup, [vBody, Begin, End]() { vBody(Begin, End); });
+	}
+}
+
+//************************************************************************************
+//Function: helps with the queued jobs of vGroup only, a foreign job could be an import or a transcode
+//that stalls the render thread or nests waits without bound.
+void CJobSystem::wait(const std::shared_ptr<CJobGroup>& vGroup)
+{
+	while (!vGroup->isDone())
+	{
+		SJob Job;
+		if (__popJob(t_WorkerIndex, vGroup.get(), Job))
+		{
+			__runJob(Job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> Lock(vGroup->m_WaitMutex);
+		vGroup->m_WaitCondition.wait(Lock, [&vGroup]() { return vGroup->isDone() || vGroup->m_QueuedJobCount > 0; });
+	}
+}
+
+//************************************************************************************
+//Function:
+void CJobSystem::__workerLoop(size_t vWorkerIndex)
+{
+	t_WorkerIndex = vWorkerIndex;
+	while (true)
+	{
+		SJob Job;
+		if (__popJob(vWorkerIndex, nullptr, Job))
+		{
+			__runJob(Job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> Lock(m_WakeMutex);
+		m_WakeCondition.wait(Lock, [this]() { return m_IsStopping || m_QueuedJobCount > 0; });
+		if (m_IsStopping && m_QueuedJobCount == 0)
+			return;
+	}
+}
+
+//************************************************************************************
+//Function: own queue first (LIFO, still warm in cache), then steal the oldest job of the others.
+//A non-null vGroup only takes jobs of that group.
+bool CJobSystem::__popJob(size_t vWorkerIndex, const CJobGroup* vGroup, SJob& voJob)
+{
+	const auto IsWanted = [vGroup](const SJob& vJob) { return !vGroup || vJob.pGroup.get() == vGroup; };
+	const auto TakeJob = [this, &voJob](std::deque<SJob>& vioJobs, std::deque<SJob>::iterator vIter)
+	{
+		voJob = std::move(*vIter);
+		vioJobs.erase(vIter);
+		m_QueuedJobCount--;
+		voJob.pGroup->m_QueuedJobCount--;
+	};
+
+	if (vWorkerIndex != INVALID_WORKER_INDEX)
+	{
+		SWorkQueue& Queue = *m_Queues[vWorkerIndex];
+		std::lock_guard<std::mutex> Lock(Queue.Mutex);
+		auto Iter = std::find_if(Queue.Jobs.rbegin(), Queue.Jobs.rend(), IsWanted);
+		if (Iter != Queue.Jobs.rend())
+		{
+			TakeJob(Queue.Jobs, std::next(Iter).base());
+			return true;
+		}
+	}
+
+	const size_t QueueCount = m_Queues.size();
+	const size_t Start = vWorkerIndex != INVALID_WORKER_INDEX ? vWorkerIndex + 1 : 0;
+	for (size_t i = 0; i < QueueCount; ++i)
+	{
+		SWorkQueue& Queue = *m_Queues[(Start + i) % QueueCount];
+		std::lock_guard<std::mutex> Lock(Queue.Mutex);
+		auto Iter = std::find_if(Queue.Jobs.begin(), Queue.Jobs.end(), IsWanted);
+		if (Iter != Queue.Jobs.end())
+		{
+			TakeJob(Queue.Jobs, Iter);
+			return true;
+		}
+	}
+	return false;
+}
+
+//************************************************************************************
+//Function:
+void CJobSystem::__runJob(SJob& vioJob)
+{
+	if (!vioJob.pGroup->isCancelled())
+		vioJob.Job();
+	CJobGroup& Group = *vioJob.pGroup;
+	if (--Group.m_PendingJobCount == 0)
+	{
+		std::lock_guard<std::mutex> Lock(Group.m_WaitMutex);
+		Group.m_WaitCondition.notify_all();
+	}
+}
@@ -0,0 +1,81 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) Elay Pu. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "FRAME_EXPORTS.h"
+
+//A set of jobs that can be waited on or cancelled together. Cancelled jobs that have not
+//started yet are dropped, running ones can poll isCancelled() to bail out early. A waiter
+//only ever runs jobs of the group it waits on, and sleeps on the group when none is queued.
+class FRAME_DLLEXPORTS CJobGroup
+{
+public:
+	void cancel() { m_IsCancelled = true; }
+	bool isCancelled() const { return m_IsCancelled; }
+	bool isDone() const { return m_PendingJobCount == 0; }
+
+private:
+	friend class CJobSystem;
+
+	std::atomic<int>  m_PendingJobCount{ 0 };
+	std::atomic<int>  m_QueuedJobCount{ 0 };	//the pending jobs no thread has taken yet
+	std::atomic<bool> m_IsCancelled{ false };
+	std::mutex m_WaitMutex;
+	std::condition_variable m_WaitCondition;	//a job of the group was queued or the last one finished
+};
+
+//Persistent work-stealing thread pool. Every worker owns a queue: it pops its own jobs
+//from the back and steals from the front of the others when it runs dry. Jobs submitted
+//by a worker go to its own queue, the others are spread round robin.
+class FRAME_DLLEXPORTS CJobSystem
+{
+public:
+	using TJob = std::function<void()>;
+
+	explicit CJobSystem(size_t vThreadCount = 0);   //0: one worker per hardware thread minus the main thread
+	~CJobSystem();
+
+	CJobSystem(const CJobSystem&) = delete;
+	CJobSystem& operator=(const CJobSystem&) = delete;
+
+	std::shared_ptr<CJobGroup> createGroup() const { return std::make_shared<CJobGroup>(); }
+	void submit(const std::shared_ptr<CJobGroup>& vGroup, TJob vJob);
+	void parallelFor(const std::shared_ptr<CJobGroup>& vGroup, size_t vBegin, size_t vEnd, size_t vGrainSize, const std::function<void(size_t, size_t)>& vBody);
+	void wait(const std::shared_ptr<CJobGroup>& vGroup);   //the calling thread runs queued jobs of vGroup while waiting
+
+	size_t getThreadCount() const { return m_Workers.size(); }
+
+private:
+	struct SJob
+	{
+		std::shared_ptr<CJobGroup> pGroup;
+		TJob Job;
+	};
+
+	struct SWorkQueue
+	{
+		std::mutex Mutex;
+		std::deque<SJob> Jobs;
+	};
+
+	void __workerLoop(size_t vWorkerIndex);
+	bool __popJob(size_t vWorkerIndex, const CJobGroup* vGroup, SJob& voJob);
+	void __runJob(SJob& vioJob);
+
+	std::vector<std::unique_ptr<SWorkQueue>> m_Queues;
+	std::vector<std::thread> m_Workers;
+	std::mutex m_WakeMutex;
+	std::condition_variable m_WakeCondition;
+	std::atomic<size_t> m_QueuedJobCount{ 0 };
+	std::atomic<size_t> m_NextQueue{ 0 };
+	bool m_IsStopping = false;
+};
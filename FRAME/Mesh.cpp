@@ -7,10 +7,94 @@
 #include "Utils.h"
 #include "Shader.h"
 #include "AABB.h"
+#include "ResourceManager.h"
+#include "MultiDrawBatch.h"
+#include "GLStateCache.h"
+#include <GLM/gtc/packing.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
 
-CMesh::CMesh(const std::vector<SMeshVertex>& vVertices, const std::vector<GLint>& vIndices, const std::vector<SMeshTexture>& vTexture, const SMeshMatProperties& vMeshMatProperties, int vMeshId)
-	:m_Vertices(vVertices), m_Indices(vIndices), m_Textures(vTexture), m_MeshMatProperties(vMeshMatProperties), m_MeshId(vMeshId)
+namespace
 {
+	int16_t toSnorm16(float vValue)
+	{
+		return static_cast<int16_t>(std::round(std::min(std::max(vValue, -1.0f), 1.0f) * 32767.0f));
+	}
+
+	//octahedral mapping of a unit vector, a zero vector ends up as +z
+	void encodeOctahedral(const glm::vec3& vDirection, int16_t voEncoded[2])
+	{
+		const float L1Norm = std::abs(vDirection.x) + std::abs(vDirection.y) + std::abs(vDirection.z);
+		glm::vec2 Encoded = L1Norm > 0.0f ? glm::vec2(vDirection.x, vDirection.y) / L1Norm : glm::vec2(0.0f);
+		if (vDirection.z < 0.0f)
+		{
+			const glm::vec2 Sign(Encoded.x >= 0.0f ? 1.0f : -1.0f, Encoded.y >= 0.0f ? 1.0f : -1.0f);
+			Encoded = (glm::vec2(1.0f) - glm::abs(glm::vec2(Encoded.y, Encoded.x))) * Sign;
+		}
+		voEncoded[0] = toSnorm16(Encoded.x);
+		voEncoded[1] = toSnorm16(Encoded.y);
+	}
+
+	//sign of dot(cross(N, T), B) per vertex, B taken from the uv derivatives of the triangles around it
+	std::vector<float> computeTangentHandedness(const SMeshVertex* vVertices, size_t vVertexCount, const GLint* vIndices, size_t vIndexCount)
+	{
+		std::vector<float> Handedness(vVertexCount, 0.0f);
+		for (size_t i = 0; i + 2 < vIndexCount; i += 3)
+		{
+			const SMeshVertex& V0 = vVertices[vIndices[i]];
+			const SMeshVertex& V1 = vVertices[vIndices[i + 1]];
+			const SMeshVertex& V2 = vVertices[vIndices[i + 2]];
+			const glm::vec3 Edge1 = V1.Position - V0.Position, Edge2 = V2.Position - V0.Position;
+			const glm::vec2 DeltaUV1 = V1.TexCoords - V0.TexCoords, DeltaUV2 = V2.TexCoords - V0.TexCoords;
+			const float Determinant = DeltaUV1.x * DeltaUV2.y - DeltaUV2.x * DeltaUV1.y;
+			if (Determinant == 0.0f)
+				continue;
+			const glm::vec3 Bitangent = (Edge2 * DeltaUV1.x - Edge1 * DeltaUV2.x) / Determinant;
+			for (size_t k = 0; k < 3; ++k)
+			{
+				const SMeshVertex& Vertex = vVertices[vIndices[i + k]];
+				Handedness[vIndices[i + k]] += glm::dot(glm::cross(Vertex.Normal, Vertex.Tangent), Bitangent);
+			}
+		}
+		return Handedness;
+	}
+
+	std::vector<SPackedMeshVertex> packMeshVertices(const SMeshVertex* vVertices, size_t vVertexCount, const GLint* vIndices, size_t vIndexCount, const glm::vec3& vMin, const glm::vec3& vExtent)
+	{
+		const std::vector<float> Handedness = computeTangentHandedness(vVertices, vVertexCount, vIndices, vIndexCount);
+		const glm::vec3 InverseExtent(vExtent.x > 0.0f ? 1.0f / vExtent.x : 0.0f, vExtent.y > 0.0f ? 1.0f / vExtent.y : 0.0f, vExtent.z > 0.0f ? 1.0f / vExtent.z : 0.0f);
+		std::vector<SPackedMeshVertex> PackedVertices(vVertexCount);
+		for (size_t i = 0; i < vVertexCount; ++i)
+		{
+			const SMeshVertex& Vertex = vVertices[i];
+			SPackedMeshVertex& Packed = PackedVertices[i];
+			const glm::vec3 Position = glm::clamp((Vertex.Position - vMin) * InverseExtent, 0.0f, 1.0f);
+			Packed.Position[0] = static_cast<uint16_t>(std::round(Position.x * 65535.0f));
+			Packed.Position[1] = static_cast<uint16_t>(std::round(Position.y * 65535.0f));
+			Packed.Position[2] = static_cast<uint16_t>(std::round(Position.z * 65535.0f));
+			Packed.Position[3] = Handedness[i] < 0.0f ? 0 : 65535;
+			encodeOctahedral(Vertex.Normal, Packed.Normal);
+			encodeOctahedral(Vertex.Tangent, Packed.Tangent);
+			Packed.TexCoords[0] = glm::packHalf1x16(Vertex.TexCoords.x);
+			Packed.TexCoords[1] = glm::packHalf1x16(Vertex.TexCoords.y);
+		}
+		return PackedVertices;
+	}
+}
+
+CMesh::CMesh(const std::shared_ptr<const void>& vStreamOwner, const SMeshVertex* vVertices, size_t vVertexCount, const GLint* vIndices, size_t vIndexCount,
+	std::vector<SMeshLod>&& vLods, std::vector<SMeshTexture>&& vTextures, const SMeshMatProperties& vMeshMatProperties, const std::shared_ptr<CAABB>& vBounding, int vMeshId)
+	:m_pStreamOwner(vStreamOwner), m_pVertices(vVertices), m_pIndices(vIndices), m_VertexCount(vVertexCount), m_IndexCount(vIndexCount), m_Lods(std::move(vLods)),
+	m_Textures(std::move(vTextures)), m_pBounding(vBounding), m_MeshMatProperties(vMeshMatProperties), m_MeshId(vMeshId)
+{
+	if (m_Lods.empty())
+	{
+		SMeshLod Lod;
+		Lod.IndexCount = static_cast<uint32_t>(m_IndexCount);
+		m_Lods.push_back(Lod);
+	}
 	__init();
 }
 
@@ -22,7 +106,30 @@ CMesh::~CMesh()
 //Function:
 GLvoid CMesh::__init()
 {
-	m_VAO = createVAO(&m_Vertices[0], static_cast<int>(m_Vertices.size() * sizeof(SMeshVertex)), { 3,3,2,3 }, &m_Indices[0], static_cast<int>(m_Indices.size() * sizeof(GLint)));
+	//a mesh with at most 64K vertices draws with 16-bit indices, the CPU side stream stays 32-bit
+	std::vector<GLushort> ShortIndices;
+	const GLvoid* pIndices = m_pIndices;
+	if (m_VertexCount <= 65536)
+	{
+		ShortIndices.assign(m_pIndices, m_pIndices + m_IndexCount);
+		pIndices = ShortIndices.data();
+		m_IndexType = GL_UNSIGNED_SHORT;
+	}
+
+	const std::shared_ptr<CGeometryArena> pGeometryArena = CResourceManager::getOrCreateInstance()->fetchOrCreateGeometryArena();
+	m_IsVertexPacked = ElayGraphics::COMPONENT_CONFIG::IS_PACK_MESH_VERTICES;
+	if (!m_IsVertexPacked)
+	{
+		m_GeometryAllocation = pGeometryArena->allocate(m_pVertices, m_VertexCount, false, pIndices, m_IndexCount, m_IndexType);
+		return;
+	}
+
+	//the float stream stays on the CPU side for getTriangle and the bounding box
+	const std::shared_ptr<CAABB> pBounding = getOrCreateBounding();
+	m_PositionBias = pBounding->getMin();
+	m_PositionScale = pBounding->getMax() - pBounding->getMin();
+	const std::vector<SPackedMeshVertex> PackedVertices = packMeshVertices(m_pVertices, m_VertexCount, m_pIndices + m_Lods[0].IndexOffset, m_Lods[0].IndexCount, m_PositionBias, m_PositionScale);
+	m_GeometryAllocation = pGeometryArena->allocate(PackedVertices.data(), PackedVertices.size(), true, pIndices, m_IndexCount, m_IndexType);
 }
 
 //************************************************************************************
@@ -33,16 +140,15 @@ GLvoid CMesh::init(const CShader& vioShader)
 
 //************************************************************************************
 //Function:
-GLvoid CMesh::update(const CShader& vShader) const
+GLvoid CMesh::update(const CShader& vShader, size_t vLod) const
 {
 	//_WARNING(m_Textures.size() > 5, "Texture num of some mesh is greater than 5.");
 	if (m_Textures.size() > 0 && m_Textures[0].ID != -1)
 	{
+		CGLStateCache& StateCache = fetchGLStateCache();
 		for (int i = 0; i < m_Textures.size(); ++i)
-		{
-			glActiveTexture(GL_TEXTURE0 + i);
-			glBindTexture(GL_TEXTURE_2D, m_Textures[i].ID);
-		}
+			StateCache.bindTexture(i, GL_TEXTURE_2D, m_Textures[i].ID);
+		StateCache.parkTextureUnit();
 	}
 	else
 	{
@@ -67,15 +173,71 @@ GLvoid CMesh::update(const CShader& vShader) const
 			vShader.setFloatUniformValue(RefractiLoc, m_MeshMatProperties.Refracti);
 	}
 
+	//shaders without the decode inputs just skip this, -1 locations are ignored
+	int IsVertexPackedLoc = vShader.getUniformId(IS_VERTEX_PACKED);
+	if (IsVertexPackedLoc >= 0)
+	{
+		vShader.setIntUniformValue(IsVertexPackedLoc, m_IsVertexPacked);
+		vShader.setFloatUniformValue(vShader.getUniformId(VERTEX_POSITION_SCALE), m_PositionScale.x, m_PositionScale.y, m_PositionScale.z);
+		vShader.setFloatUniformValue(vShader.getUniformId(VERTEX_POSITION_BIAS), m_PositionBias.x, m_PositionBias.y, m_PositionBias.z);
+	}
+
 	int MeshIdLoc = vShader.getCommonUniformId(MESH_ID);
 	if (MeshIdLoc)
 		vShader.setIntUniformValue(MeshIdLoc, m_MeshId);
 
-	glBindVertexArray(m_VAO);
-	glDrawElements(GL_TRIANGLES, static_cast<int>(m_Indices.size()), GL_UNSIGNED_INT, 0);
+	glBindVertexArray(CResourceManager::getOrCreateInstance()->fetchOrCreateGeometryArena()->getVAO(m_IsVertexPacked));
+	const SMeshLod& Lod = m_Lods[std::min(vLod, m_Lods.size() - 1)];
+	const size_t IndexSize = m_IndexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+	glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<int>(Lod.IndexCount), m_IndexType,
+		(GLvoid*)(intptr_t)((m_GeometryAllocation.FirstIndex + Lod.IndexOffset) * IndexSize), m_GeometryAllocation.BaseVertex);
+	++fetchDriverCallCounters().DrawCalls;
 	glBindVertexArray(0);
 }
 
+//************************************************************************************
+//Function: the textures and material uniforms of update() are left out, see CMultiDrawBatch
+GLvoid CMesh::appendDraw(CMultiDrawBatch& voBatch, size_t vLod, const glm::mat4& vModelMatrix) const
+{
+	voBatch.append(*this, vLod, vModelMatrix);
+}
+
+//************************************************************************************
+//Function: the AABB corners are projected to a screen rectangle, its larger side stands for the AABB diagonal, so
+//an object space error becomes Error / Diagonal * Side pixels. The full mesh is kept while the camera is inside the box.
+size_t CMesh::selectLod(const SLodSelection& vSelection) const
+{
+	if (m_Lods.size() < 2 || !m_pBounding)
+		return 0;
+
+	const glm::vec3& Min = m_pBounding->getMin();
+	const glm::vec3& Max = m_pBounding->getMax();
+	glm::vec2 ScreenMin(FLT_MAX), ScreenMax(-FLT_MAX);
+	for (int i = 0; i < 8; ++i)
+	{
+		const glm::vec4 Corner(i & 1 ? Max.x : Min.x, i & 2 ? Max.y : Min.y, i & 4 ? Max.z : Min.z, 1.0f);
+		const glm::vec4 Clip = vSelection.ViewProjectionMatrix * Corner;
+		if (Clip.w <= 0.0f)
+			return 0;
+		const glm::vec2 Ndc = glm::vec2(Clip.x, Clip.y) / Clip.w;
+		ScreenMin = glm::min(ScreenMin, Ndc);
+		ScreenMax = glm::max(ScreenMax, Ndc);
+	}
+	ScreenMin = glm::clamp(ScreenMin, -1.0f, 1.0f);
+	ScreenMax = glm::clamp(ScreenMax, -1.0f, 1.0f);
+	const glm::vec2 ScreenSize = (ScreenMax - ScreenMin) * 0.5f * vSelection.ViewportSize;
+	const float ScreenSide = std::max(ScreenSize.x, ScreenSize.y);
+	const float Diagonal = glm::length(Max - Min);
+	if (Diagonal <= 0.0f)
+		return 0;
+
+	const float MaxError = vSelection.MaxPixelError * std::exp2(vSelection.Bias) * Diagonal / std::max(ScreenSide, 1.0f);
+	size_t Lod = 0;
+	while (Lod + 1 < m_Lods.size() && m_Lods[Lod + 1].Error <= MaxError)
+		++Lod;
+	return Lod;
+}
+
 //************************************************************************************
 //Function:
 std::shared_ptr<CAABB> CMesh::getOrCreateBounding()
@@ -83,10 +245,10 @@ std::shared_ptr<CAABB> CMesh::getOrCreateBounding()
 	if (!m_pBounding)
 	{
 		std::vector<glm::vec3> Points;
-		size_t VerticesNum = m_Vertices.size();
-		for (size_t i = 0; i < VerticesNum; ++i)
+		Points.reserve(m_VertexCount);
+		for (size_t i = 0; i < m_VertexCount; ++i)
 		{
-			Points.push_back(m_Vertices[i].Position);
+			Points.push_back(m_pVertices[i].Position);
 		}
 		m_pBounding = std::make_shared<CAABB>(Points);
 	}
@@ -98,8 +260,8 @@ std::shared_ptr<CAABB> CMesh::getOrCreateBounding()
 std::vector<glm::vec3> CMesh::getTriangle()
 {
 	std::vector<glm::vec3> Triangle;
-	size_t VerticesNum = m_Vertices.size();
-	for (size_t i = 0; i < VerticesNum; ++i)
-		Triangle.push_back(m_Vertices[i].Position);
+	Triangle.reserve(m_VertexCount);
+	for (size_t i = 0; i < m_VertexCount; ++i)
+		Triangle.push_back(m_pVertices[i].Position);
 	return Triangle;
 }
\ No newline at end of file
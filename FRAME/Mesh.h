@@ -11,6 +11,8 @@
 #include <vector>
 #include <memory>
 #include <map>
+#include <cstdint>
+#include "GeometryArena.h"
 
 #define MESH_ID			"u_MeshId"
 #define SHININESS		"u_Shininess"
@@ -23,9 +25,13 @@
 #define NORMAL_TEX		"u_NormalTexture"
 #define ROUGHNESS_TEX	"u_RoughnessTexture"
 #define METALLIC_TEX	"u_MetallicTexture"
+#define IS_VERTEX_PACKED		"u_IsVertexPacked"
+#define VERTEX_POSITION_SCALE	"u_VertexPositionScale"
+#define VERTEX_POSITION_BIAS	"u_VertexPositionBias"
 
 class CShader;
 class CAABB;
+class CMultiDrawBatch;
 
 struct SMeshVertex
 {
@@ -37,6 +43,17 @@ struct SMeshVertex
 	SMeshVertex() {}
 };
 
+//GPU layout of SMeshVertex when COMPONENT_CONFIG::IS_PACK_MESH_VERTICES is set, 20 bytes instead of 44.
+//Position is unorm16 in the mesh AABB with the tangent handedness in w (0 for -1, 1 for +1),
+//Normal and Tangent are octahedral snorm16, TexCoords are half floats.
+struct SPackedMeshVertex
+{
+	uint16_t Position[4];
+	int16_t  Normal[2];
+	uint16_t TexCoords[2];
+	int16_t  Tangent[2];
+};
+
 struct SMeshTexture
 {
 	GLint ID = -1;
@@ -46,6 +63,25 @@ struct SMeshTexture
 	SMeshTexture() {}
 };
 
+//One level of detail of a mesh: a range of its index stream, all levels share the vertices.
+//Error is how far, in object space, the simplified surface strays from the full one.
+struct SMeshLod
+{
+	uint32_t IndexOffset = 0;
+	uint32_t IndexCount = 0;
+	float	 Error = 0.0f;
+};
+
+//How a pass picks the LOD of a mesh: its AABB is projected with ViewProjectionMatrix (model matrix included)
+//into ViewportSize pixels, the coarsest LOD whose error stays under MaxPixelError * 2^Bias pixels is drawn.
+struct SLodSelection
+{
+	glm::mat4 ViewProjectionMatrix = glm::mat4(1.0f);
+	glm::vec2 ViewportSize = glm::vec2(0.0f);
+	float MaxPixelError = 1.0f;
+	float Bias = 0.0f;
+};
+
 struct SMeshMatProperties
 {
 	glm::vec3 AmbientColor;
@@ -59,24 +95,49 @@ class CMesh
 {
 public:
 	CMesh() = default;
-	CMesh(const std::vector<SMeshVertex>& vVertices, const std::vector<GLint>& vIndices, const std::vector<SMeshTexture>& vTexture, const SMeshMatProperties& vMeshMatProperties, int vMeshId);
+	//vStreamOwner keeps vVertices and vIndices alive, either the mapped mesh cache or the imported mesh data.
+	//vIndices holds every LOD, an empty vLods means a single LOD over all of them.
+	CMesh(const std::shared_ptr<const void>& vStreamOwner, const SMeshVertex* vVertices, size_t vVertexCount, const GLint* vIndices, size_t vIndexCount,
+		std::vector<SMeshLod>&& vLods, std::vector<SMeshTexture>&& vTextures, const SMeshMatProperties& vMeshMatProperties, const std::shared_ptr<CAABB>& vBounding, int vMeshId);
 	~CMesh();
 	GLvoid init(const CShader& vioShader);
-	GLvoid update(const CShader& vShader) const;
+	GLvoid update(const CShader& vShader, size_t vLod = 0) const;
+	GLvoid appendDraw(CMultiDrawBatch& voBatch, size_t vLod, const glm::mat4& vModelMatrix) const;
+	GLvoid setTextures(std::vector<SMeshTexture>&& vTextures) { m_Textures = std::move(vTextures); }
 
 	std::shared_ptr<CAABB> getOrCreateBounding();
+	const std::shared_ptr<CAABB>& getBounding() const { return m_pBounding; }
 	std::vector<glm::vec3> getTriangle();
+	size_t selectLod(const SLodSelection& vSelection) const;
+	size_t getLodCount() const { return m_Lods.size(); }
+	const SMeshLod& getLod(size_t vLod) const { return m_Lods[vLod]; }
+	bool isVertexPacked() const { return m_IsVertexPacked; }
+	int  getMeshId() const { return m_MeshId; }
+	const SMeshMatProperties& getMeshMatProperties() const { return m_MeshMatProperties; }
+	const SGeometryAllocation& getGeometryAllocation() const { return m_GeometryAllocation; }
+	const glm::vec3& getPositionScale() const { return m_PositionScale; }
+	const glm::vec3& getPositionBias() const { return m_PositionBias; }
+	size_t getVertexBufferSize() const { return m_VertexCount * (m_IsVertexPacked ? sizeof(SPackedMeshVertex) : sizeof(SMeshVertex)); }
+	size_t getIndexBufferSize() const { return m_IndexCount * (m_IndexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint)); }
 private:
-	std::vector<SMeshVertex>	m_Vertices;
+	std::shared_ptr<const void>	m_pStreamOwner;
+	const SMeshVertex*			m_pVertices = nullptr;
+	const GLint*				m_pIndices = nullptr;
+	size_t						m_VertexCount = 0;
+	size_t						m_IndexCount = 0;
+	std::vector<SMeshLod>		m_Lods;
 	std::vector<SMeshTexture>	m_Textures;
-	std::vector<GLint>			m_Indices;
 	std::shared_ptr<CAABB>		m_pBounding;
 	SMeshMatProperties			m_MeshMatProperties;
-	GLint m_VAO = -1;
+	SGeometryAllocation			m_GeometryAllocation;	//vertices and indices live in the shared CGeometryArena
 	GLint m_AmbientColorLoc = -1;
 	GLint m_DiffuseColorLoc = -1;
 	GLint m_SpecularColorLoc = -1;
 	GLint m_MeshId = -1;
+	GLenum m_IndexType = GL_UNSIGNED_INT;
+	bool m_IsVertexPacked = false;
+	glm::vec3 m_PositionScale = glm::vec3(1.0f);	//object space position = bias + unorm position * scale
+	glm::vec3 m_PositionBias = glm::vec3(0.0f);
 
 	GLvoid __init();
 };
\ No newline at end of file
@@ -0,0 +1,458 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) Elay Pu. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "MeshCache.h"
+#include "JobSystem.h"
+#include "MeshOptimizer.h"
+#include <Assimp/Importer.hpp>
+#include <Assimp/scene.h>
+#include <Assimp/postprocess.h>
+#include <crtdbg.h>
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sys/stat.h>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const char MESH_CACHE_MAGIC[4] = { 'E', 'M', 'S', 'H' };
+	static_assert(sizeof(SMeshVertex) == 11 * sizeof(float), "the vertex stream is written and mapped as tightly packed SMeshVertex");
+
+	uint64_t alignOffset(uint64_t vOffset)
+	{
+		return (vOffset + CMeshCache::MESH_CACHE_ALIGNMENT - 1) & ~uint64_t(CMeshCache::MESH_CACHE_ALIGNMENT - 1);
+	}
+
+	bool querySourceStamp(const std::string& vPath, uint64_t& voSize, int64_t& voModifiedTime)
+	{
+#ifdef _WIN32
+		struct _stat64 Status;
+		if (_stat64(vPath.c_str(), &Status) != 0)
+			return false;
+#else
+		struct stat Status;
+		if (stat(vPath.c_str(), &Status) != 0)
+			return false;
+#endif
+		voSize = static_cast<uint64_t>(Status.st_size);
+		voModifiedTime = static_cast<int64_t>(Status.st_mtime);
+		return true;
+	}
+
+	uint64_t computeTextureBytes(const std::vector<SMeshTextureBinding>& vTextures)
+	{
+		uint64_t Bytes = 0;
+		for (const auto& Texture : vTextures)
+			Bytes += 2 * sizeof(uint32_t) + Texture.TexturePath.size() + Texture.TextureUniformName.size();
+		return Bytes;
+	}
+
+	//sizes are known up front, so the streams are filled in place instead of pushed back one by one
+	void processVertices(const aiMesh* vAiMesh, SMeshData& voMesh)
+	{
+		_ASSERT(vAiMesh);
+		const unsigned NumVertices = vAiMesh->mNumVertices;
+		voMesh.Vertices.resize(NumVertices);
+		voMesh.Min = glm::vec3(NumVertices ? FLT_MAX : 0.0f);
+		voMesh.Max = glm::vec3(NumVertices ? -FLT_MAX : 0.0f);
+		for (unsigned i = 0; i < NumVertices; ++i)
+		{
+			SMeshVertex& Vertex = voMesh.Vertices[i];
+			Vertex.Position = glm::vec3(vAiMesh->mVertices[i].x, vAiMesh->mVertices[i].y, vAiMesh->mVertices[i].z);
+			Vertex.Normal = vAiMesh->mNormals ? glm::vec3(vAiMesh->mNormals[i].x, vAiMesh->mNormals[i].y, vAiMesh->mNormals[i].z) : glm::vec3(0.0f);
+			Vertex.TexCoords = vAiMesh->mTextureCoords[0] ? glm::vec2(vAiMesh->mTextureCoords[0][i].x, vAiMesh->mTextureCoords[0][i].y) : glm::vec2(0.0f);
+			Vertex.Tangent = vAiMesh->mTangents ? glm::vec3(vAiMesh->mTangents[i].x, vAiMesh->mTangents[i].y, vAiMesh->mTangents[i].z) : glm::vec3(0.0f);
+			voMesh.Min = glm::min(voMesh.Min, Vertex.Position);
+			voMesh.Max = glm::max(voMesh.Max, Vertex.Position);
+		}
+	}
+
+	void processIndices(const aiMesh* vAiMesh, std::vector<GLint>& voIndices)
+	{
+		_ASSERT(vAiMesh);
+		size_t NumIndices = 0;
+		for (unsigned i = 0; i < vAiMesh->mNumFaces; ++i)
+			NumIndices += vAiMesh->mFaces[i].mNumIndices;
+		voIndices.resize(NumIndices);
+
+		GLint* pIndex = voIndices.data();
+		for (unsigned i = 0; i < vAiMesh->mNumFaces; ++i)
+		{
+			const aiFace& AiFace = vAiMesh->mFaces[i];
+			for (unsigned k = 0; k < AiFace.mNumIndices; ++k)
+				*pIndex++ = static_cast<GLint>(AiFace.mIndices[k]);
+		}
+	}
+
+	//one slot per texture, or one empty slot when the material has none of this type, as CMesh::update expects
+	void processTextures(aiTextureType vTextureType, const aiMaterial* vMat, const std::string& vDirectory, const std::string& vTextureNamePrefix, std::vector<SMeshTextureBinding>& voTextures)
+	{
+		_ASSERT(vMat);
+		const unsigned TextureCount = vMat->GetTextureCount(vTextureType);
+		if (TextureCount == 0)
+			voTextures.push_back(SMeshTextureBinding());
+		for (unsigned i = 0; i < TextureCount; ++i)
+		{
+			aiString Str;
+			vMat->GetTexture(vTextureType, i, &Str);
+			SMeshTextureBinding Binding;
+			Binding.TexturePath = vDirectory + "/" + Str.C_Str();
+			Binding.TextureUniformName = vTextureNamePrefix + std::to_string(i);
+			voTextures.push_back(Binding);
+		}
+	}
+
+	void processMatProperties(const aiMaterial* vMat, SMeshMatProperties& voMeshMatProperties)
+	{
+		_ASSERT(vMat);
+		aiColor3D AmbientColor, DiffuseColor, SpecularColor;
+		float Shininess = 0.0f, Refracti = 0.0f;
+		vMat->Get(AI_MATKEY_COLOR_AMBIENT, AmbientColor);
+		vMat->Get(AI_MATKEY_COLOR_DIFFUSE, DiffuseColor);
+		vMat->Get(AI_MATKEY_COLOR_SPECULAR, SpecularColor);
+		vMat->Get(AI_MATKEY_SHININESS, Shininess);
+		vMat->Get(AI_MATKEY_REFRACTI, Refracti);
+		voMeshMatProperties.AmbientColor = { AmbientColor.r, AmbientColor.g, AmbientColor.b };
+		voMeshMatProperties.DiffuseColor = { DiffuseColor.r, DiffuseColor.g, DiffuseColor.b };
+		voMeshMatProperties.SpecularColor = { SpecularColor.r, SpecularColor.g, SpecularColor.b };
+		voMeshMatProperties.Shininess = Shininess;
+		voMeshMatProperties.Refracti = Refracti;
+	}
+}
+
+CMeshCache::~CMeshCache()
+{
+#ifdef _WIN32
+	if (m_pData)
+		UnmapViewOfFile(m_pData);
+	if (m_MappingHandle != -1)
+		CloseHandle(reinterpret_cast<HANDLE>(m_MappingHandle));
+	if (m_FileHandle != -1)
+		CloseHandle(reinterpret_cast<HANDLE>(m_FileHandle));
+#else
+	if (m_pData)
+		munmap(const_cast<uint8_t*>(m_pData), m_FileSize);
+	if (m_FileHandle != -1)
+		close(static_cast<int>(m_FileHandle));
+#endif
+}
+
+//************************************************************************************
+//Function:
+bool CMeshCache::importModel(const std::string& vModelPath, std::vector<SMeshData>& voMeshes, const std::shared_ptr<CJobSystem>& vJobSystem)
+{
+	Assimp::Importer ModelImpoter;
+	const aiScene* pScene = ModelImpoter.ReadFile(vModelPath, aiProcess_Triangulate | aiProcess_CalcTangentSpace);
+	if (!pScene || !pScene->mRootNode || pScene->mFlags == AI_SCENE_FLAGS_INCOMPLETE)
+	{
+		std::cerr << "Error::Model:: " << ModelImpoter.GetErrorString() << std::endl;
+		return false;
+	}
+
+	const std::string Directory = vModelPath.substr(0, vModelPath.find_last_of('/'));
+	voMeshes.clear();
+	voMeshes.resize(pScene->mNumMeshes);
+	std::vector<SMeshOptimizationStatistics> OptimizationStatistics(voMeshes.size());
+	auto processMeshes = [&](size_t vBegin, size_t vEnd)
+	{
+		for (size_t i = vBegin; i < vEnd; ++i)
+		{
+			const aiMesh* pAiMesh = pScene->mMeshes[i];
+			SMeshData& Mesh = voMeshes[i];
+			processVertices(pAiMesh, Mesh);
+			processIndices(pAiMesh, Mesh.Indices);
+			OptimizationStatistics[i] = CMeshOptimizer::optimize(Mesh);
+
+			const aiMaterial* pAiMat = pScene->mMaterials[pAiMesh->mMaterialIndex];
+			processTextures(aiTextureType_DIFFUSE, pAiMat, Directory, DIFFUSE_TEX, Mesh.Textures);
+			processTextures(aiTextureType_SPECULAR, pAiMat, Directory, SPECULAR_TEX, Mesh.Textures);
+			processTextures(aiTextureType_HEIGHT, pAiMat, Directory, NORMAL_TEX, Mesh.Textures);
+			processTextures(aiTextureType_SHININESS, pAiMat, Directory, ROUGHNESS_TEX, Mesh.Textures);
+			processTextures(aiTextureType_AMBIENT, pAiMat, Directory, METALLIC_TEX, Mesh.Textures);
+			processMatProperties(pAiMat, Mesh.MatProperties);
+		}
+	};
+
+	//the scene is only read from here on, so every mesh is extracted by its own job
+	if (vJobSystem && voMeshes.size() > 1)
+	{
+		std::shared_ptr<CJobGroup> pJobs = vJobSystem->createGroup();
+		vJobSystem->parallelFor(pJobs, 0, voMeshes.size(), 1, processMeshes);
+		vJobSystem->wait(pJobs);
+	}
+	else
+	{
+		processMeshes(0, voMeshes.size());
+	}
+
+	//totals over the meshes, the stage times add up the work of every job
+	SMeshOptimizationStatistics Total;
+	for (const SMeshOptimizationStatistics& Statistics : OptimizationStatistics)
+	{
+		Total.VertexCountBefore += Statistics.VertexCountBefore;
+		Total.VertexCountAfter += Statistics.VertexCountAfter;
+		Total.Before.TriangleCount += Statistics.Before.TriangleCount;
+		Total.Before.VertexCount += Statistics.Before.VertexCount;
+		Total.Before.MissCount += Statistics.Before.MissCount;
+		Total.After.TriangleCount += Statistics.After.TriangleCount;
+		Total.After.VertexCount += Statistics.After.VertexCount;
+		Total.After.MissCount += Statistics.After.MissCount;
+		Total.WeldMs += Statistics.WeldMs;
+		Total.VertexCacheMs += Statistics.VertexCacheMs;
+		Total.OverdrawMs += Statistics.OverdrawMs;
+		Total.VertexFetchMs += Statistics.VertexFetchMs;
+		Total.LodCount = std::max(Total.LodCount, Statistics.LodCount);
+		Total.LodIndexCount += Statistics.LodIndexCount;
+		Total.LodMs += Statistics.LodMs;
+	}
+	auto computeRatio = [](size_t vMissCount, size_t vCount) { return vCount ? float(vMissCount) / vCount : 0.0f; };
+	std::cout << "MeshOptimizer:: " << vModelPath << " " << Total.VertexCountBefore << " -> " << Total.VertexCountAfter << " vertices, ACMR "
+		<< computeRatio(Total.Before.MissCount, Total.Before.TriangleCount) << " -> " << computeRatio(Total.After.MissCount, Total.After.TriangleCount) << ", ATVR "
+		<< computeRatio(Total.Before.MissCount, Total.Before.VertexCount) << " -> " << computeRatio(Total.After.MissCount, Total.After.VertexCount) << ", weld "
+		<< Total.WeldMs << " ms, vertex cache " << Total.VertexCacheMs << " ms, overdraw " << Total.OverdrawMs << " ms, vertex fetch " << Total.VertexFetchMs << " ms, up to "
+		<< Total.LodCount << " LODs adding " << Total.LodIndexCount / 3 << " triangles in " << Total.LodMs << " ms" << std::endl;
+	return true;
+}
+
+//************************************************************************************
+//Function: writes next to the cache and renames, so a crash never leaves a half written cache behind
+bool CMeshCache::write(const std::string& vModelPath, const std::vector<SMeshData>& vMeshes)
+{
+	SMeshCacheHeader Header = {};
+	std::memcpy(Header.Magic, MESH_CACHE_MAGIC, sizeof(Header.Magic));
+	Header.Version = VERSION;
+	Header.MeshCount = static_cast<uint32_t>(vMeshes.size());
+	Header.VertexStride = sizeof(SMeshVertex);
+	if (!querySourceStamp(vModelPath, Header.SourceSize, Header.SourceModifiedTime))
+	{
+		std::cerr << "Error::MeshCache:: can not stat " << vModelPath << std::endl;
+		return false;
+	}
+
+	std::vector<SMeshCacheRecord> Records(vMeshes.size());
+	uint64_t Offset = alignOffset(sizeof(SMeshCacheHeader) + Records.size() * sizeof(SMeshCacheRecord));
+	for (size_t i = 0; i < vMeshes.size(); ++i)
+	{
+		const SMeshData& Mesh = vMeshes[i];
+		SMeshCacheRecord& Record = Records[i];
+		Record.VertexCount = static_cast<uint32_t>(Mesh.Vertices.size());
+		Record.IndexCount = static_cast<uint32_t>(Mesh.Indices.size());
+		Record.TextureCount = static_cast<uint32_t>(Mesh.Textures.size());
+		Record.LodCount = static_cast<uint32_t>(Mesh.Lods.size());
+		Record.VertexOffset = Offset;
+		Offset = alignOffset(Offset + Mesh.Vertices.size() * sizeof(SMeshVertex));
+		Record.IndexOffset = Offset;
+		Offset = alignOffset(Offset + Mesh.Indices.size() * sizeof(GLint));
+		Record.LodOffset = Offset;
+		Offset = alignOffset(Offset + Mesh.Lods.size() * sizeof(SMeshLod));
+		Record.TextureOffset = Offset;
+		Offset = alignOffset(Offset + computeTextureBytes(Mesh.Textures));
+		std::memcpy(Record.Min, &Mesh.Min.x, sizeof(Record.Min));
+		std::memcpy(Record.Max, &Mesh.Max.x, sizeof(Record.Max));
+		std::memcpy(Record.AmbientColor, &Mesh.MatProperties.AmbientColor.x, sizeof(Record.AmbientColor));
+		std::memcpy(Record.DiffuseColor, &Mesh.MatProperties.DiffuseColor.x, sizeof(Record.DiffuseColor));
+		std::memcpy(Record.SpecularColor, &Mesh.MatProperties.SpecularColor.x, sizeof(Record.SpecularColor));
+		Record.Shininess = Mesh.MatProperties.Shininess;
+		Record.Refracti = Mesh.MatProperties.Refracti;
+	}
+
+	const std::string CachePath = getCachePath(vModelPath);
+	const std::string TemporaryPath = CachePath + ".tmp";
+	{
+		std::ofstream File(TemporaryPath, std::ios::binary | std::ios::trunc);
+		if (!File)
+		{
+			std::cerr << "Error::MeshCache:: can not create " << TemporaryPath << std::endl;
+			return false;
+		}
+		uint64_t Position = 0;
+		auto writeAt = [&](uint64_t vOffset, const void* vData, uint64_t vSize)
+		{
+			static const char Zeros[MESH_CACHE_ALIGNMENT] = {};
+			_ASSERT(vOffset >= Position && vOffset - Position < MESH_CACHE_ALIGNMENT);
+			File.write(Zeros, vOffset - Position);
+			File.write(static_cast<const char*>(vData), vSize);
+			Position = vOffset + vSize;
+		};
+		writeAt(0, &Header, sizeof(Header));
+		writeAt(Position, Records.data(), Records.size() * sizeof(SMeshCacheRecord));
+		for (size_t i = 0; i < vMeshes.size(); ++i)
+		{
+			writeAt(Records[i].VertexOffset, vMeshes[i].Vertices.data(), vMeshes[i].Vertices.size() * sizeof(SMeshVertex));
+			writeAt(Records[i].IndexOffset, vMeshes[i].Indices.data(), vMeshes[i].Indices.size() * sizeof(GLint));
+			writeAt(Records[i].LodOffset, vMeshes[i].Lods.data(), vMeshes[i].Lods.size() * sizeof(SMeshLod));
+			writeAt(Records[i].TextureOffset, nullptr, 0);
+			for (const auto& Texture : vMeshes[i].Textures)
+			{
+				const uint32_t Lengths[2] = { static_cast<uint32_t>(Texture.TexturePath.size()), static_cast<uint32_t>(Texture.TextureUniformName.size()) };
+				writeAt(Position, Lengths, sizeof(Lengths));
+				writeAt(Position, Texture.TexturePath.data(), Texture.TexturePath.size());
+				writeAt(Position, Texture.TextureUniformName.data(), Texture.TextureUniformName.size());
+			}
+		}
+		if (!File)
+		{
+			std::cerr << "Error::MeshCache:: failed writing " << TemporaryPath << std::endl;
+			return false;
+		}
+	}
+
+	std::remove(CachePath.c_str());
+	if (std::rename(TemporaryPath.c_str(), CachePath.c_str()) != 0)
+	{
+		std::cerr << "Error::MeshCache:: can not rename " << TemporaryPath << " to " << CachePath << std::endl;
+		std::remove(TemporaryPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+//************************************************************************************
+//Function:
+std::shared_ptr<CMeshCache> CMeshCache::open(const std::string& vModelPath)
+{
+	std::shared_ptr<CMeshCache> pCache(new CMeshCache());
+	if (!pCache->__map(getCachePath(vModelPath)) || !pCache->__validate(vModelPath))
+		return nullptr;
+	return pCache;
+}
+
+//************************************************************************************
+//Function:
+const SMeshVertex* CMeshCache::getVertices(size_t vMeshIndex) const
+{
+	return reinterpret_cast<const SMeshVertex*>(m_pData + m_pRecords[vMeshIndex].VertexOffset);
+}
+
+//************************************************************************************
+//Function:
+const GLint* CMeshCache::getIndices(size_t vMeshIndex) const
+{
+	return reinterpret_cast<const GLint*>(m_pData + m_pRecords[vMeshIndex].IndexOffset);
+}
+
+//************************************************************************************
+//Function:
+std::vector<SMeshLod> CMeshCache::getLods(size_t vMeshIndex) const
+{
+	const SMeshCacheRecord& Record = m_pRecords[vMeshIndex];
+	std::vector<SMeshLod> Lods(Record.LodCount);
+	std::memcpy(Lods.data(), m_pData + Record.LodOffset, Lods.size() * sizeof(SMeshLod));
+	return Lods;
+}
+
+//************************************************************************************
+//Function:
+std::vector<SMeshTextureBinding> CMeshCache::getTextures(size_t vMeshIndex) const
+{
+	const SMeshCacheRecord& Record = m_pRecords[vMeshIndex];
+	std::vector<SMeshTextureBinding> Textures(Record.TextureCount);
+	const uint8_t* pCursor = m_pData + Record.TextureOffset;
+	for (auto& Texture : Textures)
+	{
+		uint32_t Lengths[2];
+		std::memcpy(Lengths, pCursor, sizeof(Lengths));
+		pCursor += sizeof(Lengths);
+		Texture.TexturePath.assign(reinterpret_cast<const char*>(pCursor), Lengths[0]);
+		pCursor += Lengths[0];
+		Texture.TextureUniformName.assign(reinterpret_cast<const char*>(pCursor), Lengths[1]);
+		pCursor += Lengths[1];
+	}
+	return Textures;
+}
+
+//************************************************************************************
+//Function: read only mapping of the whole file, pages come in on first touch
+bool CMeshCache::__map(const std::string& vCachePath)
+{
+#ifdef _WIN32
+	HANDLE File = CreateFileA(vCachePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (File == INVALID_HANDLE_VALUE)
+		return false;
+	m_FileHandle = reinterpret_cast<intptr_t>(File);
+	LARGE_INTEGER Size;
+	if (!GetFileSizeEx(File, &Size) || Size.QuadPart < static_cast<LONGLONG>(sizeof(SMeshCacheHeader)))
+		return false;
+	m_FileSize = static_cast<size_t>(Size.QuadPart);
+	HANDLE Mapping = CreateFileMappingA(File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!Mapping)
+		return false;
+	m_MappingHandle = reinterpret_cast<intptr_t>(Mapping);
+	m_pData = static_cast<const uint8_t*>(MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+	const int File = ::open(vCachePath.c_str(), O_RDONLY);
+	if (File < 0)
+		return false;
+	m_FileHandle = File;
+	struct stat Status;
+	if (fstat(File, &Status) != 0 || Status.st_size < static_cast<off_t>(sizeof(SMeshCacheHeader)))
+		return false;
+	m_FileSize = static_cast<size_t>(Status.st_size);
+	void* pData = mmap(nullptr, m_FileSize, PROT_READ, MAP_PRIVATE, File, 0);
+	m_pData = pData == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(pData);
+#endif
+	return m_pData != nullptr;
+}
+
+//************************************************************************************
+//Function: every offset is checked once here, the getters trust the file afterwards; the header and records are kept only if all pass
+bool CMeshCache::__validate(const std::string& vModelPath)
+{
+	const SMeshCacheHeader* pHeader = reinterpret_cast<const SMeshCacheHeader*>(m_pData);
+	if (std::memcmp(pHeader->Magic, MESH_CACHE_MAGIC, sizeof(pHeader->Magic)) != 0 || pHeader->Version != VERSION || pHeader->VertexStride != sizeof(SMeshVertex))
+		return false;
+
+	//a cache shipped without its source model stays usable
+	uint64_t SourceSize = 0;
+	int64_t SourceModifiedTime = 0;
+	if (querySourceStamp(vModelPath, SourceSize, SourceModifiedTime) && (SourceSize != pHeader->SourceSize || SourceModifiedTime != pHeader->SourceModifiedTime))
+		return false;
+
+	if (sizeof(SMeshCacheHeader) + uint64_t(pHeader->MeshCount) * sizeof(SMeshCacheRecord) > m_FileSize)
+		return false;
+	const SMeshCacheRecord* pRecords = reinterpret_cast<const SMeshCacheRecord*>(m_pData + sizeof(SMeshCacheHeader));
+	for (uint32_t i = 0; i < pHeader->MeshCount; ++i)
+	{
+		const SMeshCacheRecord& Record = pRecords[i];
+		if (Record.VertexOffset % MESH_CACHE_ALIGNMENT != 0 || Record.IndexOffset % MESH_CACHE_ALIGNMENT != 0
+			|| Record.VertexOffset + uint64_t(Record.VertexCount) * sizeof(SMeshVertex) > m_FileSize
+			|| Record.IndexOffset + uint64_t(Record.IndexCount) * sizeof(GLint) > m_FileSize
+			|| Record.LodOffset + uint64_t(Record.LodCount) * sizeof(SMeshLod) > m_FileSize)
+			return false;
+		const SMeshLod* pLods = reinterpret_cast<const SMeshLod*>(m_pData + Record.LodOffset);
+		for (uint32_t k = 0; k < Record.LodCount; ++k)
+		{
+			if (uint64_t(pLods[k].IndexOffset) + pLods[k].IndexCount > Record.IndexCount)
+				return false;
+		}
+		uint64_t Cursor = Record.TextureOffset;
+		for (uint32_t k = 0; k < Record.TextureCount; ++k)
+		{
+			uint32_t Lengths[2];
+			if (Cursor + sizeof(Lengths) > m_FileSize)
+				return false;
+			std::memcpy(Lengths, m_pData + Cursor, sizeof(Lengths));
+			Cursor += sizeof(Lengths) + uint64_t(Lengths[0]) + Lengths[1];
+			if (Cursor > m_FileSize)
+				return false;
+		}
+	}
+
+	m_pHeader = pHeader;
+	m_pRecords = pRecords;
+	return true;
+}
@@ -0,0 +1,106 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) Elay Pu. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+#include <GL/glew.h>
+#include <GLM/glm.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Mesh.h"
+#include "FRAME_EXPORTS.h"
+
+class CJobSystem;
+
+//A texture slot of a mesh, an empty path keeps the slot unused as CMesh expects
+struct SMeshTextureBinding
+{
+	std::string TexturePath;
+	std::string TextureUniformName;
+};
+
+//Everything CModel needs from an imported mesh, without any GL object
+struct SMeshData
+{
+	std::vector<SMeshVertex>			Vertices;
+	std::vector<GLint>					Indices;	//every LOD, one after the other
+	std::vector<SMeshLod>				Lods;
+	std::vector<SMeshTextureBinding>	Textures;
+	SMeshMatProperties					MatProperties;
+	glm::vec3							Min = glm::vec3(0.0f);
+	glm::vec3							Max = glm::vec3(0.0f);
+};
+
+//File layout, native endianness:
+//SMeshCacheHeader, SMeshCacheRecord[MeshCount], then per mesh the vertex stream, the index stream, the SMeshLod
+//ranges into it and the texture bindings (uint32 path length, uint32 name length, both strings unterminated).
+//Streams start on MESH_CACHE_ALIGNMENT so a mapped file can be handed to createVAO as it is.
+struct SMeshCacheHeader
+{
+	char	 Magic[4];
+	uint32_t Version;
+	uint64_t SourceSize;
+	int64_t  SourceModifiedTime;
+	uint32_t MeshCount;
+	uint32_t VertexStride;
+};
+
+struct SMeshCacheRecord
+{
+	uint64_t VertexOffset;
+	uint64_t IndexOffset;
+	uint64_t TextureOffset;
+	uint64_t LodOffset;
+	uint32_t VertexCount;
+	uint32_t IndexCount;
+	uint32_t TextureCount;
+	uint32_t LodCount;
+	float	 Min[3];
+	float	 Max[3];
+	float	 AmbientColor[3];
+	float	 DiffuseColor[3];
+	float	 SpecularColor[3];
+	float	 Shininess;
+	float	 Refracti;
+};
+
+class FRAME_DLLEXPORTS CMeshCache
+{
+public:
+	static const uint32_t VERSION = 3;		//2: meshes are run through CMeshOptimizer, 3: LOD chains
+	static const uint32_t MESH_CACHE_ALIGNMENT = 16;
+
+	~CMeshCache();
+
+	static std::string getCachePath(const std::string& vModelPath) { return vModelPath + ".emesh"; }
+	//Assimp import with no GL call, so tools without a context can use it too.
+	//With a job system the meshes of the scene are extracted in parallel.
+	//Every mesh is welded and reordered by CMeshOptimizer, the statistics are logged per model.
+	static bool importModel(const std::string& vModelPath, std::vector<SMeshData>& voMeshes, const std::shared_ptr<CJobSystem>& vJobSystem = nullptr);
+	static bool write(const std::string& vModelPath, const std::vector<SMeshData>& vMeshes);
+	//nullptr when the cache is missing, from another version or older than the model
+	static std::shared_ptr<CMeshCache> open(const std::string& vModelPath);
+
+	size_t getMeshCount() const { return m_pHeader->MeshCount; }
+	const SMeshCacheRecord& getMeshRecord(size_t vMeshIndex) const { return m_pRecords[vMeshIndex]; }
+	const SMeshVertex* getVertices(size_t vMeshIndex) const;
+	const GLint* getIndices(size_t vMeshIndex) const;
+	std::vector<SMeshLod> getLods(size_t vMeshIndex) const;
+	std::vector<SMeshTextureBinding> getTextures(size_t vMeshIndex) const;
+	size_t getFileSize() const { return m_FileSize; }
+
+private:
+	CMeshCache() = default;
+
+	bool __map(const std::string& vCachePath);
+	bool __validate(const std::string& vModelPath);
+
+	const uint8_t*			m_pData = nullptr;
+	size_t					m_FileSize = 0;
+	const SMeshCacheHeader*	m_pHeader = nullptr;
+	const SMeshCacheRecord*	m_pRecords = nullptr;
+	intptr_t				m_FileHandle = -1;
+	intptr_t				m_MappingHandle = -1;
+};
@@ -0,0 +1,654 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) Elay Pu. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace
+{
+	//Forsyth, "Linear-Speed Vertex Cache Optimisation"
+	const float CACHE_DECAY_POWER = 1.5f;
+	const float LAST_TRIANGLE_SCORE = 0.75f;
+	const float VALENCE_BOOST_SCALE = 2.0f;
+	const float VALENCE_BOOST_POWER = 0.5f;
+	const size_t NO_TRIANGLE = static_cast<size_t>(-1);
+
+	float computeVertexScore(int vCachePosition, unsigned vRemainingValence)
+	{
+		if (vRemainingValence == 0)
+			return -1.0f;
+
+		float Score = 0.0f;
+		if (vCachePosition >= 0)
+		{
+			if (vCachePosition < 3)
+				Score = LAST_TRIANGLE_SCORE;
+			else
+				Score = std::pow(1.0f - float(vCachePosition - 3) / (CMeshOptimizer::VERTEX_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+		}
+		return Score + VALENCE_BOOST_SCALE * std::pow(float(vRemainingValence), -VALENCE_BOOST_POWER);
+	}
+
+	//FIFO cache by timestamps: a vertex is still cached while fewer than vCacheSize misses happened since it was loaded,
+	//flush() empties the cache without touching the timestamps
+	class CFifoCache
+	{
+	public:
+		CFifoCache(size_t vVertexCount, unsigned vCacheSize) : m_Timestamps(vVertexCount, 0), m_CacheSize(vCacheSize), m_Time(vCacheSize + 1) {}
+
+		bool access(GLint vIndex)
+		{
+			if (m_Time - m_Timestamps[vIndex] <= m_CacheSize)
+				return false;
+			m_Timestamps[vIndex] = m_Time++;
+			return true;
+		}
+		unsigned accessTriangle(const GLint* vTriangle) { return access(vTriangle[0]) + access(vTriangle[1]) + access(vTriangle[2]); }
+		void flush() { m_Time += m_CacheSize + 1; }
+
+	private:
+		std::vector<unsigned> m_Timestamps;
+		unsigned m_CacheSize;
+		unsigned m_Time;
+	};
+
+	struct SVertexHash
+	{
+		size_t operator()(const SMeshVertex& vVertex) const
+		{
+			//FNV-1a over the bytes, identical means bitwise identical here
+			const unsigned char* pBytes = reinterpret_cast<const unsigned char*>(&vVertex);
+			uint64_t Hash = 14695981039346656037ull;
+			for (size_t i = 0; i < sizeof(SMeshVertex); ++i)
+				Hash = (Hash ^ pBytes[i]) * 1099511628211ull;
+			return static_cast<size_t>(Hash);
+		}
+	};
+
+	struct SVertexEqual
+	{
+		bool operator()(const SMeshVertex& vLeft, const SMeshVertex& vRight) const { return std::memcmp(&vLeft, &vRight, sizeof(SMeshVertex)) == 0; }
+	};
+
+	struct SPositionHash
+	{
+		size_t operator()(const glm::vec3& vPosition) const
+		{
+			uint32_t Bits[3];
+			std::memcpy(Bits, &vPosition.x, sizeof(Bits));
+			return static_cast<size_t>(Bits[0] * 73856093u ^ Bits[1] * 19349663u ^ Bits[2] * 83492791u);
+		}
+	};
+
+	struct SPositionEqual
+	{
+		bool operator()(const glm::vec3& vLeft, const glm::vec3& vRight) const { return std::memcmp(&vLeft.x, &vRight.x, 3 * sizeof(float)) == 0; }
+	};
+
+	//Garland and Heckbert plane quadric, area weighted: Evaluate / Weight is the mean squared distance to the planes
+	struct SQuadric
+	{
+		double A00 = 0.0, A01 = 0.0, A02 = 0.0, A11 = 0.0, A12 = 0.0, A22 = 0.0;
+		double B0 = 0.0, B1 = 0.0, B2 = 0.0, C = 0.0;
+		double Weight = 0.0;
+
+		void addPlane(const glm::vec3& vNormal, float vDistance, float vWeight)
+		{
+			const double Nx = vNormal.x, Ny = vNormal.y, Nz = vNormal.z, D = vDistance, W = vWeight;
+			A00 += W * Nx * Nx; A01 += W * Nx * Ny; A02 += W * Nx * Nz;
+			A11 += W * Ny * Ny; A12 += W * Ny * Nz; A22 += W * Nz * Nz;
+			B0 += W * Nx * D; B1 += W * Ny * D; B2 += W * Nz * D;
+			C += W * D * D;
+			Weight += W;
+		}
+		void add(const SQuadric& vOther)
+		{
+			A00 += vOther.A00; A01 += vOther.A01; A02 += vOther.A02; A11 += vOther.A11; A12 += vOther.A12; A22 += vOther.A22;
+			B0 += vOther.B0; B1 += vOther.B1; B2 += vOther.B2; C += vOther.C;
+			Weight += vOther.Weight;
+		}
+		double evaluate(const glm::vec3& vPoint) const
+		{
+			const double X = vPoint.x, Y = vPoint.y, Z = vPoint.z;
+			const double Error = A00 * X * X + A11 * Y * Y + A22 * Z * Z + 2.0 * (A01 * X * Y + A02 * X * Z + A12 * Y * Z)
+				+ 2.0 * (B0 * X + B1 * Y + B2 * Z) + C;
+			return std::max(Error, 0.0);
+		}
+	};
+
+	struct SCollapse
+	{
+		GLint From;
+		GLint To;
+		float Error;	//mean squared distance
+	};
+
+	double computeElapsedMs(const std::chrono::steady_clock::time_point& vStartTime)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - vStartTime).count();
+	}
+}
+
+//************************************************************************************
+//Function: every stage in order, ACMR and ATVR of the index stream before and after
+SMeshOptimizationStatistics CMeshOptimizer::optimize(SMeshData& vioMesh)
+{
+	SMeshOptimizationStatistics Statistics;
+	Statistics.VertexCountBefore = Statistics.VertexCountAfter = vioMesh.Vertices.size();
+	Statistics.Before = Statistics.After = analyzeVertexCache(vioMesh.Indices, vioMesh.Vertices.size());
+	//points and lines aiProcess_Triangulate leaves alone are kept as they are
+	if (vioMesh.Indices.size() % 3 != 0)
+	{
+		vioMesh.Lods.assign(1, SMeshLod());
+		vioMesh.Lods[0].IndexCount = static_cast<uint32_t>(vioMesh.Indices.size());
+		return Statistics;
+	}
+
+	auto StartTime = std::chrono::steady_clock::now();
+	weldVertices(vioMesh);
+	Statistics.WeldMs = computeElapsedMs(StartTime);
+
+	StartTime = std::chrono::steady_clock::now();
+	optimizeVertexCache(vioMesh.Indices, vioMesh.Vertices.size());
+	Statistics.VertexCacheMs = computeElapsedMs(StartTime);
+
+	StartTime = std::chrono::steady_clock::now();
+	optimizeOverdraw(vioMesh.Indices, vioMesh.Vertices);
+	Statistics.OverdrawMs = computeElapsedMs(StartTime);
+
+	StartTime = std::chrono::steady_clock::now();
+	optimizeVertexFetch(vioMesh);
+	Statistics.VertexFetchMs = computeElapsedMs(StartTime);
+
+	Statistics.VertexCountAfter = vioMesh.Vertices.size();
+	Statistics.After = analyzeVertexCache(vioMesh.Indices, vioMesh.Vertices.size());
+
+	StartTime = std::chrono::steady_clock::now();
+	generateLods(vioMesh);
+	Statistics.LodMs = computeElapsedMs(StartTime);
+	Statistics.LodCount = vioMesh.Lods.size();
+	Statistics.LodIndexCount = vioMesh.Indices.size() - vioMesh.Lods[0].IndexCount;
+	return Statistics;
+}
+
+//************************************************************************************
+//Function: returns the new vertex count, the indices are remapped to the first copy of every vertex
+size_t CMeshOptimizer::weldVertices(SMeshData& vioMesh)
+{
+	std::unordered_map<SMeshVertex, GLint, SVertexHash, SVertexEqual> UniqueVertices;
+	UniqueVertices.reserve(vioMesh.Vertices.size());
+	std::vector<GLint> Remap(vioMesh.Vertices.size());
+	std::vector<SMeshVertex> WeldedVertices;
+	WeldedVertices.reserve(vioMesh.Vertices.size());
+	for (size_t i = 0; i < vioMesh.Vertices.size(); ++i)
+	{
+		auto Result = UniqueVertices.emplace(vioMesh.Vertices[i], static_cast<GLint>(WeldedVertices.size()));
+		if (Result.second)
+			WeldedVertices.push_back(vioMesh.Vertices[i]);
+		Remap[i] = Result.first->second;
+	}
+
+	for (GLint& Index : vioMesh.Indices)
+		Index = Remap[Index];
+	vioMesh.Vertices.swap(WeldedVertices);
+	return vioMesh.Vertices.size();
+}
+
+//************************************************************************************
+//Function: greedy Forsyth ordering, the next triangle is the best scored one around the simulated LRU cache,
+//or the first one not emitted yet when none of the cached vertices has triangles left
+void CMeshOptimizer::optimizeVertexCache(std::vector<GLint>& vioIndices, size_t vVertexCount)
+{
+	const size_t TriangleCount = vioIndices.size() / 3;
+	if (TriangleCount == 0)
+		return;
+
+	//per vertex the triangles still to be emitted, compacted as they are
+	std::vector<unsigned> AdjacencyOffsets(vVertexCount + 1, 0);
+	for (GLint Index : vioIndices)
+		AdjacencyOffsets[Index + 1]++;
+	std::partial_sum(AdjacencyOffsets.begin(), AdjacencyOffsets.end(), AdjacencyOffsets.begin());
+	std::vector<unsigned> Adjacency(vioIndices.size());
+	std::vector<unsigned> RemainingValences(vVertexCount, 0);
+	for (size_t i = 0; i < vioIndices.size(); ++i)
+	{
+		const GLint Index = vioIndices[i];
+		Adjacency[AdjacencyOffsets[Index] + RemainingValences[Index]++] = static_cast<unsigned>(i / 3);
+	}
+
+	std::vector<int> CachePositions(vVertexCount, -1);
+	std::vector<float> VertexScores(vVertexCount);
+	for (size_t i = 0; i < vVertexCount; ++i)
+		VertexScores[i] = computeVertexScore(-1, RemainingValences[i]);
+	auto computeTriangleScore = [&](size_t vTriangle)
+	{
+		return VertexScores[vioIndices[vTriangle * 3]] + VertexScores[vioIndices[vTriangle * 3 + 1]] + VertexScores[vioIndices[vTriangle * 3 + 2]];
+	};
+
+	size_t BestTriangle = 0;
+	float BestScore = computeTriangleScore(0);
+	for (size_t i = 1; i < TriangleCount; ++i)
+	{
+		const float Score = computeTriangleScore(i);
+		if (Score > BestScore)
+		{
+			BestScore = Score;
+			BestTriangle = i;
+		}
+	}
+
+	std::vector<GLint> OptimizedIndices;
+	OptimizedIndices.reserve(vioIndices.size());
+	std::vector<bool> IsEmitted(TriangleCount, false);
+	std::vector<GLint> Cache, NewCache;
+	Cache.reserve(VERTEX_CACHE_SIZE + 3);
+	NewCache.reserve(VERTEX_CACHE_SIZE + 3);
+	size_t NextUnemitted = 0;
+	while (OptimizedIndices.size() < vioIndices.size())
+	{
+		if (BestTriangle == NO_TRIANGLE)
+		{
+			while (IsEmitted[NextUnemitted])
+				++NextUnemitted;
+			BestTriangle = NextUnemitted;
+		}
+		IsEmitted[BestTriangle] = true;
+
+		NewCache.clear();
+		for (size_t k = 0; k < 3; ++k)
+		{
+			const GLint Index = vioIndices[BestTriangle * 3 + k];
+			OptimizedIndices.push_back(Index);
+			if (std::find(NewCache.begin(), NewCache.end(), Index) == NewCache.end())
+				NewCache.push_back(Index);
+
+			unsigned* pBegin = &Adjacency[AdjacencyOffsets[Index]];
+			unsigned* pEnd = pBegin + RemainingValences[Index];
+			*std::find(pBegin, pEnd, static_cast<unsigned>(BestTriangle)) = *(pEnd - 1);
+			RemainingValences[Index]--;
+		}
+		const size_t EmittedVertexCount = NewCache.size();
+		for (GLint Index : Cache)
+		{
+			if (std::find(NewCache.begin(), NewCache.begin() + EmittedVertexCount, Index) == NewCache.begin() + EmittedVertexCount)
+				NewCache.push_back(Index);
+		}
+		for (size_t i = VERTEX_CACHE_SIZE; i < NewCache.size(); ++i)
+		{
+			CachePositions[NewCache[i]] = -1;
+			VertexScores[NewCache[i]] = computeVertexScore(-1, RemainingValences[NewCache[i]]);
+		}
+		NewCache.resize(std::min<size_t>(NewCache.size(), VERTEX_CACHE_SIZE));
+		for (size_t i = 0; i < NewCache.size(); ++i)
+		{
+			CachePositions[NewCache[i]] = static_cast<int>(i);
+			VertexScores[NewCache[i]] = computeVertexScore(static_cast<int>(i), RemainingValences[NewCache[i]]);
+		}
+		Cache.swap(NewCache);
+
+		BestTriangle = NO_TRIANGLE;
+		BestScore = -1.0f;
+		for (GLint Index : Cache)
+		{
+			for (unsigned i = 0; i < RemainingValences[Index]; ++i)
+			{
+				const unsigned Triangle = Adjacency[AdjacencyOffsets[Index] + i];
+				const float Score = computeTriangleScore(Triangle);
+				if (Score > BestScore)
+				{
+					BestScore = Score;
+					BestTriangle = Triangle;
+				}
+			}
+		}
+	}
+	vioIndices.swap(OptimizedIndices);
+}
+
+//************************************************************************************
+//Function: expects a cache optimized order. It is cut where the order restarts (all three vertices miss) and
+//again wherever the ACMR so far is back within vThreshold of the cluster's own, then the clusters are sorted so
+//the ones facing away from the mesh center, which tend to occlude the others, are drawn first.
+void CMeshOptimizer::optimizeOverdraw(std::vector<GLint>& vioIndices, const std::vector<SMeshVertex>& vVertices, float vThreshold)
+{
+	const size_t TriangleCount = vioIndices.size() / 3;
+	if (TriangleCount < 2)
+		return;
+
+	CFifoCache Cache(vVertices.size(), ANALYZED_CACHE_SIZE);
+	std::vector<size_t> HardBoundaries;
+	for (size_t i = 0; i < TriangleCount; ++i)
+	{
+		if (Cache.accessTriangle(&vioIndices[i * 3]) == 3 || i == 0)
+			HardBoundaries.push_back(i);
+	}
+	HardBoundaries.push_back(TriangleCount);
+
+	std::vector<size_t> Clusters;
+	for (size_t i = 0; i + 1 < HardBoundaries.size(); ++i)
+	{
+		const size_t Begin = HardBoundaries[i], End = HardBoundaries[i + 1];
+		Cache.flush();
+		unsigned ClusterMissCount = 0;
+		for (size_t k = Begin; k < End; ++k)
+			ClusterMissCount += Cache.accessTriangle(&vioIndices[k * 3]);
+		const float ClusterThreshold = vThreshold * ClusterMissCount / (End - Begin);
+
+		Cache.flush();
+		Clusters.push_back(Begin);
+		size_t ClusterBegin = Begin;
+		unsigned MissCount = 0;
+		for (size_t k = Begin; k < End; ++k)
+		{
+			MissCount += Cache.accessTriangle(&vioIndices[k * 3]);
+			if (k + 1 < End && float(MissCount) / (k + 1 - ClusterBegin) <= ClusterThreshold)
+			{
+				Clusters.push_back(k + 1);
+				ClusterBegin = k + 1;
+				MissCount = 0;
+				Cache.flush();
+			}
+		}
+	}
+	Clusters.push_back(TriangleCount);
+
+	//area weighted center of the mesh and of every cluster, the cluster normal is the sum of its face normals
+	auto computeTriangle = [&](size_t vTriangle, glm::vec3& voCenter, glm::vec3& voAreaNormal)
+	{
+		const glm::vec3& P0 = vVertices[vioIndices[vTriangle * 3]].Position;
+		const glm::vec3& P1 = vVertices[vioIndices[vTriangle * 3 + 1]].Position;
+		const glm::vec3& P2 = vVertices[vioIndices[vTriangle * 3 + 2]].Position;
+		voCenter = (P0 + P1 + P2) / 3.0f;
+		voAreaNormal = glm::cross(P1 - P0, P2 - P0);
+	};
+	glm::vec3 MeshCenter(0.0f);
+	float MeshArea = 0.0f;
+	for (size_t i = 0; i < TriangleCount; ++i)
+	{
+		glm::vec3 Center, AreaNormal;
+		computeTriangle(i, Center, AreaNormal);
+		const float Area = glm::length(AreaNormal);
+		MeshCenter += Center * Area;
+		MeshArea += Area;
+	}
+	if (MeshArea > 0.0f)
+		MeshCenter /= MeshArea;
+
+	const size_t ClusterCount = Clusters.size() - 1;
+	std::vector<float> SortKeys(ClusterCount);
+	for (size_t i = 0; i < ClusterCount; ++i)
+	{
+		glm::vec3 ClusterCenter(0.0f), ClusterNormal(0.0f);
+		float ClusterArea = 0.0f;
+		for (size_t k = Clusters[i]; k < Clusters[i + 1]; ++k)
+		{
+			glm::vec3 Center, AreaNormal;
+			computeTriangle(k, Center, AreaNormal);
+			const float Area = glm::length(AreaNormal);
+			ClusterCenter += Center * Area;
+			ClusterNormal += AreaNormal;
+			ClusterArea += Area;
+		}
+		const float NormalLength = glm::length(ClusterNormal);
+		SortKeys[i] = ClusterArea > 0.0f && NormalLength > 0.0f ? glm::dot(ClusterCenter / ClusterArea - MeshCenter, ClusterNormal / NormalLength) : 0.0f;
+	}
+
+	std::vector<size_t> ClusterOrder(ClusterCount);
+	std::iota(ClusterOrder.begin(), ClusterOrder.end(), 0);
+	std::stable_sort(ClusterOrder.begin(), ClusterOrder.end(), [&](size_t vLeft, size_t vRight) { return SortKeys[vLeft] > SortKeys[vRight]; });
+
+	std::vector<GLint> SortedIndices;
+	SortedIndices.reserve(vioIndices.size());
+	for (size_t Cluster : ClusterOrder)
+		SortedIndices.insert(SortedIndices.end(), vioIndices.begin() + Clusters[Cluster] * 3, vioIndices.begin() + Clusters[Cluster + 1] * 3);
+	vioIndices.swap(SortedIndices);
+}
+
+//************************************************************************************
+//Function: vertices renumbered in the order the indices first reference them, unreferenced ones are dropped
+void CMeshOptimizer::optimizeVertexFetch(SMeshData& vioMesh)
+{
+	std::vector<GLint> Remap(vioMesh.Vertices.size(), -1);
+	std::vector<SMeshVertex> ReorderedVertices;
+	ReorderedVertices.reserve(vioMesh.Vertices.size());
+	for (GLint& Index : vioMesh.Indices)
+	{
+		if (Remap[Index] < 0)
+		{
+			Remap[Index] = static_cast<GLint>(ReorderedVertices.size());
+			ReorderedVertices.push_back(vioMesh.Vertices[Index]);
+		}
+		Index = Remap[Index];
+	}
+	vioMesh.Vertices.swap(ReorderedVertices);
+}
+
+//************************************************************************************
+//Function:
+SVertexCacheStatistics CMeshOptimizer::analyzeVertexCache(const std::vector<GLint>& vIndices, size_t vVertexCount, unsigned vCacheSize)
+{
+	SVertexCacheStatistics Statistics;
+	Statistics.TriangleCount = vIndices.size() / 3;
+	CFifoCache Cache(vVertexCount, vCacheSize);
+	std::vector<bool> IsReferenced(vVertexCount, false);
+	for (GLint Index : vIndices)
+	{
+		Statistics.MissCount += Cache.access(Index);
+		if (!IsReferenced[Index])
+		{
+			IsReferenced[Index] = true;
+			Statistics.VertexCount++;
+		}
+	}
+	Statistics.ACMR = Statistics.TriangleCount ? float(Statistics.MissCount) / Statistics.TriangleCount : 0.0f;
+	Statistics.ATVR = Statistics.VertexCount ? float(Statistics.MissCount) / Statistics.VertexCount : 0.0f;
+	return Statistics;
+}
+
+//************************************************************************************
+//Function: each LOD is simplified from the previous one, so its error adds up along the chain
+void CMeshOptimizer::generateLods(SMeshData& vioMesh)
+{
+	vioMesh.Lods.assign(1, SMeshLod());
+	vioMesh.Lods[0].IndexCount = static_cast<uint32_t>(vioMesh.Indices.size());
+
+	std::vector<GLint> PreviousIndices = vioMesh.Indices;
+	float Error = 0.0f;
+	while (vioMesh.Lods.size() < MAX_LOD_COUNT)
+	{
+		const size_t TargetIndexCount = PreviousIndices.size() / 6 * 3;
+		if (TargetIndexCount < MIN_LOD_TRIANGLE_COUNT * 3)
+			break;
+
+		float LodError = 0.0f;
+		std::vector<GLint> LodIndices = simplify(PreviousIndices, vioMesh.Vertices, TargetIndexCount, LodError);
+		if (LodIndices.size() > PreviousIndices.size() * 3 / 4)
+			break;
+		optimizeVertexCache(LodIndices, vioMesh.Vertices.size());
+
+		Error += LodError;
+		SMeshLod Lod;
+		Lod.IndexOffset = static_cast<uint32_t>(vioMesh.Indices.size());
+		Lod.IndexCount = static_cast<uint32_t>(LodIndices.size());
+		Lod.Error = Error;
+		vioMesh.Lods.push_back(Lod);
+		vioMesh.Indices.insert(vioMesh.Indices.end(), LodIndices.begin(), LodIndices.end());
+		PreviousIndices.swap(LodIndices);
+	}
+}
+
+//************************************************************************************
+//Function: in passes: every edge gets its cheaper valid direction, the cheapest collapses are applied as long as they
+//do not touch a vertex an earlier collapse of the pass moved or changed the neighborhood of, then the triangles are rebuilt
+std::vector<GLint> CMeshOptimizer::simplify(const std::vector<GLint>& vIndices, const std::vector<SMeshVertex>& vVertices, size_t vTargetIndexCount, float& voError)
+{
+	const size_t VertexCount = vVertices.size();
+	std::vector<GLint> Indices = vIndices;
+	voError = 0.0f;
+
+	//a vertex sharing its position with another one sits on an attribute seam, an edge without its reverse is an open border
+	std::vector<bool> IsLocked(VertexCount, false);
+	{
+		std::unordered_map<glm::vec3, GLint, SPositionHash, SPositionEqual> FirstVertices;
+		std::vector<GLint> PositionIds(VertexCount);
+		for (size_t i = 0; i < VertexCount; ++i)
+		{
+			auto Result = FirstVertices.emplace(vVertices[i].Position, static_cast<GLint>(i));
+			PositionIds[i] = Result.first->second;
+			if (!Result.second)
+				IsLocked[i] = IsLocked[Result.first->second] = true;
+		}
+
+		auto computeEdgeKey = [&](GLint vFrom, GLint vTo) { return uint64_t(uint32_t(PositionIds[vFrom])) << 32 | uint32_t(PositionIds[vTo]); };
+		std::unordered_set<uint64_t> DirectedEdges;
+		DirectedEdges.reserve(Indices.size());
+		for (size_t i = 0; i < Indices.size(); i += 3)
+			for (size_t k = 0; k < 3; ++k)
+				DirectedEdges.insert(computeEdgeKey(Indices[i + k], Indices[i + (k + 1) % 3]));
+		for (size_t i = 0; i < Indices.size(); i += 3)
+		{
+			for (size_t k = 0; k < 3; ++k)
+			{
+				const GLint From = Indices[i + k], To = Indices[i + (k + 1) % 3];
+				if (!DirectedEdges.count(computeEdgeKey(To, From)))
+					IsLocked[From] = IsLocked[To] = true;
+			}
+		}
+	}
+
+	std::vector<SQuadric> Quadrics(VertexCount);
+	for (size_t i = 0; i < Indices.size(); i += 3)
+	{
+		const glm::vec3& P0 = vVertices[Indices[i]].Position;
+		const glm::vec3 AreaNormal = glm::cross(vVertices[Indices[i + 1]].Position - P0, vVertices[Indices[i + 2]].Position - P0);
+		const float DoubleArea = glm::length(AreaNormal);
+		if (DoubleArea <= 0.0f)
+			continue;
+		const glm::vec3 Normal = AreaNormal / DoubleArea;
+		for (size_t k = 0; k < 3; ++k)
+			Quadrics[Indices[i + k]].addPlane(Normal, -glm::dot(Normal, P0), DoubleArea * 0.5f);
+	}
+	auto computeCollapseError = [&](GLint vFrom, GLint vTo)
+	{
+		SQuadric Quadric = Quadrics[vFrom];
+		Quadric.add(Quadrics[vTo]);
+		return Quadric.Weight > 0.0 ? static_cast<float>(Quadric.evaluate(vVertices[vTo].Position) / Quadric.Weight) : 0.0f;
+	};
+
+	std::vector<unsigned> AdjacencyOffsets, Adjacency;
+	std::vector<SCollapse> Collapses;
+	std::vector<bool> IsTouched(VertexCount);
+	std::vector<GLint> Remap(VertexCount), FromNeighbors, SharedNeighbors;
+	while (Indices.size() > vTargetIndexCount)
+	{
+		AdjacencyOffsets.assign(VertexCount + 1, 0);
+		for (GLint Index : Indices)
+			AdjacencyOffsets[Index + 1]++;
+		std::partial_sum(AdjacencyOffsets.begin(), AdjacencyOffsets.end(), AdjacencyOffsets.begin());
+		Adjacency.resize(Indices.size());
+		std::vector<unsigned> Cursors(AdjacencyOffsets.begin(), AdjacencyOffsets.end() - 1);
+		for (size_t i = 0; i < Indices.size(); ++i)
+			Adjacency[Cursors[Indices[i]]++] = static_cast<unsigned>(i / 3);
+
+		Collapses.clear();
+		for (size_t i = 0; i < Indices.size(); i += 3)
+		{
+			for (size_t k = 0; k < 3; ++k)
+			{
+				const GLint V0 = Indices[i + k], V1 = Indices[i + (k + 1) % 3];
+				//an interior edge shows up once in each direction
+				if (V0 > V1 || (IsLocked[V0] && IsLocked[V1]))
+					continue;
+				const float Error01 = IsLocked[V0] ? FLT_MAX : computeCollapseError(V0, V1);
+				const float Error10 = IsLocked[V1] ? FLT_MAX : computeCollapseError(V1, V0);
+				Collapses.push_back(Error01 <= Error10 ? SCollapse{ V0, V1, Error01 } : SCollapse{ V1, V0, Error10 });
+			}
+		}
+		if (Collapses.empty())
+			break;
+		std::sort(Collapses.begin(), Collapses.end(), [](const SCollapse& vLeft, const SCollapse& vRight) { return vLeft.Error < vRight.Error; });
+
+		std::iota(Remap.begin(), Remap.end(), 0);
+		IsTouched.assign(VertexCount, false);
+		const size_t TrianglesToRemove = (Indices.size() - vTargetIndexCount) / 3;
+		size_t RemovedTriangleCount = 0;
+		for (const SCollapse& Collapse : Collapses)
+		{
+			if (IsTouched[Collapse.From] || IsTouched[Collapse.To])
+				continue;
+
+			//link condition: the only common neighbors are the apexes of the triangles on the edge,
+			//and no triangle that stays may flip when From moves onto To
+			const glm::vec3& FromPosition = vVertices[Collapse.From].Position;
+			const glm::vec3& ToPosition = vVertices[Collapse.To].Position;
+			FromNeighbors.clear();
+			SharedNeighbors.clear();
+			bool IsValid = true;
+			for (unsigned i = AdjacencyOffsets[Collapse.From]; i < AdjacencyOffsets[Collapse.From + 1] && IsValid; ++i)
+			{
+				const GLint* pTriangle = &Indices[Adjacency[i] * 3];
+				const size_t Corner = pTriangle[0] == Collapse.From ? 0 : (pTriangle[1] == Collapse.From ? 1 : 2);
+				const GLint Next = pTriangle[(Corner + 1) % 3], Previous = pTriangle[(Corner + 2) % 3];
+				FromNeighbors.push_back(Next);
+				FromNeighbors.push_back(Previous);
+				if (Next == Collapse.To || Previous == Collapse.To)
+				{
+					SharedNeighbors.push_back(Next == Collapse.To ? Previous : Next);
+					continue;
+				}
+				const glm::vec3& NextPosition = vVertices[Next].Position;
+				const glm::vec3& PreviousPosition = vVertices[Previous].Position;
+				const glm::vec3 NormalBefore = glm::cross(NextPosition - FromPosition, PreviousPosition - FromPosition);
+				const glm::vec3 NormalAfter = glm::cross(NextPosition - ToPosition, PreviousPosition - ToPosition);
+				IsValid = glm::dot(NormalBefore, NormalAfter) > 0.0f;
+			}
+			for (unsigned i = AdjacencyOffsets[Collapse.To]; i < AdjacencyOffsets[Collapse.To + 1] && IsValid; ++i)
+			{
+				const GLint* pTriangle = &Indices[Adjacency[i] * 3];
+				for (size_t k = 0; k < 3 && IsValid; ++k)
+				{
+					const GLint Neighbor = pTriangle[k];
+					if (Neighbor != Collapse.To && Neighbor != Collapse.From
+						&& std::find(FromNeighbors.begin(), FromNeighbors.end(), Neighbor) != FromNeighbors.end()
+						&& std::find(SharedNeighbors.begin(), SharedNeighbors.end(), Neighbor) == SharedNeighbors.end())
+						IsValid = false;
+				}
+			}
+			if (!IsValid)
+				continue;
+
+			Remap[Collapse.From] = Collapse.To;
+			Quadrics[Collapse.To].add(Quadrics[Collapse.From]);
+			IsTouched[Collapse.From] = IsTouched[Collapse.To] = true;
+			for (GLint Neighbor : FromNeighbors)
+				IsTouched[Neighbor] = true;
+			voError = std::max(voError, std::sqrt(Collapse.Error));
+			RemovedTriangleCount += SharedNeighbors.size();
+			if (RemovedTriangleCount >= TrianglesToRemove)
+				break;
+		}
+		if (RemovedTriangleCount == 0)
+			break;
+
+		size_t WrittenIndexCount = 0;
+		for (size_t i = 0; i < Indices.size(); i += 3)
+		{
+			const GLint I0 = Remap[Indices[i]], I1 = Remap[Indices[i + 1]], I2 = Remap[Indices[i + 2]];
+			if (I0 == I1 || I1 == I2 || I0 == I2)
+				continue;
+			Indices[WrittenIndexCount++] = I0;
+			Indices[WrittenIndexCount++] = I1;
+			Indices[WrittenIndexCount++] = I2;
+		}
+		Indices.resize(WrittenIndexCount);
+	}
+	return Indices;
+}
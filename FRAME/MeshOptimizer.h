@@ -0,0 +1,62 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) Elay Pu. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+#include <GL/glew.h>
+#include <vector>
+#include "MeshCache.h"
+#include "FRAME_EXPORTS.h"
+
+//ACMR: post-transform cache misses per triangle, 0.5 at best, 3 for no reuse at all.
+//ATVR: misses per referenced vertex, 1 means every vertex is transformed exactly once.
+struct SVertexCacheStatistics
+{
+	size_t TriangleCount = 0;
+	size_t VertexCount = 0;		//referenced by the index stream
+	size_t MissCount = 0;
+	float ACMR = 0.0f;
+	float ATVR = 0.0f;
+};
+
+struct SMeshOptimizationStatistics
+{
+	size_t VertexCountBefore = 0;
+	size_t VertexCountAfter = 0;
+	SVertexCacheStatistics Before;
+	SVertexCacheStatistics After;
+	double WeldMs = 0.0;
+	double VertexCacheMs = 0.0;
+	double OverdrawMs = 0.0;
+	double VertexFetchMs = 0.0;
+	size_t LodCount = 1;
+	size_t LodIndexCount = 0;	//indices the coarser LODs add
+	double LodMs = 0.0;
+};
+
+//Import time reordering of a triangle list, run before the mesh data is written to the mesh cache:
+//weld identical vertices, reorder the triangles for the post-transform cache (Forsyth),
+//sort clusters of them front to back for overdraw (Tipsify style), renumber the vertices in first use order and
+//append a chain of simplified LODs to the index stream.
+class FRAME_DLLEXPORTS CMeshOptimizer
+{
+public:
+	static const unsigned VERTEX_CACHE_SIZE = 32;		//LRU size the Forsyth scores are tuned for
+	static const unsigned ANALYZED_CACHE_SIZE = 16;		//FIFO size ACMR and ATVR are reported with
+	static const unsigned MAX_LOD_COUNT = 5;			//the full mesh and up to four halvings of it
+	static const unsigned MIN_LOD_TRIANGLE_COUNT = 64;
+
+	static SMeshOptimizationStatistics optimize(SMeshData& vioMesh);
+
+	static size_t weldVertices(SMeshData& vioMesh);
+	static void optimizeVertexCache(std::vector<GLint>& vioIndices, size_t vVertexCount);
+	//vThreshold: how much ACMR a cluster may lose against the cache optimized order to be drawn on its own
+	static void optimizeOverdraw(std::vector<GLint>& vioIndices, const std::vector<SMeshVertex>& vVertices, float vThreshold = 1.05f);
+	static void optimizeVertexFetch(SMeshData& vioMesh);
+	//every LOD halves the triangles of the previous one, the chain ends early when seams and borders stop the simplification
+	static void generateLods(SMeshData& vioMesh);
+	//quadric error edge collapses onto existing vertices, so the result indexes vVertices as it is.
+	//Vertices on open borders or attribute seams stay. voError is the object space distance to the input surface.
+	static std::vector<GLint> simplify(const std::vector<GLint>& vIndices, const std::vector<SMeshVertex>& vVertices, size_t vTargetIndexCount, float& voError);
+	static SVertexCacheStatistics analyzeVertexCache(const std::vector<GLint>& vIndices, size_t vVertexCount, unsigned vCacheSize = ANALYZED_CACHE_SIZE);
+};
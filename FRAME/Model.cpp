@@ -3,15 +3,191 @@
 //--------------------------------------------------------------------------------------
 
 #include "Model.h"
+#include <chrono>
+#include <fstream>
 #include <iostream>
+#include <mutex>
+#include <unordered_map>
+#include "MeshCache.h"
+#include "JobSystem.h"
+#include "TextureStreamer.h"
+#include "TextureCompressor.h"
+#include "ResourceManager.h"
 #include "Utils.h"
 #include "common.h"
 #include "Shader.h"
 #include "AABB.h"
 
-CModel::CModel(const std::string &vModelPath)
+//Shared by the load jobs of one model and the context thread, the jobs only hold this so
+//a model destroyed while loading just cancels them.
+struct SModelLoadState
 {
-	__loadModel(vModelPath);
+	struct STextureFile
+	{
+		size_t TextureIndex = 0;
+		std::string FilePath;	//the DDS cache when the texture is compressed
+		uint64_t ContentHash = 0;
+		std::shared_ptr<const std::vector<char>> pFileData;	//empty when the file can't be read
+	};
+
+	std::string ModelPath;
+	std::shared_ptr<CJobSystem> pJobSystem;
+	std::shared_ptr<CJobGroup> pJobs;
+	std::chrono::steady_clock::time_point StartTime;
+
+	std::mutex Mutex;
+	//published once by the import job, read only afterwards
+	bool IsMeshDataReady = false;
+	bool IsFromMeshCache = false;
+	double MeshDataMs = 0.0;
+	std::shared_ptr<CMeshCache> pMeshCache;
+	std::shared_ptr<std::vector<SMeshData>> pMeshes;
+	std::vector<std::vector<SMeshTextureBinding>> MeshTextureBindings;
+	std::vector<std::vector<int>> MeshTextureIndices;	//per slot, -1 for an empty slot
+	std::vector<std::string> TexturePaths;
+	std::vector<ETextureUsage> TextureUsages;	//of the first binding of each texture
+	//filled by the texture read jobs, drained by pumpLoad
+	std::vector<STextureFile> TextureFiles;
+};
+
+namespace
+{
+	double computeElapsedMs(const std::chrono::steady_clock::time_point& vStartTime)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - vStartTime).count();
+	}
+
+	//the texture streamer keys its cache by the hash, it decodes the data itself when the content is new;
+	//with compression on the data is the block compressed DDS cache MeshConverter wrote, the source while it is missing or stale
+	SModelLoadState::STextureFile readTextureFile(const std::string& vFilePath, size_t vTextureIndex, ETextureUsage vUsage)
+	{
+		SModelLoadState::STextureFile TextureFile;
+		TextureFile.TextureIndex = vTextureIndex;
+		TextureFile.FilePath = vFilePath;
+		auto pFileData = std::make_shared<std::vector<char>>();
+		if (ElayGraphics::COMPONENT_CONFIG::IS_COMPRESS_TEXTURES && CTextureCompressor::isCompressible(vFilePath)
+			&& CTextureCompressor::loadCache(vFilePath, vUsage, TextureFile.FilePath, *pFileData))
+		{
+			TextureFile.ContentHash = CTextureStreamer::hashContent(pFileData->data(), pFileData->size());
+			TextureFile.pFileData = pFileData;
+			return TextureFile;
+		}
+
+		std::ifstream File(vFilePath, std::ios::binary | std::ios::ate);
+		if (File)
+		{
+			pFileData->resize(static_cast<size_t>(File.tellg()));
+			File.seekg(0);
+			File.read(pFileData->data(), pFileData->size());
+		}
+		if (!File || pFileData->empty())
+		{
+			std::cerr << "Error::Model:: can't read the texture " << vFilePath << std::endl;
+			pFileData->clear();
+		}
+		TextureFile.ContentHash = CTextureStreamer::hashContent(pFileData->data(), pFileData->size());
+		TextureFile.pFileData = pFileData;
+		return TextureFile;
+	}
+
+	//worker side: mesh data from the mesh cache or from Assimp, then one read job per distinct texture
+	void prepareModel(const std::shared_ptr<SModelLoadState>& vState)
+	{
+		SModelLoadState& State = *vState;
+		std::shared_ptr<CMeshCache> pMeshCache = CMeshCache::open(State.ModelPath);
+		std::shared_ptr<std::vector<SMeshData>> pMeshes;
+		std::vector<std::vector<SMeshTextureBinding>> MeshTextureBindings;
+		if (pMeshCache)
+		{
+			MeshTextureBindings.resize(pMeshCache->getMeshCount());
+			for (size_t i = 0; i < MeshTextureBindings.size(); ++i)
+				MeshTextureBindings[i] = pMeshCache->getTextures(i);
+		}
+		else
+		{
+			pMeshes = std::make_shared<std::vector<SMeshData>>();
+			if (CMeshCache::importModel(State.ModelPath, *pMeshes, State.pJobSystem))
+			{
+				if (!CMeshCache::write(State.ModelPath, *pMeshes))
+					std::cerr << "Error::Model:: can not write the mesh cache of " << State.ModelPath << std::endl;
+			}
+			else
+			{
+				pMeshes->clear();
+			}
+			for (const SMeshData& Mesh : *pMeshes)
+				MeshTextureBindings.push_back(Mesh.Textures);
+		}
+
+		std::unordered_map<std::string, int> TextureIndices;
+		std::vector<std::string> TexturePaths;
+		std::vector<ETextureUsage> TextureUsages;
+		std::vector<std::vector<int>> MeshTextureIndices(MeshTextureBindings.size());
+		for (size_t i = 0; i < MeshTextureBindings.size(); ++i)
+		{
+			for (const SMeshTextureBinding& Binding : MeshTextureBindings[i])
+			{
+				int TextureIndex = -1;
+				if (!Binding.TexturePath.empty())
+				{
+					auto Result = TextureIndices.emplace(Binding.TexturePath, static_cast<int>(TexturePaths.size()));
+					if (Result.second)
+					{
+						TexturePaths.push_back(Binding.TexturePath);
+						TextureUsages.push_back(CTextureCompressor::getTextureUsage(Binding.TextureUniformName));
+					}
+					TextureIndex = Result.first->second;
+				}
+				MeshTextureIndices[i].push_back(TextureIndex);
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> Lock(State.Mutex);
+			State.IsFromMeshCache = pMeshCache != nullptr;
+			State.MeshDataMs = computeElapsedMs(State.StartTime);
+			State.pMeshCache = pMeshCache;
+			State.pMeshes = pMeshes;
+			State.MeshTextureBindings = std::move(MeshTextureBindings);
+			State.MeshTextureIndices = std::move(MeshTextureIndices);
+			State.TexturePaths = TexturePaths;
+			State.TextureUsages = TextureUsages;
+			State.IsMeshDataReady = true;
+		}
+
+		for (size_t i = 0; i < TexturePaths.size(); ++i)
+		{
+			State.pJobSystem->submit(State.pJobs, [vState, i]()
+			{
+				SModelLoadState::STextureFile TextureFile = readTextureFile(vState->TexturePaths[i], i, vState->TextureUsages[i]);
+				std::lock_guard<std::mutex> Lock(vState->Mutex);
+				vState->TextureFiles.push_back(std::move(TextureFile));
+			});
+		}
+	}
+}
+
+CModel::CModel(const std::string &vModelPath) : CModel(vModelPath, CResourceManager::getOrCreateInstance()->getOrCreateJobSystem())
+{
+	finishLoad();
+}
+
+CModel::CModel(const std::string &vModelPath, const std::shared_ptr<CJobSystem>& vJobSystem)
+{
+	_ASSERT(vJobSystem);
+	m_pLoadState = std::make_shared<SModelLoadState>();
+	m_pLoadState->ModelPath = vModelPath;
+	m_pLoadState->pJobSystem = vJobSystem;
+	m_pLoadState->pJobs = vJobSystem->createGroup();
+	m_pLoadState->StartTime = std::chrono::steady_clock::now();
+	std::shared_ptr<SModelLoadState> pState = m_pLoadState;
+	vJobSystem->submit(m_pLoadState->pJobs, [pState]() { prepareModel(pState); });
+}
+
+CModel::~CModel()
+{
+	if (m_pLoadState)
+		m_pLoadState->pJobs->cancel();
 }
 
 //************************************************************************************
@@ -44,166 +220,161 @@ GLvoid CModel::update(const CShader& vShader) const
 
 //************************************************************************************
 //Function:
-GLvoid CModel::__loadModel(const std::string& vPath)
+GLvoid CModel::update(const CShader& vShader, const SLodSelection& vLodSelection) const
 {
-	Assimp::Importer ModelImpoter;
-	m_pScene = ModelImpoter.ReadFile(vPath, aiProcess_Triangulate | aiProcess_CalcTangentSpace);
-	if (!m_pScene || !m_pScene->mRootNode || m_pScene->mFlags == AI_SCENE_FLAGS_INCOMPLETE)
-	{
-		std::cerr << "Error::Model:: " << ModelImpoter.GetErrorString() << std::endl;
-		return;
-	}
-	m_Directory = vPath.substr(0, vPath.find_last_of('/'));
-	__traverseNodes();
+	for (auto &vMesh : m_Meshes)
+		vMesh.update(vShader, vMesh.selectLod(vLodSelection));
 }
 
 //************************************************************************************
 //Function:
-GLvoid CModel::__traverseNodes()
+GLvoid CModel::update(const CShader& vShader, const std::vector<uint32_t>& vMeshIndices, const SLodSelection& vLodSelection) const
 {
-	GLint NumMeshes = static_cast<GLint>(m_pScene->mNumMeshes);
-	for (GLint i = 0; i < NumMeshes; ++i)
-		m_Meshes.push_back(__processMesh(m_pScene->mMeshes[i]));
+	for (auto MeshIndex : vMeshIndices)
+	{
+		_ASSERT(MeshIndex < m_Meshes.size());
+		const CMesh& Mesh = m_Meshes[MeshIndex];
+		Mesh.update(vShader, Mesh.selectLod(vLodSelection));
+	}
 }
 
 //************************************************************************************
 //Function:
-CMesh CModel::__processMesh(const aiMesh *vAiMesh)
-{
-	_ASSERT(vAiMesh);
-	std::vector<SMeshVertex> Vertices;
-	std::vector<GLint> Indices;
-	std::vector<SMeshTexture> Textures;
-	SMeshMatProperties MeshMatProperties;
-	__processVertex(vAiMesh, Vertices);
-	__processIndices(vAiMesh, Indices);
-	__processTextures(vAiMesh, Textures);
-	__processMatProperties(vAiMesh, MeshMatProperties);
-	return CMesh(Vertices, Indices, Textures, MeshMatProperties, ++m_MeshCount);
-}
-
-GLvoid CModel::__processMatProperties(const aiMesh *vAiMesh, SMeshMatProperties& voMeshMatProperties)
+GLvoid CModel::appendDraws(CMultiDrawBatch& voBatch, const std::vector<uint32_t>& vMeshIndices, const SLodSelection& vLodSelection, const glm::mat4& vModelMatrix) const
 {
-	_ASSERT(vAiMesh);
-	if (vAiMesh->mMaterialIndex < 0)
-		return;
-	aiMaterial *pAiMat = m_pScene->mMaterials[vAiMesh->mMaterialIndex];
-	aiColor3D AmbientColor, DiffuseColor, SpecularColor;
-	float Shininess = 0.0f, Refracti = 0.0f;
-	pAiMat->Get(AI_MATKEY_COLOR_AMBIENT, AmbientColor);
-	pAiMat->Get(AI_MATKEY_COLOR_DIFFUSE, DiffuseColor);
-	pAiMat->Get(AI_MATKEY_COLOR_SPECULAR, SpecularColor);
-	pAiMat->Get(AI_MATKEY_SHININESS, Shininess);
-	pAiMat->Get(AI_MATKEY_REFRACTI, Refracti);
-	voMeshMatProperties.AmbientColor = { AmbientColor.r, AmbientColor.g, AmbientColor.b };
-	voMeshMatProperties.DiffuseColor = { DiffuseColor.r, DiffuseColor.g, DiffuseColor.b };
-	voMeshMatProperties.SpecularColor = { SpecularColor.r, SpecularColor.g, SpecularColor.b };
-	voMeshMatProperties.Shininess = Shininess;
-	voMeshMatProperties.Refracti = Refracti;
+	SLodSelection LodSelection = vLodSelection;
+	LodSelection.ViewProjectionMatrix = vLodSelection.ViewProjectionMatrix * vModelMatrix;
+	for (auto MeshIndex : vMeshIndices)
+	{
+		_ASSERT(MeshIndex < m_Meshes.size());
+		const CMesh& Mesh = m_Meshes[MeshIndex];
+		Mesh.appendDraw(voBatch, Mesh.selectLod(LodSelection), vModelMatrix);
+	}
 }
 
 //************************************************************************************
-//Function:
-GLvoid CModel::__processVertex(const aiMesh *vAiMesh, std::vector<SMeshVertex> &voVertices)
+//Function: uploads whatever the jobs finished since the last call, done when the jobs were done before the results were taken
+bool CModel::pumpLoad()
 {
-	_ASSERT(vAiMesh);
-	GLint NumVertices = (GLint)vAiMesh->mNumVertices;
-	for (GLint i = 0; i < NumVertices; ++i)
-	{
-		SMeshVertex Vertex;
-		Vertex.Position = glm::vec3(vAiMesh->mVertices[i].x, vAiMesh->mVertices[i].y, vAiMesh->mVertices[i].z);
-		if (vAiMesh->mNormals != nullptr)
-			Vertex.Normal = glm::vec3(vAiMesh->mNormals[i].x, vAiMesh->mNormals[i].y, vAiMesh->mNormals[i].z);
-		else
-			Vertex.Normal = glm::vec3(0.0f, 0.0f, 0.0f);
-		if (vAiMesh->mTextureCoords[0]) {
-			Vertex.TexCoords = glm::vec2(vAiMesh->mTextureCoords[0][i].x, vAiMesh->mTextureCoords[0][i].y);
-		}
-		else {
-			Vertex.TexCoords = glm::vec2(0.0f, 0.0f);
-		}
+	if (!m_pLoadState)
+		return true;
 
-		if (vAiMesh->mTangents)
-			Vertex.Tangent = glm::vec3(vAiMesh->mTangents[i].x, vAiMesh->mTangents[i].y, vAiMesh->mTangents[i].z);
-		
-		voVertices.push_back(Vertex);
+	SModelLoadState& State = *m_pLoadState;
+	const bool IsJobsDone = State.pJobs->isDone();
+	bool IsMeshDataReady = false;
+	std::vector<SModelLoadState::STextureFile> TextureFiles;
+	{
+		std::lock_guard<std::mutex> Lock(State.Mutex);
+		IsMeshDataReady = State.IsMeshDataReady;
+		TextureFiles.swap(State.TextureFiles);
 	}
-}
 
-//************************************************************************************
-//Function:
-GLvoid CModel::__processIndices(const aiMesh *vAiMesh, std::vector<GLint> &voIndices)
-{
-	_ASSERT(vAiMesh);
-	GLint NumFaces = vAiMesh->mNumFaces;
-	for (GLint i = 0; i < NumFaces; ++i)
+	if (IsMeshDataReady && !m_AreMeshesCreated)
+		__createMeshes();
+	for (const auto& TextureFile : TextureFiles)
+		__requestTexture(TextureFile.TextureIndex, TextureFile.FilePath, TextureFile.ContentHash, TextureFile.pFileData);
+	if (!IsJobsDone)
+		return false;
+
+	size_t VertexBufferSize = 0, IndexBufferSize = 0;
+	for (const CMesh& Mesh : m_Meshes)
 	{
-		aiFace AiFace = vAiMesh->mFaces[i];
-		GLint NumIndices = AiFace.mNumIndices;
-		for (GLint k = 0; k < NumIndices; ++k)
-			voIndices.push_back(AiFace.mIndices[k]);
+		VertexBufferSize += Mesh.getVertexBufferSize();
+		IndexBufferSize += Mesh.getIndexBufferSize();
 	}
+	if (m_Meshes.empty())
+		std::cerr << "Error::Model:: " << State.ModelPath << " has no mesh to draw" << std::endl;
+	else
+		std::cout << "Model:: " << State.ModelPath << " loaded " << m_Meshes.size() << " meshes " << (State.IsFromMeshCache ? "from the mesh cache" : "imported with Assimp") << " in " << State.MeshDataMs
+			<< " ms, " << m_LoadedTextures.size() << " textures, " << computeElapsedMs(State.StartTime) << " ms in total on " << State.pJobSystem->getThreadCount() << " workers, "
+			<< VertexBufferSize / 1024 << " KB of " << (m_Meshes[0].isVertexPacked() ? "packed" : "float") << " vertices and " << IndexBufferSize / 1024 << " KB of indices" << std::endl;
+	m_pLoadState.reset();
+	m_pBounding.reset();
+	return true;
 }
 
 //************************************************************************************
-//Function:
-GLvoid CModel::__processTextures(const aiMesh *vAiMesh, std::vector<SMeshTexture> &voTextures)
+//Function: the calling thread helps with the remaining jobs
+void CModel::finishLoad()
 {
-	_ASSERT(vAiMesh);
-	if (vAiMesh->mMaterialIndex < 0)
+	if (!m_pLoadState)
 		return;
-	aiMaterial *pAiMat = m_pScene->mMaterials[vAiMesh->mMaterialIndex];
-	ElayGraphics::STexture Texture2DInSRGBSpace;
-	Texture2DInSRGBSpace.isSRGBSpace = GL_TRUE;
-	ElayGraphics::STexture Texture2D4Roughness;
-	Texture2D4Roughness.Type4MinFilter = GL_LINEAR_MIPMAP_LINEAR;
-	__loadTextureFromMaterial(aiTextureType_DIFFUSE, pAiMat, DIFFUSE_TEX, voTextures/*, Texture2DInSRGBSpace*/);
-	__loadTextureFromMaterial(aiTextureType_SPECULAR, pAiMat, SPECULAR_TEX, voTextures);
-	__loadTextureFromMaterial(aiTextureType_HEIGHT, pAiMat, NORMAL_TEX, voTextures);
-	__loadTextureFromMaterial(aiTextureType_SHININESS, pAiMat, ROUGHNESS_TEX, voTextures/*, Texture2D4Roughness*/);
-	__loadTextureFromMaterial(aiTextureType_AMBIENT, pAiMat, METALLIC_TEX, voTextures);
+	m_pLoadState->pJobSystem->wait(m_pLoadState->pJobs);
+	pumpLoad();
 }
 
 //************************************************************************************
-//Function:
-GLvoid CModel::__loadTextureFromMaterial(aiTextureType vTextureType, const aiMaterial *vMat, const std::string& vTextureNamePrefix, std::vector<SMeshTexture>& voTextures, std::shared_ptr<ElayGraphics::STexture> vTexture2D/* = std::make_shared<ElayGraphics::STexture>()*/)
+//Function: the VAOs are created now, the mesh textures wait in m_PendingMeshTextures for the texture streamer
+GLvoid CModel::__createMeshes()
 {
-	_ASSERT(vMat);
-	GLint TextureCount = vMat->GetTextureCount(vTextureType);
-	int TextureIndex = -1;
-	if (TextureCount <= 0)
-	{
-		SMeshTexture MeshTexture;		//Noteطע͵ֱreturnΪҪinitõuniformӦ
-		voTextures.push_back(MeshTexture);
-	}
-	for (GLint i = 0; i < TextureCount; ++i)
+	SModelLoadState& State = *m_pLoadState;
+	m_AreMeshesCreated = true;
+	const size_t MeshCount = State.MeshTextureBindings.size();
+	m_Meshes.reserve(MeshCount);
+	m_PendingMeshTextures.resize(MeshCount);
+	m_PendingTextureCounts.assign(MeshCount, 0);
+	m_LoadedTextures.resize(State.TexturePaths.size());
+	m_TextureUsers.resize(State.TexturePaths.size());
+	for (size_t i = 0; i < State.TexturePaths.size(); ++i)
+		m_LoadedTextures[i].TexturePath = State.TexturePaths[i];
+
+	for (size_t i = 0; i < MeshCount; ++i)
 	{
-		aiString Str;
-		vMat->GetTexture(vTextureType, i, &Str);
-		std::string TextureName = Str.C_Str();
-		std::string TexturePath = m_Directory + "/" + TextureName;
-		GLboolean Skip = GL_FALSE;
-		GLint LoadedTextureCount = static_cast<int>(m_LoadedTextures.size());
-		for (int k = 0; k < LoadedTextureCount; ++k)
+		if (State.pMeshCache)
 		{
-			if (TexturePath == m_LoadedTextures[k].TexturePath)
-			{
-				Skip = GL_TRUE;
-				m_LoadedTextures[k].TextureUniformName = vTextureNamePrefix + std::to_string(++TextureIndex);
-				voTextures.push_back(m_LoadedTextures[k]);
-				break;
-			}
+			const CMeshCache& MeshCache = *State.pMeshCache;
+			const SMeshCacheRecord& Record = MeshCache.getMeshRecord(i);
+			SMeshMatProperties MatProperties;
+			MatProperties.AmbientColor = glm::vec3(Record.AmbientColor[0], Record.AmbientColor[1], Record.AmbientColor[2]);
+			MatProperties.DiffuseColor = glm::vec3(Record.DiffuseColor[0], Record.DiffuseColor[1], Record.DiffuseColor[2]);
+			MatProperties.SpecularColor = glm::vec3(Record.SpecularColor[0], Record.SpecularColor[1], Record.SpecularColor[2]);
+			MatProperties.Shininess = Record.Shininess;
+			MatProperties.Refracti = Record.Refracti;
+			auto pBounding = std::make_shared<CAABB>(glm::vec3(Record.Min[0], Record.Min[1], Record.Min[2]), glm::vec3(Record.Max[0], Record.Max[1], Record.Max[2]));
+			m_Meshes.emplace_back(State.pMeshCache, MeshCache.getVertices(i), Record.VertexCount, MeshCache.getIndices(i), Record.IndexCount, MeshCache.getLods(i), std::vector<SMeshTexture>(), MatProperties, pBounding, ++m_MeshCount);
+		}
+		else
+		{
+			const SMeshData& Mesh = (*State.pMeshes)[i];
+			m_Meshes.emplace_back(State.pMeshes, Mesh.Vertices.data(), Mesh.Vertices.size(), Mesh.Indices.data(), Mesh.Indices.size(), std::vector<SMeshLod>(Mesh.Lods), std::vector<SMeshTexture>(), Mesh.MatProperties, std::make_shared<CAABB>(Mesh.Min, Mesh.Max), ++m_MeshCount);
 		}
-		if (!Skip)
+
+		//Note: an empty slot stays, init binds the texture uniforms by position
+		const std::vector<SMeshTextureBinding>& Bindings = State.MeshTextureBindings[i];
+		std::vector<SMeshTexture>& Textures = m_PendingMeshTextures[i];
+		Textures.resize(Bindings.size());
+		for (size_t k = 0; k < Bindings.size(); ++k)
 		{
-			SMeshTexture MeshTexture;
-			loadTextureFromFile(TexturePath, vTexture2D);
-			MeshTexture.ID = vTexture2D->TextureID;
-			MeshTexture.TexturePath = TexturePath;
-			MeshTexture.TextureUniformName = vTextureNamePrefix + std::to_string(++TextureIndex);
-			voTextures.push_back(MeshTexture);
-			m_LoadedTextures.push_back(MeshTexture);
+			const int TextureIndex = State.MeshTextureIndices[i][k];
+			if (TextureIndex < 0)
+				continue;
+			Textures[k].TexturePath = Bindings[k].TexturePath;
+			Textures[k].TextureUniformName = Bindings[k].TextureUniformName;
+			m_TextureUsers[TextureIndex].emplace_back(i, k);
+			m_PendingTextureCounts[i]++;
 		}
+		if (m_PendingTextureCounts[i] == 0)
+			m_Meshes[i].setTextures(std::move(Textures));
+	}
+}
+
+//************************************************************************************
+//Function: a normal map waits for its mips as a flat normal, any other texture as mid gray
+GLvoid CModel::__requestTexture(size_t vTextureIndex, const std::string& vFilePath, uint64_t vContentHash, const std::shared_ptr<const std::vector<char>>& vFileData)
+{
+	static const GLubyte FlatNormal[4] = { 128, 128, 255, 255 };
+	static const GLubyte Gray[4] = { 128, 128, 128, 255 };
+	bool IsNormalMap = false;
+	for (const auto& User : m_TextureUsers[vTextureIndex])
+		IsNormalMap |= m_PendingMeshTextures[User.first][User.second].TextureUniformName == NORMAL_TEX;
+
+	const GLuint TextureID = CResourceManager::getOrCreateInstance()->fetchOrCreateTextureStreamer()->requestTexture(vContentHash, vFilePath, vFileData, IsNormalMap ? FlatNormal : Gray);
+	m_LoadedTextures[vTextureIndex].ID = TextureID;
+	for (const auto& User : m_TextureUsers[vTextureIndex])
+	{
+		m_PendingMeshTextures[User.first][User.second].ID = TextureID;
+		if (--m_PendingTextureCounts[User.first] == 0)
+			m_Meshes[User.first].setTextures(std::move(m_PendingMeshTextures[User.first]));
 	}
 }
 
@@ -211,7 +382,8 @@ GLvoid CModel::__loadTextureFromMaterial(aiTextureType vTextureType, const aiMat
 //Function:
 std::shared_ptr<CAABB> CModel::getOrCreateBounding()
 {
-	if (!m_pBounding)
+	//while loading only the meshes created so far count, so nothing is kept
+	if (!m_pBounding || m_pLoadState)
 	{
 		m_pBounding = std::make_shared<CAABB>();
 		size_t MeshSize = m_Meshes.size();
@@ -223,6 +395,14 @@ std::shared_ptr<CAABB> CModel::getOrCreateBounding()
 	return m_pBounding;
 }
 
+//************************************************************************************
+//Function:
+std::shared_ptr<CAABB> CModel::getOrCreateMeshBounding(size_t vMeshIndex)
+{
+	_ASSERT(vMeshIndex < m_Meshes.size());
+	return m_Meshes[vMeshIndex].getOrCreateBounding();
+}
+
 //************************************************************************************
 //Function:
 std::vector<glm::vec3> CModel::getTriangle()
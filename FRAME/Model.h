@@ -7,41 +7,54 @@
 #include <string>
 #include <vector>
 #include <map>
-#include <Assimp/Importer.hpp>
-#include <Assimp/scene.h>
-#include <Assimp/postprocess.h>
 #include <memory>
 #include "Mesh.h"
 #include "Common.h"
 
 class CShader;
 class CAABB;
+class CJobSystem;
+class CMultiDrawBatch;
+struct SModelLoadState;
 
+//Meshes are prepared and texture files read by jobs; the VAOs are created on the context
+//thread by pumpLoad as the jobs finish, and the textures are requested from the shared
+//CTextureStreamer, which streams their mips in over the following frames. A mesh is drawn
+//with its material colors until all of its textures are requested. With IS_COMPRESS_TEXTURES
+//the read jobs hand the streamer the block compressed DDS cache MeshConverter wrote instead, if it is fresh.
 class CModel
 {
 public:
 	CModel() = default;
-	CModel(const std::string &vModelPath);
-	~CModel() = default;
+	CModel(const std::string &vModelPath);	//returns with every mesh and texture created, the texture mips still stream in
+	CModel(const std::string &vModelPath, const std::shared_ptr<CJobSystem>& vJobSystem);	//returns at once, pumpLoad finishes it
+	~CModel();
 	void init(CShader &vioShader);
 	void update(const CShader &vShader) const;
+	void update(const CShader &vShader, const SLodSelection& vLodSelection) const;	//every mesh picks its own LOD
+	void update(const CShader &vShader, const std::vector<uint32_t>& vMeshIndices, const SLodSelection& vLodSelection) const;	//only the listed meshes
+	//vLodSelection holds the view projection matrix without vModelMatrix, the LODs are picked with both
+	void appendDraws(CMultiDrawBatch& voBatch, const std::vector<uint32_t>& vMeshIndices, const SLodSelection& vLodSelection, const glm::mat4& vModelMatrix) const;
 
+	bool pumpLoad();	//context thread only, true once loaded
+	void finishLoad();
+	bool isLoaded() const { return !m_pLoadState; }
+
+	size_t getMeshCount() const { return m_Meshes.size(); }	//grows from 0 while loading
 	std::shared_ptr<CAABB> getOrCreateBounding();
+	std::shared_ptr<CAABB> getOrCreateMeshBounding(size_t vMeshIndex);
 	std::vector<glm::vec3> getTriangle();
 private:
 	int						   m_MeshCount = -1;
-	std::vector<SMeshTexture>  m_LoadedTextures;
+	std::vector<SMeshTexture>  m_LoadedTextures;	//one per distinct texture path of the model
 	std::vector<CMesh>         m_Meshes;
-	std::string                m_Directory;
-	const aiScene             *m_pScene;
 	std::shared_ptr<CAABB>     m_pBounding;	//طƲãӦɹģʽӦİΧ
+	std::shared_ptr<SModelLoadState> m_pLoadState;
+	bool					   m_AreMeshesCreated = false;
+	std::vector<std::vector<SMeshTexture>> m_PendingMeshTextures;
+	std::vector<int>		   m_PendingTextureCounts;
+	std::vector<std::vector<std::pair<size_t, size_t>>> m_TextureUsers;	//(mesh, slot) of every loaded texture
 
-	GLvoid __loadModel(const std::string& vPath);
-	GLvoid __traverseNodes();
-	CMesh  __processMesh(const aiMesh *vAiMesh);
-	GLvoid __processVertex(const aiMesh *vAiMesh, std::vector<SMeshVertex> &voVertices);
-	GLvoid __processIndices(const aiMesh *vAiMesh, std::vector<GLint> &voIndices);
-	GLvoid __processTextures(const aiMesh *vAiMesh, std::vector<SMeshTexture> &voTextures);
-	GLvoid __processMatProperties(const aiMesh *vAiMesh, SMeshMatProperties& voMeshMatProperties);
-	GLvoid __loadTextureFromMaterial(aiTextureType vTextureType, const aiMaterial *vMat, const std::string& vTextureNamePrefix, std::vector<SMeshTexture>& voTextures, std::shared_ptr<ElayGraphics::STexture> vTexture2D = std::make_shared<ElayGraphics::STexture>());
+	GLvoid __createMeshes();
+	GLvoid __requestTexture(size_t vTextureIndex, const std::string& vFilePath, uint64_t vContentHash, const std::shared_ptr<const std::vector<char>>& vFileData);
 };
\ No newline at end of file
@@ -0,0 +1,207 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) Elay Pu. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "MultiDrawBatch.h"
+#include "Mesh.h"
+#include "Shader.h"
+#include "Utils.h"
+#include "ResourceManager.h"
+#include "GeometryArena.h"
+#include "AABB.h"
+#include <algorithm>
+
+CMultiDrawBatch::~CMultiDrawBatch()
+{
+	if (m_IndirectBuffer)
+		glDeleteBuffers(1, &m_IndirectBuffer);
+	if (m_RecordBuffer)
+		glDeleteBuffers(1, &m_RecordBuffer);
+	if (m_MaterialBuffer)
+		glDeleteBuffers(1, &m_MaterialBuffer);
+	if (m_BoundsBuffer)
+		glDeleteBuffers(1, &m_BoundsBuffer);
+}
+
+//************************************************************************************
+//Function:
+bool CMultiDrawBatch::isSupported()
+{
+	return GLEW_VERSION_4_3 && GLEW_ARB_shader_draw_parameters;
+}
+
+//************************************************************************************
+//Function:
+bool CMultiDrawBatch::isDrawCountSupported()
+{
+	return isSupported() && GLEW_ARB_indirect_parameters;
+}
+
+//************************************************************************************
+//Function:
+void CMultiDrawBatch::clear()
+{
+	for (SDrawGroup& Group : m_Groups)
+	{
+		Group.Commands.clear();
+		Group.Records.clear();
+		Group.Bounds.clear();
+	}
+	m_Materials.clear();
+	m_MaterialIndices.clear();
+}
+
+//************************************************************************************
+//Function:
+void CMultiDrawBatch::append(const CMesh& vMesh, size_t vLod, const glm::mat4& vModelMatrix)
+{
+	const SGeometryAllocation& Allocation = vMesh.getGeometryAllocation();
+	const SMeshLod& Lod = vMesh.getLod(std::min(vLod, vMesh.getLodCount() - 1));
+	const size_t GroupIndex = __getGroupIndex(Allocation.IsVertexPacked, Allocation.IndexType);
+	SDrawGroup& Group = m_Groups[GroupIndex];
+
+	auto Iter = m_MaterialIndices.find(&vMesh);
+	if (Iter == m_MaterialIndices.end())
+	{
+		const SMeshMatProperties& Properties = vMesh.getMeshMatProperties();
+		SDrawMaterial Material;
+		Material.AmbientColor = glm::vec4(Properties.AmbientColor, Properties.Shininess);
+		Material.DiffuseColor = glm::vec4(Properties.DiffuseColor, Properties.Refracti);
+		Material.SpecularColor = glm::vec4(Properties.SpecularColor, 0.0f);
+		Iter = m_MaterialIndices.insert(std::make_pair(&vMesh, static_cast<GLuint>(m_Materials.size()))).first;
+		m_Materials.push_back(Material);
+	}
+
+	SDrawElementsIndirectCommand Command;
+	Command.Count = Lod.IndexCount;
+	Command.InstanceCount = 1;
+	Command.FirstIndex = Allocation.FirstIndex + Lod.IndexOffset;
+	Command.BaseVertex = Allocation.BaseVertex;
+	Command.BaseInstance = 0;
+	Group.Commands.push_back(Command);
+
+	SDrawRecord Record = {};
+	Record.ModelMatrix = vModelMatrix;
+	Record.PositionScale = glm::vec4(vMesh.getPositionScale(), Allocation.IsVertexPacked ? 1.0f : 0.0f);
+	Record.PositionBias = glm::vec4(vMesh.getPositionBias(), 0.0f);
+	Record.MeshId = static_cast<GLuint>(vMesh.getMeshId());
+	Record.MaterialIndex = Iter->second;
+	Group.Records.push_back(Record);
+
+	SDrawBounds Bounds = {};
+	Bounds.MinCorner = glm::vec3(1.0f);
+	Bounds.MaxCorner = glm::vec3(-1.0f);
+	if (const std::shared_ptr<CAABB>& pBounding = vMesh.getBounding())
+	{
+		Bounds.MinCorner = pBounding->getMin();
+		Bounds.MaxCorner = pBounding->getMax();
+	}
+	Bounds.GroupIndex = static_cast<GLuint>(GroupIndex);
+	Group.Bounds.push_back(Bounds);
+}
+
+//************************************************************************************
+//Function: the buffers are orphaned with glBufferData every call, so a batch can be reused within a frame
+void CMultiDrawBatch::upload()
+{
+	m_Commands.clear();
+	m_Records.clear();
+	m_Bounds.clear();
+	for (const SDrawGroup& Group : m_Groups)
+	{
+		const GLuint GroupFirstDraw = static_cast<GLuint>(m_Commands.size());
+		m_Commands.insert(m_Commands.end(), Group.Commands.begin(), Group.Commands.end());
+		m_Records.insert(m_Records.end(), Group.Records.begin(), Group.Records.end());
+		for (SDrawBounds Bounds : Group.Bounds)
+		{
+			Bounds.GroupFirstDraw = GroupFirstDraw;
+			m_Bounds.push_back(Bounds);
+		}
+	}
+	if (m_Commands.empty())
+		return;
+
+	if (!m_IndirectBuffer)
+	{
+		glGenBuffers(1, &m_IndirectBuffer);
+		glGenBuffers(1, &m_RecordBuffer);
+		glGenBuffers(1, &m_MaterialBuffer);
+		glGenBuffers(1, &m_BoundsBuffer);
+	}
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_IndirectBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, m_Commands.size() * sizeof(SDrawElementsIndirectCommand), m_Commands.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	++fetchDriverCallCounters().BufferUploads;
+	updateSSBOBuffer(m_RecordBuffer, m_Records.size() * sizeof(SDrawRecord), m_Records.data(), GL_STREAM_DRAW);
+	updateSSBOBuffer(m_MaterialBuffer, m_Materials.size() * sizeof(SDrawMaterial), m_Materials.data(), GL_STREAM_DRAW);
+	updateSSBOBuffer(m_BoundsBuffer, m_Bounds.size() * sizeof(SDrawBounds), m_Bounds.data(), GL_STREAM_DRAW);
+}
+
+//************************************************************************************
+//Function:
+void CMultiDrawBatch::draw(const CShader& vShader)
+{
+	m_MultiDrawCallCount = 0;
+	upload();
+	if (!m_Commands.empty())
+		__drawGroups(vShader, m_IndirectBuffer, m_RecordBuffer, 0, 0, 0);
+}
+
+//************************************************************************************
+//Function:
+void CMultiDrawBatch::drawCulled(const CShader& vShader, GLuint vCommandBuffer, GLuint vRecordBuffer, size_t vFirstDraw, GLuint vCountBuffer, GLintptr vCountOffset)
+{
+	m_MultiDrawCallCount = 0;
+	if (!m_Commands.empty())
+		__drawGroups(vShader, vCommandBuffer, vRecordBuffer, vFirstDraw, isDrawCountSupported() ? vCountBuffer : 0, vCountOffset);
+}
+
+//************************************************************************************
+//Function: vCountBuffer 0 draws every command of a group
+void CMultiDrawBatch::__drawGroups(const CShader& vShader, GLuint vCommandBuffer, GLuint vRecordBuffer, size_t vFirstDraw, GLuint vCountBuffer, GLintptr vCountOffset)
+{
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, vCommandBuffer);
+	if (vCountBuffer)
+		glBindBuffer(GL_PARAMETER_BUFFER_ARB, vCountBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_RECORD_BINDING, vRecordBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_MATERIAL_BINDING, m_MaterialBuffer);
+
+	const GLint IsMultiDrawLoc = vShader.getUniformId(IS_MULTI_DRAW);
+	const GLint DrawRecordOffsetLoc = vShader.getUniformId(DRAW_RECORD_OFFSET);
+	vShader.setIntUniformValue(IsMultiDrawLoc, 1);
+	const std::shared_ptr<CGeometryArena> pGeometryArena = CResourceManager::getOrCreateInstance()->fetchOrCreateGeometryArena();
+	size_t FirstDraw = vFirstDraw;
+	for (size_t i = 0; i < GROUP_COUNT; ++i)
+	{
+		const size_t DrawCount = m_Groups[i].Commands.size();
+		if (DrawCount == 0)
+			continue;
+		//gl_DrawIDARB restarts at 0 with every call
+		vShader.setIntUniformValue(DrawRecordOffsetLoc, static_cast<GLint>(FirstDraw));
+		glBindVertexArray(pGeometryArena->getVAO(i >= 2));
+		const GLenum IndexType = (i & 1) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+		const GLvoid* pIndirect = (GLvoid*)(intptr_t)(FirstDraw * sizeof(SDrawElementsIndirectCommand));
+		if (vCountBuffer)
+			glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, IndexType, pIndirect, vCountOffset + i * sizeof(GLuint), static_cast<GLsizei>(DrawCount), 0);
+		else
+			glMultiDrawElementsIndirect(GL_TRIANGLES, IndexType, pIndirect, static_cast<GLsizei>(DrawCount), 0);
+		++fetchDriverCallCounters().DrawCalls;
+		++m_MultiDrawCallCount;
+		FirstDraw += DrawCount;
+	}
+	glBindVertexArray(0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	if (vCountBuffer)
+		glBindBuffer(GL_PARAMETER_BUFFER_ARB, 0);
+	vShader.setIntUniformValue(IsMultiDrawLoc, 0);
+}
+
+//************************************************************************************
+//Function:
+size_t CMultiDrawBatch::getDrawCount() const
+{
+	size_t DrawCount = 0;
+	for (const SDrawGroup& Group : m_Groups)
+		DrawCount += Group.Commands.size();
+	return DrawCount;
+}
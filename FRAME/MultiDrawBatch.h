@@ -0,0 +1,111 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) Elay Pu. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+#include <GL/glew.h>
+#include <GLM/glm.hpp>
+#include <map>
+#include <vector>
+#include "FRAME_EXPORTS.h"
+
+#define IS_MULTI_DRAW			"u_IsMultiDraw"
+#define DRAW_RECORD_OFFSET		"u_DrawRecordOffset"
+
+class CMesh;
+class CShader;
+
+//Per draw data of a multi-draw, std430 like SDrawRecord in the vertex shaders
+struct SDrawRecord
+{
+	glm::mat4 ModelMatrix;
+	glm::vec4 PositionScale;	//w is 1 for SPackedMeshVertex
+	glm::vec4 PositionBias;
+	GLuint	  MeshId;
+	GLuint	  MaterialIndex;	//into u_DrawMaterials
+	GLuint	  Padding[2];
+};
+
+//Material colors of a mesh, what CMesh::update sets as uniforms
+struct SDrawMaterial
+{
+	glm::vec4 AmbientColor;		//w is the shininess
+	glm::vec4 DiffuseColor;		//w is the refraction index
+	glm::vec4 SpecularColor;
+};
+
+//Model space AABB of a draw for a culling shader, in the order of the uploaded commands
+struct SDrawBounds
+{
+	glm::vec3 MinCorner;		//MinCorner.x > MaxCorner.x when the mesh has no AABB, it is never culled
+	GLuint	  GroupIndex;
+	glm::vec3 MaxCorner;
+	GLuint	  GroupFirstDraw;	//where the draws of the group start in the uploaded commands
+};
+
+//Collects the meshes a pass draws and issues them as one glMultiDrawElementsIndirect per vertex layout and
+//index type of the geometry arena, one or two per shader in practice. While u_IsMultiDraw is set the vertex
+//shader reads u_DrawRecords[u_DrawRecordOffset + gl_DrawIDARB] instead of the per mesh uniforms.
+//Mesh textures are not bound per draw, none of the shaders drawn this way samples them.
+class FRAME_DLLEXPORTS CMultiDrawBatch
+{
+public:
+	static const GLuint DRAW_RECORD_BINDING = 7;
+	static const GLuint DRAW_MATERIAL_BINDING = 8;
+	static const size_t GROUP_COUNT = 4;
+
+	CMultiDrawBatch() = default;
+	~CMultiDrawBatch();
+
+	static bool isSupported();	//GL_ARB_shader_draw_parameters, gl_DrawID is core from GLSL 4.60 only
+	static bool isDrawCountSupported();	//GL_ARB_indirect_parameters
+
+	void clear();
+	void append(const CMesh& vMesh, size_t vLod, const glm::mat4& vModelMatrix);
+	void upload();	//for a culling shader to read the commands, records and bounds, draw() uploads itself
+	void draw(const CShader& vShader);
+	//Draws what a culling shader compacted out of the uploaded draws. Group i keeps its draws at vFirstDraw plus its
+	//first draw in vCommandBuffer and vRecordBuffer, their count is the GLuint at vCountOffset + 4 * i of vCountBuffer.
+	//Without GL_ARB_indirect_parameters the whole range of the group is drawn, the culled commands must be zeroed.
+	void drawCulled(const CShader& vShader, GLuint vCommandBuffer, GLuint vRecordBuffer, size_t vFirstDraw, GLuint vCountBuffer, GLintptr vCountOffset);
+
+	size_t getDrawCount() const;
+	unsigned getMultiDrawCallCount() const { return m_MultiDrawCallCount; }
+	GLuint getCommandBuffer() const { return m_IndirectBuffer; }
+	GLuint getRecordBuffer() const { return m_RecordBuffer; }
+	GLuint getBoundsBuffer() const { return m_BoundsBuffer; }
+
+private:
+	struct SDrawElementsIndirectCommand
+	{
+		GLuint Count;
+		GLuint InstanceCount;
+		GLuint FirstIndex;
+		GLint  BaseVertex;
+		GLuint BaseInstance;
+	};
+
+	//one per vertex layout and index type, they cannot share a glMultiDrawElementsIndirect
+	struct SDrawGroup
+	{
+		std::vector<SDrawElementsIndirectCommand> Commands;
+		std::vector<SDrawRecord> Records;
+		std::vector<SDrawBounds> Bounds;
+	};
+
+	SDrawGroup m_Groups[GROUP_COUNT];
+	std::vector<SDrawMaterial> m_Materials;
+	std::map<const CMesh*, GLuint> m_MaterialIndices;
+	std::vector<SDrawElementsIndirectCommand> m_Commands;	//all groups, uploaded in one go
+	std::vector<SDrawRecord> m_Records;
+	std::vector<SDrawBounds> m_Bounds;
+	GLuint m_IndirectBuffer = 0;
+	GLuint m_RecordBuffer = 0;
+	GLuint m_MaterialBuffer = 0;
+	GLuint m_BoundsBuffer = 0;
+	unsigned m_MultiDrawCallCount = 0;
+
+	void __drawGroups(const CShader& vShader, GLuint vCommandBuffer, GLuint vRecordBuffer, size_t vFirstDraw, GLuint vCountBuffer, GLintptr vCountOffset);
+
+	static size_t __getGroupIndex(bool vIsVertexPacked, GLenum vIndexType) { return (vIsVertexPacked ? 2 : 0) + (vIndexType == GL_UNSIGNED_SHORT ? 1 : 0); }
+};
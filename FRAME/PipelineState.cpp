@@ -0,0 +1,13 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) Elay Pu. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "PipelineState.h"
+#include "GLStateCache.h"
+
+//************************************************************************************
+//Function:
+void CPipelineState::apply() const
+{
+	fetchGLStateCache().applyPipelineState(*this);
+}
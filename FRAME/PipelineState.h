@@ -0,0 +1,40 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) Elay Pu. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+#include <GL/glew.h>
+#include <memory>
+#include "FRAME_EXPORTS.h"
+
+class CShader;
+
+//Defaults are those of a new GL context, a pass sets what it turns on
+struct SPipelineStateDesc
+{
+	bool IsDepthTest = false;
+	GLenum DepthFunc = GL_LESS;
+	bool IsDepthWrite = true;
+	bool IsCullFace = false;
+	GLenum CullFace = GL_BACK;
+	bool IsBlend = false;
+	GLenum BlendSourceFactor = GL_ONE;
+	GLenum BlendDestinationFactor = GL_ZERO;
+	std::shared_ptr<CShader> pShader;	//none when the pass picks its shader per frame and activates it itself
+};
+
+//Depth, cull, blend and program state a pass declares once in initV and applies before it draws. Applying goes through
+//CGLStateCache, so only what the previous pipeline left different is issued and a pass no longer restores the state
+//it changed when it is done.
+class FRAME_DLLEXPORTS CPipelineState
+{
+public:
+	CPipelineState() = default;
+	explicit CPipelineState(const SPipelineStateDesc& vDesc) : m_Desc(vDesc) {}
+
+	const SPipelineStateDesc& getDesc() const { return m_Desc; }
+	void apply() const;
+
+private:
+	SPipelineStateDesc m_Desc;
+};
@@ -5,6 +5,8 @@
 #include "RenderPass.h"
 #include "Shader.h"
 
+unsigned IRenderPass::s_ScheduleRevision = 0;
+
 IRenderPass::IRenderPass()
 {
 }
@@ -38,6 +40,15 @@ ElayGraphics::ERenderPassType IRenderPass::getPassType()
 void IRenderPass::setPassType(ElayGraphics::ERenderPassType vType)
 {
 	m_Type = vType;
+	invalidateSchedule();
+}
+
+//************************************************************************************
+//Function:
+void IRenderPass::setExecutionOrder(int vExecutionOrder)
+{
+	m_ExecutionOrder = vExecutionOrder;
+	invalidateSchedule();
 }
 
 //************************************************************************************
@@ -52,4 +63,19 @@ int IRenderPass::getExecutionOrder()
 void IRenderPass::finishExecute()
 {
 	 m_ExecutionOrder = -1;
+	 invalidateSchedule();
+}
+
+//************************************************************************************
+//Function:
+unsigned IRenderPass::getScheduleRevision()
+{
+	return s_ScheduleRevision;
+}
+
+//************************************************************************************
+//Function:
+void IRenderPass::invalidateSchedule()
+{
+	++s_ScheduleRevision;
 }
\ No newline at end of file
@@ -26,11 +26,15 @@ public:
 	int getExecutionOrder() const { return m_ExecutionOrder; }
 
 	void setPassName(const std::string &vPassName) { m_PassName = vPassName; }
-	void setExecutionOrder(int vExecutionOrder) { m_ExecutionOrder = vExecutionOrder; }
+	void setExecutionOrder(int vExecutionOrder);
 	ElayGraphics::ERenderPassType getPassType();
 	void setPassType(ElayGraphics::ERenderPassType vType);
 	int getExecutionOrder();
 	void finishExecute();
+
+	//bumped whenever a pass is registered or changes its order or type, CApp recompiles its pass plan then
+	static unsigned getScheduleRevision();
+	static void invalidateSchedule();
 protected:
 	std::shared_ptr<CShader> m_pShader;
 
@@ -38,4 +42,6 @@ private:
 	std::string m_PassName;
 	ElayGraphics::ERenderPassType m_Type  = ElayGraphics::ERenderPassType::RenderPassType_Normal;
 	int m_ExecutionOrder = -1;
+
+	static unsigned s_ScheduleRevision;
 };
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include "ResourceManager.h"
 #include <boost/algorithm/string/split.hpp>
 #include <boost/algorithm/string/classification.hpp>
+#include <algorithm>
 #include <iostream>
 #include "Camera.h"
 #include "UBO4ProjectionWorld.h"
@@ -16,6 +17,9 @@
 #include "GUI.h"
 #include "MainGUI.h"
 #include "GLFWWindow.h"
+#include "JobSystem.h"
+#include "GeometryArena.h"
+#include "TextureStreamer.h"
 
 CResourceManager::CResourceManager()
 {
@@ -68,9 +72,33 @@ const std::shared_ptr<CModel>& CResourceManager::getOrCreateModel(const std::str
 	std::string ModelName = *(SplitStringSet.end() - 1);
 	if (m_ModelMap.find(ModelName) == m_ModelMap.end())
 		m_ModelMap[ModelName] = std::make_shared<CModel>(vModelPath);
+	else
+		m_ModelMap[ModelName]->finishLoad();
+	return m_ModelMap[ModelName];
+}
+
+//************************************************************************************
+//Function: the jobs start at once, so several models load together; updatePendingModels uploads their results every frame
+const std::shared_ptr<CModel>& CResourceManager::getOrCreateModelAsync(const std::string &vModelPath)
+{
+	std::vector<std::string> SplitStringSet;
+	boost::split(SplitStringSet, vModelPath, boost::is_any_of("/\\"));
+	std::string ModelName = *(SplitStringSet.end() - 1);
+	if (m_ModelMap.find(ModelName) == m_ModelMap.end())
+	{
+		m_ModelMap[ModelName] = std::make_shared<CModel>(vModelPath, getOrCreateJobSystem());
+		m_PendingModelSet.push_back(m_ModelMap[ModelName]);
+	}
 	return m_ModelMap[ModelName];
 }
 
+//************************************************************************************
+//Function:
+GLvoid CResourceManager::updatePendingModels()
+{
+	m_PendingModelSet.erase(std::remove_if(m_PendingModelSet.begin(), m_PendingModelSet.end(), [](const std::shared_ptr<CModel>& vModel) { return vModel->pumpLoad(); }), m_PendingModelSet.end());
+}
+
 //************************************************************************************
 //Function:
 const std::shared_ptr<CMainGUI>& CResourceManager::getOrCreateMainGUI()
@@ -80,6 +108,15 @@ const std::shared_ptr<CMainGUI>& CResourceManager::getOrCreateMainGUI()
 	return m_pMainGUI;
 }
 
+//************************************************************************************
+//Function:
+const std::shared_ptr<CJobSystem>& CResourceManager::getOrCreateJobSystem()
+{
+	if (!m_pJobSystem)
+		m_pJobSystem = std::make_shared<CJobSystem>();
+	return m_pJobSystem;
+}
+
 //************************************************************************************
 //Function:
 std::shared_ptr<CUBO4ProjectionWorld> CResourceManager::fetchOrCreateUBO4ProjectionWorld()
@@ -116,12 +153,31 @@ std::shared_ptr<CTools>	CResourceManager::fetchOrCreateTools()
 	return m_pTools;
 }
 
+//************************************************************************************
+//Function:
+std::shared_ptr<CGeometryArena> CResourceManager::fetchOrCreateGeometryArena()
+{
+	if (!m_pGeometryArena)
+		m_pGeometryArena = std::make_shared<CGeometryArena>();
+	return m_pGeometryArena;
+}
+
+//************************************************************************************
+//Function:
+std::shared_ptr<CTextureStreamer> CResourceManager::fetchOrCreateTextureStreamer()
+{
+	if (!m_pTextureStreamer)
+		m_pTextureStreamer = std::make_shared<CTextureStreamer>(getOrCreateJobSystem());
+	return m_pTextureStreamer;
+}
+
 //************************************************************************************
 //Function:
 void CResourceManager::registerRenderPass(const std::shared_ptr<IRenderPass> &vRenderPass)
 {
 	_ASSERT(vRenderPass);
 	m_RenderPassSet.push_back(vRenderPass->getPassName(), vRenderPass, 1);
+	IRenderPass::invalidateSchedule();
 }
 
 //************************************************************************************
@@ -153,24 +209,39 @@ const std::shared_ptr<IGameObject>& CResourceManager::getGameObjectByName(const
 GLvoid CResourceManager::registerSharedData(const std::string& vDataName, boost::any vData)
 {
 	_ASSERT(!vDataName.empty());
-	_WARNING(m_SharedDataMap.find(vDataName) != m_SharedDataMap.end(), "WARNING: the data called " + vDataName + " has existed in Resource Manager.");
+	auto Iter = m_SharedDataMap.find(vDataName);
+	_WARNING(Iter != m_SharedDataMap.end() && !Iter->second.empty(), "WARNING: the data called " + vDataName + " has existed in Resource Manager.");
 	m_SharedDataMap[vDataName] = vData;
 }
 
 //************************************************************************************
-//Function:
+//Function: a slot only interned by a handle is not registered, the empty value it returns fails the any_cast of the caller
 const boost::any& CResourceManager::getSharedDataByName(const std::string &vDataName)
 {
-	_ASSERT(m_SharedDataMap.find(vDataName) != m_SharedDataMap.end());
-	return m_SharedDataMap[vDataName];
+	return fetchSharedDataByName(vDataName);
 }
 
 //************************************************************************************
 //Function:
 boost::any&	CResourceManager::fetchSharedDataByName(const std::string& vDataName)
 {
-	_ASSERT(m_SharedDataMap.find(vDataName) != m_SharedDataMap.end());
-	return m_SharedDataMap[vDataName];
+	auto Iter = m_SharedDataMap.find(vDataName);
+	if (Iter == m_SharedDataMap.end() || Iter->second.empty())
+	{
+		std::cerr << "Error::ResourceManager:: the shared data called " << vDataName << " is not registered." << std::endl;
+		static boost::any UnregisteredData;
+		UnregisteredData = boost::any();
+		return UnregisteredData;
+	}
+	return Iter->second;
+}
+
+//************************************************************************************
+//Function: map nodes never move, so the slot keeps its address even when the name is registered later
+boost::any* CResourceManager::internSharedData(const std::string& vDataName)
+{
+	_ASSERT(!vDataName.empty());
+	return &m_SharedDataMap[vDataName];
 }
 
 //************************************************************************************
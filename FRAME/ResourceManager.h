@@ -32,6 +32,9 @@ class IGameObject;
 class IGUI;
 class CMainGUI;
 class CGLFWWindow;
+class CJobSystem;
+class CGeometryArena;
+class CTextureStreamer;
 
 class CResourceManager : public CSingleton<CResourceManager>
 {
@@ -40,11 +43,14 @@ public:
 	~CResourceManager();
 
 	GLvoid  init();
+	GLvoid  updatePendingModels();
 	GLint														getOrCreateScreenQuadVAO();
 	GLint														getOrCreateCubeVAO();
 	GLint														getOrCretaeSphereVAO();
 	const std::shared_ptr<CModel>&								getOrCreateModel(const std::string &vModelPath);
+	const std::shared_ptr<CModel>&								getOrCreateModelAsync(const std::string &vModelPath);		//CModel::isLoaded tells when it is complete
 	const std::shared_ptr<CMainGUI>&							getOrCreateMainGUI();
+	const std::shared_ptr<CJobSystem>&							getOrCreateJobSystem();
 	const std::shared_ptr<IRenderPass>&							getRenderPassByName(const std::string &vPassName);			//Time consuming much
 	const std::shared_ptr<IGameObject>&							getGameObjectByName(const std::string &vGameObjectName);	//Time consuming much
 	const std::shared_ptr<IGUI>&								getSubGUIByName(const std::string &vSubGUIByName);			//Time consuming much
@@ -53,11 +59,14 @@ public:
 	const ElayGraphics::MVector<std::shared_ptr<IGUI>>&			getSubGUISet() const { return m_SubGUISet; }
 	const boost::any&											getSharedDataByName(const std::string &vDataName);
 	boost::any&													fetchSharedDataByName(const std::string& vDataName);
+	boost::any*													internSharedData(const std::string& vDataName);
 
 	std::shared_ptr<CCamera>              fecthOrCreateMainCamera();
 	std::shared_ptr<CUBO4ProjectionWorld> fetchOrCreateUBO4ProjectionWorld();
 	std::shared_ptr<CGLFWWindow>		  fetchOrCreateGLFWWindow();
 	std::shared_ptr<CTools>				  fetchOrCreateTools();
+	std::shared_ptr<CGeometryArena>		  fetchOrCreateGeometryArena();
+	std::shared_ptr<CTextureStreamer>	  fetchOrCreateTextureStreamer();
 
 	void updateSharedDataByName(const std::string& vDataName, const boost::any& vData);
 
@@ -74,6 +83,9 @@ private:
 	std::shared_ptr<CCamera>                m_pMainCamera;
 	std::shared_ptr<CMainGUI>				m_pMainGUI;
 	std::shared_ptr<CTools>				    m_pTools;
+	std::shared_ptr<CJobSystem>				m_pJobSystem;
+	std::shared_ptr<CGeometryArena>			m_pGeometryArena;
+	std::shared_ptr<CTextureStreamer>		m_pTextureStreamer;
 
 	GLint m_ScreenQuadVAO = 0;
 	GLint m_CubeVAO = 0;
@@ -84,5 +96,6 @@ private:
 	ElayGraphics::MVector<std::shared_ptr<IGameObject>> m_GameObjectSet;
 	ElayGraphics::MVector<std::shared_ptr<IGUI>>		m_SubGUISet;
 	std::map<std::string, std::shared_ptr<CModel>> m_ModelMap;
+	std::vector<std::shared_ptr<CModel>> m_PendingModelSet;
 	std::map<std::string, boost::any> m_SharedDataMap;
 };
\ No newline at end of file
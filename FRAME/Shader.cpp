@@ -8,6 +8,84 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include "Utils.h"
+#include "GLStateCache.h"
+
+bool CShader::s_IsUniformLocationCacheEnabled = true;
+CShader::SProgramCacheStats CShader::s_ProgramCacheStats;
+
+namespace
+{
+	const char PROGRAM_BINARY_MAGIC[4] = { 'E', 'P', 'R', 'G' };
+
+	//in front of the driver's binary in a .glbin file
+	struct SProgramBinaryHeader
+	{
+		char	 Magic[4];
+		uint32_t BinaryFormat;
+		uint64_t CacheKey;
+		uint64_t BinarySize;
+	};
+
+	uint64_t hashBytes(const char* vData, size_t vLength, uint64_t vHash = 14695981039346656037ull)
+	{
+		uint64_t Hash = vHash;	//FNV-1a
+		for (size_t i = 0; i < vLength; ++i)
+		{
+			Hash ^= static_cast<unsigned char>(vData[i]);
+			Hash *= 1099511628211ull;
+		}
+		return Hash;
+	}
+
+	double computeElapsedMs(const std::chrono::steady_clock::time_point& vStartTime)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - vStartTime).count();
+	}
+
+	//a binary only loads into the driver build that wrote it
+	uint64_t hashDriver()
+	{
+		uint64_t Hash = 14695981039346656037ull;
+		for (GLenum Name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+		{
+			const char* pString = reinterpret_cast<const char*>(glGetString(Name));
+			if (pString)
+				Hash = hashBytes(pString, std::strlen(pString) + 1, Hash);
+		}
+		return Hash;
+	}
+
+	bool isProgramBinarySupported()
+	{
+		static const bool IsSupported = []()
+		{
+			GLint FormatCount = 0;
+			if (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary)
+				glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &FormatCount);
+			return FormatCount > 0;
+		}();
+		return IsSupported;
+	}
+
+	//the driver compiles and links on its own threads once asked to, so the link status can be polled
+	bool isParallelCompileSupported()
+	{
+		static const bool IsSupported = []()
+		{
+			if (!GLEW_KHR_parallel_shader_compile)
+				return false;
+			glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+			return true;
+		}();
+		return IsSupported;
+	}
+}
 
 CShader::CShader(const std::string& vVertexShaderFileName, const std::string& vFragmentShaderFileName, const std::string& vGeometryShaderFileName,
 	const std::string& vTessellationControlShaderFileName, const std::string& vTessellationEvaluationShaderFileName)
@@ -15,19 +93,23 @@ CShader::CShader(const std::string& vVertexShaderFileName, const std::string& vF
 	__loadShader(vVertexShaderFileName, vFragmentShaderFileName, vGeometryShaderFileName, vTessellationControlShaderFileName, vTessellationEvaluationShaderFileName);
 }
 
+CShader::CShader(const std::string& vVertexShaderFileName, const std::string& vFragmentShaderFileName, const std::vector<std::string>& vDefines) : m_Defines(vDefines)
+{
+	__loadShader(vVertexShaderFileName, vFragmentShaderFileName);
+}
+
 CShader::CShader(const std::string& vComputeShaderFileName)
 {
 	_ASSERT(!vComputeShaderFileName.empty());
 	if (m_ShaderProgram)
 		return;
-	m_ShaderProgram = glCreateProgram();
-	GLint ComputeShader = __loadShader(vComputeShaderFileName, GL_COMPUTE_SHADER);
-	__linkProgram();
-	__deleteShader(ComputeShader);
+	__createProgram({ { vComputeShaderFileName, GL_COMPUTE_SHADER } });
 }
 
 CShader::~CShader()
 {
+	for (GLint Shader : m_PendingShaders)
+		__deleteShader(Shader);
 	if (m_ShaderProgram)
 		glDeleteProgram(m_ShaderProgram);
 }
@@ -40,45 +122,129 @@ GLvoid CShader::__loadShader(const std::string& vVertexShaderFileName, const std
 	_ASSERT(!vVertexShaderFileName.empty() && !vFragmentShaderFileName.empty());
 	if (m_ShaderProgram)
 		return;
-	m_ShaderProgram = glCreateProgram();
 
-	GLint VertexShader   = __loadShader(vVertexShaderFileName, GL_VERTEX_SHADER);
-	GLint FragmentShader = __loadShader(vFragmentShaderFileName, GL_FRAGMENT_SHADER);
-
-	GLint GeometryShader = 0, TessellationControlShader = 0, TessellationEvaluationShader = 0;
+	std::vector<std::pair<std::string, GLenum>> Stages = { { vVertexShaderFileName, GL_VERTEX_SHADER }, { vFragmentShaderFileName, GL_FRAGMENT_SHADER } };
 	if (!vGeometryShaderFileName.empty())
-		GeometryShader = __loadShader(vGeometryShaderFileName, GL_GEOMETRY_SHADER);
+		Stages.emplace_back(vGeometryShaderFileName, GL_GEOMETRY_SHADER);
 	if (!vTessellationControlShaderFileName.empty())
-		TessellationControlShader = __loadShader(vTessellationControlShaderFileName, GL_TESS_CONTROL_SHADER);
+		Stages.emplace_back(vTessellationControlShaderFileName, GL_TESS_CONTROL_SHADER);
 	if (!vTessellationEvaluationShaderFileName.empty())
-		TessellationEvaluationShader = __loadShader(vTessellationEvaluationShaderFileName, GL_TESS_EVALUATION_SHADER);
+		Stages.emplace_back(vTessellationEvaluationShaderFileName, GL_TESS_EVALUATION_SHADER);
+	__createProgram(Stages);
+}
 
-	__linkProgram();
+//************************************************************************************
+//Function: the program comes from its binary cache when the sources, the defines and the driver are the ones it was written
+//with; otherwise the stages are compiled and linked without asking for any status, which __waitLink does on first use
+GLvoid CShader::__createProgram(const std::vector<std::pair<std::string, GLenum>>& vStages)
+{
+	const auto StartTime = std::chrono::steady_clock::now();
+	m_ShaderProgram = glCreateProgram();
+	++s_ProgramCacheStats.ProgramCount;
 
-	__deleteShader(VertexShader);
-	__deleteShader(FragmentShader);
-	__deleteShader(GeometryShader);
-	__deleteShader(TessellationControlShader);
-	__deleteShader(TessellationEvaluationShader);
+	static const uint64_t DriverHash = hashDriver();
+	std::vector<std::string> Sources;
+	uint64_t CacheKey = DriverHash, NameHash = 14695981039346656037ull;
+	for (const auto& Stage : vStages)
+	{
+		std::vector<std::string> IncludedFiles;
+		Sources.push_back(__insertDefines(__expandIncludes(Stage.first, IncludedFiles)));
+		CacheKey = hashBytes(reinterpret_cast<const char*>(&Stage.second), sizeof(Stage.second), CacheKey);
+		CacheKey = hashBytes(Sources.back().data(), Sources.back().size() + 1, CacheKey);
+		NameHash = hashBytes(Stage.first.data(), Stage.first.size() + 1, NameHash);
+	}
+	for (const std::string& Define : m_Defines)
+		NameHash = hashBytes(Define.data(), Define.size() + 1, NameHash);
+	//two programs sharing the first stage, or two permutations of one program, get a file each
+	char NameHashText[9] = {};
+	snprintf(NameHashText, sizeof(NameHashText), "%08x", static_cast<uint32_t>(NameHash ^ (NameHash >> 32)));
+	m_ProgramCachePath = vStages.front().first + "." + NameHashText + ".glbin";
+	m_ProgramCacheKey = CacheKey;
+
+	if (__loadProgramBinary())
+	{
+		__reflectUniforms();
+		++s_ProgramCacheStats.CacheHitCount;
+		s_ProgramCacheStats.CacheLoadMs += computeElapsedMs(StartTime);
+		return;
+	}
+
+	isParallelCompileSupported();
+	for (size_t i = 0; i < vStages.size(); ++i)
+		m_PendingShaders.push_back(__compileShader(Sources[i], vStages[i].second));
+	__linkProgram();
+	++s_ProgramCacheStats.CompiledCount;
+	s_ProgramCacheStats.SubmitMs += computeElapsedMs(StartTime);
 }
 
 //************************************************************************************
-//Function:
-GLint CShader::__loadShader(const std::string& vShaderFileName, GLint vShaderType) const
+//Function: glCompileShader only queues the work, nothing here waits for it
+GLint CShader::__compileShader(const std::string& vShaderSource, GLenum vShaderType) const
 {
-	_ASSERT(!vShaderFileName.empty() && vShaderType);
+	_ASSERT(vShaderType && m_ShaderProgram);
 	GLint Shader = glCreateShader(vShaderType);
 	_ASSERT(Shader);
-	const std::string ShaderSource = __loadShaderSourceFromFile(vShaderFileName);
-	const GLchar *pShaderSource = ShaderSource.c_str();
-	_ASSERT(pShaderSource);
+	const GLchar *pShaderSource = vShaderSource.c_str();
 	glShaderSource(Shader, 1, &pShaderSource, nullptr);
-	_ASSERT(__compileShader(Shader));
-	_ASSERT(m_ShaderProgram);
+	glCompileShader(Shader);
 	glAttachShader(m_ShaderProgram, Shader);
 	return Shader;
 }
 
+//************************************************************************************
+//Function: #include "file" is replaced by the file, found next to the one including it, unless this stage has it already.
+//#line directives keep the compiler's line numbers right; the source string number is the file's place in vioIncludedFiles
+std::string CShader::__expandIncludes(const std::string& vShaderFileName, std::vector<std::string>& vioIncludedFiles) const
+{
+	const int FileIndex = static_cast<int>(vioIncludedFiles.size());
+	vioIncludedFiles.push_back(vShaderFileName);
+	const size_t SlashPosition = vShaderFileName.find_last_of("/\\");
+	const std::string Directory = SlashPosition == std::string::npos ? std::string() : vShaderFileName.substr(0, SlashPosition + 1);
+
+	std::istringstream Lines(__loadShaderSourceFromFile(vShaderFileName));
+	std::string Line, Source = FileIndex == 0 ? std::string() : "#line 1 " + std::to_string(FileIndex) + "\n";
+	for (int LineNumber = 1; std::getline(Lines, Line); ++LineNumber)
+	{
+		const size_t DirectiveBegin = Line.find_first_not_of(" \t");
+		if (DirectiveBegin == std::string::npos || Line.compare(DirectiveBegin, 8, "#include") != 0)
+		{
+			Source += Line + "\n";
+			continue;
+		}
+		const size_t NameBegin = Line.find('"', DirectiveBegin);
+		const size_t NameEnd = NameBegin == std::string::npos ? std::string::npos : Line.find('"', NameBegin + 1);
+		if (NameEnd == std::string::npos)
+		{
+			std::cerr << "Error::Shader:: " << vShaderFileName << "(" << LineNumber << "): #include expects a \"file\"" << std::endl;
+			Source += "\n";
+			continue;
+		}
+		const std::string IncludedFileName = Directory + Line.substr(NameBegin + 1, NameEnd - NameBegin - 1);
+		if (std::find(vioIncludedFiles.begin(), vioIncludedFiles.end(), IncludedFileName) == vioIncludedFiles.end())
+			Source += __expandIncludes(IncludedFileName, vioIncludedFiles);
+		Source += "#line " + std::to_string(LineNumber + 1) + " " + std::to_string(FileIndex) + "\n";
+	}
+	return Source;
+}
+
+//************************************************************************************
+//Function: right after #version, which has to stay the first directive
+std::string CShader::__insertDefines(const std::string& vSource) const
+{
+	if (m_Defines.empty())
+		return vSource;
+	const size_t VersionPosition = vSource.find("#version");
+	const size_t InsertPosition = VersionPosition == std::string::npos ? 0 : vSource.find('\n', VersionPosition) + 1;
+	if (InsertPosition == 0 && VersionPosition != std::string::npos)
+		return vSource;
+	std::string Defines;
+	for (const std::string& Define : m_Defines)
+		Defines += "#define " + Define + "\n";
+	const auto NextLineNumber = std::count(vSource.begin(), vSource.begin() + InsertPosition, '\n') + 1;
+	Defines += "#line " + std::to_string(NextLineNumber) + " 0\n";
+	return vSource.substr(0, InsertPosition) + Defines + vSource.substr(InsertPosition);
+}
+
 //************************************************************************************
 //Function:
 std::string CShader::__loadShaderSourceFromFile(const std::string& vShaderFileName) const
@@ -100,40 +266,138 @@ std::string CShader::__loadShaderSourceFromFile(const std::string& vShaderFileNa
 
 //************************************************************************************
 //Function:
-GLboolean CShader::__compileShader(GLint vShader) const
+GLvoid CShader::__linkProgram()
 {
-	_ASSERT(vShader);
-	GLint Success = 0;
-	const GLint MaxInfoLogLength = 512;
-	GLchar InfoLog[MaxInfoLogLength] = {};
-	glCompileShader(vShader);
-	glGetShaderiv(vShader, GL_COMPILE_STATUS, &Success);
-	if (!Success)
-	{
-		glGetShaderInfoLog(vShader, MaxInfoLogLength, nullptr, InfoLog);
-		std::cerr << "Error::Shader:: Shader Compile Failure: " << InfoLog << std::endl;
-		return GL_FALSE;
-	}
-	return GL_TRUE;
+	_ASSERT(m_ShaderProgram);
+	if (isProgramBinarySupported())
+		glProgramParameteri(m_ShaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(m_ShaderProgram);
+	m_IsLinkPending = true;
 }
 
 //************************************************************************************
-//Function:
-GLboolean CShader::__linkProgram() const
+//Function: true once using the program won't stall; without GL_KHR_parallel_shader_compile the driver can't be asked,
+//and it is always true
+GLboolean CShader::isReady() const
 {
-	_ASSERT(m_ShaderProgram);
+	if (!m_IsLinkPending || !isParallelCompileSupported())
+		return GL_TRUE;
+	GLint IsCompleted = GL_FALSE;
+	glGetProgramiv(m_ShaderProgram, GL_COMPLETION_STATUS_KHR, &IsCompleted);
+	return IsCompleted ? GL_TRUE : GL_FALSE;
+}
+
+//************************************************************************************
+//Function: the first status query blocks until the driver is done; the uniforms are reflected and the binary cached then
+GLvoid CShader::__waitLink() const
+{
+	if (!m_IsLinkPending)
+		return;
+	const auto StartTime = std::chrono::steady_clock::now();
+	m_IsLinkPending = false;
 	GLint Success = 0;
 	const GLint MaxInfoLogLength = 512;
 	GLchar InfoLog[MaxInfoLogLength] = {};
-	glLinkProgram(m_ShaderProgram);
 	glGetProgramiv(m_ShaderProgram, GL_LINK_STATUS, &Success);
-	if (!Success)
+	if (Success)
 	{
+		__reflectUniforms();
+		__saveProgramBinary();
+	}
+	else
+	{
+		for (GLint Shader : m_PendingShaders)
+		{
+			glGetShaderiv(Shader, GL_COMPILE_STATUS, &Success);
+			if (Success)
+				continue;
+			glGetShaderInfoLog(Shader, MaxInfoLogLength, nullptr, InfoLog);
+			std::cerr << "Error::Shader:: Shader Compile Failure: " << InfoLog << std::endl;
+		}
 		glGetProgramInfoLog(m_ShaderProgram, MaxInfoLogLength, nullptr, InfoLog);
 		std::cerr << "Error::Shader:: Shader Program Link Failure: " << InfoLog << std::endl;
+		++s_ProgramCacheStats.LinkFailureCount;
+	}
+	for (GLint Shader : m_PendingShaders)
+		__deleteShader(Shader);
+	m_PendingShaders.clear();
+	s_ProgramCacheStats.WaitMs += computeElapsedMs(StartTime);
+}
+
+//************************************************************************************
+//Function: false for a missing or stale file, or a binary the driver refuses, the program is compiled then
+GLboolean CShader::__loadProgramBinary()
+{
+	if (!isProgramBinarySupported())
 		return GL_FALSE;
+	std::ifstream File(m_ProgramCachePath, std::ios::binary);
+	SProgramBinaryHeader Header = {};
+	if (!File.read(reinterpret_cast<char*>(&Header), sizeof(Header)) || std::memcmp(Header.Magic, PROGRAM_BINARY_MAGIC, sizeof(Header.Magic)) != 0 || Header.CacheKey != m_ProgramCacheKey)
+		return GL_FALSE;
+	//a truncated or corrupt file must not decide how much is allocated
+	const std::streamoff BinaryStart = File.tellg();
+	File.seekg(0, std::ios::end);
+	const std::streamoff FileSize = File.tellg();
+	if (BinaryStart < 0 || FileSize < BinaryStart || Header.BinarySize == 0 || Header.BinarySize > static_cast<uint64_t>(FileSize - BinaryStart)
+		|| Header.BinarySize > static_cast<uint64_t>(std::numeric_limits<GLsizei>::max()))
+		return GL_FALSE;
+	File.seekg(BinaryStart);
+	std::vector<char> Binary(static_cast<size_t>(Header.BinarySize));
+	if (!File.read(Binary.data(), Binary.size()))
+		return GL_FALSE;
+
+	glProgramBinary(m_ShaderProgram, Header.BinaryFormat, Binary.data(), static_cast<GLsizei>(Binary.size()));
+	GLint Success = 0;
+	glGetProgramiv(m_ShaderProgram, GL_LINK_STATUS, &Success);
+	return Success ? GL_TRUE : GL_FALSE;
+}
+
+//************************************************************************************
+//Function:
+GLvoid CShader::__saveProgramBinary() const
+{
+	if (!isProgramBinarySupported())
+		return;
+	GLint BinarySize = 0;
+	glGetProgramiv(m_ShaderProgram, GL_PROGRAM_BINARY_LENGTH, &BinarySize);
+	if (BinarySize <= 0)
+		return;
+	std::vector<char> Binary(BinarySize);
+	SProgramBinaryHeader Header = {};
+	std::memcpy(Header.Magic, PROGRAM_BINARY_MAGIC, sizeof(Header.Magic));
+	GLenum BinaryFormat = 0;
+	glGetProgramBinary(m_ShaderProgram, BinarySize, nullptr, &BinaryFormat, Binary.data());
+	Header.BinaryFormat = BinaryFormat;
+	Header.CacheKey = m_ProgramCacheKey;
+	Header.BinarySize = Binary.size();
+
+	//written next to the cache and renamed, a crash never leaves a truncated binary behind
+	const std::string TemporaryPath = m_ProgramCachePath + ".tmp";
+	{
+		std::ofstream File(TemporaryPath, std::ios::binary | std::ios::trunc);
+		File.write(reinterpret_cast<const char*>(&Header), sizeof(Header));
+		File.write(Binary.data(), Binary.size());
+		if (!File)
+		{
+			std::cerr << "Error::Shader:: can't write the program binary " << TemporaryPath << std::endl;
+			File.close();
+			std::remove(TemporaryPath.c_str());
+			return;
+		}
+	}
+	std::remove(m_ProgramCachePath.c_str());
+	if (std::rename(TemporaryPath.c_str(), m_ProgramCachePath.c_str()) != 0)
+	{
+		std::cerr << "Error::Shader:: can't rename " << TemporaryPath << " to " << m_ProgramCachePath << std::endl;
+		std::remove(TemporaryPath.c_str());
 	}
-	return GL_TRUE;
+}
+
+//************************************************************************************
+//Function:
+const CShader::SProgramCacheStats& CShader::getProgramCacheStats()
+{
+	return s_ProgramCacheStats;
 }
 
 //************************************************************************************
@@ -148,9 +412,123 @@ GLvoid CShader::__deleteShader(GLint vShader) const
 //Function:
 GLint CShader::getUniformId(const std::string& vUniformName) const
 {
-	return glGetUniformLocation(m_ShaderProgram, vUniformName.c_str());
+	return __findUniformLocation(vUniformName);
+}
+
+//************************************************************************************
+//Function: -1 when the block is not active in this program
+GLint CShader::getUniformBlockSize(const std::string& vBlockName) const
+{
+	__waitLink();
+	return __findUniformSlot(m_UniformBlockSizeTable, vBlockName, -1);
+}
+
+//************************************************************************************
+//Function: offset of a block member as the linker laid it out, -1 when it is not active
+GLint CShader::getUniformBlockMemberOffset(const std::string& vMemberName) const
+{
+	__waitLink();
+	return __findUniformSlot(m_UniformBlockOffsetTable, vMemberName, -1);
+}
+
+//************************************************************************************
+//Function:
+GLvoid CShader::setUniformLocationCache(bool vIsEnabled)
+{
+	s_IsUniformLocationCacheEnabled = vIsEnabled;
+}
+
+//************************************************************************************
+//Function:
+GLint CShader::__findUniformLocation(const std::string& vUniformName) const
+{
+	__waitLink();
+	if (!s_IsUniformLocationCacheEnabled)
+	{
+		++fetchDriverCallCounters().UniformLocationQueries;
+		return glGetUniformLocation(m_ShaderProgram, vUniformName.c_str());
+	}
+	return __findUniformSlot(m_UniformLocationTable, vUniformName, -1);
+}
+
+//************************************************************************************
+//Function:
+GLint CShader::__findUniformSlot(const std::vector<SUniformSlot>& vTable, const std::string& vName, GLint vDefaultValue)
+{
+	const SUniformSlot Key = { hashBytes(vName.data(), vName.size()), 0 };
+	auto Iter = std::lower_bound(vTable.begin(), vTable.end(), Key);
+	return (Iter != vTable.end() && Iter->NameHash == Key.NameHash) ? Iter->Value : vDefaultValue;
 }
 
+//************************************************************************************
+//Function: queries every active uniform and uniform block once. Array elements get their own
+//entries ("a", "a[0]" ... "a[n-1]"), so any name glGetUniformLocation accepts is in the table
+GLvoid CShader::__reflectUniforms() const
+{
+	m_UniformLocationTable.clear();
+	m_UniformBlockSizeTable.clear();
+	m_UniformBlockOffsetTable.clear();
+
+	auto addSlot = [](std::vector<SUniformSlot>& vioTable, const std::string& vName, GLint vValue)
+	{
+		vioTable.push_back({ hashBytes(vName.data(), vName.size()), vValue });
+	};
+
+	GLint MaxNameLength = 0, UniformCount = 0;
+	glGetProgramInterfaceiv(m_ShaderProgram, GL_UNIFORM, GL_MAX_NAME_LENGTH, &MaxNameLength);
+	glGetProgramInterfaceiv(m_ShaderProgram, GL_UNIFORM, GL_ACTIVE_RESOURCES, &UniformCount);
+	std::vector<GLchar> NameBuffer(std::max(MaxNameLength, 1));
+	const GLenum UniformProperties[] = { GL_BLOCK_INDEX, GL_LOCATION, GL_ARRAY_SIZE, GL_OFFSET, GL_ARRAY_STRIDE };
+	for (GLint i = 0; i < UniformCount; ++i)
+	{
+		GLint Values[5] = {};
+		glGetProgramResourceiv(m_ShaderProgram, GL_UNIFORM, i, 5, UniformProperties, 5, nullptr, Values);
+		glGetProgramResourceName(m_ShaderProgram, GL_UNIFORM, i, static_cast<GLsizei>(NameBuffer.size()), nullptr, NameBuffer.data());
+		const std::string Name(NameBuffer.data());
+		const bool IsInBlock = Values[0] != -1;
+		const GLint ArraySize = Values[2];
+
+		//the linker reports arrays of basic types as "name[0]"
+		const bool IsArray = Name.size() > 3 && Name.compare(Name.size() - 3, 3, "[0]") == 0;
+		const std::string BaseName = IsArray ? Name.substr(0, Name.size() - 3) : Name;
+		if (IsInBlock)
+		{
+			addSlot(m_UniformBlockOffsetTable, BaseName, Values[3]);
+			for (GLint k = 0; IsArray && k < ArraySize; ++k)
+				addSlot(m_UniformBlockOffsetTable, BaseName + "[" + std::to_string(k) + "]", Values[3] + k * Values[4]);
+			continue;
+		}
+
+		addSlot(m_UniformLocationTable, BaseName, Values[1]);
+		for (GLint k = 0; IsArray && k < ArraySize; ++k)
+		{
+			const std::string ElementName = BaseName + "[" + std::to_string(k) + "]";
+			addSlot(m_UniformLocationTable, ElementName, k == 0 ? Values[1] : glGetUniformLocation(m_ShaderProgram, ElementName.c_str()));
+		}
+	}
+
+	GLint BlockCount = 0;
+	glGetProgramInterfaceiv(m_ShaderProgram, GL_UNIFORM_BLOCK, GL_MAX_NAME_LENGTH, &MaxNameLength);
+	glGetProgramInterfaceiv(m_ShaderProgram, GL_UNIFORM_BLOCK, GL_ACTIVE_RESOURCES, &BlockCount);
+	NameBuffer.resize(std::max(MaxNameLength, 1));
+	const GLenum BlockProperty = GL_BUFFER_DATA_SIZE;
+	for (GLint i = 0; i < BlockCount; ++i)
+	{
+		GLint DataSize = 0;
+		glGetProgramResourceiv(m_ShaderProgram, GL_UNIFORM_BLOCK, i, 1, &BlockProperty, 1, nullptr, &DataSize);
+		glGetProgramResourceName(m_ShaderProgram, GL_UNIFORM_BLOCK, i, static_cast<GLsizei>(NameBuffer.size()), nullptr, NameBuffer.data());
+		addSlot(m_UniformBlockSizeTable, NameBuffer.data(), DataSize);
+	}
+
+	for (auto* pTable : { &m_UniformLocationTable, &m_UniformBlockSizeTable, &m_UniformBlockOffsetTable })
+	{
+		std::sort(pTable->begin(), pTable->end());
+		auto Duplicate = std::adjacent_find(pTable->begin(), pTable->end(), [](const SUniformSlot& vLhs, const SUniformSlot& vRhs) { return vLhs.NameHash == vRhs.NameHash; });
+		_WARNING(Duplicate != pTable->end(), "WARNING: two uniform names of one program share a hash, only one of them can be found.");
+	}
+}
+
+
 //************************************************************************************
 //Function:
 GLint CShader::getCommonUniformId(const std::string& vUniformName) const
@@ -168,34 +546,39 @@ GLint CShader::getCommonUniformId(const std::string& vUniformName) const
 //Function:
 GLvoid CShader::setIntUniformValue(const std::string& vUniformName, GLint v0) const 
 {
-	glUniform1i(glGetUniformLocation(m_ShaderProgram, vUniformName.c_str()), v0);
+	++fetchDriverCallCounters().UniformUploads;
+	glUniform1i(__findUniformLocation(vUniformName), v0);
 }
 
 //************************************************************************************
 //Function:
 GLvoid CShader::setIntUniformValue(const std::string& vUniformName, GLint v0, GLint v1) const
 {
-	glUniform2i(glGetUniformLocation(m_ShaderProgram, vUniformName.c_str()), v0, v1);
+	++fetchDriverCallCounters().UniformUploads;
+	glUniform2i(__findUniformLocation(vUniformName), v0, v1);
 }
 
 //************************************************************************************
 //Function:
 GLvoid CShader::setIntUniformValue(const std::string& vUniformName, GLint v0, GLint v1, GLint v2) const
 {
-	glUniform3i(glGetUniformLocation(m_ShaderProgram, vUniformName.c_str()), v0, v1, v2);
+	++fetchDriverCallCounters().UniformUploads;
+	glUniform3i(__findUniformLocation(vUniformName), v0, v1, v2);
 }
 
 //************************************************************************************
 //Function:
 GLvoid CShader::setIntUniformValue(const std::string& vUniformName, GLint v0, GLint v1, GLint v2, GLint v3) const
 {
-	glUniform4i(glGetUniformLocation(m_ShaderProgram, vUniformName.c_str()), v0, v1, v2, v3);
+	++fetchDriverCallCounters().UniformUploads;
+	glUniform4i(__findUniformLocation(vUniformName), v0, v1, v2, v3);
 }
 
 //************************************************************************************
 //Function:
 GLvoid CShader::setIntUniformValue(int vUniformId, GLint v0) const
 {
+	++fetchDriverCallCounters().UniformUploads;
 	glUniform1i(vUniformId, v0);
 }
 
@@ -203,6 +586,7 @@ GLvoid CShader::setIntUniformValue(int vUniformId, GLint v0) const
 //Function:
 GLvoid CShader::setIntUniformValue(int vUniformId, GLint v0, GLint v1) const
 {
+	++fetchDriverCallCounters().UniformUploads;
 	glUniform2i(vUniformId, v0, v1);
 }
 
@@ -210,6 +594,7 @@ GLvoid CShader::setIntUniformValue(int vUniformId, GLint v0, GLint v1) const
 //Function:
 GLvoid CShader::setIntUniformValue(int vUniformId, GLint v0, GLint v1, GLint v2) const
 {
+	++fetchDriverCallCounters().UniformUploads;
 	glUniform3i(vUniformId, v0, v1, v2);
 }
 
@@ -217,6 +602,7 @@ GLvoid CShader::setIntUniformValue(int vUniformId, GLint v0, GLint v1, GLint v2)
 //Function:
 GLvoid CShader::setIntUniformValue(int vUniformId, GLint v0, GLint v1, GLint v2, GLint v3) const
 {
+	++fetchDriverCallCounters().UniformUploads;
 	glUniform4i(vUniformId, v0, v1, v2, v3);
 }
 
@@ -224,35 +610,39 @@ GLvoid CShader::setIntUniformValue(int vUniformId, GLint v0, GLint v1, GLint v2,
 //Function:
 GLvoid CShader::setFloatUniformValue(const std::string& vUniformName, GLfloat v0) const
 {
-	glUniform1f(glGetUniformLocation(m_ShaderProgram, vUniformName.c_str()), v0);
+	++fetchDriverCallCounters().UniformUploads;
+	glUniform1f(__findUniformLocation(vUniformName), v0);
 }
 
 //************************************************************************************
 //Function:
 GLvoid CShader::setFloatUniformValue(const std::string& vUniformName, GLfloat v0, GLfloat v1) const
 {
-	glUniform2f(glGetUniformLocation(m_ShaderProgram, vUniformName.c_str()), v0, v1);
+	++fetchDriverCallCounters().UniformUploads;
+	glUniform2f(__findUniformLocation(vUniformName), v0, v1);
 }
 
 //************************************************************************************
 //Function:
 GLvoid CShader::setFloatUniformValue(const std::string& vUniformName, GLfloat v0, GLfloat v1, GLfloat v2) const
 {
-	int l = glGetUniformLocation(m_ShaderProgram, vUniformName.c_str());
-	glUniform3f(glGetUniformLocation(m_ShaderProgram, vUniformName.c_str()), v0, v1, v2);
+	++fetchDriverCallCounters().UniformUploads;
+	glUniform3f(__findUniformLocation(vUniformName), v0, v1, v2);
 }
 
 //************************************************************************************
 //Function:
 GLvoid CShader::setFloatUniformValue(const std::string& vUniformName, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3) const
 {
-	glUniform4f(glGetUniformLocation(m_ShaderProgram, vUniformName.c_str()), v0, v1, v2, v3);
+	++fetchDriverCallCounters().UniformUploads;
+	glUniform4f(__findUniformLocation(vUniformName), v0, v1, v2, v3);
 }
 
 //************************************************************************************
 //Function:
 GLvoid CShader::setFloatUniformValue(int vUniformId, GLfloat v0) const
 {
+	++fetchDriverCallCounters().UniformUploads;
 	glUniform1f(vUniformId, v0);
 }
 
@@ -260,6 +650,7 @@ GLvoid CShader::setFloatUniformValue(int vUniformId, GLfloat v0) const
 //Function:
 GLvoid CShader::setFloatUniformValue(int vUniformId, GLfloat v0, GLfloat v1) const
 {
+	++fetchDriverCallCounters().UniformUploads;
 	glUniform2f(vUniformId, v0, v1);
 }
 
@@ -267,6 +658,7 @@ GLvoid CShader::setFloatUniformValue(int vUniformId, GLfloat v0, GLfloat v1) con
 //Function:
 GLvoid CShader::setFloatUniformValue(int vUniformId, GLfloat v0, GLfloat v1, GLfloat v2) const
 {
+	++fetchDriverCallCounters().UniformUploads;
 	glUniform3f(vUniformId, v0, v1, v2);
 }
 
@@ -274,47 +666,53 @@ GLvoid CShader::setFloatUniformValue(int vUniformId, GLfloat v0, GLfloat v1, GLf
 //Function:
 GLvoid CShader::setFloatUniformValue(int vUniformId, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3) const
 {
+	++fetchDriverCallCounters().UniformUploads;
 	glUniform4f(vUniformId, v0, v1, v2, v3);
 }
 
 GLvoid CShader::setFloatArrayUniformValue(const std::string& vUniformName, GLuint count, GLfloat* value) const
 {
-	int sucess = glGetUniformLocation(m_ShaderProgram, vUniformName.c_str());
-	glUniform1fv(glGetUniformLocation(m_ShaderProgram, vUniformName.c_str()), count, value);
+	++fetchDriverCallCounters().UniformUploads;
+	glUniform1fv(__findUniformLocation(vUniformName), count, value);
 }
 
 //************************************************************************************
 //Function:
 GLvoid CShader::setDoubleUniformValue(const std::string& vUniformName, GLdouble v0) const
 {
-	glUniform1d(glGetUniformLocation(m_ShaderProgram, vUniformName.c_str()), v0);
+	++fetchDriverCallCounters().UniformUploads;
+	glUniform1d(__findUniformLocation(vUniformName), v0);
 }
 
 //************************************************************************************
 //Function:
 GLvoid CShader::setDoubleUniformValue(const std::string& vUniformName, GLdouble v0, GLdouble v1) const
 {
-	glUniform2d(glGetUniformLocation(m_ShaderProgram, vUniformName.c_str()), v0, v1);
+	++fetchDriverCallCounters().UniformUploads;
+	glUniform2d(__findUniformLocation(vUniformName), v0, v1);
 }
 
 //************************************************************************************
 //Function:
 GLvoid CShader::setDoubleUniformValue(const std::string& vUniformName, GLdouble v0, GLdouble v1, GLdouble v2) const
 {
-	glUniform3d(glGetUniformLocation(m_ShaderProgram, vUniformName.c_str()), v0, v1, v2);
+	++fetchDriverCallCounters().UniformUploads;
+	glUniform3d(__findUniformLocation(vUniformName), v0, v1, v2);
 }
 
 //************************************************************************************
 //Function:
 GLvoid CShader::setDoubleUniformValue(const std::string& vUniformName, GLdouble v0, GLdouble v1, GLdouble v2, GLdouble v3) const
 {
-	glUniform4d(glGetUniformLocation(m_ShaderProgram, vUniformName.c_str()), v0, v1, v2, v3);
+	++fetchDriverCallCounters().UniformUploads;
+	glUniform4d(__findUniformLocation(vUniformName), v0, v1, v2, v3);
 }
 
 //************************************************************************************
 //Function:
 GLvoid CShader::setDoubleUniformValue(int vUniformId, GLdouble v0) const
 {
+	++fetchDriverCallCounters().UniformUploads;
 	glUniform1d(vUniformId, v0);
 }
 
@@ -322,6 +720,7 @@ GLvoid CShader::setDoubleUniformValue(int vUniformId, GLdouble v0) const
 //Function:
 GLvoid CShader::setDoubleUniformValue(int vUniformId, GLdouble v0, GLdouble v1) const
 {
+	++fetchDriverCallCounters().UniformUploads;
 	glUniform2d(vUniformId, v0, v1);
 }
 
@@ -329,6 +728,7 @@ GLvoid CShader::setDoubleUniformValue(int vUniformId, GLdouble v0, GLdouble v1)
 //Function:
 GLvoid CShader::setDoubleUniformValue(int vUniformId, GLdouble v0, GLdouble v1, GLdouble v2) const
 {
+	++fetchDriverCallCounters().UniformUploads;
 	glUniform3d(vUniformId, v0, v1, v2);
 }
 
@@ -336,6 +736,7 @@ GLvoid CShader::setDoubleUniformValue(int vUniformId, GLdouble v0, GLdouble v1,
 //Function:
 GLvoid CShader::setDoubleUniformValue(int vUniformId, GLdouble v0, GLdouble v1, GLdouble v2, GLdouble v3) const
 {
+	++fetchDriverCallCounters().UniformUploads;
 	glUniform4d(vUniformId, v0, v1, v2, v3);
 }
 
@@ -343,13 +744,15 @@ GLvoid CShader::setDoubleUniformValue(int vUniformId, GLdouble v0, GLdouble v1,
 //Function:
 GLvoid CShader::setMat4UniformValue(const std::string& vUniformName, const GLfloat vMatrix[16]) const
 {
-	glUniformMatrix4fv(glGetUniformLocation(m_ShaderProgram, vUniformName.c_str()), 1, GL_FALSE, vMatrix);
+	++fetchDriverCallCounters().UniformUploads;
+	glUniformMatrix4fv(__findUniformLocation(vUniformName), 1, GL_FALSE, vMatrix);
 }
 
 //************************************************************************************
 //Function:
 GLvoid CShader::setMat4UniformValue(int vUniformId, const GLfloat vMatrix[16]) const
 {
+	++fetchDriverCallCounters().UniformUploads;
 	glUniformMatrix4fv(vUniformId, 1, GL_FALSE, vMatrix);
 }
 
@@ -362,17 +765,17 @@ GLvoid CShader::setTextureUniformValue(const std::string& vTextureUniformName, c
 		//_WARNING(m_TextureNameAndTextureIDAndBindingIndexAndTextureTypeSet.find(vTextureUniformName) == m_TextureNameAndTextureIDAndBindingIndexAndTextureTypeSet.end(), "Texture Uniform not be binded.");
 		auto &Item = m_TextureUniformNameAndBindUnitAndTC[vTextureUniformName];
 		std::get<1>(Item) = vioTextureConfig;
-		glActiveTexture(GL_TEXTURE0 + std::get<0>(Item));
-		glBindTexture(static_cast<int>(vioTextureConfig->TextureType), vioTextureConfig->TextureID);
+		fetchGLStateCache().bindTexture(std::get<0>(Item), static_cast<GLenum>(vioTextureConfig->TextureType), vioTextureConfig->TextureID);
 	}
 	else
 	{
 		int BindingIndex = ++m_LastBindingIndex;
-		glActiveTexture(GL_TEXTURE0 + BindingIndex);
-		glUniform1i(glGetUniformLocation(m_ShaderProgram, vTextureUniformName.c_str()), BindingIndex);
-		glBindTexture(static_cast<int>(vioTextureConfig->TextureType), vioTextureConfig->TextureID);
+		glUniform1i(__findUniformLocation(vTextureUniformName), BindingIndex);
+		++fetchDriverCallCounters().UniformUploads;
+		fetchGLStateCache().bindTexture(BindingIndex, static_cast<GLenum>(vioTextureConfig->TextureType), vioTextureConfig->TextureID);
 		m_TextureUniformNameAndBindUnitAndTC[vTextureUniformName] = std::make_tuple(BindingIndex, vioTextureConfig);
 	}
+	fetchGLStateCache().parkTextureUnit();
 }
 
 //************************************************************************************
@@ -383,12 +786,12 @@ GLvoid CShader::setImageUniformValue(const std::shared_ptr<ElayGraphics::STextur
 	{
 		if (m_BindingImageTextureSet.find(vTextureConfig) == m_BindingImageTextureSet.end())
 		{
-			glBindImageTexture(vTextureConfig->ImageBindUnit, vTextureConfig->TextureID, 0, GL_FALSE, 0, GL_READ_WRITE, vTextureConfig->InternalFormat);
+			fetchGLStateCache().bindImageTexture(vTextureConfig->ImageBindUnit, vTextureConfig->TextureID, 0, vTextureConfig->isLayeredImage(), 0, GL_READ_WRITE, vTextureConfig->InternalFormat);
 			m_BindingImageTextureSet.insert(vTextureConfig);
 		}
 		else
 		{
-			glBindImageTexture(vTextureConfig->ImageBindUnit, vTextureConfig->TextureID, 0, GL_FALSE, 0, GL_READ_WRITE, vTextureConfig->InternalFormat);
+			fetchGLStateCache().bindImageTexture(vTextureConfig->ImageBindUnit, vTextureConfig->TextureID, 0, vTextureConfig->isLayeredImage(), 0, GL_READ_WRITE, vTextureConfig->InternalFormat);
 		}
 	}
 }
@@ -421,7 +824,8 @@ GLvoid CShader::setCommonUniformAndId(const std::string& vUniformName, int vValu
 //Function:
 GLvoid CShader::activeShader() const
 {
-	glUseProgram(m_ShaderProgram);
+	__waitLink();
+	fetchGLStateCache().useProgram(m_ShaderProgram);
 	__activeAllTextureUniform();
 }
 
@@ -429,6 +833,7 @@ GLvoid CShader::activeShader() const
 //Function:
 GLint CShader::getShaderProgram() const
 {
+	__waitLink();
 	return m_ShaderProgram;
 }
 
@@ -442,16 +847,17 @@ GLvoid CShader::__activeAllTextureUniform() const
 		glActiveTexture(GL_TEXTURE0 + std::get<1>(Item));
 		glBindTexture(std::get<2>(Item), std::get<0>(Item));
 	}*/
+	CGLStateCache& StateCache = fetchGLStateCache();
 	for (const auto& Item : m_TextureUniformNameAndBindUnitAndTC)
 	{
-		glActiveTexture(GL_TEXTURE0 + std::get<0>(Item.second));
 		const auto& TextureConfig = std::get<1>(Item.second);
-		glBindTexture(static_cast<int>(TextureConfig->TextureType), TextureConfig->TextureID);
+		StateCache.bindTexture(std::get<0>(Item.second), static_cast<GLenum>(TextureConfig->TextureType), TextureConfig->TextureID);
 	}
+	StateCache.parkTextureUnit();
 
 	for (const auto& Item : m_BindingImageTextureSet)
 	{
-		glBindImageTexture(Item->ImageBindUnit, Item->TextureID, 0, GL_FALSE, 0, GL_READ_WRITE, Item->InternalFormat);
+		StateCache.bindImageTexture(Item->ImageBindUnit, Item->TextureID, 0, Item->isLayeredImage(), 0, GL_READ_WRITE, Item->InternalFormat);
 	}
 }
 
@@ -459,6 +865,7 @@ GLvoid CShader::__activeAllTextureUniform() const
 //Function:
 void CShader::InquireLocalGroupSize(std::vector<GLint>& voLocalGroupSize) const
 {
+	__waitLink();
 	voLocalGroupSize.resize(3);
 	glGetProgramiv(m_ShaderProgram, GL_COMPUTE_WORK_GROUP_SIZE, voLocalGroupSize.data());
 }
\ No newline at end of file
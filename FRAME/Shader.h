@@ -9,20 +9,44 @@
 #include <tuple>
 #include <map>
 #include <set>
+#include <cstdint>
 #include "FRAME_EXPORTS.h"
 #include "Common.h"
 
+//Sources may #include "file" relative to themselves, and a program may be built with a list of #defines, which
+//CShaderPermutationSet uses for feature variants of one program.
+//A program is linked from its binary cache, <first stage file>.<hash of the file names and defines>.glbin, while the
+//sources and the driver match the ones the binary was written with. Otherwise its stages are compiled and linked without
+//waiting, with GL_KHR_parallel_shader_compile on the driver's threads, so the programs a pass creates in a row build
+//at once; the first use of a program waits for its link, then reflects its uniforms and writes the binary cache.
 class FRAME_DLLEXPORTS CShader
 {
 public:
+	struct SProgramCacheStats
+	{
+		unsigned ProgramCount = 0;
+		unsigned CacheHitCount = 0;
+		unsigned CompiledCount = 0;
+		unsigned LinkFailureCount = 0;
+		double	 CacheLoadMs = 0.0;	//reading and loading binaries
+		double	 SubmitMs = 0.0;	//issuing the compiles and links of cache misses
+		double	 WaitMs = 0.0;		//blocked on links at first use
+	};
+
 	CShader() = default;
 	CShader(const std::string& vVertexShaderFileName, const std::string& vFragmentShaderFileName, const std::string& vGeometryShaderFileName = "",
 		const std::string& vTessellationControlShaderFileName = "", const std::string& vTessellationEvaluationShaderFileName = "");
+	CShader(const std::string& vVertexShaderFileName, const std::string& vFragmentShaderFileName, const std::vector<std::string>& vDefines);	//"NAME" or "NAME VALUE" each
 	CShader(const std::string& vComputeShaderFileName);
 	~CShader();
 
+	CShader(const CShader&) = delete;	//the destructor deletes the program
+	CShader& operator=(const CShader&) = delete;
+
 	GLint  getUniformId(const std::string& vUniformName) const;
 	GLint  getCommonUniformId(const std::string& vUniformName) const;
+	GLint  getUniformBlockSize(const std::string& vBlockName) const;
+	GLint  getUniformBlockMemberOffset(const std::string& vMemberName) const;
 
 	GLvoid setIntUniformValue(const std::string& vUniformName, GLint v0) const;
 	GLvoid setIntUniformValue(const std::string& vUniformName, GLint v0, GLint v1) const;
@@ -68,8 +92,33 @@ public:
 	void InquireLocalGroupSize(std::vector<GLint>& voLocalGroupSize) const;
 
 	GLint getShaderProgram() const;
+	GLboolean isReady() const;	//polls the link without blocking
+
+	static const SProgramCacheStats& getProgramCacheStats();
+
+	static GLvoid setUniformLocationCache(bool vIsEnabled);	//false: every name lookup goes back to glGetUniformLocation, as before reflection
 
 private:
+	//flat table sorted by name hash, filled once after linking
+	struct SUniformSlot
+	{
+		uint64_t NameHash;
+		GLint	 Value;		//location, block data size or block member offset
+		bool operator<(const SUniformSlot& vOther) const { return NameHash < vOther.NameHash; }
+	};
+	//filled by __waitLink, which the const lookups call
+	mutable std::vector<SUniformSlot> m_UniformLocationTable;
+	mutable std::vector<SUniformSlot> m_UniformBlockSizeTable;
+	mutable std::vector<SUniformSlot> m_UniformBlockOffsetTable;
+	static bool s_IsUniformLocationCacheEnabled;
+	static SProgramCacheStats s_ProgramCacheStats;
+
+	std::vector<std::string> m_Defines;
+	std::string m_ProgramCachePath;
+	uint64_t m_ProgramCacheKey = 0;	//of the driver, the stage types and the sources
+	mutable bool m_IsLinkPending = false;
+	mutable std::vector<GLint> m_PendingShaders;	//attached until the link is done
+
 	GLint m_ShaderProgram = 0;
 	GLint m_LastBindingIndex = 7;
 	std::map<std::string, std::tuple<int, std::shared_ptr<ElayGraphics::STexture>>> m_TextureUniformNameAndBindUnitAndTC;
@@ -77,13 +126,21 @@ private:
 	//std::vector<std::tuple<int, int, int>> m_TextureAndBindingIndexAndTextureTypeSet;
 	std::shared_ptr<std::map<std::string, int>> m_pCommonUniformAndId;	//Ϊģ׼
 
-	GLint		__loadShader(const std::string& vShaderFileName, GLint vShaderType) const;
 	GLvoid		__loadShader(const std::string& vVertexShaderFileName, const std::string& vFragmentShaderFileName, const std::string& vGeometryShaderFileName = "",
 								const std::string& vTessellationControlShaderFileName = "", const std::string& vTessellationEvaluationShaderFileName = "");
+	GLvoid		__createProgram(const std::vector<std::pair<std::string, GLenum>>& vStages);
 	GLvoid		__deleteShader(GLint vShader) const;
-	GLboolean	__compileShader(GLint vShader) const;
-	GLboolean	__linkProgram() const;
+	GLint		__compileShader(const std::string& vShaderSource, GLenum vShaderType) const;
+	GLvoid		__linkProgram();
+	GLvoid		__waitLink() const;
+	GLboolean	__loadProgramBinary();
+	GLvoid		__saveProgramBinary() const;
+	GLvoid		__reflectUniforms() const;
+	GLint		__findUniformLocation(const std::string& vUniformName) const;
+	static GLint __findUniformSlot(const std::vector<SUniformSlot>& vTable, const std::string& vName, GLint vDefaultValue);
 	std::string __loadShaderSourceFromFile(const std::string& vShaderFileName) const;
+	std::string __expandIncludes(const std::string& vShaderFileName, std::vector<std::string>& vioIncludedFiles) const;
+	std::string __insertDefines(const std::string& vSource) const;
 
 	GLvoid		__activeAllTextureUniform() const;
 };
\ No newline at end of file
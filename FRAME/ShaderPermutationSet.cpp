@@ -0,0 +1,53 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) Elay Pu. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "ShaderPermutationSet.h"
+#include "Shader.h"
+#include <crtdbg.h>
+#include <iostream>
+
+CShaderPermutationSet::CShaderPermutationSet(const std::string& vVertexShaderFileName, const std::string& vFragmentShaderFileName, const std::vector<std::string>& vFeatureDefines)
+	: m_VertexShaderFileName(vVertexShaderFileName), m_FragmentShaderFileName(vFragmentShaderFileName), m_FeatureDefines(vFeatureDefines)
+{
+	_ASSERT(!vVertexShaderFileName.empty() && !vFragmentShaderFileName.empty() && vFeatureDefines.size() <= MAX_FEATURE_COUNT);
+}
+
+//************************************************************************************
+//Function: bits beyond the feature count are ignored, so they don't make two variants of the same shader
+const std::shared_ptr<CShader>& CShaderPermutationSet::fetchOrCreateShader(uint32_t vPermutationKey)
+{
+	if (m_FeatureDefines.size() < MAX_FEATURE_COUNT)
+		vPermutationKey &= (1u << m_FeatureDefines.size()) - 1;
+	auto Iter = m_Shaders.find(vPermutationKey);
+	if (Iter != m_Shaders.end())
+		return Iter->second;
+
+	std::vector<std::string> Defines;
+	for (size_t i = 0; i < m_FeatureDefines.size(); ++i)
+	{
+		if (vPermutationKey & (1u << i))
+			Defines.push_back(m_FeatureDefines[i]);
+	}
+	auto& pShader = m_Shaders[vPermutationKey];
+	pShader = std::make_shared<CShader>(m_VertexShaderFileName, m_FragmentShaderFileName, Defines);
+	std::cout << "ShaderPermutationSet:: " << m_FragmentShaderFileName << " variant " << vPermutationKey << " (" << getFeatureNames(vPermutationKey) << "), "
+		<< m_Shaders.size() << " of " << (1ull << m_FeatureDefines.size()) << " variants created" << std::endl;
+	return pShader;
+}
+
+//************************************************************************************
+//Function:
+std::string CShaderPermutationSet::getFeatureNames(uint32_t vPermutationKey) const
+{
+	std::string Names;
+	for (size_t i = 0; i < m_FeatureDefines.size(); ++i)
+	{
+		if (!(vPermutationKey & (1u << i)))
+			continue;
+		if (!Names.empty())
+			Names += " ";
+		Names += m_FeatureDefines[i];
+	}
+	return Names.empty() ? "no features" : Names;
+}
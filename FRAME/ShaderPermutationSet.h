@@ -0,0 +1,36 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) Elay Pu. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "FRAME_EXPORTS.h"
+
+class CShader;
+
+//Feature variants of one program. Bit i of a permutation key turns on the #define vFeatureDefines[i], so a feature
+//the key leaves out is compiled out of the shader instead of branched over. A variant is compiled the first time
+//its key is asked for and kept; with the program binary cache of CShader a variant used before loads at startup.
+class FRAME_DLLEXPORTS CShaderPermutationSet
+{
+public:
+	static const size_t MAX_FEATURE_COUNT = 32;
+
+	CShaderPermutationSet() = default;
+	CShaderPermutationSet(const std::string& vVertexShaderFileName, const std::string& vFragmentShaderFileName, const std::vector<std::string>& vFeatureDefines);
+
+	const std::shared_ptr<CShader>& fetchOrCreateShader(uint32_t vPermutationKey);
+	bool hasShader(uint32_t vPermutationKey) const { return m_Shaders.find(vPermutationKey) != m_Shaders.end(); }
+	size_t getShaderCount() const { return m_Shaders.size(); }
+	std::string getFeatureNames(uint32_t vPermutationKey) const;	//of the bits set, for messages
+
+private:
+	std::string m_VertexShaderFileName;
+	std::string m_FragmentShaderFileName;
+	std::vector<std::string> m_FeatureDefines;
+	std::unordered_map<uint32_t, std::shared_ptr<CShader>> m_Shaders;
+};
@@ -0,0 +1,797 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) Elay Pu. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "TextureCompressor.h"
+#include "JobSystem.h"
+#include "Mesh.h"
+#include "Common.h"
+#include <stb_image.h>
+#include <gli.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <sys/stat.h>
+
+namespace
+{
+	const int BLOCK_TEXEL_COUNT = 16;
+	//weights of the 4-bit indices of BC7, out of 64
+	const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	bool queryModifiedTime(const std::string& vPath, int64_t& voModifiedTime)
+	{
+#ifdef _WIN32
+		struct _stat64 Status;
+		if (_stat64(vPath.c_str(), &Status) != 0)
+			return false;
+#else
+		struct stat Status;
+		if (stat(vPath.c_str(), &Status) != 0)
+			return false;
+#endif
+		voModifiedTime = static_cast<int64_t>(Status.st_mtime);
+		return true;
+	}
+
+	bool readFile(const std::string& vPath, std::vector<char>& voFileData)
+	{
+		std::ifstream File(vPath, std::ios::binary | std::ios::ate);
+		if (!File)
+			return false;
+		voFileData.resize(static_cast<size_t>(File.tellg()));
+		File.seekg(0);
+		File.read(voFileData.data(), voFileData.size());
+		return File && !voFileData.empty();
+	}
+
+	//written next to the cache and renamed, a crash never leaves a truncated cache that looks fresh
+	bool writeFileAtomically(const std::string& vPath, const std::vector<char>& vFileData)
+	{
+		const std::string TemporaryPath = vPath + ".tmp";
+		{
+			std::ofstream File(TemporaryPath, std::ios::binary | std::ios::trunc);
+			File.write(vFileData.data(), vFileData.size());
+			if (!File)
+			{
+				File.close();
+				std::remove(TemporaryPath.c_str());
+				return false;
+			}
+		}
+		std::remove(vPath.c_str());
+		if (std::rename(TemporaryPath.c_str(), vPath.c_str()) != 0)
+		{
+			std::remove(TemporaryPath.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	//one lock per source texture, models sharing a texture wait for the first transcode and read its cache
+	std::mutex& fetchTextureLock(const std::string& vTexturePath)
+	{
+		static std::mutex s_Mutex;
+		static std::unordered_map<std::string, std::unique_ptr<std::mutex>> s_TextureLocks;
+		std::lock_guard<std::mutex> Lock(s_Mutex);
+		std::unique_ptr<std::mutex>& pTextureLock = s_TextureLocks[vTexturePath];
+		if (!pTextureLock)
+			pTextureLock = std::make_unique<std::mutex>();
+		return *pTextureLock;
+	}
+
+	//Appends bits from the lowest bit of the first byte on, the order every BC format is read in
+	struct SBitWriter
+	{
+		uint8_t* pData;
+		unsigned Position = 0;
+
+		void write(uint32_t vValue, unsigned vBitCount)
+		{
+			for (unsigned i = 0; i < vBitCount; ++i, ++Position)
+				pData[Position >> 3] |= ((vValue >> i) & 1u) << (Position & 7);
+		}
+	};
+
+	struct SBitReader
+	{
+		const uint8_t* pData;
+		unsigned Position = 0;
+
+		uint32_t read(unsigned vBitCount)
+		{
+			uint32_t Value = 0;
+			for (unsigned i = 0; i < vBitCount; ++i, ++Position)
+				Value |= ((pData[Position >> 3] >> (Position & 7)) & 1u) << i;
+			return Value;
+		}
+	};
+
+	//the texels of block (vBlockX, vBlockY), a block over the edge repeats the last row and column
+	void fetchBlock(const uint8_t* vRGBA, uint32_t vWidth, uint32_t vHeight, uint32_t vBlockX, uint32_t vBlockY, float voTexels[BLOCK_TEXEL_COUNT][4])
+	{
+		for (uint32_t i = 0; i < BLOCK_TEXEL_COUNT; ++i)
+		{
+			const uint32_t X = std::min(vBlockX * 4 + i % 4, vWidth - 1), Y = std::min(vBlockY * 4 + i / 4, vHeight - 1);
+			const uint8_t* pTexel = vRGBA + (size_t(Y) * vWidth + X) * 4;
+			for (int c = 0; c < 4; ++c)
+				voTexels[i][c] = pTexel[c];
+		}
+	}
+
+	float computeDistance(const float vLeft[4], const float vRight[4], int vChannelCount)
+	{
+		float Distance = 0.0f;
+		for (int c = 0; c < vChannelCount; ++c)
+			Distance += (vLeft[c] - vRight[c]) * (vLeft[c] - vRight[c]);
+		return Distance;
+	}
+
+	//the texels projected on the principal axis of their covariance, the extremes are the first endpoints
+	void fitEndpoints(const float vTexels[BLOCK_TEXEL_COUNT][4], int vChannelCount, float voEndpoint0[4], float voEndpoint1[4])
+	{
+		float Mean[4] = {};
+		for (int i = 0; i < BLOCK_TEXEL_COUNT; ++i)
+			for (int c = 0; c < vChannelCount; ++c)
+				Mean[c] += vTexels[i][c] / BLOCK_TEXEL_COUNT;
+		float Covariance[4][4] = {};
+		for (int i = 0; i < BLOCK_TEXEL_COUNT; ++i)
+			for (int r = 0; r < vChannelCount; ++r)
+				for (int c = 0; c < vChannelCount; ++c)
+					Covariance[r][c] += (vTexels[i][r] - Mean[r]) * (vTexels[i][c] - Mean[c]);
+
+		float Axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+		for (int Iteration = 0; Iteration < 8; ++Iteration)
+		{
+			float Next[4] = {};
+			float Length = 0.0f;
+			for (int r = 0; r < vChannelCount; ++r)
+			{
+				for (int c = 0; c < vChannelCount; ++c)
+					Next[r] += Covariance[r][c] * Axis[c];
+				Length += Next[r] * Next[r];
+			}
+			if (Length < 1e-12f)
+				break;
+			Length = std::sqrt(Length);
+			for (int c = 0; c < vChannelCount; ++c)
+				Axis[c] = Next[c] / Length;
+		}
+
+		float MinProjection = FLT_MAX, MaxProjection = -FLT_MAX;
+		for (int i = 0; i < BLOCK_TEXEL_COUNT; ++i)
+		{
+			float Projection = 0.0f;
+			for (int c = 0; c < vChannelCount; ++c)
+				Projection += (vTexels[i][c] - Mean[c]) * Axis[c];
+			MinProjection = std::min(MinProjection, Projection);
+			MaxProjection = std::max(MaxProjection, Projection);
+		}
+		for (int c = 0; c < vChannelCount; ++c)
+		{
+			voEndpoint0[c] = std::min(std::max(Mean[c] + MinProjection * Axis[c], 0.0f), 255.0f);
+			voEndpoint1[c] = std::min(std::max(Mean[c] + MaxProjection * Axis[c], 0.0f), 255.0f);
+		}
+	}
+
+	//least squares endpoints for the interpolation weights the indices picked, false when they are all the same
+	bool refitEndpoints(const float vTexels[BLOCK_TEXEL_COUNT][4], int vChannelCount, const float vWeights[BLOCK_TEXEL_COUNT], float voEndpoint0[4], float voEndpoint1[4])
+	{
+		float A = 0.0f, B = 0.0f, C = 0.0f, D0[4] = {}, D1[4] = {};
+		for (int i = 0; i < BLOCK_TEXEL_COUNT; ++i)
+		{
+			const float W = vWeights[i];
+			A += (1.0f - W) * (1.0f - W);
+			B += (1.0f - W) * W;
+			C += W * W;
+			for (int c = 0; c < vChannelCount; ++c)
+			{
+				D0[c] += (1.0f - W) * vTexels[i][c];
+				D1[c] += W * vTexels[i][c];
+			}
+		}
+		const float Determinant = A * C - B * B;
+		if (std::abs(Determinant) < 1e-6f)
+			return false;
+		for (int c = 0; c < vChannelCount; ++c)
+		{
+			voEndpoint0[c] = std::min(std::max((C * D0[c] - B * D1[c]) / Determinant, 0.0f), 255.0f);
+			voEndpoint1[c] = std::min(std::max((A * D1[c] - B * D0[c]) / Determinant, 0.0f), 255.0f);
+		}
+		return true;
+	}
+
+	uint16_t packRGB565(const float vColor[4])
+	{
+		const int R = static_cast<int>(std::round(vColor[0] * 31.0f / 255.0f));
+		const int G = static_cast<int>(std::round(vColor[1] * 63.0f / 255.0f));
+		const int B = static_cast<int>(std::round(vColor[2] * 31.0f / 255.0f));
+		return static_cast<uint16_t>((R << 11) | (G << 5) | B);
+	}
+
+	void unpackRGB565(uint16_t vColor, float voColor[4])
+	{
+		const int R = (vColor >> 11) & 31, G = (vColor >> 5) & 63, B = vColor & 31;
+		voColor[0] = static_cast<float>((R << 3) | (R >> 2));
+		voColor[1] = static_cast<float>((G << 2) | (G >> 4));
+		voColor[2] = static_cast<float>((B << 3) | (B >> 2));
+		voColor[3] = 255.0f;
+	}
+
+	//the 4 color mode, Color0 > Color1; with equal colors the block is in the 3 color mode and index 0 is still Color0
+	void buildBC1Palette(uint16_t vColor0, uint16_t vColor1, float voPalette[4][4])
+	{
+		unpackRGB565(vColor0, voPalette[0]);
+		unpackRGB565(vColor1, voPalette[1]);
+		for (int c = 0; c < 4; ++c)
+		{
+			if (vColor0 > vColor1)
+			{
+				voPalette[2][c] = std::round((2.0f * voPalette[0][c] + voPalette[1][c]) / 3.0f);
+				voPalette[3][c] = std::round((voPalette[0][c] + 2.0f * voPalette[1][c]) / 3.0f);
+			}
+			else
+			{
+				voPalette[2][c] = std::round((voPalette[0][c] + voPalette[1][c]) / 2.0f);
+				voPalette[3][c] = 0.0f;
+			}
+		}
+	}
+
+	void encodeBC1Block(const float vTexels[BLOCK_TEXEL_COUNT][4], uint8_t voBlock[8])
+	{
+		static const float Weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+		float Endpoint0[4], Endpoint1[4];
+		fitEndpoints(vTexels, 3, Endpoint0, Endpoint1);
+		float BestError = FLT_MAX;
+		for (int Iteration = 0; Iteration < 2; ++Iteration)
+		{
+			uint16_t Color0 = packRGB565(Endpoint0), Color1 = packRGB565(Endpoint1);
+			if (Color0 < Color1)
+				std::swap(Color0, Color1);
+			float Palette[4][4];
+			buildBC1Palette(Color0, Color1, Palette);
+			const int PaletteSize = Color0 == Color1 ? 1 : 4;
+
+			uint32_t Indices = 0;
+			float Error = 0.0f, TexelWeights[BLOCK_TEXEL_COUNT];
+			for (int i = 0; i < BLOCK_TEXEL_COUNT; ++i)
+			{
+				int BestIndex = 0;
+				float BestDistance = FLT_MAX;
+				for (int k = 0; k < PaletteSize; ++k)
+				{
+					const float Distance = computeDistance(vTexels[i], Palette[k], 3);
+					if (Distance < BestDistance)
+					{
+						BestDistance = Distance;
+						BestIndex = k;
+					}
+				}
+				Indices |= static_cast<uint32_t>(BestIndex) << (2 * i);
+				TexelWeights[i] = Weights[BestIndex];
+				Error += BestDistance;
+			}
+			if (Error < BestError)
+			{
+				BestError = Error;
+				std::memcpy(voBlock, &Color0, 2);
+				std::memcpy(voBlock + 2, &Color1, 2);
+				std::memcpy(voBlock + 4, &Indices, 4);
+			}
+			if (PaletteSize == 1 || !refitEndpoints(vTexels, 3, TexelWeights, Endpoint0, Endpoint1))
+				break;
+		}
+	}
+
+	void decodeBC1Block(const uint8_t vBlock[8], float voTexels[BLOCK_TEXEL_COUNT][4])
+	{
+		uint16_t Color0, Color1;
+		uint32_t Indices;
+		std::memcpy(&Color0, vBlock, 2);
+		std::memcpy(&Color1, vBlock + 2, 2);
+		std::memcpy(&Indices, vBlock + 4, 4);
+		float Palette[4][4];
+		buildBC1Palette(Color0, Color1, Palette);
+		for (int i = 0; i < BLOCK_TEXEL_COUNT; ++i)
+			std::memcpy(voTexels[i], Palette[(Indices >> (2 * i)) & 3], sizeof(float) * 4);
+	}
+
+	//the 8 value mode, Endpoint0 > Endpoint1
+	void buildBC4Palette(int vEndpoint0, int vEndpoint1, float voPalette[8])
+	{
+		voPalette[0] = static_cast<float>(vEndpoint0);
+		voPalette[1] = static_cast<float>(vEndpoint1);
+		for (int k = 2; k < 8; ++k)
+			voPalette[k] = vEndpoint0 > vEndpoint1 ? std::round(((8 - k) * vEndpoint0 + (k - 1) * vEndpoint1) / 7.0f)
+				: (k < 6 ? std::round(((6 - k) * vEndpoint0 + (k - 1) * vEndpoint1) / 5.0f) : (k == 6 ? 0.0f : 255.0f));
+	}
+
+	//vChannel of vTexels
+	void encodeBC4Block(const float vTexels[BLOCK_TEXEL_COUNT][4], int vChannel, uint8_t voBlock[8])
+	{
+		float Values[BLOCK_TEXEL_COUNT][4];
+		float Endpoint0[4] = { 0.0f }, Endpoint1[4] = { 0.0f };
+		for (int i = 0; i < BLOCK_TEXEL_COUNT; ++i)
+		{
+			Values[i][0] = vTexels[i][vChannel];
+			Endpoint0[0] = std::max(Endpoint0[0], Values[i][0]);
+		}
+		Endpoint1[0] = Endpoint0[0];
+		for (int i = 0; i < BLOCK_TEXEL_COUNT; ++i)
+			Endpoint1[0] = std::min(Endpoint1[0], Values[i][0]);
+
+		float BestError = FLT_MAX;
+		for (int Iteration = 0; Iteration < 2; ++Iteration)
+		{
+			int Value0 = static_cast<int>(std::round(Endpoint0[0])), Value1 = static_cast<int>(std::round(Endpoint1[0]));
+			if (Value0 < Value1)
+				std::swap(Value0, Value1);
+			float Palette[8];
+			buildBC4Palette(Value0, Value1, Palette);
+			const int PaletteSize = Value0 == Value1 ? 1 : 8;
+
+			uint64_t Indices = 0;
+			float Error = 0.0f, TexelWeights[BLOCK_TEXEL_COUNT];
+			for (int i = 0; i < BLOCK_TEXEL_COUNT; ++i)
+			{
+				int BestIndex = 0;
+				float BestDistance = FLT_MAX;
+				for (int k = 0; k < PaletteSize; ++k)
+				{
+					const float Distance = (Values[i][0] - Palette[k]) * (Values[i][0] - Palette[k]);
+					if (Distance < BestDistance)
+					{
+						BestDistance = Distance;
+						BestIndex = k;
+					}
+				}
+				Indices |= static_cast<uint64_t>(BestIndex) << (3 * i);
+				TexelWeights[i] = BestIndex == 0 ? 0.0f : (BestIndex == 1 ? 1.0f : (BestIndex - 1) / 7.0f);
+				Error += BestDistance;
+			}
+			if (Error < BestError)
+			{
+				BestError = Error;
+				voBlock[0] = static_cast<uint8_t>(Value0);
+				voBlock[1] = static_cast<uint8_t>(Value1);
+				for (int i = 0; i < 6; ++i)
+					voBlock[2 + i] = static_cast<uint8_t>(Indices >> (8 * i));
+			}
+			if (PaletteSize == 1 || !refitEndpoints(Values, 1, TexelWeights, Endpoint0, Endpoint1))
+				break;
+		}
+	}
+
+	void decodeBC4Block(const uint8_t vBlock[8], int vChannel, float voTexels[BLOCK_TEXEL_COUNT][4])
+	{
+		float Palette[8];
+		buildBC4Palette(vBlock[0], vBlock[1], Palette);
+		uint64_t Indices = 0;
+		for (int i = 0; i < 6; ++i)
+			Indices |= static_cast<uint64_t>(vBlock[2 + i]) << (8 * i);
+		for (int i = 0; i < BLOCK_TEXEL_COUNT; ++i)
+			voTexels[i][vChannel] = Palette[(Indices >> (3 * i)) & 7];
+	}
+
+	int interpolateBC7(int vEndpoint0, int vEndpoint1, int vWeight)
+	{
+		return ((64 - vWeight) * vEndpoint0 + vWeight * vEndpoint1 + 32) >> 6;
+	}
+
+	//7 bits per channel and a p-bit shared by the channels, the p-bit with the smaller error wins
+	void quantizeBC7Endpoint(const float vEndpoint[4], uint32_t voQuantized[4], uint32_t& voPBit, int voDecoded[4])
+	{
+		float BestError = FLT_MAX;
+		for (uint32_t PBit = 0; PBit < 2; ++PBit)
+		{
+			float Error = 0.0f;
+			uint32_t Quantized[4];
+			for (int c = 0; c < 4; ++c)
+			{
+				Quantized[c] = static_cast<uint32_t>(std::min(std::max(std::round((vEndpoint[c] - PBit) / 2.0f), 0.0f), 127.0f));
+				const float Decoded = static_cast<float>((Quantized[c] << 1) | PBit);
+				Error += (Decoded - vEndpoint[c]) * (Decoded - vEndpoint[c]);
+			}
+			if (Error < BestError)
+			{
+				BestError = Error;
+				voPBit = PBit;
+				for (int c = 0; c < 4; ++c)
+				{
+					voQuantized[c] = Quantized[c];
+					voDecoded[c] = static_cast<int>((Quantized[c] << 1) | PBit);
+				}
+			}
+		}
+	}
+
+	//mode 6: 7 mode bits, R0 R1 G0 G1 B0 B1 A0 A1 of 7 bits, P0 P1, then 16 indices of 4 bits but the first of 3
+	void encodeBC7Block(const float vTexels[BLOCK_TEXEL_COUNT][4], uint8_t voBlock[16])
+	{
+		float Endpoint0[4], Endpoint1[4];
+		fitEndpoints(vTexels, 4, Endpoint0, Endpoint1);
+		float BestError = FLT_MAX;
+		uint32_t BestQuantized[2][4] = {}, BestPBits[2] = {}, BestIndices[BLOCK_TEXEL_COUNT] = {};
+		for (int Iteration = 0; Iteration < 2; ++Iteration)
+		{
+			uint32_t Quantized[2][4], PBits[2];
+			int Decoded[2][4];
+			quantizeBC7Endpoint(Endpoint0, Quantized[0], PBits[0], Decoded[0]);
+			quantizeBC7Endpoint(Endpoint1, Quantized[1], PBits[1], Decoded[1]);
+			float Palette[16][4];
+			for (int k = 0; k < 16; ++k)
+				for (int c = 0; c < 4; ++c)
+					Palette[k][c] = static_cast<float>(interpolateBC7(Decoded[0][c], Decoded[1][c], BC7_WEIGHTS[k]));
+
+			uint32_t Indices[BLOCK_TEXEL_COUNT];
+			float Error = 0.0f, TexelWeights[BLOCK_TEXEL_COUNT];
+			for (int i = 0; i < BLOCK_TEXEL_COUNT; ++i)
+			{
+				float BestDistance = FLT_MAX;
+				for (int k = 0; k < 16; ++k)
+				{
+					const float Distance = computeDistance(vTexels[i], Palette[k], 4);
+					if (Distance < BestDistance)
+					{
+						BestDistance = Distance;
+						Indices[i] = k;
+					}
+				}
+				TexelWeights[i] = BC7_WEIGHTS[Indices[i]] / 64.0f;
+				Error += BestDistance;
+			}
+			if (Error < BestError)
+			{
+				BestError = Error;
+				std::memcpy(BestQuantized, Quantized, sizeof(Quantized));
+				std::memcpy(BestPBits, PBits, sizeof(PBits));
+				std::memcpy(BestIndices, Indices, sizeof(Indices));
+			}
+			if (!refitEndpoints(vTexels, 4, TexelWeights, Endpoint0, Endpoint1))
+				break;
+		}
+
+		//the top bit of the first index is implied 0, the endpoints are swapped to make it so
+		if (BestIndices[0] >= 8)
+		{
+			for (int c = 0; c < 4; ++c)
+				std::swap(BestQuantized[0][c], BestQuantized[1][c]);
+			std::swap(BestPBits[0], BestPBits[1]);
+			for (uint32_t& Index : BestIndices)
+				Index = 15 - Index;
+		}
+
+		std::memset(voBlock, 0, 16);
+		SBitWriter Writer{ voBlock };
+		Writer.write(1u << 6, 7);
+		for (int c = 0; c < 4; ++c)
+		{
+			Writer.write(BestQuantized[0][c], 7);
+			Writer.write(BestQuantized[1][c], 7);
+		}
+		Writer.write(BestPBits[0], 1);
+		Writer.write(BestPBits[1], 1);
+		for (int i = 0; i < BLOCK_TEXEL_COUNT; ++i)
+			Writer.write(BestIndices[i], i == 0 ? 3 : 4);
+	}
+
+	//mode 6 only, the one encodeBC7Block writes
+	void decodeBC7Block(const uint8_t vBlock[16], float voTexels[BLOCK_TEXEL_COUNT][4])
+	{
+		SBitReader Reader{ vBlock };
+		_ASSERT(Reader.read(7) == (1u << 6));
+		uint32_t Quantized[2][4];
+		for (int c = 0; c < 4; ++c)
+		{
+			Quantized[0][c] = Reader.read(7);
+			Quantized[1][c] = Reader.read(7);
+		}
+		const uint32_t PBits[2] = { Reader.read(1), Reader.read(1) };
+		for (int i = 0; i < BLOCK_TEXEL_COUNT; ++i)
+		{
+			const uint32_t Index = Reader.read(i == 0 ? 3 : 4);
+			for (int c = 0; c < 4; ++c)
+				voTexels[i][c] = static_cast<float>(interpolateBC7((Quantized[0][c] << 1) | PBits[0], (Quantized[1][c] << 1) | PBits[1], BC7_WEIGHTS[Index]));
+		}
+	}
+
+	size_t getBlockSize(ETextureCompression vCompression)
+	{
+		return vCompression == ETextureCompression::BC1 || vCompression == ETextureCompression::BC4 ? 8 : 16;
+	}
+
+	void encodeBlock(ETextureCompression vCompression, const float vTexels[BLOCK_TEXEL_COUNT][4], uint8_t* voBlock)
+	{
+		switch (vCompression)
+		{
+		case ETextureCompression::BC1:
+			encodeBC1Block(vTexels, voBlock);
+			break;
+		case ETextureCompression::BC4:
+			encodeBC4Block(vTexels, 0, voBlock);
+			break;
+		case ETextureCompression::BC5:
+			encodeBC4Block(vTexels, 0, voBlock);
+			encodeBC4Block(vTexels, 1, voBlock + 8);
+			break;
+		case ETextureCompression::BC7:
+			encodeBC7Block(vTexels, voBlock);
+			break;
+		}
+	}
+
+	void decodeBlock(ETextureCompression vCompression, const uint8_t* vBlock, float voTexels[BLOCK_TEXEL_COUNT][4])
+	{
+		switch (vCompression)
+		{
+		case ETextureCompression::BC1:
+			decodeBC1Block(vBlock, voTexels);
+			break;
+		case ETextureCompression::BC4:
+			decodeBC4Block(vBlock, 0, voTexels);
+			break;
+		case ETextureCompression::BC5:
+			decodeBC4Block(vBlock, 0, voTexels);
+			decodeBC4Block(vBlock + 8, 1, voTexels);
+			break;
+		case ETextureCompression::BC7:
+			decodeBC7Block(vBlock, voTexels);
+			break;
+		}
+	}
+
+	//2x2 box filter like CTextureStreamer builds its mips with, a normal map is renormalized after it
+	std::vector<uint8_t> downsampleLevel(const std::vector<uint8_t>& vRGBA, uint32_t vWidth, uint32_t vHeight, bool vIsNormalMap)
+	{
+		const uint32_t TargetWidth = std::max(vWidth / 2, 1u), TargetHeight = std::max(vHeight / 2, 1u);
+		std::vector<uint8_t> Target(size_t(TargetWidth) * TargetHeight * 4);
+		for (uint32_t y = 0; y < TargetHeight; ++y)
+		{
+			for (uint32_t x = 0; x < TargetWidth; ++x)
+			{
+				float Sum[4] = {};
+				for (uint32_t k = 0; k < 4; ++k)
+				{
+					const uint32_t SourceX = std::min(x * 2 + (k & 1), vWidth - 1), SourceY = std::min(y * 2 + (k >> 1), vHeight - 1);
+					for (int c = 0; c < 4; ++c)
+						Sum[c] += vRGBA[(size_t(SourceY) * vWidth + SourceX) * 4 + c] * 0.25f;
+				}
+				if (vIsNormalMap)
+				{
+					float Normal[3] = { Sum[0] / 127.5f - 1.0f, Sum[1] / 127.5f - 1.0f, Sum[2] / 127.5f - 1.0f };
+					const float Length = std::sqrt(Normal[0] * Normal[0] + Normal[1] * Normal[1] + Normal[2] * Normal[2]);
+					for (int c = 0; c < 3 && Length > 1e-6f; ++c)
+						Sum[c] = (Normal[c] / Length + 1.0f) * 127.5f;
+				}
+				for (int c = 0; c < 4; ++c)
+					Target[(size_t(y) * TargetWidth + x) * 4 + c] = static_cast<uint8_t>(std::min(std::max(Sum[c] + 0.5f, 0.0f), 255.0f));
+			}
+		}
+		return Target;
+	}
+
+	const char* getCompressionName(ETextureCompression vCompression)
+	{
+		static const char* Names[] = { "bc1", "bc4", "bc5", "bc7" };
+		return Names[static_cast<int>(vCompression)];
+	}
+}
+
+//************************************************************************************
+//Function:
+std::string CTextureCompressor::getCachePath(const std::string& vTexturePath, ETextureCompression vCompression)
+{
+	return vTexturePath + "." + getCompressionName(vCompression) + ".dds";
+}
+
+//************************************************************************************
+//Function:
+ETextureUsage CTextureCompressor::getTextureUsage(const std::string& vTextureUniformName)
+{
+	if (vTextureUniformName == NORMAL_TEX)
+		return ETextureUsage::Normal;
+	if (vTextureUniformName == ROUGHNESS_TEX || vTextureUniformName == METALLIC_TEX)
+		return ETextureUsage::Mask;
+	return ETextureUsage::Color;
+}
+
+//************************************************************************************
+//Function:
+bool CTextureCompressor::isCompressible(const std::string& vTexturePath)
+{
+	const size_t DotPosition = vTexturePath.find_last_of('.');
+	if (DotPosition == std::string::npos)
+		return true;
+	std::string Extension = vTexturePath.substr(DotPosition + 1);
+	std::transform(Extension.begin(), Extension.end(), Extension.begin(), [](unsigned char vChar) { return static_cast<char>(std::tolower(vChar)); });
+	return Extension != "dds" && Extension != "hdr" && Extension != "ktx";
+}
+
+//************************************************************************************
+//Function: every level down to 1x1, a job per row of blocks; the error of level 0 is summed per row so no job shares a sum
+STextureCompressionResult CTextureCompressor::compress(const uint8_t* vRGBA, uint32_t vWidth, uint32_t vHeight, int vSourceChannelCount, ETextureUsage vUsage, const std::shared_ptr<CJobSystem>& vJobSystem)
+{
+	_ASSERT(vRGBA && vWidth > 0 && vHeight > 0);
+	bool IsOpaque = true;
+	for (size_t i = 0; i < size_t(vWidth) * vHeight && IsOpaque; ++i)
+		IsOpaque = vRGBA[i * 4 + 3] == 255;
+
+	STextureCompressionResult Result;
+	Result.Width = vWidth;
+	Result.Height = vHeight;
+	switch (vUsage)
+	{
+	case ETextureUsage::Normal:
+		Result.Compression = ETextureCompression::BC5;
+		break;
+	case ETextureUsage::Mask:
+		Result.Compression = ETextureCompression::BC4;
+		break;
+	default:
+		Result.Compression = IsOpaque && ElayGraphics::COMPONENT_CONFIG::IS_ALLOW_BC1_TEXTURES ? ETextureCompression::BC1 : ETextureCompression::BC7;
+		break;
+	}
+	const size_t BlockSize = getBlockSize(Result.Compression);
+
+	std::vector<std::vector<uint8_t>> Levels(1, std::vector<uint8_t>(vRGBA, vRGBA + size_t(vWidth) * vHeight * 4));
+	std::vector<std::pair<uint32_t, uint32_t>> LevelSizes(1, std::make_pair(vWidth, vHeight));
+	while (LevelSizes.back().first > 1 || LevelSizes.back().second > 1)
+	{
+		const auto& Size = LevelSizes.back();
+		Levels.push_back(downsampleLevel(Levels.back(), Size.first, Size.second, vUsage == ETextureUsage::Normal));
+		LevelSizes.push_back(std::make_pair(std::max(Size.first / 2, 1u), std::max(Size.second / 2, 1u)));
+	}
+
+	const uint32_t BlockRowCount0 = (vHeight + 3) / 4;
+	std::vector<double> RowErrors(BlockRowCount0, 0.0);
+	const int ErrorChannelCount = Result.Compression == ETextureCompression::BC4 ? 1 : (Result.Compression == ETextureCompression::BC5 ? 2 : (IsOpaque ? 3 : 4));
+	Result.Levels.resize(Levels.size());
+	auto pJobs = vJobSystem ? vJobSystem->createGroup() : nullptr;
+	for (size_t Level = 0; Level < Levels.size(); ++Level)
+	{
+		const uint32_t Width = LevelSizes[Level].first, Height = LevelSizes[Level].second;
+		const uint32_t BlockColumnCount = (Width + 3) / 4, BlockRowCount = (Height + 3) / 4;
+		Result.Levels[Level].resize(size_t(BlockColumnCount) * BlockRowCount * BlockSize);
+		Result.SourceBytes += size_t(Width) * Height * vSourceChannelCount;
+
+		const uint8_t* pSource = Levels[Level].data();
+		uint8_t* pTarget = Result.Levels[Level].data();
+		const ETextureCompression Compression = Result.Compression;
+		auto encodeRows = [=, &RowErrors](size_t vBegin, size_t vEnd)
+		{
+			for (size_t BlockY = vBegin; BlockY < vEnd; ++BlockY)
+			{
+				for (uint32_t BlockX = 0; BlockX < BlockColumnCount; ++BlockX)
+				{
+					float Texels[BLOCK_TEXEL_COUNT][4], DecodedTexels[BLOCK_TEXEL_COUNT][4];
+					fetchBlock(pSource, Width, Height, BlockX, static_cast<uint32_t>(BlockY), Texels);
+					uint8_t* pBlock = pTarget + (BlockY * BlockColumnCount + BlockX) * BlockSize;
+					encodeBlock(Compression, Texels, pBlock);
+					if (Level != 0)
+						continue;
+					decodeBlock(Compression, pBlock, DecodedTexels);
+					for (uint32_t i = 0; i < BLOCK_TEXEL_COUNT; ++i)
+					{
+						if (BlockX * 4 + i % 4 < Width && BlockY * 4 + i / 4 < Height)
+							RowErrors[BlockY] += computeDistance(Texels[i], DecodedTexels[i], ErrorChannelCount);
+					}
+				}
+			}
+		};
+		if (pJobs)
+			vJobSystem->parallelFor(pJobs, 0, BlockRowCount, 1, encodeRows);
+		else
+			encodeRows(0, BlockRowCount);
+	}
+	if (pJobs)
+		vJobSystem->wait(pJobs);
+
+	double SquaredError = 0.0;
+	for (double RowError : RowErrors)
+		SquaredError += RowError;
+	const double MeanSquaredError = SquaredError / (double(vWidth) * vHeight * ErrorChannelCount);
+	Result.PSNR = MeanSquaredError > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / MeanSquaredError) : std::numeric_limits<double>::infinity();
+	return Result;
+}
+
+//************************************************************************************
+//Function: the DX10 header and format gli picks, BC4 and BC5 read back as the RGTC formats
+bool CTextureCompressor::writeDDS(const STextureCompressionResult& vResult, std::vector<char>& voFileData)
+{
+	static const gli::format Formats[] = { gli::FORMAT_RGB_DXT1_UNORM_BLOCK8, gli::FORMAT_R_ATI1N_UNORM_BLOCK8, gli::FORMAT_RG_ATI2N_UNORM_BLOCK16, gli::FORMAT_RGBA_BP_UNORM_BLOCK16 };
+	gli::texture2d Texture(Formats[static_cast<int>(vResult.Compression)], gli::extent2d(vResult.Width, vResult.Height), vResult.Levels.size());
+	for (size_t Level = 0; Level < vResult.Levels.size(); ++Level)
+	{
+		if (Texture.size(Level) != vResult.Levels[Level].size())
+			return false;
+		std::memcpy(Texture.data(0, 0, Level), vResult.Levels[Level].data(), vResult.Levels[Level].size());
+	}
+	voFileData.clear();
+	return gli::save_dds(Texture, voFileData);
+}
+
+//************************************************************************************
+//Function: a color texture may have gone to BC1 or BC7, whichever fresh cache there is wins
+bool CTextureCompressor::loadCache(const std::string& vTexturePath, ETextureUsage vUsage, std::string& voCachePath, std::vector<char>& voFileData)
+{
+	std::vector<ETextureCompression> Compressions;
+	if (vUsage == ETextureUsage::Normal)
+		Compressions.push_back(ETextureCompression::BC5);
+	else if (vUsage == ETextureUsage::Mask)
+		Compressions.push_back(ETextureCompression::BC4);
+	else if (ElayGraphics::COMPONENT_CONFIG::IS_ALLOW_BC1_TEXTURES)
+		Compressions = { ETextureCompression::BC1, ETextureCompression::BC7 };
+	else
+		Compressions.push_back(ETextureCompression::BC7);
+
+	int64_t SourceModifiedTime = 0, CacheModifiedTime = 0;
+	if (!queryModifiedTime(vTexturePath, SourceModifiedTime))
+		return false;
+	for (ETextureCompression Compression : Compressions)
+	{
+		const std::string CachePath = getCachePath(vTexturePath, Compression);
+		if (queryModifiedTime(CachePath, CacheModifiedTime) && CacheModifiedTime >= SourceModifiedTime && readFile(CachePath, voFileData))
+		{
+			voCachePath = CachePath;
+			return true;
+		}
+	}
+	return false;
+}
+
+//************************************************************************************
+//Function: calls for the same texture are serialized, so only the first one transcodes and the others find its cache
+bool CTextureCompressor::loadOrCompress(const std::string& vTexturePath, ETextureUsage vUsage, const std::shared_ptr<CJobSystem>& vJobSystem, bool vIsForced,
+	std::string& voCachePath, std::vector<char>& voFileData)
+{
+	std::lock_guard<std::mutex> TextureLock(fetchTextureLock(vTexturePath));
+	if (!vIsForced && loadCache(vTexturePath, vUsage, voCachePath, voFileData))
+		return true;
+
+	std::vector<char> SourceData;
+	if (!readFile(vTexturePath, SourceData))
+	{
+		std::cerr << "Error::TextureCompressor:: can't read " << vTexturePath << std::endl;
+		return false;
+	}
+	const auto StartTime = std::chrono::steady_clock::now();
+	//the thread's own flag, the global one belongs to the loaders on other threads
+	stbi_set_flip_vertically_on_load_thread(true);
+	int Width = 0, Height = 0, ChannelCount = 0;
+	stbi_uc* pPixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(SourceData.data()), static_cast<int>(SourceData.size()), &Width, &Height, &ChannelCount, 4);
+	if (!pPixels)
+	{
+		std::cerr << "Error::TextureCompressor:: can't decode " << vTexturePath << std::endl;
+		return false;
+	}
+	const STextureCompressionResult Result = compress(pPixels, Width, Height, ChannelCount, vUsage, vJobSystem);
+	stbi_image_free(pPixels);
+	if (!writeDDS(Result, voFileData))
+	{
+		std::cerr << "Error::TextureCompressor:: can't build the DDS file of " << vTexturePath << std::endl;
+		return false;
+	}
+
+	voCachePath = getCachePath(vTexturePath, Result.Compression);
+	if (!writeFileAtomically(voCachePath, voFileData))
+		std::cerr << "Error::TextureCompressor:: can't write " << voCachePath << ", the texture is compressed again next time" << std::endl;
+
+	size_t CompressedBytes = 0;
+	for (const auto& Level : Result.Levels)
+		CompressedBytes += Level.size();
+	const double ElapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - StartTime).count();
+	std::cout << "TextureCompressor:: " << vTexturePath << " to " << getCompressionName(Result.Compression) << ", " << Width << "x" << Height << " with " << Result.Levels.size()
+		<< " levels, " << CompressedBytes / 1024 << " KB instead of " << Result.SourceBytes / 1024 << " KB (" << double(Result.SourceBytes) / CompressedBytes << "x), PSNR "
+		<< Result.PSNR << " dB, in " << ElapsedMs << " ms" << std::endl;
+	return true;
+}
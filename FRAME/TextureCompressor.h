@@ -0,0 +1,63 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) Elay Pu. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "FRAME_EXPORTS.h"
+
+class CJobSystem;
+
+//What a material texture holds, it decides the block format
+enum class ETextureUsage
+{
+	Color,		//BC7, or BC1 when allowed and the texture is opaque
+	Normal,		//BC5 of x and y, z is not stored and samples as 0
+	Mask,		//BC4 of the red channel: roughness, metallic, occlusion
+};
+
+enum class ETextureCompression
+{
+	BC1,
+	BC4,
+	BC5,
+	BC7,
+};
+
+//A compressed mip chain, level 0 first, every level rows of 4x4 blocks in the row order they are uploaded
+struct STextureCompressionResult
+{
+	ETextureCompression Compression = ETextureCompression::BC7;
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	std::vector<std::vector<uint8_t>> Levels;
+	size_t SourceBytes = 0;		//of the RGBA8 or RGB8 chain the texture was uploaded as before
+	double PSNR = 0.0;			//dB of level 0 against the source, over the channels the format keeps
+};
+
+//Import-time transcoder of material textures to block compressed DDS files the gli path of CTextureStreamer loads
+//as they are. The cache is written next to the source, <texture>.<format>.dds, and is used while it is newer than the
+//source. Blocks are encoded on the job system a row of blocks per job: BC1 and BC4 from the extremes along the principal
+//axis with a least squares refit, BC7 in mode 6 (one subset, RGBA 7.7.7.7 endpoints with a p-bit, 4-bit indices).
+//Mips are box filtered from level 0, normal maps are renormalized on every level.
+class FRAME_DLLEXPORTS CTextureCompressor
+{
+public:
+	static std::string getCachePath(const std::string& vTexturePath, ETextureCompression vCompression);
+	static ETextureUsage getTextureUsage(const std::string& vTextureUniformName);	//a DIFFUSE_TEX ... METALLIC_TEX of Mesh.h
+	static bool isCompressible(const std::string& vTexturePath);	//not for files that are DDS or HDR already
+
+	//vRGBA is tightly packed RGBA8 as the texture is uploaded, vSourceChannelCount only sizes SourceBytes
+	static STextureCompressionResult compress(const uint8_t* vRGBA, uint32_t vWidth, uint32_t vHeight, int vSourceChannelCount, ETextureUsage vUsage, const std::shared_ptr<CJobSystem>& vJobSystem = nullptr);
+	static bool writeDDS(const STextureCompressionResult& vResult, std::vector<char>& voFileData);
+
+	//The DDS file of vTexturePath from a cache newer than the source, false when there is none. Never transcodes.
+	static bool loadCache(const std::string& vTexturePath, ETextureUsage vUsage, std::string& voCachePath, std::vector<char>& voFileData);
+	//The DDS file of vTexturePath from the cache, transcoded and written to it first when the cache is missing or stale.
+	//False when the source can't be read or decoded. For MeshConverter, a transcode can take seconds.
+	static bool loadOrCompress(const std::string& vTexturePath, ETextureUsage vUsage, const std::shared_ptr<CJobSystem>& vJobSystem, bool vIsForced,
+		std::string& voCachePath, std::vector<char>& voFileData);
+};
@@ -0,0 +1,471 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) Elay Pu. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "TextureStreamer.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <type_traits>
+#include <stb_image.h>
+#include <gli.hpp>
+#include "JobSystem.h"
+#include "GLStateCache.h"
+
+//One mip level as it is uploaded, tightly packed. A row is a row of texels, or a row of blocks of a compressed format.
+struct SStreamedLevel
+{
+	GLsizei Width = 0;
+	GLsizei Height = 0;
+	GLsizei RowCount = 0;
+	size_t  RowPitch = 0;
+	const GLubyte* pData = nullptr;
+};
+
+//A decoded image with its whole mip chain, level 0 first
+struct SStreamedImage
+{
+	GLint   InternalFormat = GL_RGBA;
+	GLenum  ExternalFormat = GL_RGBA;
+	GLenum  DataType = GL_UNSIGNED_BYTE;
+	bool    IsCompressed = false;
+	GLsizei BlockHeight = 1;	//texel rows per row
+	std::vector<SStreamedLevel> Levels;
+	std::shared_ptr<void> pPixelOwner;	//level 0 of stb, or the whole gli texture
+	std::vector<GLubyte> MipData;	//the levels built from level 0
+};
+
+//Shared by the decode jobs and the context thread, so a streamer destroyed while decoding just cancels them
+struct STextureStreamQueue
+{
+	struct SDecodedTexture
+	{
+		GLuint TextureID = 0;
+		std::string FilePath;
+		std::shared_ptr<SStreamedImage> pImage;	//nullptr when decoding failed
+	};
+
+	std::mutex Mutex;
+	std::vector<SDecodedTexture> DecodedTextures;
+};
+
+namespace
+{
+	double computeElapsedMs(const std::chrono::steady_clock::time_point& vStartTime)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - vStartTime).count();
+	}
+
+	//2x2 box filter, the last texel of an odd side is left out like glGenerateMipmap does on most drivers
+	template <typename T>
+	void downsampleLevel(const T* vSource, GLsizei vWidth, GLsizei vHeight, int vChannelCount, T* voTarget)
+	{
+		const float Rounding = std::is_integral<T>::value ? 0.5f : 0.0f;
+		const GLsizei TargetWidth = std::max(vWidth / 2, 1), TargetHeight = std::max(vHeight / 2, 1);
+		for (GLsizei y = 0; y < TargetHeight; ++y)
+		{
+			const T* pRows[2] = { vSource + size_t(std::min(y * 2, vHeight - 1)) * vWidth * vChannelCount, vSource + size_t(std::min(y * 2 + 1, vHeight - 1)) * vWidth * vChannelCount };
+			for (GLsizei x = 0; x < TargetWidth; ++x)
+			{
+				const size_t Columns[2] = { size_t(std::min(x * 2, vWidth - 1)) * vChannelCount, size_t(std::min(x * 2 + 1, vWidth - 1)) * vChannelCount };
+				for (int c = 0; c < vChannelCount; ++c)
+				{
+					const float Sum = float(pRows[0][Columns[0] + c]) + float(pRows[0][Columns[1] + c]) + float(pRows[1][Columns[0] + c]) + float(pRows[1][Columns[1] + c]);
+					voTarget[(size_t(y) * TargetWidth + x) * vChannelCount + c] = static_cast<T>(Sum * 0.25f + Rounding);
+				}
+			}
+		}
+	}
+
+	//the formats configureCommonTexture and configureHDRTexture pick
+	std::shared_ptr<SStreamedImage> decodeCommonImage(const std::vector<char>& vFileData, bool vIsHDR)
+	{
+		//decoded on a worker, the global flag belongs to the loaders on other threads
+		stbi_set_flip_vertically_on_load_thread(true);
+		GLint Width = 0, Height = 0, ChannelCount = 0;
+		const stbi_uc* pFileData = reinterpret_cast<const stbi_uc*>(vFileData.data());
+		const int FileSize = static_cast<int>(vFileData.size());
+		void* pPixels = vIsHDR ? static_cast<void*>(stbi_loadf_from_memory(pFileData, FileSize, &Width, &Height, &ChannelCount, 0))
+			: static_cast<void*>(stbi_load_from_memory(pFileData, FileSize, &Width, &Height, &ChannelCount, 0));
+		if (!pPixels)
+			return nullptr;
+		auto pImage = std::make_shared<SStreamedImage>();
+		pImage->pPixelOwner = std::shared_ptr<void>(pPixels, [](void* vPixels) { stbi_image_free(vPixels); });
+		if (ChannelCount < 1 || ChannelCount > 4)
+			return nullptr;
+
+		static const GLenum ExternalFormats[] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+		static const GLint HDRInternalFormats[] = { GL_R16F, GL_RG16F, GL_RGB16F, GL_RGBA16F };
+		pImage->ExternalFormat = ExternalFormats[ChannelCount - 1];
+		pImage->InternalFormat = vIsHDR ? HDRInternalFormats[ChannelCount - 1] : static_cast<GLint>(ExternalFormats[ChannelCount - 1]);
+		pImage->DataType = vIsHDR ? GL_FLOAT : GL_UNSIGNED_BYTE;
+		const size_t TexelSize = ChannelCount * (vIsHDR ? sizeof(float) : sizeof(stbi_uc));
+
+		size_t MipDataSize = 0;
+		for (GLsizei LevelWidth = Width, LevelHeight = Height;;)
+		{
+			SStreamedLevel Level;
+			Level.Width = LevelWidth;
+			Level.Height = Level.RowCount = LevelHeight;
+			Level.RowPitch = LevelWidth * TexelSize;
+			if (!pImage->Levels.empty())
+				MipDataSize += Level.RowPitch * LevelHeight;
+			pImage->Levels.push_back(Level);
+			if (LevelWidth == 1 && LevelHeight == 1)
+				break;
+			LevelWidth = std::max(LevelWidth / 2, 1);
+			LevelHeight = std::max(LevelHeight / 2, 1);
+		}
+
+		pImage->MipData.resize(MipDataSize);
+		pImage->Levels[0].pData = static_cast<const GLubyte*>(pPixels);
+		GLubyte* pMipData = pImage->MipData.data();
+		for (size_t i = 1; i < pImage->Levels.size(); ++i)
+		{
+			const SStreamedLevel& Source = pImage->Levels[i - 1];
+			if (vIsHDR)
+				downsampleLevel(reinterpret_cast<const float*>(Source.pData), Source.Width, Source.Height, ChannelCount, reinterpret_cast<float*>(pMipData));
+			else
+				downsampleLevel(Source.pData, Source.Width, Source.Height, ChannelCount, pMipData);
+			pImage->Levels[i].pData = pMipData;
+			pMipData += pImage->Levels[i].RowPitch * pImage->Levels[i].Height;
+		}
+		return pImage;
+	}
+
+	//the levels the file has, compressed or not; a file without mips streams its one level
+	std::shared_ptr<SStreamedImage> decodeDDSImage(const std::vector<char>& vFileData)
+	{
+		auto pTexture = std::make_shared<gli::texture>(gli::load(vFileData.data(), vFileData.size()));
+		if (pTexture->empty() || pTexture->target() != gli::TARGET_2D)
+			return nullptr;
+		auto pImage = std::make_shared<SStreamedImage>();
+		gli::gl GL(gli::gl::PROFILE_GL33);
+		const gli::gl::format GLIFormat = GL.translate(pTexture->format(), pTexture->swizzles());
+		pImage->InternalFormat = GLIFormat.Internal;
+		pImage->ExternalFormat = GLIFormat.External;
+		pImage->DataType = GLIFormat.Type;
+		pImage->IsCompressed = gli::is_compressed(pTexture->format());
+		const gli::extent3d BlockExtent = gli::block_extent(pTexture->format());
+		const size_t BlockSize = gli::block_size(pTexture->format());
+		pImage->BlockHeight = BlockExtent.y;
+		for (size_t i = 0; i < pTexture->levels(); ++i)
+		{
+			const gli::extent3d Extent = pTexture->extent(i);
+			SStreamedLevel Level;
+			Level.Width = Extent.x;
+			Level.Height = Extent.y;
+			Level.RowCount = (Extent.y + BlockExtent.y - 1) / BlockExtent.y;
+			Level.RowPitch = (Extent.x + BlockExtent.x - 1) / BlockExtent.x * BlockSize;
+			Level.pData = static_cast<const GLubyte*>(pTexture->data(0, 0, i));
+			pImage->Levels.push_back(Level);
+		}
+		pImage->pPixelOwner = pTexture;
+		return pImage;
+	}
+
+	std::shared_ptr<SStreamedImage> decodeImage(const std::string& vFilePath, const std::vector<char>& vFileData)
+	{
+		const size_t DotPosition = vFilePath.find_last_of('.');
+		const std::string Extension = DotPosition == std::string::npos ? std::string() : vFilePath.substr(DotPosition + 1);
+		if (Extension == "dds")
+			return decodeDDSImage(vFileData);
+		return decodeCommonImage(vFileData, Extension == "hdr");
+	}
+
+	size_t computeLevelSize(const SStreamedLevel& vLevel)
+	{
+		return vLevel.RowCount * vLevel.RowPitch;
+	}
+}
+
+CTextureStreamer::CTextureStreamer(const std::shared_ptr<CJobSystem>& vJobSystem, size_t vUploadBudget) : m_pJobSystem(vJobSystem), m_UploadBudget(vUploadBudget)
+{
+	_ASSERT(vJobSystem);
+	m_pJobs = vJobSystem->createGroup();
+	m_pDecodedQueue = std::make_shared<STextureStreamQueue>();
+}
+
+CTextureStreamer::~CTextureStreamer()
+{
+	m_pJobs->cancel();
+	for (SRingPart& Part : m_RingParts)
+	{
+		if (Part.Fence)
+			glDeleteSync(Part.Fence);
+	}
+	if (m_UploadBuffer)
+		glDeleteBuffers(1, &m_UploadBuffer);
+	for (const auto& Texture : m_Textures)
+		fetchGLStateCache().deleteTextures(1, &Texture.second);
+}
+
+//************************************************************************************
+//Function:
+uint64_t CTextureStreamer::hashContent(const char* vData, size_t vSize)
+{
+	uint64_t Hash = 14695981039346656037ull;
+	for (size_t i = 0; i < vSize; ++i)
+		Hash = (Hash ^ static_cast<unsigned char>(vData[i])) * 1099511628211ull;
+	return Hash;
+}
+
+//************************************************************************************
+//Function: the placeholder is level 0 until the decoded levels replace it, see __startStream
+GLuint CTextureStreamer::requestTexture(uint64_t vContentHash, const std::string& vFilePath, const std::shared_ptr<const std::vector<char>>& vFileData, const GLubyte vPlaceholder[4])
+{
+	++m_RequestCount;
+	auto Iter = m_Textures.find(vContentHash);
+	if (Iter != m_Textures.end())
+	{
+		++m_CacheHitCount;
+		return Iter->second;
+	}
+
+	GLuint TextureID = 0;
+	glGenTextures(1, &TextureID);
+	glBindTexture(GL_TEXTURE_2D, TextureID);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, vPlaceholder);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	m_Textures.emplace(vContentHash, TextureID);
+
+	if (!m_IsStreaming)
+	{
+		m_IsStreaming = true;
+		m_LastFrameTime = std::chrono::steady_clock::now();
+	}
+	++m_PendingDecodeCount;
+	std::shared_ptr<STextureStreamQueue> pQueue = m_pDecodedQueue;
+	m_pJobSystem->submit(m_pJobs, [pQueue, TextureID, vFilePath, vFileData]()
+	{
+		STextureStreamQueue::SDecodedTexture Decoded;
+		Decoded.TextureID = TextureID;
+		Decoded.FilePath = vFilePath;
+		if (vFileData && !vFileData->empty())
+			Decoded.pImage = decodeImage(vFilePath, *vFileData);
+		std::lock_guard<std::mutex> Lock(pQueue->Mutex);
+		pQueue->DecodedTextures.push_back(std::move(Decoded));
+	});
+	return TextureID;
+}
+
+//************************************************************************************
+//Function: every texture gets its mip tail before any gets a larger level, the stream with the smallest next level goes first
+void CTextureStreamer::update()
+{
+	if (!m_IsStreaming)
+		return;
+
+	std::vector<STextureStreamQueue::SDecodedTexture> DecodedTextures;
+	{
+		std::lock_guard<std::mutex> Lock(m_pDecodedQueue->Mutex);
+		DecodedTextures.swap(m_pDecodedQueue->DecodedTextures);
+	}
+	for (auto& Decoded : DecodedTextures)
+	{
+		--m_PendingDecodeCount;
+		if (!Decoded.pImage || Decoded.pImage->Levels.empty())
+		{
+			std::cerr << "Error::TextureStreamer:: " << Decoded.FilePath << " can't be decoded, it keeps its placeholder" << std::endl;
+			continue;
+		}
+		SStream Stream;
+		Stream.TextureID = Decoded.TextureID;
+		Stream.pImage = std::move(Decoded.pImage);
+		Stream.NextLevel = static_cast<int>(Stream.pImage->Levels.size()) - 1;
+		m_Streams.push_back(std::move(Stream));
+	}
+
+	const auto UploadStartTime = std::chrono::steady_clock::now();
+	size_t UploadBytes = 0;
+	if (!m_Streams.empty())
+	{
+		__reserveUploadRing();
+		SRingPart& Part = m_RingParts[m_Frame % UPLOAD_RING_SIZE];
+		if (Part.Fence && glClientWaitSync(Part.Fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+		{
+			++m_BusyRingFrameCount;
+		}
+		else
+		{
+			if (Part.Fence)
+			{
+				glDeleteSync(Part.Fence);
+				Part.Fence = nullptr;
+			}
+			const size_t PartOffset = (m_Frame % UPLOAD_RING_SIZE) * m_RingPartSize;
+			if (m_pUploadData)
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_UploadBuffer);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			while (!m_Streams.empty())
+			{
+				//offsets into the unpack buffer stay aligned for every data type
+				UploadBytes = (UploadBytes + 15) & ~size_t(15);
+				if (UploadBytes >= m_UploadBudget)
+					break;
+				auto Iter = std::min_element(m_Streams.begin(), m_Streams.end(), [](const SStream& vLeft, const SStream& vRight)
+				{
+					return computeLevelSize(vLeft.pImage->Levels[vLeft.NextLevel]) < computeLevelSize(vRight.pImage->Levels[vRight.NextLevel]);
+				});
+				const size_t Size = __uploadRows(*Iter, m_UploadBudget - UploadBytes, PartOffset + UploadBytes, UploadBytes == 0);
+				if (Size == 0)
+					break;
+				UploadBytes += Size;
+				if (Iter->NextLevel < 0)
+				{
+					++m_StreamedTextureCount;
+					m_Streams.erase(Iter);
+				}
+			}
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+			if (m_pUploadData)
+			{
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+				Part.Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+				++m_Frame;
+			}
+		}
+	}
+	__recordFrame(computeElapsedMs(UploadStartTime), UploadBytes);
+}
+
+//************************************************************************************
+//Function: one part per frame of m_UploadBudget bytes, rebuilt when the budget changes
+void CTextureStreamer::__reserveUploadRing()
+{
+	if (!GLEW_ARB_buffer_storage || m_RingPartSize == m_UploadBudget)
+		return;
+	for (SRingPart& Part : m_RingParts)
+	{
+		if (Part.Fence)
+		{
+			glClientWaitSync(Part.Fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+			glDeleteSync(Part.Fence);
+			Part.Fence = nullptr;
+		}
+	}
+	if (m_UploadBuffer)
+		glDeleteBuffers(1, &m_UploadBuffer);
+
+	m_RingPartSize = m_UploadBudget;
+	const GLbitfield Flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glGenBuffers(1, &m_UploadBuffer);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_UploadBuffer);
+	glBufferStorage(GL_PIXEL_UNPACK_BUFFER, m_RingPartSize * UPLOAD_RING_SIZE, nullptr, Flags);
+	m_pUploadData = static_cast<GLubyte*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, m_RingPartSize * UPLOAD_RING_SIZE, Flags));
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	if (!m_pUploadData)
+		std::cerr << "Error::TextureStreamer:: the upload ring can't be mapped, textures are uploaded from memory" << std::endl;
+}
+
+//************************************************************************************
+//Function: every level is specified at once and the placeholder is gone, GL_TEXTURE_BASE_LEVEL hides the levels without data yet
+void CTextureStreamer::__startStream(SStream& vioStream)
+{
+	const SStreamedImage& Image = *vioStream.pImage;
+	const GLint LevelCount = static_cast<GLint>(Image.Levels.size());
+	if (m_pUploadData)
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glBindTexture(GL_TEXTURE_2D, vioStream.TextureID);
+	for (GLint i = 0; i < LevelCount; ++i)
+	{
+		const SStreamedLevel& Level = Image.Levels[i];
+		if (Image.IsCompressed)
+			glCompressedTexImage2D(GL_TEXTURE_2D, i, Image.InternalFormat, Level.Width, Level.Height, 0, static_cast<GLsizei>(computeLevelSize(Level)), nullptr);
+		else
+			glTexImage2D(GL_TEXTURE_2D, i, Image.InternalFormat, Level.Width, Level.Height, 0, Image.ExternalFormat, Image.DataType, nullptr);
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, LevelCount - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, LevelCount - 1);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	if (m_pUploadData)
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_UploadBuffer);
+	vioStream.IsStarted = true;
+}
+
+//************************************************************************************
+//Function: as many rows of the next level as vByteBudget holds; a stream only starts when its whole mip tail fits,
+//the texture is never sampled between __startStream and its first level. The first upload of a frame takes at least
+//one row, so a row wider than the whole budget still goes up, from memory since it can't fit in its ring part
+size_t CTextureStreamer::__uploadRows(SStream& vioStream, size_t vByteBudget, size_t vRingOffset, bool vIsFirstUpload)
+{
+	const SStreamedImage& Image = *vioStream.pImage;
+	const SStreamedLevel& Level = Image.Levels[vioStream.NextLevel];
+	if (!vioStream.IsStarted)
+	{
+		if (computeLevelSize(Level) > vByteBudget && !vIsFirstUpload)
+			return 0;
+		__startStream(vioStream);
+	}
+	GLsizei RowCount = static_cast<GLsizei>(std::min<size_t>(Level.RowCount - vioStream.NextRow, vByteBudget / Level.RowPitch));
+	if (RowCount <= 0 && vIsFirstUpload)
+		RowCount = 1;
+	if (RowCount <= 0)
+		return 0;
+
+	const size_t Size = RowCount * Level.RowPitch;
+	const GLubyte* pSource = Level.pData + vioStream.NextRow * Level.RowPitch;
+	const GLvoid* pPixels = pSource;
+	const bool IsFromRing = m_pUploadData && Size <= vByteBudget;
+	if (IsFromRing)
+	{
+		std::memcpy(m_pUploadData + vRingOffset, pSource, Size);
+		pPixels = reinterpret_cast<const GLvoid*>(vRingOffset);
+	}
+	else if (m_pUploadData)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+	const GLint OffsetY = vioStream.NextRow * Image.BlockHeight;
+	const GLsizei Height = std::min(RowCount * Image.BlockHeight, Level.Height - OffsetY);
+	glBindTexture(GL_TEXTURE_2D, vioStream.TextureID);
+	if (Image.IsCompressed)
+		glCompressedTexSubImage2D(GL_TEXTURE_2D, vioStream.NextLevel, 0, OffsetY, Level.Width, Height, Image.InternalFormat, static_cast<GLsizei>(Size), pPixels);
+	else
+		glTexSubImage2D(GL_TEXTURE_2D, vioStream.NextLevel, 0, OffsetY, Level.Width, Height, Image.ExternalFormat, Image.DataType, pPixels);
+
+	if (m_pUploadData && !IsFromRing)
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_UploadBuffer);
+
+	vioStream.NextRow += RowCount;
+	if (vioStream.NextRow == Level.RowCount)
+	{
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, vioStream.NextLevel);
+		--vioStream.NextLevel;
+		vioStream.NextRow = 0;
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return Size;
+}
+
+//************************************************************************************
+//Function: frame times count from one update to the next while anything is requested, decoded or uploaded
+void CTextureStreamer::__recordFrame(double vUploadMs, size_t vUploadBytes)
+{
+	const auto Now = std::chrono::steady_clock::now();
+	const double FrameMs = std::chrono::duration<double, std::milli>(Now - m_LastFrameTime).count();
+	m_LastFrameTime = Now;
+	++m_StreamingFrameCount;
+	m_FrameMsSum += FrameMs;
+	m_MaxFrameMs = std::max(m_MaxFrameMs, FrameMs);
+	m_MaxUploadMs = std::max(m_MaxUploadMs, vUploadMs);
+	m_UploadedBytes += vUploadBytes;
+	m_MaxFrameUploadBytes = std::max(m_MaxFrameUploadBytes, vUploadBytes);
+	if (!isIdle())
+		return;
+
+	std::cout << "TextureStreamer:: " << m_StreamedTextureCount << " textures streamed for " << m_RequestCount << " requests (" << m_CacheHitCount << " cache hits), "
+		<< m_UploadedBytes / 1024 << " KB over " << m_StreamingFrameCount << " frames, at most " << m_MaxFrameUploadBytes / 1024 << " KB and " << m_MaxUploadMs
+		<< " ms of uploads a frame, frames took " << m_FrameMsSum / m_StreamingFrameCount << " ms on average and " << m_MaxFrameMs << " ms at most, "
+		<< m_BusyRingFrameCount << " frames skipped on a busy upload ring" << std::endl;
+	m_IsStreaming = false;
+	m_RequestCount = m_CacheHitCount = m_StreamedTextureCount = m_StreamingFrameCount = m_BusyRingFrameCount = 0;
+	m_UploadedBytes = m_MaxFrameUploadBytes = 0;
+	m_MaxUploadMs = m_FrameMsSum = m_MaxFrameMs = 0.0;
+}
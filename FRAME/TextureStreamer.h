@@ -0,0 +1,98 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) Elay Pu. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+#include <GL/glew.h>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class CJobSystem;
+class CJobGroup;
+struct STextureStreamQueue;
+struct SStreamedImage;
+
+//One texture cache for every model, keyed by a hash of the file content, so the same image under two paths or in two
+//models is decoded and uploaded once. requestTexture hands out the GL texture at once, holding a 1x1 placeholder texel.
+//A job decodes the file from memory and builds the whole mip chain on the CPU; update() then uploads it smallest level
+//first, at most the upload budget per frame, and moves GL_TEXTURE_BASE_LEVEL down as each level completes, so a texture
+//shows its mip tail a frame after decoding and sharpens as the larger levels land. Levels larger than what is left of
+//the budget go up in bands of rows.
+//Uploads go through a persistently mapped pixel unpack buffer of UPLOAD_RING_SIZE frames, each part fenced; a frame
+//whose part the GPU still reads skips streaming instead of waiting. Without GL_ARB_buffer_storage the same budget is
+//uploaded from the decoded memory directly.
+class CTextureStreamer
+{
+public:
+	static const size_t DEFAULT_UPLOAD_BUDGET = 8 << 20;	//bytes per frame
+	static const size_t UPLOAD_RING_SIZE = 3;
+
+	explicit CTextureStreamer(const std::shared_ptr<CJobSystem>& vJobSystem, size_t vUploadBudget = DEFAULT_UPLOAD_BUDGET);
+	~CTextureStreamer();
+
+	CTextureStreamer(const CTextureStreamer&) = delete;
+	CTextureStreamer& operator=(const CTextureStreamer&) = delete;
+
+	static uint64_t hashContent(const char* vData, size_t vSize);	//FNV-1a
+
+	//Context thread only. vFilePath picks the decoder by its extension and names the texture in messages, vFileData is
+	//not needed once the call returns when the content is cached already. vPlaceholder is RGBA8.
+	GLuint requestTexture(uint64_t vContentHash, const std::string& vFilePath, const std::shared_ptr<const std::vector<char>>& vFileData, const GLubyte vPlaceholder[4]);
+	void update();	//context thread, once per frame
+	bool isIdle() const { return m_PendingDecodeCount == 0 && m_Streams.empty(); }
+
+	void setUploadBudget(size_t vUploadBudget) { m_UploadBudget = vUploadBudget; }
+	size_t getTextureCount() const { return m_Textures.size(); }
+
+private:
+	struct SStream
+	{
+		GLuint TextureID = 0;
+		std::shared_ptr<SStreamedImage> pImage;
+		int NextLevel = 0;	//counts down, done below 0
+		GLsizei NextRow = 0;	//a row of SStreamedLevel
+		bool IsStarted = false;
+	};
+
+	struct SRingPart
+	{
+		GLsync Fence = nullptr;
+	};
+
+	void __reserveUploadRing();
+	void __startStream(SStream& vioStream);
+	size_t __uploadRows(SStream& vioStream, size_t vByteBudget, size_t vRingOffset, bool vIsFirstUpload);
+	void __recordFrame(double vUploadMs, size_t vUploadBytes);
+
+	std::shared_ptr<CJobSystem> m_pJobSystem;
+	std::shared_ptr<CJobGroup> m_pJobs;
+	std::shared_ptr<STextureStreamQueue> m_pDecodedQueue;	//filled by the decode jobs
+	std::unordered_map<uint64_t, GLuint> m_Textures;	//content hash to texture, textures are never freed
+	std::vector<SStream> m_Streams;
+	size_t m_PendingDecodeCount = 0;
+	size_t m_UploadBudget = DEFAULT_UPLOAD_BUDGET;
+
+	GLuint m_UploadBuffer = 0;
+	GLubyte* m_pUploadData = nullptr;	//persistently mapped, UPLOAD_RING_SIZE parts of m_RingPartSize
+	size_t m_RingPartSize = 0;
+	SRingPart m_RingParts[UPLOAD_RING_SIZE];
+	uint64_t m_Frame = 0;
+
+	//since streaming last started, logged when it goes idle
+	std::chrono::steady_clock::time_point m_LastFrameTime;
+	bool m_IsStreaming = false;
+	unsigned m_RequestCount = 0;
+	unsigned m_CacheHitCount = 0;
+	unsigned m_StreamedTextureCount = 0;
+	unsigned m_StreamingFrameCount = 0;
+	unsigned m_BusyRingFrameCount = 0;
+	size_t m_UploadedBytes = 0;
+	size_t m_MaxFrameUploadBytes = 0;
+	double m_MaxUploadMs = 0.0;
+	double m_FrameMsSum = 0.0;
+	double m_MaxFrameMs = 0.0;
+};
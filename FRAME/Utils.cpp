@@ -3,6 +3,7 @@
 //--------------------------------------------------------------------------------------
 
 #include "Utils.h"
+#include "GLStateCache.h"
 #include <initializer_list>
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
@@ -48,6 +49,38 @@ GLint createVAO(const GLvoid* vVertices, GLint vVerticesSize, std::initializer_l
 	return VAO;
 }
 
+//************************************************************************************
+//Function:
+GLint createVAO(const GLvoid* vVertices, GLint vVerticesSize, std::initializer_list<SVertexAttribute> vAttribs, GLint vStride, const GLvoid* vIndices, GLint vIndicesSize, int *voVBO)
+{
+	GLint VAO = 0, VBO = 0, EBO = 0;
+	glGenVertexArrays(1, &(GLuint&)VAO);
+	glBindVertexArray(VAO);
+	VBO = genBuffer(GL_ARRAY_BUFFER, vVerticesSize, vVertices, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	if (vIndices)
+	{
+		EBO = genBuffer(GL_ELEMENT_ARRAY_BUFFER, vIndicesSize, vIndices, GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	}
+	GLint i = 0;
+	for (const auto& Attrib : vAttribs)
+	{
+		glEnableVertexAttribArray(i);
+		if (Attrib.IsInteger)
+			glVertexAttribIPointer(i, Attrib.Size, Attrib.Type, vStride, (GLvoid*)(intptr_t)Attrib.Offset);
+		else
+			glVertexAttribPointer(i, Attrib.Size, Attrib.Type, Attrib.IsNormalized, vStride, (GLvoid*)(intptr_t)Attrib.Offset);
+		++i;
+	}
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	if (voVBO)
+		*voVBO = VBO;
+	return VAO;
+}
+
 //************************************************************************************
 //Function:
 GLint createVAO(int vBufferIndex, std::initializer_list<GLint> vAttribsLength, GLenum vDataType)
@@ -278,7 +311,26 @@ GLvoid  updateSSBOBuffer(GLint BufferID, GLsizeiptr vSize, const GLvoid *vData,
 {
 	glBindBuffer(GL_SHADER_STORAGE_BUFFER, BufferID);
 	glBufferData(GL_SHADER_STORAGE_BUFFER, vSize, vData, vUsage);
+	++fetchDriverCallCounters().BufferUploads;
+}
+//************************************************************************************
+//Function: the whole block in one glBufferSubData
+GLvoid updateUniformBuffer(GLint vBufferID, GLsizeiptr vSize, const GLvoid* vData)
+{
+	glBindBuffer(GL_UNIFORM_BUFFER, vBufferID);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, vSize, vData);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	++fetchDriverCallCounters().BufferUploads;
 }
+
+//************************************************************************************
+//Function:
+ElayGraphics::SDriverCallCounters& fetchDriverCallCounters()
+{
+	static ElayGraphics::SDriverCallCounters Counters;
+	return Counters;
+}
+
 //************************************************************************************
 //Function:
 void transferData2Buffer(GLenum vTarget,GLint vTargetID,std::vector<GLintptr> vOffsets, std::vector<GLsizeiptr> vSizes,std::vector<const GLvoid*> vDatas)
@@ -290,6 +342,7 @@ void transferData2Buffer(GLenum vTarget,GLint vTargetID,std::vector<GLintptr> vO
 	{
 		glBufferSubData(vTarget, vOffsets[i], vSizes[i], vDatas[i]);
 	}
+	fetchDriverCallCounters().BufferUploads += OffsetSize;
 	glBindBuffer(vTarget, 0);
 }
 
@@ -363,7 +416,7 @@ GLvoid genTexture(std::shared_ptr<ElayGraphics::STexture> vioTexture)
 		glGenerateMipmap(TextureType);
 	glBindTexture(TextureType, 0);
 	if (vioTexture->ImageBindUnit != -1)
-		glBindImageTexture(vioTexture->ImageBindUnit, TextureID, 0, GL_FALSE, 0, GL_READ_WRITE, vioTexture->InternalFormat);
+		fetchGLStateCache().bindImageTexture(vioTexture->ImageBindUnit, TextureID, 0, vioTexture->isLayeredImage(), 0, GL_READ_WRITE, vioTexture->InternalFormat);
 	vioTexture->TextureID = TextureID;
 }
 
@@ -510,28 +563,36 @@ GLvoid loadCubeTextureFromFile(const std::vector<std::string>& vFilePath, std::s
 	genTexture(voTexture2D);
 }
 //************************************************************************************
-//Function:
-GLvoid loadTextureFromFile(const std::string& vFilePath, std::shared_ptr<ElayGraphics::STexture> voTexture2D)
+//Function: stbi pixels are freed and the gli texture is destroyed when the returned owner goes away
+std::shared_ptr<void> decodeTextureFromFile(const std::string& vFilePath, std::shared_ptr<ElayGraphics::STexture> voTexture2D)
 {
-	GLint ImageWidth = 0, ImageHeight = 0;
-	
 	std::vector<std::string> SplitStringSet;
-	boost::split(SplitStringSet, vFilePath, boost::is_any_of(".")); 
-	bool IsUseStbi = true;
-	gli::texture GLITexture;
+	boost::split(SplitStringSet, vFilePath, boost::is_any_of("."));
+	std::shared_ptr<void> pPixelOwner;
 	if (*(SplitStringSet.end() - 1) == "dds")
 	{
-		configureDDSTexture(vFilePath, GLITexture, voTexture2D);
-		IsUseStbi = false;
+		auto pGLITexture = std::make_shared<gli::texture>();
+		configureDDSTexture(vFilePath, *pGLITexture, voTexture2D);
+		pPixelOwner = pGLITexture;
 	}
-	else if (*(SplitStringSet.end() - 1) == "hdr")
-		configureHDRTexture(vFilePath, voTexture2D);
 	else
-		configureCommonTexture(vFilePath, voTexture2D);
+	{
+		if (*(SplitStringSet.end() - 1) == "hdr")
+			configureHDRTexture(vFilePath, voTexture2D);
+		else
+			configureCommonTexture(vFilePath, voTexture2D);
+		pPixelOwner = std::shared_ptr<void>(voTexture2D->pDataSet[0], [](void* vPixels) { stbi_image_free(vPixels); });
+	}
 	voTexture2D->isMipmap = true;
-	genTexture(voTexture2D);
+	return pPixelOwner;
+}
 
-	if (IsUseStbi) stbi_image_free(voTexture2D->pDataSet[0]);
+//************************************************************************************
+//Function:
+GLvoid loadTextureFromFile(const std::string& vFilePath, std::shared_ptr<ElayGraphics::STexture> voTexture2D)
+{
+	std::shared_ptr<void> pPixelOwner = decodeTextureFromFile(vFilePath, voTexture2D);
+	genTexture(voTexture2D);
 }
 
 //************************************************************************************
@@ -548,7 +609,7 @@ GLint genFBO(const std::initializer_list< std::shared_ptr<ElayGraphics::STexture
 {
 	GLint FBO;
 	glGenFramebuffers(1, &(GLuint&)FBO);
-	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+	fetchGLStateCache().bindFramebuffer(GL_FRAMEBUFFER, FBO);
 	GLint i = -1;
 	GLboolean HasDepthTextureAttachment = GL_FALSE, HasStencilTextureAttachment = GL_FALSE;
 	std::vector<GLenum> Attachments;
@@ -643,7 +704,7 @@ GLint genFBO(const std::initializer_list< std::shared_ptr<ElayGraphics::STexture
 	{
 		std::cerr << "Error::FBO:: Framebuffer Is Not Complete." << glCheckFramebufferStatus(GL_FRAMEBUFFER) << std::endl;
 	}
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	fetchGLStateCache().bindFramebuffer(GL_FRAMEBUFFER, 0);
 	return FBO;
 }
 
@@ -705,13 +766,12 @@ void blitFrameBufferTexture(std::shared_ptr<ElayGraphics::STexture> vioSrcTextur
 		genFBO({ vioDestTexture });
 
 	glColorMaski(vioDestTexture->FrameBufferID, vChannels[0], vChannels[1], vChannels[2], vChannels[3]);
-	glBindFramebuffer(GL_READ_FRAMEBUFFER, vioSrcTexture->FrameBufferID);
+	fetchGLStateCache().bindFramebuffer(GL_READ_FRAMEBUFFER, vioSrcTexture->FrameBufferID);
 	glReadBuffer(GL_COLOR_ATTACHMENT0 + vioSrcTexture->AttachmentID);
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, vioDestTexture->FrameBufferID);
+	fetchGLStateCache().bindFramebuffer(GL_DRAW_FRAMEBUFFER, vioDestTexture->FrameBufferID);
 	glDrawBuffer(GL_COLOR_ATTACHMENT0 + vioDestTexture->AttachmentID);
 	glBlitFramebuffer(0, 0, vioSrcTexture->Width, vioSrcTexture->Height, 0, 0, vioSrcTexture->Width, vioSrcTexture->Height, GL_COLOR_BUFFER_BIT, vFilter);
 
 	glColorMaski(vioDestTexture->FrameBufferID, true, true, true, true);
-	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	fetchGLStateCache().bindFramebuffer(GL_FRAMEBUFFER, 0);
 }
\ No newline at end of file
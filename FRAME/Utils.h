@@ -13,7 +13,20 @@
 
 #define SAFE_DELETE(p) if(p){ delete p; p = nullptr; }
 
+//One attribute of an interleaved vertex, Offset in bytes. IsInteger feeds ivec/uvec inputs through glVertexAttribIPointer,
+//IsNormalized maps integer types to [0, 1] or [-1, 1] floats. The overload taking these accepts GLushort or GLuint
+//indices, vIndicesSize is in bytes either way.
+struct SVertexAttribute
+{
+	GLint		Size = 0;
+	GLenum		Type = GL_FLOAT;
+	GLboolean	IsNormalized = GL_FALSE;
+	GLboolean	IsInteger = GL_FALSE;
+	GLint		Offset = 0;
+};
+
 FRAME_DLLEXPORTS GLint  createVAO(const GLvoid* vVertices, GLint vVerticesSize, std::initializer_list<GLint> vAttribsLength, const GLint vIndices[] = nullptr, GLint vIndicesSize = 0, int *voVBO = nullptr);
+FRAME_DLLEXPORTS GLint  createVAO(const GLvoid* vVertices, GLint vVerticesSize, std::initializer_list<SVertexAttribute> vAttribs, GLint vStride, const GLvoid* vIndices = nullptr, GLint vIndicesSize = 0, int *voVBO = nullptr);
 FRAME_DLLEXPORTS GLint  createVAO(int vBufferIndex, std::initializer_list<GLint> vAttribsLength, GLenum vDataType = GL_FLOAT);
 FRAME_DLLEXPORTS GLint  genBuffer(GLenum vTarget, GLsizeiptr vSize, const GLvoid *vData, GLenum vUsage, GLint vBindingIndex = -1);
 FRAME_DLLEXPORTS GLvoid getSSBOBuffer(GLint BufferID, GLsizeiptr vSize, GLvoid **vData);
@@ -23,6 +36,7 @@ FRAME_DLLEXPORTS GLvoid genTextureByBuffer(std::shared_ptr<ElayGraphics::STextur
 FRAME_DLLEXPORTS GLvoid genGenerateMipmap(std::shared_ptr<ElayGraphics::STexture> vioTexture);
 FRAME_DLLEXPORTS GLvoid ClearTexture(std::shared_ptr<ElayGraphics::STexture> vioTexture, GLuint TextureType);
 FRAME_DLLEXPORTS GLvoid loadTextureFromFile(const std::string& vFilePath, std::shared_ptr<ElayGraphics::STexture> voTexture2D);
+FRAME_DLLEXPORTS std::shared_ptr<void> decodeTextureFromFile(const std::string& vFilePath, std::shared_ptr<ElayGraphics::STexture> voTexture2D);	//no GL call, keep the result alive until genTexture
 FRAME_DLLEXPORTS GLvoid loadCubeTextureFromFile(const std::vector<std::string>& vFilePath, std::shared_ptr<ElayGraphics::STexture> voTexture2D);
 FRAME_DLLEXPORTS GLint  createVAO4ScreenQuad();
 FRAME_DLLEXPORTS GLint  createVAO4Cube();
@@ -31,6 +45,8 @@ FRAME_DLLEXPORTS void   drawQuad();
 FRAME_DLLEXPORTS void   drawCube();
 FRAME_DLLEXPORTS void   drawSphere();
 FRAME_DLLEXPORTS GLint  genFBO(const std::initializer_list<std::shared_ptr<ElayGraphics::STexture>>& vioTextureAttachments);
+FRAME_DLLEXPORTS GLvoid updateUniformBuffer(GLint vBufferID, GLsizeiptr vSize, const GLvoid* vData);
+FRAME_DLLEXPORTS ElayGraphics::SDriverCallCounters& fetchDriverCallCounters();
 FRAME_DLLEXPORTS void   transferData2Buffer(GLenum vTarget, GLint vTargetID, std::vector<GLintptr> vOffsets, std::vector<GLsizeiptr> vSizes, std::vector<const GLvoid*> vDatas);
 FRAME_DLLEXPORTS int    captureScreen2Img(const std::string& vFileName, int vQuality = 100.0);
 FRAME_DLLEXPORTS void   hueToRGB(float vHue, glm::vec4& voRGB);
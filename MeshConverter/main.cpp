@@ -0,0 +1,98 @@
+#include "MeshCache.h"
+#include "JobSystem.h"
+#include "TextureCompressor.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Offline mesh cache converter:
+//   MeshConverter <model directory> [--force]
+// writes <model>.emesh next to every model Assimp can read, so CModel maps it instead of importing,
+// and the block compressed <texture>.<format>.dds of every texture the models bind, which CModel
+// streams instead of the source when texture compression is on.
+namespace
+{
+	bool isModelFile(const std::filesystem::path& vPath)
+	{
+		static const char* ModelExtensions[] = { ".obj", ".fbx", ".gltf", ".glb", ".dae", ".ply", ".3ds", ".stl" };
+		std::string Extension = vPath.extension().string();
+		std::transform(Extension.begin(), Extension.end(), Extension.begin(), [](unsigned char vChar) { return static_cast<char>(std::tolower(vChar)); });
+		return std::find(std::begin(ModelExtensions), std::end(ModelExtensions), Extension) != std::end(ModelExtensions);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		std::cerr << "Usage: MeshConverter <model directory> [--force]" << std::endl;
+		return 1;
+	}
+	const std::filesystem::path Directory = argv[1];
+	const bool IsForced = argc > 2 && std::string(argv[2]) == "--force";
+	if (!std::filesystem::is_directory(Directory))
+	{
+		std::cerr << "Error::MeshConverter:: " << Directory.string() << " is not a directory" << std::endl;
+		return 1;
+	}
+
+	const auto pJobSystem = std::make_shared<CJobSystem>();
+	unsigned ConvertedCount = 0, SkippedCount = 0, FailedCount = 0;
+	unsigned TextureCount = 0, TextureFailedCount = 0;
+	std::unordered_set<std::string> VisitedTexturePaths;	//textures shared by several models are transcoded once
+	for (const auto& Entry : std::filesystem::recursive_directory_iterator(Directory))
+	{
+		if (!Entry.is_regular_file() || !isModelFile(Entry.path()))
+			continue;
+
+		// the same '/' separated path CModel is given, so the cache lands where it looks for it
+		const std::string ModelPath = Entry.path().generic_string();
+		std::vector<std::vector<SMeshTextureBinding>> MeshTextureBindings;
+		const std::shared_ptr<CMeshCache> pMeshCache = IsForced ? nullptr : CMeshCache::open(ModelPath);
+		if (pMeshCache)
+		{
+			for (size_t i = 0; i < pMeshCache->getMeshCount(); ++i)
+				MeshTextureBindings.push_back(pMeshCache->getTextures(i));
+			SkippedCount++;
+		}
+		else
+		{
+			const auto StartTime = std::chrono::steady_clock::now();
+			std::vector<SMeshData> Meshes;
+			if (!CMeshCache::importModel(ModelPath, Meshes, pJobSystem) || !CMeshCache::write(ModelPath, Meshes))
+			{
+				FailedCount++;
+				continue;
+			}
+			const double ElapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - StartTime).count();
+			std::cout << ModelPath << ": " << Meshes.size() << " meshes, " << std::filesystem::file_size(CMeshCache::getCachePath(ModelPath)) << " bytes in " << ElapsedMs << " ms" << std::endl;
+			ConvertedCount++;
+			for (const SMeshData& Mesh : Meshes)
+				MeshTextureBindings.push_back(Mesh.Textures);
+		}
+
+		for (const auto& Bindings : MeshTextureBindings)
+		{
+			for (const SMeshTextureBinding& Binding : Bindings)
+			{
+				if (Binding.TexturePath.empty() || !CTextureCompressor::isCompressible(Binding.TexturePath) || !VisitedTexturePaths.insert(Binding.TexturePath).second)
+					continue;
+				std::string CachePath;
+				std::vector<char> FileData;
+				if (CTextureCompressor::loadOrCompress(Binding.TexturePath, CTextureCompressor::getTextureUsage(Binding.TextureUniformName), pJobSystem, IsForced, CachePath, FileData))
+					TextureCount++;
+				else
+					TextureFailedCount++;
+			}
+		}
+	}
+
+	std::cout << "MeshConverter:: " << ConvertedCount << " converted, " << SkippedCount << " up to date, " << FailedCount << " failed; "
+		<< TextureCount << " textures compressed or up to date, " << TextureFailedCount << " failed" << std::endl;
+	return FailedCount == 0 && TextureFailedCount == 0 ? 0 : 1;
+}
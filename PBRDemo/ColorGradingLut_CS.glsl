@@ -0,0 +1,764 @@
+#version 430 core
+
+precision highp float;
+
+// GPU port of the color grading LUT build in ColorGradingPass.cpp. One invocation
+// per LUT texel, the scalar CPU chain (gradeTexel, toneMapLutSlice, outputLutSlice)
+// is the reference this must match.
+
+#define LOCAL_GROUP_SIZE 4
+layout (local_size_x = LOCAL_GROUP_SIZE, local_size_y = LOCAL_GROUP_SIZE, local_size_z = LOCAL_GROUP_SIZE) in;
+
+layout (rgba16f, binding = 0) uniform writeonly image3D u_Lut;
+
+// Same values as CColorGradingPass::ToneMapping
+#define TONE_MAPPER_LINEAR          0
+#define TONE_MAPPER_ACES_LEGACY     1
+#define TONE_MAPPER_ACES            2
+#define TONE_MAPPER_FILMIC          3
+#define TONE_MAPPER_AGX             4
+#define TONE_MAPPER_GENERIC         5
+#define TONE_MAPPER_DISPLAY_RANGE   6
+
+#define AGX_LOOK_NONE    0
+#define AGX_LOOK_PUNCHY  1
+#define AGX_LOOK_GOLDEN  2
+
+#define FLT_MIN     1.175494351e-38
+#define FLT_MAX     3.402823466e+38
+#define HALF_MAX    65504.0
+
+uniform int u_LutDimension;
+uniform bool u_HasAdjustments;
+uniform float u_Exposure;
+uniform float u_NightAdaptation;
+// mat3 uploaded in the upper left corner of a mat4
+uniform mat4 u_ColorGradingIn;
+uniform mat4 u_AdaptationTransform;
+uniform vec3 u_ColorGradingLuminance;
+uniform vec3 u_OutRed;
+uniform vec3 u_OutGreen;
+uniform vec3 u_OutBlue;
+uniform vec3 u_Shadows;
+uniform vec3 u_Midtones;
+uniform vec3 u_Highlights;
+uniform vec4 u_TonalRanges;
+uniform vec3 u_Slope;
+uniform vec3 u_Offset;
+uniform vec3 u_Power;
+uniform float u_Contrast;
+uniform float u_Vibrance;
+uniform float u_Saturation;
+uniform vec3 u_ShadowGamma;
+uniform vec3 u_MidPoint;
+uniform vec3 u_HighlightScale;
+
+// getScotopicConstants()
+uniform vec3 u_ScotopicL;
+uniform vec3 u_ScotopicM;
+uniform vec3 u_ScotopicS;
+uniform vec3 u_ScotopicR;
+uniform vec3 u_ScotopicConeSensitivity;
+uniform vec3 u_ScotopicRodStrength;
+uniform mat4 u_ScotopicLMS_to_RGB;
+uniform mat4 u_ScotopicOpponent_to_LMS;
+uniform mat4 u_ScotopicWeightedRodResponse;
+
+uniform int u_ToneMapper;
+uniform int u_AgxLook;
+uniform vec4 u_GenericToneMapper;   // contrast, midGrayIn, midGrayOut, hdrMax
+uniform bool u_LuminanceScaling;
+uniform bool u_GamutMapping;
+uniform bool u_LinearOETF;
+
+//------------------------------------------------------------------------------
+// Color spaces, see ColorSpaceUtils.h
+//------------------------------------------------------------------------------
+
+const mat3 XYZ_to_sRGB = mat3(
+     3.2404542, -0.9692660,  0.0556434,
+    -1.5371385,  1.8760108, -0.2040259,
+    -0.4985314,  0.0415560,  1.0572252
+);
+
+const mat3 Rec2020_to_XYZ = mat3(
+    0.6369530,  0.2626983,  0.0000000,
+    0.1446169,  0.6780088,  0.0280731,
+    0.1688558,  0.0592929,  1.0608272
+);
+
+const mat3 XYZ_to_Rec2020 = mat3(
+     1.7166634, -0.6666738,  0.0176425,
+    -0.3556733,  1.6164557, -0.0427770,
+    -0.2533681,  0.0157683,  0.9422433
+);
+
+const mat3 AP1_to_XYZ = mat3(
+    0.6624541811,  0.2722287168, -0.0055746495,
+    0.1340042065,  0.6740817658,  0.0040607335,
+    0.1561876870,  0.0536895174,  1.0103391003
+);
+
+const mat3 XYZ_to_AP1 = mat3(
+     1.6410233797, -0.6636628587,  0.0117218943,
+    -0.3248032942,  1.6153315917, -0.0082844420,
+    -0.2364246952,  0.0167563477,  0.9883948585
+);
+
+const mat3 AP1_to_AP0 = mat3(
+     0.6954522414,  0.0447945634, -0.0055258826,
+     0.1406786965,  0.8596711185,  0.0040252103,
+     0.1638690622,  0.0955343182,  1.0015006723
+);
+
+const mat3 AP0_to_AP1 = mat3(
+     1.4514393161, -0.0765537734,  0.0083161484,
+    -0.2365107469,  1.1762296998, -0.0060324498,
+    -0.2149285693, -0.0996759264,  0.9977163014
+);
+
+const mat3 sRGB_to_OkLab_LMS = mat3(
+    0.4122214708, 0.2119034982, 0.0883024619,
+    0.5363325363, 0.6806995451, 0.2817188376,
+    0.0514459929, 0.1073969566, 0.6299787005
+);
+
+const mat3 OkLab_LMS_to_OkLab = mat3(
+     0.2104542553,  1.9779984951,  0.0259040371,
+     0.7936177850, -2.4285922050,  0.7827717662,
+    -0.0040720468,  0.4505937099, -0.8086757660
+);
+
+const mat3 OkLab_to_OkLab_LMS = mat3(
+    1.0000000000,  1.0000000000,  1.0000000000,
+    0.3963377774, -0.1055613458, -0.0894841775,
+    0.2158037573, -0.0638541728, -1.2914855480
+);
+
+const mat3 OkLab_LMS_to_sRGB = mat3(
+     4.0767416621, -1.2684380046, -0.0041960863,
+    -3.3077115913,  2.6097574011, -0.7034186147,
+     0.2309699292, -0.3413193965,  1.7076147010
+);
+
+const mat3 Rec2020_to_AP0 = AP1_to_AP0 * XYZ_to_AP1 * Rec2020_to_XYZ;
+const mat3 AP1_to_Rec2020 = XYZ_to_Rec2020 * AP1_to_XYZ;
+
+const vec3 LUMINANCE_Rec2020 = vec3(0.2627002, 0.6779981, 0.0593017);
+const vec3 LUMINANCE_AP1 = vec3(0.272229, 0.674082, 0.0536895);
+const float MIDDLE_GRAY_ACEScct = 0.4135884;
+const float SCOTOPIC_LOG_EXPOSURE = 380.0;
+
+float min3(vec3 v)
+{
+    return min(v.x, min(v.y, v.z));
+}
+
+float max3(vec3 v)
+{
+    return max(v.x, max(v.y, v.z));
+}
+
+vec3 cbrt(vec3 v)
+{
+    return sign(v) * pow(abs(v), vec3(1.0 / 3.0));
+}
+
+vec3 LogC_to_linear(vec3 x)
+{
+    const float ia = 1.0 / 5.555556;
+    const float b = 0.047996;
+    const float ic = 1.0 / 0.244161;
+    const float d = 0.386036;
+    return (pow(vec3(10.0), (x - d) * ic) - b) * ia;
+}
+
+vec3 linear_to_LogC(vec3 x)
+{
+    const float a = 5.555556;
+    const float b = 0.047996;
+    const float c = 0.244161;
+    const float d = 0.386036;
+    // log10(x) == log2(x) / log2(10)
+    return c * (log2(a * x + b) * 0.30102999566) + d;
+}
+
+vec3 OETF_sRGB(vec3 x)
+{
+    return mix(1.055 * pow(x, vec3(1.0 / 2.4)) - 0.055, x * 12.92, lessThanEqual(x, vec3(0.0031308)));
+}
+
+vec3 xyY_to_XYZ(vec3 v)
+{
+    float a = v.z / max(v.y, 1e-5);
+    return vec3(v.x * a, v.z, (1.0 - v.x - v.y) * a);
+}
+
+vec3 XYZ_to_xyY(vec3 v)
+{
+    return vec3(v.xy / max(v.x + v.y + v.z, 1e-5), v.y);
+}
+
+//------------------------------------------------------------------------------
+// Color grading, see gradeTexel()
+//------------------------------------------------------------------------------
+
+vec3 scotopicAdaptation(vec3 v, float nightAdaptation)
+{
+    v *= SCOTOPIC_LOG_EXPOSURE;
+
+    vec4 q = vec4(dot(v, u_ScotopicL), dot(v, u_ScotopicM), dot(v, u_ScotopicS), dot(v, u_ScotopicR));
+    vec3 g = inversesqrt(1.0 + max(vec3(0.0), (0.33 / u_ScotopicConeSensitivity) * (q.rgb + u_ScotopicRodStrength * q.w)));
+
+    vec3 deltaOpponent = mat3(u_ScotopicWeightedRodResponse) * g * q.w * nightAdaptation;
+    vec3 qHat = q.rgb + mat3(u_ScotopicOpponent_to_LMS) * deltaOpponent;
+
+    return (mat3(u_ScotopicLMS_to_RGB) * qHat) / SCOTOPIC_LOG_EXPOSURE;
+}
+
+vec3 tonalRanges(vec3 v, vec3 luminance)
+{
+    float y = dot(v, luminance);
+    float s = 1.0 - smoothstep(u_TonalRanges.x, u_TonalRanges.y, y);
+    float h = smoothstep(u_TonalRanges.z, u_TonalRanges.w, y);
+    float m = 1.0 - s - h;
+    return v * s * u_Shadows + v * m * u_Midtones + v * h * u_Highlights;
+}
+
+vec3 colorDecisionList(vec3 v)
+{
+    v = v * u_Slope + u_Offset;
+    // pow() is undefined below 0, those lanes keep v
+    vec3 pv = pow(max(v, vec3(0.0)), u_Power);
+    return mix(pv, v, lessThanEqual(v, vec3(0.0)));
+}
+
+vec3 vibrance(vec3 v, vec3 luminance)
+{
+    float r = v.r - max(v.g, v.b);
+    float s = (u_Vibrance - 1.0) / (1.0 + exp(-r * 3.0)) + 1.0;
+    vec3 l = (1.0 - s) * luminance;
+    return vec3(
+        dot(v, l + vec3(s, 0.0, 0.0)),
+        dot(v, l + vec3(0.0, s, 0.0)),
+        dot(v, l + vec3(0.0, 0.0, s))
+    );
+}
+
+vec3 curves(vec3 v)
+{
+    vec3 d = 1.0 / pow(u_MidPoint, u_ShadowGamma - 1.0);
+    vec3 dark = pow(v, u_ShadowGamma) * d;
+    vec3 light = u_HighlightScale * (v - u_MidPoint) + u_MidPoint;
+    return mix(light, dark, lessThanEqual(v, u_MidPoint));
+}
+
+vec3 gradeTexel(vec3 v)
+{
+    v = LogC_to_linear(v);
+    v = max(v, vec3(0.0));
+
+    if (u_HasAdjustments)
+    {
+        v *= exp2(u_Exposure);
+        v = scotopicAdaptation(v, u_NightAdaptation);
+    }
+
+    v = mat3(u_ColorGradingIn) * v;
+
+    if (u_HasAdjustments)
+    {
+        v = mat3(u_AdaptationTransform) * v;
+        v = max(v, vec3(0.0));
+        v = vec3(dot(v, u_OutRed), dot(v, u_OutGreen), dot(v, u_OutBlue));
+        v = tonalRanges(v, u_ColorGradingLuminance);
+        v = linear_to_LogC(v);
+        v = colorDecisionList(v);
+        v = MIDDLE_GRAY_ACEScct + u_Contrast * (v - MIDDLE_GRAY_ACEScct);
+        v = LogC_to_linear(v);
+        v = vibrance(v, u_ColorGradingLuminance);
+        v = vec3(dot(v, u_ColorGradingLuminance)) + u_Saturation * (v - vec3(dot(v, u_ColorGradingLuminance)));
+        v = max(v, vec3(0.0));
+        v = curves(v);
+    }
+    return v;
+}
+
+//------------------------------------------------------------------------------
+// Tone mappers, see ToneMapper.cpp
+//------------------------------------------------------------------------------
+
+float rgb_2_saturation(vec3 rgb)
+{
+    const float TINY = 1e-5;
+    return (max(max3(rgb), TINY) - max(min3(rgb), TINY)) / max(max3(rgb), 1e-2);
+}
+
+float rgb_2_yc(vec3 rgb)
+{
+    const float ycRadiusWeight = 1.75;
+    float r = rgb.r;
+    float g = rgb.g;
+    float b = rgb.b;
+    float chroma = sqrt(b * (b - g) + g * (g - r) + r * (r - b));
+    return (b + g + r + ycRadiusWeight * chroma) / 3.0;
+}
+
+float sigmoid_shaper(float x)
+{
+    float t = max(1.0 - abs(x / 2.0), 0.0);
+    float y = 1.0 + sign(x) * (1.0 - t * t);
+    return y / 2.0;
+}
+
+float glow_fwd(float ycIn, float glowGainIn, float glowMid)
+{
+    if (ycIn <= 2.0 / 3.0 * glowMid)
+    {
+        return glowGainIn;
+    }
+    if (ycIn >= 2.0 * glowMid)
+    {
+        return 0.0;
+    }
+    return glowGainIn * (glowMid / ycIn - 1.0 / 2.0);
+}
+
+float rgb_2_hue(vec3 rgb)
+{
+    float hue = 0.0;
+    if (!(rgb.x == rgb.y && rgb.y == rgb.z))
+    {
+        hue = degrees(atan(sqrt(3.0) * (rgb.y - rgb.z), 2.0 * rgb.x - rgb.y - rgb.z));
+    }
+    return (hue < 0.0) ? hue + 360.0 : hue;
+}
+
+float center_hue(float hue, float centerH)
+{
+    float hueCentered = hue - centerH;
+    if (hueCentered < -180.0)
+    {
+        hueCentered = hueCentered + 360.0;
+    }
+    else if (hueCentered > 180.0)
+    {
+        hueCentered = hueCentered - 360.0;
+    }
+    return hueCentered;
+}
+
+vec3 darkSurround_to_dimSurround(vec3 linearCV)
+{
+    const float DIM_SURROUND_GAMMA = 0.9811;
+    vec3 XYZ = AP1_to_XYZ * linearCV;
+    vec3 xyY = XYZ_to_xyY(XYZ);
+    xyY.z = clamp(xyY.z, 0.0, HALF_MAX);
+    xyY.z = pow(xyY.z, DIM_SURROUND_GAMMA);
+    XYZ = xyY_to_XYZ(xyY);
+    return XYZ_to_AP1 * XYZ;
+}
+
+vec3 ACES(vec3 color, float brightness)
+{
+    const float RRT_GLOW_GAIN = 0.05;
+    const float RRT_GLOW_MID = 0.08;
+    const float RRT_RED_SCALE = 0.82;
+    const float RRT_RED_PIVOT = 0.03;
+    const float RRT_RED_HUE = 0.0;
+    const float RRT_RED_WIDTH = 135.0;
+    const float RRT_SAT_FACTOR = 0.96;
+    const float ODT_SAT_FACTOR = 0.93;
+
+    vec3 ap0 = Rec2020_to_AP0 * color;
+
+    // Glow module
+    float saturation = rgb_2_saturation(ap0);
+    float ycIn = rgb_2_yc(ap0);
+    float s = sigmoid_shaper((saturation - 0.4) / 0.2);
+    float addedGlow = 1.0 + glow_fwd(ycIn, RRT_GLOW_GAIN * s, RRT_GLOW_MID);
+    ap0 *= addedGlow;
+
+    // Red modifier
+    float hue = rgb_2_hue(ap0);
+    float centeredHue = center_hue(hue, RRT_RED_HUE);
+    float hueWeight = smoothstep(0.0, 1.0, 1.0 - abs(2.0 * centeredHue / RRT_RED_WIDTH));
+    hueWeight *= hueWeight;
+    ap0.r += hueWeight * saturation * (RRT_RED_PIVOT - ap0.r) * (1.0 - RRT_RED_SCALE);
+
+    vec3 ap1 = clamp(AP0_to_AP1 * ap0, 0.0, HALF_MAX);
+    ap1 = mix(vec3(dot(ap1, LUMINANCE_AP1)), ap1, RRT_SAT_FACTOR);
+    ap1 *= brightness;
+
+    const float a = 2.785085;
+    const float b = 0.107772;
+    const float c = 2.936045;
+    const float d = 0.887122;
+    const float e = 0.806889;
+    vec3 rgbPost = (ap1 * (a * ap1 + b)) / (ap1 * (c * ap1 + d) + e);
+
+    vec3 linearCV = darkSurround_to_dimSurround(rgbPost);
+    linearCV = mix(vec3(dot(linearCV, LUMINANCE_AP1)), linearCV, ODT_SAT_FACTOR);
+    return AP1_to_Rec2020 * linearCV;
+}
+
+vec3 filmic(vec3 x)
+{
+    const float a = 2.51;
+    const float b = 0.03;
+    const float c = 2.43;
+    const float d = 0.59;
+    const float e = 0.14;
+    return (x * (a * x + b)) / (x * (c * x + d) + e);
+}
+
+const mat3 AgXInsetMatrix = mat3(
+    0.856627153315983, 0.137318972929847, 0.11189821299995,
+    0.0951212405381588, 0.761241990602591, 0.0767994186031903,
+    0.0482516061458583, 0.101439036467562, 0.811302368396859
+);
+
+const mat3 AgXOutsetMatrixInv = mat3(
+    0.899796955911611, 0.11142098895748, 0.11142098895748,
+    0.0871996192028351, 0.875575586156966, 0.0871996192028349,
+    0.013003424885555, 0.0130034248855548, 0.801379391839686
+);
+
+vec3 agxDefaultContrastApprox(vec3 x)
+{
+    vec3 x2 = x * x;
+    vec3 x4 = x2 * x2;
+    vec3 x6 = x4 * x2;
+    return -17.86 * x6 * x
+        + 78.01 * x6
+        - 126.7 * x4 * x
+        + 92.06 * x4
+        - 28.72 * x2 * x
+        + 4.361 * x2
+        - 0.1718 * x
+        + 0.002857;
+}
+
+vec3 agxLook(vec3 val)
+{
+    if (u_AgxLook == AGX_LOOK_NONE)
+    {
+        return val;
+    }
+    const vec3 lw = vec3(0.2126, 0.7152, 0.0722);
+    float luma = dot(val, lw);
+
+    vec3 slope = vec3(1.0);
+    vec3 power = vec3(1.0);
+    float sat = 1.0;
+    if (u_AgxLook == AGX_LOOK_GOLDEN)
+    {
+        slope = vec3(1.0, 0.9, 0.5);
+        power = vec3(0.8);
+        sat = 1.3;
+    }
+    if (u_AgxLook == AGX_LOOK_PUNCHY)
+    {
+        power = vec3(1.35);
+        sat = 1.4;
+    }
+    val = pow(val * slope, power);
+    return luma + sat * (val - luma);
+}
+
+vec3 agx(vec3 v)
+{
+    const float AgxMinEv = -12.47393;
+    const float AgxMaxEv = 4.026069;
+
+    v = max(vec3(0.0), v);
+    v = AgXInsetMatrix * v;
+    v = max(v, vec3(1E-10));
+    v = log2(v);
+    v = (v - AgxMinEv) / (AgxMaxEv - AgxMinEv);
+    v = clamp(v, 0.0, 1.0);
+    v = agxDefaultContrastApprox(v);
+    v = agxLook(v);
+    v = inverse(AgXOutsetMatrixInv) * v;
+    return pow(max(vec3(0.0), v), vec3(2.2));
+}
+
+vec3 displayRange(vec3 c)
+{
+    // 16 debug colors + 1 duplicated at the end for easy indexing
+    const vec3 debugColors[17] = vec3[17](
+        vec3(0.0,     0.0,     0.0),
+        vec3(0.0,     0.0,     0.1647),
+        vec3(0.0,     0.0,     0.3647),
+        vec3(0.0,     0.0,     0.6647),
+        vec3(0.0,     0.0,     0.9647),
+        vec3(0.0,     0.9255,  0.9255),
+        vec3(0.0,     0.5647,  0.0),
+        vec3(0.0,     0.7843,  0.0),
+        vec3(1.0,     1.0,     0.0),
+        vec3(0.90588, 0.75294, 0.0),
+        vec3(1.0,     0.5647,  0.0),
+        vec3(1.0,     0.0,     0.0),
+        vec3(0.8392,  0.0,     0.0),
+        vec3(1.0,     0.0,     1.0),
+        vec3(0.6,     0.3333,  0.7882),
+        vec3(1.0,     1.0,     1.0),
+        vec3(1.0,     1.0,     1.0)
+    );
+    float v = log2(dot(c, LUMINANCE_Rec2020) / 0.18);
+    v = clamp(v + 5.0, 0.0, 15.0);
+    int index = int(v);
+    return mix(debugColors[index], debugColors[index + 1], clamp(v - float(index), 0.0, 1.0));
+}
+
+vec3 generic(vec3 x)
+{
+    // GenericToneMapper::Options::setParameters()
+    float contrast = max(u_GenericToneMapper.x, 1e-5);
+    float midGrayIn = clamp(u_GenericToneMapper.y, 1e-5, 1.0);
+    float midGrayOut = clamp(u_GenericToneMapper.z, 1e-5, 1.0);
+    float hdrMax = max(u_GenericToneMapper.w, 1.0);
+    float a = pow(midGrayIn, contrast);
+    float b = pow(hdrMax, contrast);
+    float c = a - midGrayOut * b;
+    float inputScale = (a * b * (midGrayOut - 1.0)) / c;
+    float outputScale = midGrayOut * (a - b) / c;
+
+    x = pow(x, vec3(contrast));
+    return outputScale * x / (x + inputScale);
+}
+
+vec3 toneMap(vec3 v)
+{
+    switch (u_ToneMapper)
+    {
+        case TONE_MAPPER_LINEAR:        return clamp(v, 0.0, 1.0);
+        case TONE_MAPPER_ACES:          return ACES(v, 1.0);
+        case TONE_MAPPER_FILMIC:        return filmic(v);
+        case TONE_MAPPER_AGX:           return agx(v);
+        case TONE_MAPPER_GENERIC:       return generic(v);
+        case TONE_MAPPER_DISPLAY_RANGE: return displayRange(v);
+        default:                        return ACES(v, 1.0 / 0.6);
+    }
+}
+
+vec3 luminanceScaling(vec3 x, vec3 luminanceWeights)
+{
+    float luminanceIn = dot(x, luminanceWeights);
+    float luminanceOut = toneMap(vec3(luminanceIn)).y;
+
+    float peak = max(max3(x), FLT_MIN);
+    vec3 chromaRatio = max(x / peak, vec3(0.0));
+    float chromaRatioLuminance = dot(chromaRatio, luminanceWeights);
+
+    vec3 maxReserves = 1.0 - chromaRatio;
+    float maxReservesLuminance = dot(maxReserves, luminanceWeights);
+
+    float luminanceDifference = max(luminanceOut - chromaRatioLuminance, 0.0);
+    float scaledLuminanceDifference = luminanceDifference / max(maxReservesLuminance, FLT_MIN);
+    float chromaScale = (luminanceOut - luminanceDifference) / max(chromaRatioLuminance, FLT_MIN);
+
+    return chromaScale * chromaRatio + scaledLuminanceDifference * maxReserves;
+}
+
+//------------------------------------------------------------------------------
+// Gamut mapping, see ColorSpaceUtils.cpp
+//------------------------------------------------------------------------------
+
+vec3 sRGB_to_OkLab(vec3 x)
+{
+    return OkLab_LMS_to_OkLab * cbrt(sRGB_to_OkLab_LMS * x);
+}
+
+vec3 OkLab_to_sRGB(vec3 x)
+{
+    vec3 lms = OkLab_to_OkLab_LMS * x;
+    return OkLab_LMS_to_sRGB * (lms * lms * lms);
+}
+
+float compute_max_saturation(float a, float b)
+{
+    float k0, k1, k2, k3, k4, wl, wm, ws;
+    if (-1.88170328 * a - 0.80936493 * b > 1.0)
+    {
+        k0 = +1.19086277; k1 = +1.76576728; k2 = +0.59662641; k3 = +0.75515197; k4 = +0.56771245;
+        wl = +4.0767416621; wm = -3.3077115913; ws = +0.2309699292;
+    }
+    else if (1.81444104 * a - 1.19445276 * b > 1.0)
+    {
+        k0 = +0.73956515; k1 = -0.45954404; k2 = +0.08285427; k3 = +0.12541070; k4 = +0.14503204;
+        wl = -1.2681437731; wm = +2.6097574011; ws = -0.3413193965;
+    }
+    else
+    {
+        k0 = +1.35733652; k1 = -0.00915799; k2 = -1.15130210; k3 = -0.50559606; k4 = +0.00692167;
+        wl = -0.0041960863; wm = -0.7034186147; ws = +1.7076147010;
+    }
+
+    float S = k0 + k1 * a + k2 * b + k3 * a * a + k4 * a * b;
+
+    float k_l = +0.3963377774 * a + 0.2158037573 * b;
+    float k_m = -0.1055613458 * a - 0.0638541728 * b;
+    float k_s = -0.0894841775 * a - 1.2914855480 * b;
+
+    float l_ = 1.0 + S * k_l;
+    float m_ = 1.0 + S * k_m;
+    float s_ = 1.0 + S * k_s;
+
+    float l = l_ * l_ * l_;
+    float m = m_ * m_ * m_;
+    float s = s_ * s_ * s_;
+
+    float l_dS = 3.0 * k_l * l_ * l_;
+    float m_dS = 3.0 * k_m * m_ * m_;
+    float s_dS = 3.0 * k_s * s_ * s_;
+
+    float l_dS2 = 6.0 * k_l * k_l * l_;
+    float m_dS2 = 6.0 * k_m * k_m * m_;
+    float s_dS2 = 6.0 * k_s * k_s * s_;
+
+    float f = wl * l + wm * m + ws * s;
+    float f1 = wl * l_dS + wm * m_dS + ws * s_dS;
+    float f2 = wl * l_dS2 + wm * m_dS2 + ws * s_dS2;
+
+    return S - f * f1 / (f1 * f1 - 0.5 * f * f2);
+}
+
+vec2 find_cusp(float a, float b)
+{
+    float S_cusp = compute_max_saturation(a, b);
+    vec3 rgb_at_max = OkLab_to_sRGB(vec3(1.0, S_cusp * a, S_cusp * b));
+    float L_cusp = pow(1.0 / max3(rgb_at_max), 1.0 / 3.0);
+    float C_cusp = L_cusp * S_cusp;
+    return vec2(L_cusp, C_cusp);
+}
+
+float find_gamut_intersection(float a, float b, float L1, float C1, float L0)
+{
+    vec2 cusp = find_cusp(a, b);
+
+    if (((L1 - L0) * cusp.y - (cusp.x - L0) * C1) <= 0.0)
+    {
+        // Lower half
+        return cusp.y * L0 / (C1 * cusp.x + cusp.y * (L0 - L1));
+    }
+
+    // Upper half, intersect with the triangle then one step of Halley's method
+    float t = cusp.y * (L0 - 1.0) / (C1 * (cusp.x - 1.0) + cusp.y * (L0 - L1));
+
+    float dL = L1 - L0;
+    float dC = C1;
+
+    float k_l = +0.3963377774 * a + 0.2158037573 * b;
+    float k_m = -0.1055613458 * a - 0.0638541728 * b;
+    float k_s = -0.0894841775 * a - 1.2914855480 * b;
+
+    float l_dt = dL + dC * k_l;
+    float m_dt = dL + dC * k_m;
+    float s_dt = dL + dC * k_s;
+
+    float L = L0 * (1.0 - t) + t * L1;
+    float C = t * C1;
+
+    float l_ = L + C * k_l;
+    float m_ = L + C * k_m;
+    float s_ = L + C * k_s;
+
+    float l = l_ * l_ * l_;
+    float m = m_ * m_ * m_;
+    float s = s_ * s_ * s_;
+
+    float ldt = 3.0 * l_dt * l_ * l_;
+    float mdt = 3.0 * m_dt * m_ * m_;
+    float sdt = 3.0 * s_dt * s_ * s_;
+
+    float ldt2 = 6.0 * l_dt * l_dt * l_;
+    float mdt2 = 6.0 * m_dt * m_dt * m_;
+    float sdt2 = 6.0 * s_dt * s_dt * s_;
+
+    float r = 4.0767416621 * l - 3.3077115913 * m + 0.2309699292 * s - 1.0;
+    float r1 = 4.0767416621 * ldt - 3.3077115913 * mdt + 0.2309699292 * sdt;
+    float r2 = 4.0767416621 * ldt2 - 3.3077115913 * mdt2 + 0.2309699292 * sdt2;
+    float u_r = r1 / (r1 * r1 - 0.5 * r * r2);
+    float t_r = -r * u_r;
+
+    float g = -1.2681437731 * l + 2.6097574011 * m - 0.3413193965 * s - 1.0;
+    float g1 = -1.2681437731 * ldt + 2.6097574011 * mdt - 0.3413193965 * sdt;
+    float g2 = -1.2681437731 * ldt2 + 2.6097574011 * mdt2 - 0.3413193965 * sdt2;
+    float u_g = g1 / (g1 * g1 - 0.5 * g * g2);
+    float t_g = -g * u_g;
+
+    float b0 = -0.0041960863 * l - 0.7034186147 * m + 1.7076147010 * s - 1.0;
+    float b1 = -0.0041960863 * ldt - 0.7034186147 * mdt + 1.7076147010 * sdt;
+    float b2 = -0.0041960863 * ldt2 - 0.7034186147 * mdt2 + 1.7076147010 * sdt2;
+    float u_b = b1 / (b1 * b1 - 0.5 * b0 * b2);
+    float t_b = -b0 * u_b;
+
+    t_r = u_r >= 0.0 ? t_r : FLT_MAX;
+    t_g = u_g >= 0.0 ? t_g : FLT_MAX;
+    t_b = u_b >= 0.0 ? t_b : FLT_MAX;
+
+    return t + min(t_r, min(t_g, t_b));
+}
+
+vec3 gamutMapping_sRGB(vec3 rgb)
+{
+    const float alpha = 0.05;
+    const float threshold = 0.03;
+    if (all(lessThanEqual(rgb, vec3(1.0 + threshold))) && all(greaterThanEqual(rgb, vec3(-threshold))))
+    {
+        return rgb;
+    }
+
+    vec3 lab = sRGB_to_OkLab(rgb);
+    float L = lab.x;
+    float eps = 0.00001;
+    float C = max(eps, sqrt(lab.y * lab.y + lab.z * lab.z));
+    float a_ = lab.y / C;
+    float b_ = lab.z / C;
+
+    float Ld = L - 0.5;
+    float e1 = 0.5 + abs(Ld) + alpha * C;
+    float L0 = 0.5 * (1.0 + sign(Ld) * (e1 - sqrt(e1 * e1 - 2.0 * abs(Ld))));
+
+    float t = find_gamut_intersection(a_, b_, L, C, L0);
+    float L_clipped = L0 * (1.0 - t) + t * L;
+    float C_clipped = t * C;
+
+    return OkLab_to_sRGB(vec3(L_clipped, C_clipped * a_, C_clipped * b_));
+}
+
+void main()
+{
+    ivec3 texel = ivec3(gl_GlobalInvocationID.xyz);
+    if (any(greaterThanEqual(texel, ivec3(u_LutDimension))))
+    {
+        return;
+    }
+
+    vec3 v = vec3(texel) * (1.0 / float(u_LutDimension - 1));
+    v = gradeTexel(v);
+
+    // the CPU reference runs the tone mapper a second time, keep both in sync
+    if (u_LuminanceScaling)
+    {
+        v = luminanceScaling(v, u_ColorGradingLuminance);
+    }
+    else
+    {
+        v = toneMap(v);
+    }
+    v = toneMap(v);
+
+    if (u_GamutMapping)
+    {
+        v = gamutMapping_sRGB(v);
+    }
+    v = clamp(v, 0.0, 1.0);
+    if (!u_LinearOETF)
+    {
+        v = OETF_sRGB(v);
+    }
+
+    imageStore(u_Lut, texel, vec4(v, 0.0));
+}
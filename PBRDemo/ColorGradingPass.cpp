@@ -6,10 +6,16 @@
 #include <cmath>
 #include <cstdlib>
 #include <mutex>
+#include "JobSystem.h"
 #include <tuple>
 #include "Common.h"
 #include "Interface.h"
 #include "Shader.h"
+#include "GLStateCache.h"
+#include "SimdFloat.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
 #include <GLM/glm.hpp>
 #include <GLM/gtc/matrix_transform.hpp>
 #include <GLM/gtc/type_ptr.hpp>
@@ -66,6 +72,58 @@ bool ColorGradingSettings::operator==(const ColorGradingSettings& rhs) const
         scale == rhs.scale;
 }
 
+uint8_t ColorGradingSettings::getChangedLutStages(const ColorGradingSettings& rhs) const
+{
+    // Must list the same fields as operator==
+    static_assert(sizeof(ColorGradingSettings) == 312, "Please update Settings.cpp");
+    uint8_t stages = 0;
+    if (quality != rhs.quality)
+    {
+        stages |= CColorGradingPass::LUT_STAGE_ALL;
+    }
+    // FILMIC also switches the grading color space, see selectColorGradingTransformIn()
+    const bool filmicChanged = (toneMapping == ToneMappingSeeting::FILMIC) != (rhs.toneMapping == ToneMappingSeeting::FILMIC);
+    if (filmicChanged ||
+        exposure != rhs.exposure ||
+        nightAdaptation != rhs.nightAdaptation ||
+        temperature != rhs.temperature ||
+        tint != rhs.tint ||
+        outRed != rhs.outRed ||
+        outGreen != rhs.outGreen ||
+        outBlue != rhs.outBlue ||
+        shadows != rhs.shadows ||
+        midtones != rhs.midtones ||
+        highlights != rhs.highlights ||
+        ranges != rhs.ranges ||
+        contrast != rhs.contrast ||
+        vibrance != rhs.vibrance ||
+        saturation != rhs.saturation ||
+        slope != rhs.slope ||
+        offset != rhs.offset ||
+        power != rhs.power ||
+        gamma != rhs.gamma ||
+        midPoint != rhs.midPoint ||
+        linkedCurves != rhs.linkedCurves ||
+        scale != rhs.scale)
+    {
+        stages |= CColorGradingPass::LUT_STAGE_GRADING;
+    }
+    if (toneMapping != rhs.toneMapping ||
+        genericToneMapper != rhs.genericToneMapper ||
+        agxToneMapper != rhs.agxToneMapper ||
+        luminanceScaling != rhs.luminanceScaling)
+    {
+        stages |= CColorGradingPass::LUT_STAGE_TONE_MAPPING;
+    }
+    if (gamutMapping != rhs.gamutMapping ||
+        !(colorspace == rhs.colorspace))
+    {
+        stages |= CColorGradingPass::LUT_STAGE_OUTPUT;
+    }
+    // enabled does not affect the LUT
+    return stages;
+}
+
 
 glm::mat3 vec3ToMat3(glm::vec3 v)
 {
@@ -99,44 +157,50 @@ void CColorGradingPass::setQuality(CColorGradingPass::QualityLevel qualityLevel)
         dimension = 64;
         break;
     }
+    lutDirtyStages |= LUT_STAGE_ALL;
 }
 
 void CColorGradingPass::setFormat(LutFormat format) noexcept
 {
     this->format = format;
-    
+    lutDirtyStages |= LUT_STAGE_OUTPUT;
 }
 
 void CColorGradingPass::setDimensions(uint8_t dim) noexcept
 {
     this->dimension = glm::clamp(+dim, 16, 64);
-    
+    lutDirtyStages |= LUT_STAGE_ALL;
 }
 
 void CColorGradingPass::setToneMapper(const ToneMapper* toneMapper) noexcept
 {
     this->toneMapper = toneMapper;
+    lutDirtyStages |= LUT_STAGE_TONE_MAPPING;
 }
 
 
 void CColorGradingPass::setLuminanceScaling(bool luminanceScaling) noexcept
 {
     this->luminanceScaling = luminanceScaling;
+    lutDirtyStages |= LUT_STAGE_TONE_MAPPING;
 }
 
 void CColorGradingPass::setGamutMapping(bool gamutMapping) noexcept
 {
     this->gamutMapping = gamutMapping;
+    lutDirtyStages |= LUT_STAGE_OUTPUT;
 }
 
 void CColorGradingPass::setExposure(float exposure) noexcept
 {
     this->exposure = exposure;
+    lutDirtyStages |= LUT_STAGE_GRADING;
 }
 
 void CColorGradingPass::setNightAdaptation(float adaptation) noexcept
 {
     this->nightAdaptation = glm::saturate(adaptation);
+    lutDirtyStages |= LUT_STAGE_GRADING;
 }
 
 void CColorGradingPass::setWhiteBalance(float temperature, float tint) noexcept
@@ -145,6 +209,7 @@ void CColorGradingPass::setWhiteBalance(float temperature, float tint) noexcept
         glm::clamp(temperature, -1.0f, 1.0f),
         glm::clamp(tint, -1.0f, 1.0f)
     };
+    lutDirtyStages |= LUT_STAGE_GRADING;
 }
 
 void CColorGradingPass::setChannelMixer(
@@ -153,7 +218,7 @@ void CColorGradingPass::setChannelMixer(
     this->outRed = glm::clamp(outRed, -2.0f, 2.0f);
     this->outGreen = glm::clamp(outGreen, -2.0f, 2.0f);
     this->outBlue = glm::clamp(outBlue, -2.0f, 2.0f);
-    
+    lutDirtyStages |= LUT_STAGE_GRADING;
 }
 
 void CColorGradingPass::setShadowsMidtonesHighlights(
@@ -168,8 +233,7 @@ void CColorGradingPass::setShadowsMidtonesHighlights(
     ranges.y = glm::clamp(ranges.y, ranges.x + 1e-5f, ranges.w - 1e-5f); // darks
     ranges.z = glm::clamp(ranges.z, ranges.x + 1e-5f, ranges.w - 1e-5f); // lights
     this->tonalRanges = ranges;
-
-    
+    lutDirtyStages |= LUT_STAGE_GRADING;
 }
 
 void CColorGradingPass::setSlopeOffsetPower(
@@ -178,25 +242,25 @@ void CColorGradingPass::setSlopeOffsetPower(
     this->slope = glm::max(glm::vec3(1e-5f), slope);
     this->offset = offset;
     this->power = glm::max(glm::vec3(1e-5f), power);
-    
+    lutDirtyStages |= LUT_STAGE_GRADING;
 }
 
 void CColorGradingPass::setContrast(float contrast) noexcept
 {
     this->contrast = glm::clamp(contrast, 0.0f, 2.0f);
-    
+    lutDirtyStages |= LUT_STAGE_GRADING;
 }
 
 void CColorGradingPass::setVibrance(float vibrance) noexcept
 {
     this->vibrance = glm::clamp(vibrance, 0.0f, 2.0f);
-    
+    lutDirtyStages |= LUT_STAGE_GRADING;
 }
 
 void CColorGradingPass::setSaturation(float saturation) noexcept
 {
     this->saturation = glm::clamp(saturation, 0.0f, 2.0f);
-    
+    lutDirtyStages |= LUT_STAGE_GRADING;
 }
 
 void CColorGradingPass::setCurves(
@@ -205,14 +269,21 @@ void CColorGradingPass::setCurves(
     this->shadowGamma = glm::max(glm::vec3(1e-5f), shadowGamma);
     this->midPoint = glm::max(glm::vec3(1e-5f), midPoint);
     this->highlightScale = highlightScale;
-    
+    lutDirtyStages |= LUT_STAGE_GRADING;
 }
 
 void CColorGradingPass::setOutputColorSpace(
     const ColorSpace& colorSpace) noexcept 
 {
     this->outputColorSpace = colorSpace;
-    
+    lutDirtyStages |= LUT_STAGE_OUTPUT;
+}
+
+void CColorGradingPass::setLutBackend(LutBackend backend, bool runBenchmark) noexcept
+{
+    this->lutBackend = backend;
+    this->runLutBenchmark = runBenchmark;
+    this->isComputeLutChecked = false;
 }
 
 
@@ -233,96 +304,116 @@ inline glm::vec3 adjustExposure(glm::vec3 v, float exposure)
 // Purkinje shift/scotopic vision
 //------------------------------------------------------------------------------
 
-glm::vec3 scotopicAdaptation(glm::vec3 v, float nightAdaptation) noexcept 
+// The matrices below only depend on constants, build them once instead of once per texel
+struct ScotopicConstants
 {
+    glm::vec3 L;
+    glm::vec3 M;
+    glm::vec3 S;
+    glm::vec3 R;
+    glm::vec3 m;
+    glm::vec3 k;
+    glm::mat3 LMS_to_RGB;
+    glm::mat3 opponent_to_LMS;
+    glm::mat3 weightedRodResponse;
+};
 
-    constexpr glm::vec3 L{ 7.696847f, 18.424824f,  2.068096f };
-    constexpr glm::vec3 M{ 2.431137f, 18.697937f,  3.012463f };
-    constexpr glm::vec3 S{ 0.289117f,  1.401833f, 13.792292f };
-    constexpr glm::vec3 R{ 0.466386f, 15.564362f, 10.059963f };
-
-    
-    glm::mat3 LMS_to_RGB = glm::inverse(glm::transpose(glm::mat3{ L, M, S }));
-
-    // Maximal LMS cone sensitivity, Cao et al. Table 1
-    constexpr glm::vec3 m{ 0.63721f, 0.39242f, 1.6064f };
-    // Strength of rod input, free parameters in Cao et al., manually tuned for our needs
-    // We follow Kirk & O'Brien who recommend constant values as opposed to Cao et al.
-    // who propose to adapt those values based on retinal illuminance. We instead offer
-    // artistic control at the end of the process
-    // The vector below is {k1, k1, k2} in Kirk & O'Brien, but {k5, k5, k6} in Cao et al.
-    constexpr glm::vec3 k{ 0.2f, 0.2f, 0.3f };
-
-    // Transform from opponent space back to LMS
-    glm::mat3 opponent_to_LMS
-    {
-        -0.5f, 0.5f, 0.0f,
-        0.0f, 0.0f, 1.0f,
-        0.5f, 0.5f, 1.0f
-    };
-
-    // The constants below follow Cao et al, using the KC pathway
-    // Scaling constant
-    constexpr float K_ = 45.0f;
-    // Static saturation
-    constexpr float S_ = 10.0f;
-    // Surround strength of opponent signal
-    constexpr float k3 = 0.6f;
-    // Radio of responses for white light
-    constexpr float rw = 0.139f;
-    // Relative weight of L cones
-    constexpr float p = 0.6189f;
-
-    // Weighted cone response as described in Cao et al., section 3.3
-    // The approximately linear relation defined in the paper is represented here
-    // in matrix form to simplify the code
-
-
-    glm::mat3 weightedRodResponse = (K_ / S_) * glm::mat3{
-        -(k3 + rw),       p * k3,          p * S_,
-        1.0f + k3 * rw, (1.0f - p) * k3, (1.0f - p) * S_,
-        0.0f,            1.0f,            0.0f
-    } 
-    *glm::mat3
+static const ScotopicConstants& getScotopicConstants() noexcept
+{
+    static const ScotopicConstants constants = []()
     {
-        k[0], 0,    0,
-        0,    k[1], 0,
-        0.0f, 0,    k[2]
-    } 
-    *glm::inverse(
-        glm::mat3
+        ScotopicConstants sc;
+        sc.L = { 7.696847f, 18.424824f,  2.068096f };
+        sc.M = { 2.431137f, 18.697937f,  3.012463f };
+        sc.S = { 0.289117f,  1.401833f, 13.792292f };
+        sc.R = { 0.466386f, 15.564362f, 10.059963f };
+
+        sc.LMS_to_RGB = glm::inverse(glm::transpose(glm::mat3{ sc.L, sc.M, sc.S }));
+
+        // Maximal LMS cone sensitivity, Cao et al. Table 1
+        sc.m = { 0.63721f, 0.39242f, 1.6064f };
+        // Strength of rod input, free parameters in Cao et al., manually tuned for our needs
+        // We follow Kirk & O'Brien who recommend constant values as opposed to Cao et al.
+        // who propose to adapt those values based on retinal illuminance. We instead offer
+        // artistic control at the end of the process
+        // The vector below is {k1, k1, k2} in Kirk & O'Brien, but {k5, k5, k6} in Cao et al.
+        sc.k = { 0.2f, 0.2f, 0.3f };
+
+        // Transform from opponent space back to LMS
+        sc.opponent_to_LMS = glm::mat3
         {
-            m[0], 0,    0,
-            0,    m[1], 0,
-            0.0f, 0,    m[2]
+            -0.5f, 0.5f, 0.0f,
+            0.0f, 0.0f, 1.0f,
+            0.5f, 0.5f, 1.0f
+        };
+
+        // The constants below follow Cao et al, using the KC pathway
+        // Scaling constant
+        constexpr float K_ = 45.0f;
+        // Static saturation
+        constexpr float S_ = 10.0f;
+        // Surround strength of opponent signal
+        constexpr float k3 = 0.6f;
+        // Radio of responses for white light
+        constexpr float rw = 0.139f;
+        // Relative weight of L cones
+        constexpr float p = 0.6189f;
+
+        // Weighted cone response as described in Cao et al., section 3.3
+        // The approximately linear relation defined in the paper is represented here
+        // in matrix form to simplify the code
+        sc.weightedRodResponse = (K_ / S_) * glm::mat3{
+            -(k3 + rw),       p * k3,          p * S_,
+            1.0f + k3 * rw, (1.0f - p) * k3, (1.0f - p) * S_,
+            0.0f,            1.0f,            0.0f
         }
-    );
+        *glm::mat3
+        {
+            sc.k[0], 0,       0,
+            0,       sc.k[1], 0,
+            0.0f,    0,       sc.k[2]
+        }
+        *glm::inverse(
+            glm::mat3
+            {
+                sc.m[0], 0,       0,
+                0,       sc.m[1], 0,
+                0.0f,    0,       sc.m[2]
+            }
+        );
+        return sc;
+    }();
+    return constants;
+}
 
+// Move to log-luminance, or the EV values as measured by a Minolta Spotmeter F.
+// The relationship is EV = log2(L * 100 / 14), or 2^EV = L / 0.14. We can therefore
+// multiply our input by 0.14 to obtain our log-luminance values.
+// We then follow Patry's recommendation to shift the log-luminance by ~ +11.4EV to
+// match luminance values to mesopic measurements as described in Rezagholizadeh &
+// Clark 2013,
+// The result is 0.14 * exp2(11.40) ~= 380.0 (we use +11.406 EV to get a round number)
+constexpr float SCOTOPIC_LOG_EXPOSURE = 380.0f;
 
-    // Move to log-luminance, or the EV values as measured by a Minolta Spotmeter F.
-    // The relationship is EV = log2(L * 100 / 14), or 2^EV = L / 0.14. We can therefore
-    // multiply our input by 0.14 to obtain our log-luminance values.
-    // We then follow Patry's recommendation to shift the log-luminance by ~ +11.4EV to
-    // match luminance values to mesopic measurements as described in Rezagholizadeh &
-    // Clark 2013,
-    // The result is 0.14 * exp2(11.40) ~= 380.0 (we use +11.406 EV to get a round number)
-    constexpr float logExposure = 380.0f;
+glm::vec3 scotopicAdaptation(glm::vec3 v, float nightAdaptation) noexcept 
+{
+    const ScotopicConstants& sc = getScotopicConstants();
 
     // Move to scaled log-luminance
-    v *= logExposure;
+    v *= SCOTOPIC_LOG_EXPOSURE;
 
     // Convert the scene color from Rec.709 to LMSR response
-    glm::vec4 q{ dot(v, L), dot(v, M), dot(v, S), dot(v, R) };
+    glm::vec4 q{ dot(v, sc.L), dot(v, sc.M), dot(v, sc.S), dot(v, sc.R) };
     // Regulated signal through the selected pathway (KC in Cao et al.)
-    glm::vec3 g = glm::inversesqrt(1.0f + glm::max(glm::vec3{ 0.0f }, glm::vec3((0.33f / m) * (glm::rgb(q) + k * q.w))));
+    glm::vec3 g = glm::inversesqrt(1.0f + glm::max(glm::vec3{ 0.0f }, glm::vec3((0.33f / sc.m) * (glm::rgb(q) + sc.k * q.w))));
 
     // Compute the incremental effect that rods have in opponent space
-    glm::vec3 deltaOpponent = weightedRodResponse * g * q.w * nightAdaptation;
+    glm::vec3 deltaOpponent = sc.weightedRodResponse * g * q.w * nightAdaptation;
     // Photopic response in LMS space
-    glm::vec3 qHat = glm::rgb(q) + opponent_to_LMS * deltaOpponent;
+    glm::vec3 qHat = glm::rgb(q) + sc.opponent_to_LMS * deltaOpponent;
 
     // And finally, back to RGB
-    return (LMS_to_RGB * qHat) / logExposure;
+    return (sc.LMS_to_RGB * qHat) / SCOTOPIC_LOG_EXPOSURE;
 }
 
 //------------------------------------------------------------------------------
@@ -454,7 +545,8 @@ static glm::vec3 luminanceScalingFunc(glm::vec3 x,
     // TODO: We could optimize for the case of single-channel luminance
     float luminanceOut = toneMapper(glm::vec3(luminanceIn)).y;
 
-    float peak = max(x);
+    // black has no chroma, keep 0 / 0 from turning the texel into NaN
+    float peak = std::max(max(x), std::numeric_limits<float>::min());
     glm::vec3 chromaRatio = max(x / peak, 0.0f);
 
     float chromaRatioLuminance = dot(chromaRatio, luminanceWeights);
@@ -548,253 +640,1065 @@ struct Config
     ColorTransform oetf;
 };
 
+// Snapshot of everything a LUT build reads, so the pass can keep changing while
+// the jobs run.
+struct LutBuildParams
+{
+    Config config;
+    std::shared_ptr<const ToneMapper> toneMapper;
+    bool hasAdjustments;
+    bool luminanceScaling;
+    bool gamutMapping;
+    float exposure;
+    float nightAdaptation;
+    glm::vec3 outRed;
+    glm::vec3 outGreen;
+    glm::vec3 outBlue;
+    glm::vec3 shadows;
+    glm::vec3 midtones;
+    glm::vec3 highlights;
+    glm::vec4 tonalRanges;
+    glm::vec3 slope;
+    glm::vec3 offset;
+    glm::vec3 power;
+    float contrast;
+    float vibrance;
+    float saturation;
+    glm::vec3 shadowGamma;
+    glm::vec3 midPoint;
+    glm::vec3 highlightScale;
+};
 
+// Packs one finished slice into GL_UNSIGNED_INT_2_10_10_10_REV for LutFormat::INTEGER
+static void convertLutSlice(const Config& c, size_t b, const glm::half4* data, uint32_t* converted)
+{
+    uint32_t* const  dst = converted + b * c.lutDimension * c.lutDimension;
+    const glm::half4* src = data + b * c.lutDimension * c.lutDimension;
+    const size_t count = c.lutDimension * c.lutDimension;
+    for (size_t i = 0; i < count; ++i) {
+        glm::vec3 v{ src[i] };
+        uint32_t pr = uint32_t(std::floor(v.x * 1023.0f + 0.5f));
+        uint32_t pg = uint32_t(std::floor(v.y * 1023.0f + 0.5f));
+        uint32_t pb = uint32_t(std::floor(v.z * 1023.0f + 0.5f));
+        dst[i] = (pb << 20u) | (pg << 10u) | pr;
+    }
+}
 
-CColorGradingPass::CColorGradingPass(const std::string& vPassName, int vExcutionOrder) : IRenderPass(vPassName, vExcutionOrder)
+// Everything before tone mapping, for one texel of the LUT
+static glm::vec3 gradeTexel(const LutBuildParams& params, glm::vec3 v)
 {
-    
+    const Config& c = params.config;
+
+    // LogC encoding
+    v = LogC_to_linear(v);
+
+    // Kill negative values near 0.0f due to imprecision in the log conversion
+    v = max(v, 0.0f);
+
+    if (params.hasAdjustments)
+    {
+        // Exposure
+        v = adjustExposure(v, params.exposure);
+        // Purkinje shift ("low-light" vision)
+        v = scotopicAdaptation(v, params.nightAdaptation);
+    }
+
+
+    v = c.colorGradingIn * v;
+
+    if (params.hasAdjustments)
+    {
+        // White balance
+        v = chromaticAdaptation(v, c.adaptationTransform);
+
+        // Kill negative values before the next transforms
+        v = max(v, 0.0f);
+
+        // Channel mixer
+        v = channelMixer(v, params.outRed, params.outGreen, params.outBlue);
 
+        // Shadows/mid-tones/highlights
+        v = tonalRangesFunc(v, c.colorGradingLuminance,
+            params.shadows, params.midtones, params.highlights,
+            params.tonalRanges);
 
+        // The adjustments below behave better in log space
+        v = linear_to_LogC(v);
+
+        // ASC CDL
+        v = colorDecisionList(v, params.slope, params.offset, params.power);
+
+        // Contrast in log space
+        v = contrastFunc(v, params.contrast);
+
+        // Back to linear space
+        v = LogC_to_linear(v);
+
+        // Vibrance in linear space
+        v = vibranceFunc(v, c.colorGradingLuminance, params.vibrance);
+
+        // Saturation in linear space
+        v = saturationFunc(v, c.colorGradingLuminance, params.saturation);
+
+        // Kill negative values before curves
+        v = max(v, 0.0f);
+
+        // RGB curves
+        v = curves(v,
+            params.shadowGamma, params.midPoint, params.highlightScale);
+    }
+    return v;
 }
 
+// The float LUTs cached between stages store each blue slice as three planes
+// (r, g, b) of lutDimension^2 floats, so a whole slice can be handed to
+// ToneMapper::apply().
+struct LutPlanes
+{
+    float* r;
+    float* g;
+    float* b;
+};
 
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wdeprecated-declarations"
-void CColorGradingPass::initV()
+static LutPlanes getLutSlicePlanes(const Config& c, float* lut, size_t b)
 {
+    const size_t sliceTexels = c.lutDimension * c.lutDimension;
+    float* slice = lut + 3 * b * sliceTexels;
+    return { slice, slice + sliceTexels, slice + 2 * sliceTexels };
+}
 
-    // Fallback for clients that still use the deprecated ToneMapping API
-    bool needToneMapper = this->toneMapper == nullptr;
-    if (needToneMapper)
+static void gradeLutSlice(const LutBuildParams& params, size_t b, float* graded)
+{
+    const Config& c = params.config;
+    const LutPlanes dst = getLutSlicePlanes(c, graded, b);
+    size_t i = 0;
+    for (size_t g = 0; g < c.lutDimension; g++) {
+        for (size_t r = 0; r < c.lutDimension; r++, i++) {
+            glm::vec3 v = glm::vec3{ r, g, b } *(1.0f / float(c.lutDimension - 1u));
+            v = gradeTexel(params, v);
+            dst.r[i] = v.r;
+            dst.g[i] = v.g;
+            dst.b[i] = v.b;
+        }
+    }
+}
+
+static void toneMapLutSlice(const LutBuildParams& params, size_t b, float* graded, float* toneMapped)
+{
+    const Config& c = params.config;
+    const LutPlanes src = getLutSlicePlanes(c, graded, b);
+    const LutPlanes dst = getLutSlicePlanes(c, toneMapped, b);
+    const size_t sliceTexels = c.lutDimension * c.lutDimension;
+    for (size_t i = 0; i < sliceTexels; i++) {
+        glm::vec3 v{ src.r[i], src.g[i], src.b[i] };
+        if (params.luminanceScaling)
+        {
+            v = luminanceScalingFunc(v, *params.toneMapper, c.colorGradingLuminance);
+        }
+        else
+        {
+            v = (*params.toneMapper)(v);
+        }
+        v = (*params.toneMapper)(v);
+        dst.r[i] = v.r;
+        dst.g[i] = v.g;
+        dst.b[i] = v.b;
+    }
+}
+
+static void outputLutSlice(const LutBuildParams& params, size_t b, float* toneMapped, glm::half4* data, uint32_t* converted)
+{
+    const Config& c = params.config;
+    const LutPlanes src = getLutSlicePlanes(c, toneMapped, b);
+    const size_t sliceTexels = c.lutDimension * c.lutDimension;
+    glm::half4* p = data + b * sliceTexels;
+    for (size_t i = 0; i < sliceTexels; i++) {
+        glm::vec3 v{ src.r[i], src.g[i], src.b[i] };
+
+        // Apply gamut mapping
+        if (params.gamutMapping)
+        {
+            // TODO: This should depend on the output color space
+            v = gamutMapping_sRGB(v);
+        }
+
+        // TODO: We should convert to the output color space if we use a working
+        //       color space that's not sRGB
+        // TODO: Allow the user to customize the output color space
+
+        // We need to clamp for the output transfer function
+        v = glm::saturate(v);
+
+        // Apply OETF
+        v = c.oetf(v);
+
+        *p++ = glm::half4{ v, 0.0f };
+    }
+
+    if (converted)
+    {
+        convertLutSlice(c, b, data, converted);
+    }
+}
+
+//------------------------------------------------------------------------------
+// Batched color grading
+//------------------------------------------------------------------------------
+
+// Texels staged together by the batched grading and output stages. Must be a
+// multiple of the widest lane count.
+constexpr size_t LUT_BATCH_SIZE = 64;
+
+// Largest difference allowed between a backend and the scalar chain: a few half
+// float ulps in [0, 1], the 10 bit format is coarser than that
+constexpr float LUT_BACKEND_TOLERANCE = 2.0f / 1024.0f;
+
+// One channel per member, each holding simd::floatN::WIDTH texels
+struct rgbN
+{
+    simd::floatN r;
+    simd::floatN g;
+    simd::floatN b;
+};
+
+inline rgbN mulN(const glm::mat3& m, const rgbN& v)
+{
+    // glm matrices are column major: m[column][row]
+    return {
+        m[0][0] * v.r + m[1][0] * v.g + m[2][0] * v.b,
+        m[0][1] * v.r + m[1][1] * v.g + m[2][1] * v.b,
+        m[0][2] * v.r + m[1][2] * v.g + m[2][2] * v.b
+    };
+}
+
+inline simd::floatN dotN(const rgbN& v, glm::vec3 w)
+{
+    return w.x * v.r + w.y * v.g + w.z * v.b;
+}
+
+inline rgbN max0N(const rgbN& v)
+{
+    const simd::floatN zero = simd::splat(0.0f);
+    return { simd::max(v.r, zero), simd::max(v.g, zero), simd::max(v.b, zero) };
+}
+
+inline simd::floatN smoothstepN(float edge0, float edge1, simd::floatN x)
+{
+    const simd::floatN t = simd::saturate((x - edge0) * simd::splat(1.0f / (edge1 - edge0)));
+    return t * t * (3.0f - 2.0f * t);
+}
+
+// Same curves as LogC_to_linear() and linear_to_LogC()
+inline simd::floatN LogC_to_linearN(simd::floatN x)
+{
+    const float ia = 1.0f / 5.555556f;
+    const float b = 0.047996f;
+    const float ic = 1.0f / 0.244161f;
+    const float d = 0.386036f;
+    // 10^x == 2^(x * log2(10))
+    return (simd::exp2((x - d) * (ic * 3.32192809f)) - b) * ia;
+}
+
+inline simd::floatN linear_to_LogCN(simd::floatN x)
+{
+    const float a = 5.555556f;
+    const float b = 0.047996f;
+    const float c = 0.244161f;
+    const float d = 0.386036f;
+    return c * simd::log10(a * x + b) + d;
+}
+
+inline simd::floatN OETF_sRGBN(simd::floatN x)
+{
+    return simd::select(simd::lessEqual(x, simd::splat(0.0031308f)),
+        x * 12.92f, 1.055f * simd::pow(x, 1.0f / 2.4f) - 0.055f);
+}
+
+inline rgbN scotopicAdaptationN(rgbN v, float nightAdaptation)
+{
+    const ScotopicConstants& sc = getScotopicConstants();
+
+    v = { v.r * SCOTOPIC_LOG_EXPOSURE, v.g * SCOTOPIC_LOG_EXPOSURE, v.b * SCOTOPIC_LOG_EXPOSURE };
+
+    const rgbN q = { dotN(v, sc.L), dotN(v, sc.M), dotN(v, sc.S) };
+    const simd::floatN qw = dotN(v, sc.R);
+
+    const simd::floatN zero = simd::splat(0.0f);
+    const rgbN g = {
+        1.0f / simd::sqrt(1.0f + simd::max(zero, (0.33f / sc.m.x) * (q.r + sc.k.x * qw))),
+        1.0f / simd::sqrt(1.0f + simd::max(zero, (0.33f / sc.m.y) * (q.g + sc.k.y * qw))),
+        1.0f / simd::sqrt(1.0f + simd::max(zero, (0.33f / sc.m.z) * (q.b + sc.k.z * qw)))
+    };
+
+    const simd::floatN rod = qw * nightAdaptation;
+    const rgbN deltaOpponent = mulN(sc.weightedRodResponse, { g.r * rod, g.g * rod, g.b * rod });
+    const rgbN deltaLMS = mulN(sc.opponent_to_LMS, deltaOpponent);
+    const rgbN rgb = mulN(sc.LMS_to_RGB, { q.r + deltaLMS.r, q.g + deltaLMS.g, q.b + deltaLMS.b });
+
+    constexpr float inverseLogExposure = 1.0f / SCOTOPIC_LOG_EXPOSURE;
+    return { rgb.r * inverseLogExposure, rgb.g * inverseLogExposure, rgb.b * inverseLogExposure };
+}
+
+// gradeTexel() on simd::floatN::WIDTH texels.
+// The color grading input transform and the white balance are both linear and
+// back to back, so they are folded into workingTransform.
+static rgbN gradeBeforeToneMappingN(const LutBuildParams& params, const glm::mat3& workingTransform, rgbN v)
+{
+    v = { LogC_to_linearN(v.r), LogC_to_linearN(v.g), LogC_to_linearN(v.b) };
+    v = max0N(v);
+
+    if (params.hasAdjustments)
+    {
+        const float exposureScale = std::exp2(params.exposure);
+        v = { v.r * exposureScale, v.g * exposureScale, v.b * exposureScale };
+        v = scotopicAdaptationN(v, params.nightAdaptation);
+    }
+
+    v = mulN(workingTransform, v);
+
+    if (!params.hasAdjustments)
+    {
+        return v;
+    }
+
+    v = max0N(v);
+
+    // Channel mixer
+    v = { dotN(v, params.outRed), dotN(v, params.outGreen), dotN(v, params.outBlue) };
+
+    // Shadows/mid-tones/highlights
+    {
+        const glm::vec4& ranges = params.tonalRanges;
+        const simd::floatN y = dotN(v, params.config.colorGradingLuminance);
+        const simd::floatN s = 1.0f - smoothstepN(ranges.x, ranges.y, y);
+        const simd::floatN h = smoothstepN(ranges.z, ranges.w, y);
+        const simd::floatN m = 1.0f - s - h;
+        v = {
+            v.r * (s * params.shadows.r + m * params.midtones.r + h * params.highlights.r),
+            v.g * (s * params.shadows.g + m * params.midtones.g + h * params.highlights.g),
+            v.b * (s * params.shadows.b + m * params.midtones.b + h * params.highlights.b)
+        };
+    }
+
+    v = { linear_to_LogCN(v.r), linear_to_LogCN(v.g), linear_to_LogCN(v.b) };
+
+    // ASC CDL and contrast, per channel
+    simd::floatN* channels[3] = { &v.r, &v.g, &v.b };
+    for (int i = 0; i < 3; i++)
+    {
+        simd::floatN x = *channels[i] * params.slope[i] + params.offset[i];
+        x = simd::select(simd::lessEqual(x, simd::splat(0.0f)), x, simd::pow(x, params.power[i]));
+        x = MIDDLE_GRAY_ACEScct + params.contrast * (x - MIDDLE_GRAY_ACEScct);
+        *channels[i] = LogC_to_linearN(x);
+    }
+
+    // Vibrance: the weights of vibranceFunc() reduce to y + s * (v - y)
+    {
+        const simd::floatN r = v.r - simd::max(v.g, v.b);
+        const simd::floatN s = (params.vibrance - 1.0f) / (1.0f + simd::exp(r * -3.0f)) + 1.0f;
+        const simd::floatN y = dotN(v, params.config.colorGradingLuminance);
+        v = { y + s * (v.r - y), y + s * (v.g - y), y + s * (v.b - y) };
+    }
+
+    // Saturation
+    {
+        const simd::floatN y = dotN(v, params.config.colorGradingLuminance);
+        v = { y + params.saturation * (v.r - y), y + params.saturation * (v.g - y), y + params.saturation * (v.b - y) };
+    }
+
+    v = max0N(v);
+
+    // RGB curves
+    for (int i = 0; i < 3; i++)
+    {
+        const float midPoint = params.midPoint[i];
+        const float d = 1.0f / std::pow(midPoint, params.shadowGamma[i] - 1.0f);
+        const simd::floatN x = *channels[i];
+        const simd::floatN dark = simd::pow(x, params.shadowGamma[i]) * d;
+        const simd::floatN light = params.highlightScale[i] * (x - midPoint) + midPoint;
+        *channels[i] = simd::select(simd::lessEqual(x, simd::splat(midPoint)), dark, light);
+    }
+    return v;
+}
+
+static void gradeLutSliceBatched(const LutBuildParams& params, size_t b, float* graded)
+{
+    constexpr size_t W = simd::floatN::WIDTH;
+    static_assert(LUT_BATCH_SIZE % W == 0, "LUT_BATCH_SIZE must be a multiple of the lane count");
+
+    const Config& c = params.config;
+    const LutPlanes dst = getLutSlicePlanes(c, graded, b);
+    const size_t sliceTexels = c.lutDimension * c.lutDimension;
+    const float step = 1.0f / float(c.lutDimension - 1u);
+    const glm::mat3 workingTransform = params.hasAdjustments ? c.adaptationTransform * c.colorGradingIn : c.colorGradingIn;
+
+    float r[LUT_BATCH_SIZE];
+    float g[LUT_BATCH_SIZE];
+    float bl[LUT_BATCH_SIZE];
+    for (size_t first = 0; first < sliceTexels; first += LUT_BATCH_SIZE)
     {
-        switch (this->toneMapping)
+        // the last batch of a slice can be short, pad it with copies of its last texel
+        const size_t n = std::min(LUT_BATCH_SIZE, sliceTexels - first);
+        for (size_t i = 0; i < LUT_BATCH_SIZE; i++)
+        {
+            const size_t texel = first + std::min(i, n - 1);
+            r[i] = float(texel % c.lutDimension) * step;
+            g[i] = float(texel / c.lutDimension) * step;
+            bl[i] = float(b) * step;
+        }
+
+        for (size_t i = 0; i < LUT_BATCH_SIZE; i += W)
         {
-        case ToneMapping::LINEAR:
-            this->toneMapper = new LinearToneMapper();
-            break;
-        case ToneMapping::ACES_LEGACY:
-            this->toneMapper = new ACESLegacyToneMapper();
-            break;
-        case ToneMapping::ACES:
-            this->toneMapper = new ACESToneMapper();
-            break;
-        case ToneMapping::AGX:
-            this->toneMapper = new AgxToneMapper(agxToneMapperSetting.look);
-            break;
-        case ToneMapping::GENERIC:
-            this->toneMapper = new GenericToneMapper(
-                genericToneMapperSetting.contrast,
-                genericToneMapperSetting.midGrayIn,
-                genericToneMapperSetting.midGrayOut,
-                genericToneMapperSetting.hdrMax
-            );
-            break;
-        case ToneMapping::FILMIC:
-            this->toneMapper = new FilmicToneMapper();
-            break;
-        case ToneMapping::DISPLAY_RANGE:
-            this->toneMapper = new DisplayRangeToneMapper();
-            break;
+            rgbN v = gradeBeforeToneMappingN(params, workingTransform, { simd::load(r + i), simd::load(g + i), simd::load(bl + i) });
+            simd::store(r + i, v.r);
+            simd::store(g + i, v.g);
+            simd::store(bl + i, v.b);
         }
+
+        std::copy(r, r + n, dst.r + first);
+        std::copy(g, g + n, dst.g + first);
+        std::copy(bl, bl + n, dst.b + first);
     }
+}
 
+// One ToneMapper::apply() call per pass over the slice instead of a virtual call per texel.
+// Luminance scaling has no batch version and runs per texel.
+static void toneMapLutSliceBatched(const LutBuildParams& params, size_t b, float* graded, float* toneMapped)
+{
+    const Config& c = params.config;
+    const LutPlanes src = getLutSlicePlanes(c, graded, b);
+    const LutPlanes dst = getLutSlicePlanes(c, toneMapped, b);
+    const size_t sliceTexels = c.lutDimension * c.lutDimension;
 
-    Config c;
-    std::mutex configLock;
+    if (params.luminanceScaling)
+    {
+        for (size_t i = 0; i < sliceTexels; i++)
+        {
+            glm::vec3 v = luminanceScalingFunc({ src.r[i], src.g[i], src.b[i] }, *params.toneMapper, c.colorGradingLuminance);
+            dst.r[i] = v.r; dst.g[i] = v.g; dst.b[i] = v.b;
+        }
+    }
+    else
     {
-        std::lock_guard<std::mutex> const lock(configLock);
-        c.lutDimension = this->dimension;
-        c.adaptationTransform = adaptationTransform(this->whiteBalance);
-        c.colorGradingIn = selectColorGradingTransformIn(this->toneMapping);
-        c.colorGradingOut = selectColorGradingTransformOut(this->toneMapping);
-        c.colorGradingLuminance = selectColorGradingLuminance(this->toneMapping);
-        c.oetf = selectOETF(this->outputColorSpace);
+        params.toneMapper->apply(src.r, src.g, src.b, sliceTexels, dst.r, dst.g, dst.b);
     }
-    size_t mDimension = c.lutDimension;
-    size_t lutElementCount = c.lutDimension * c.lutDimension * c.lutDimension;
-    size_t elementSize = sizeof(glm::half4);
+    // toneMapLutSlice() runs the tone mapper a second time, keep both paths identical
+    params.toneMapper->apply(dst.r, dst.g, dst.b, sliceTexels, dst.r, dst.g, dst.b);
+}
 
-    void* data = malloc(lutElementCount * elementSize);
+// Gamut mapping and custom OETFs have no lane version and run per texel.
+static void outputLutSliceBatched(const LutBuildParams& params, size_t b, float* toneMapped, glm::half4* data, uint32_t* converted)
+{
+    constexpr size_t W = simd::floatN::WIDTH;
+
+    const Config& c = params.config;
+    const LutPlanes src = getLutSlicePlanes(c, toneMapped, b);
+    const size_t sliceTexels = c.lutDimension * c.lutDimension;
+    const bool sRGBOETF = c.oetf == OETF_sRGB;
+    const bool linearOETF = c.oetf == OETF_Linear;
+
+    float r[LUT_BATCH_SIZE];
+    float g[LUT_BATCH_SIZE];
+    float bl[LUT_BATCH_SIZE];
+    glm::half4* p = data + b * sliceTexels;
+    for (size_t first = 0; first < sliceTexels; first += LUT_BATCH_SIZE)
+    {
+        // the cache is shared with later builds, work on a copy; pad short batches with the last texel
+        const size_t n = std::min(LUT_BATCH_SIZE, sliceTexels - first);
+        for (size_t i = 0; i < LUT_BATCH_SIZE; i++)
+        {
+            const size_t texel = first + std::min(i, n - 1);
+            r[i] = src.r[texel];
+            g[i] = src.g[texel];
+            bl[i] = src.b[texel];
+        }
 
-    auto [textureFormat, format, type] = selectLutTextureParams(this->format);
+        if (params.gamutMapping)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                glm::vec3 v = gamutMapping_sRGB({ r[i], g[i], bl[i] });
+                r[i] = v.r; g[i] = v.g; bl[i] = v.b;
+            }
+        }
 
+        for (size_t i = 0; i < LUT_BATCH_SIZE; i += W)
+        {
+            simd::floatN vr = simd::saturate(simd::load(r + i));
+            simd::floatN vg = simd::saturate(simd::load(g + i));
+            simd::floatN vb = simd::saturate(simd::load(bl + i));
+            if (sRGBOETF)
+            {
+                vr = OETF_sRGBN(vr);
+                vg = OETF_sRGBN(vg);
+                vb = OETF_sRGBN(vb);
+            }
+            simd::store(r + i, vr);
+            simd::store(g + i, vg);
+            simd::store(bl + i, vb);
+        }
+
+        for (size_t i = 0; i < n; i++)
+        {
+            glm::vec3 v{ r[i], g[i], bl[i] };
+            if (!sRGBOETF && !linearOETF)
+            {
+                v = c.oetf(v);
+            }
+            *p++ = glm::half4{ v, 0.0f };
+        }
+    }
 
-    void* converted = nullptr;
-    if (type == GL_UNSIGNED_INT_2_10_10_10_REV)
+    if (converted)
     {
-        // convert input to UINT_2_10_10_10_REV if needed
-        converted = malloc(lutElementCount * sizeof(uint32_t));
+        convertLutSlice(c, b, data, converted);
     }
+}
+
+//------------------------------------------------------------------------------
+// LUT build stages
+//------------------------------------------------------------------------------
+
+struct LutStageFunctions
+{
+    void (*grade)(const LutBuildParams&, size_t, float*);
+    void (*toneMap)(const LutBuildParams&, size_t, float*, float*);
+    void (*output)(const LutBuildParams&, size_t, float*, glm::half4*, uint32_t*);
+};
+
+static const LutStageFunctions SCALAR_LUT_STAGES = { &gradeLutSlice, &toneMapLutSlice, &outputLutSlice };
+static const LutStageFunctions BATCHED_LUT_STAGES = { &gradeLutSliceBatched, &toneMapLutSliceBatched, &outputLutSliceBatched };
+
+// Where the stages of a build read and write
+struct LutBuffers
+{
+    float* graded;          // output of LUT_STAGE_GRADING, see LutPlanes
+    float* toneMapped;      // output of LUT_STAGE_TONE_MAPPING, same layout
+    glm::half4* data;
+    uint32_t* converted;    // nullptr unless LutFormat::INTEGER
+};
 
+// Runs the requested stages for one blue slice. Slices are independent, each
+// stage only reads what the previous stage wrote for the same slice.
+static void buildLutSlice(const LutStageFunctions& functions, const LutBuildParams& params,
+    uint8_t stages, size_t b, const LutBuffers& buffers)
+{
+    if (stages & CColorGradingPass::LUT_STAGE_GRADING)
+    {
+        functions.grade(params, b, buffers.graded);
+    }
+    if (stages & CColorGradingPass::LUT_STAGE_TONE_MAPPING)
+    {
+        functions.toneMap(params, b, buffers.graded, buffers.toneMapped);
+    }
+    if (stages & CColorGradingPass::LUT_STAGE_OUTPUT)
+    {
+        functions.output(params, b, buffers.toneMapped, buffers.data, buffers.converted);
+    }
+}
 
-    std::vector<std::thread> js(c.lutDimension);
-    for (size_t b = 0; b < c.lutDimension; b++)
+// Builds the whole LUT on the calling thread with both backends, then logs the
+// time of every stage and the largest difference between the two results. The
+// tone mapping and output columns are what an edit of the tone mapper or of the
+// output color space costs. Returns false when the batched LUT is off tolerance.
+static bool benchmarkLutBackends(const LutBuildParams& params)
+{
+    using Clock = std::chrono::steady_clock;
+    const size_t lutDimension = params.config.lutDimension;
+    const size_t lutElementCount = lutDimension * lutDimension * lutDimension;
+    std::vector<float> graded(3 * lutElementCount);
+    std::vector<float> toneMapped(3 * lutElementCount);
+    std::vector<glm::half4> luts[2] = { std::vector<glm::half4>(lutElementCount), std::vector<glm::half4>(lutElementCount) };
+
+    std::cout << "Color grading LUT benchmark: " << lutDimension << "^3 texels, 1 thread, "
+        << simd::floatN::WIDTH << " lanes" << std::endl;
+
+    const LutStageFunctions* backends[2] = { &SCALAR_LUT_STAGES, &BATCHED_LUT_STAGES };
+    const char* backendNames[2] = { "scalar ", "batched" };
+    const uint8_t stages[3] = { CColorGradingPass::LUT_STAGE_GRADING, CColorGradingPass::LUT_STAGE_TONE_MAPPING, CColorGradingPass::LUT_STAGE_OUTPUT };
+    float totalMs[2] = {};
+    for (size_t i = 0; i < 2; i++)
     {
-        js[b] = std::thread(
-            [data, converted, b, &c, &configLock, this]()
+        const LutBuffers buffers = { graded.data(), toneMapped.data(), luts[i].data(), nullptr };
+        float stageMs[3];
+        for (size_t k = 0; k < 3; k++)
+        {
+            const auto start = Clock::now();
+            for (size_t b = 0; b < lutDimension; b++)
             {
-                Config config;
-                {
-                    std::lock_guard<std::mutex> lock(configLock);
-                    config = c;
-                }
-                glm::half4* p = (glm::half4*)data + b * config.lutDimension * config.lutDimension;
-                for (size_t g = 0; g < config.lutDimension; g++) {
-                    for (size_t r = 0; r < config.lutDimension; r++) {
-                        glm::vec3 v = glm::vec3{ r, g, b } *(1.0f / float(config.lutDimension - 1u));
-
-                        // LogC encoding
-                        v = LogC_to_linear(v);
-
-                        // Kill negative values near 0.0f due to imprecision in the log conversion
-                        v = max(v, 0.0f);
-
-                        if (this->hasAdjustments) 
-                        {
-                            // Exposure
-                            v = adjustExposure(v, this->exposure);
-                            // Purkinje shift ("low-light" vision)
-                            v = scotopicAdaptation(v, this->nightAdaptation);
-                        }
-
-
-                        v = c.colorGradingIn * v;
-
-                        if (this->hasAdjustments)
-                        {
-                            // White balance
-                            v = chromaticAdaptation(v, config.adaptationTransform);
-
-                            // Kill negative values before the next transforms
-                            v = max(v, 0.0f);
-
-                            // Channel mixer
-                            v = channelMixer(v, this->outRed, this->outGreen, this->outBlue);
-
-                            // Shadows/mid-tones/highlights
-                            v = tonalRangesFunc(v, c.colorGradingLuminance,
-                                this->shadows, this->midtones, this->highlights,
-                                this->tonalRanges);
-
-                            // The adjustments below behave better in log space
-                            v = linear_to_LogC(v);
-
-                            // ASC CDL
-                            v = colorDecisionList(v, this->slope, this->offset, this->power);
-
-                            // Contrast in log space
-                            v = contrastFunc(v, this->contrast);
-
-                            // Back to linear space
-                            v = LogC_to_linear(v);
-
-                            // Vibrance in linear space
-                            v = vibranceFunc(v, c.colorGradingLuminance, this->vibrance);
-
-                            // Saturation in linear space
-                            v = saturationFunc(v, c.colorGradingLuminance, this->saturation);
-
-                            // Kill negative values before curves
-                            v = max(v, 0.0f);
-
-                            // RGB curves
-                            v = curves(v,
-                                this->shadowGamma, this->midPoint, this->highlightScale);
-                        }
-
-                        if (this->luminanceScaling) 
-                        {
-                            v = luminanceScalingFunc(v, *this->toneMapper, c.colorGradingLuminance);
-                        }
-                        else 
-                        {
-                            v = (*this->toneMapper)(v);
-                        }
-                        v = (*this->toneMapper)(v);
-                        // Apply gamut mapping
-                        if (this->gamutMapping)
-                        {
-                            // TODO: This should depend on the output color space
-                            v = gamutMapping_sRGB(v);
-                        }
-
-                        // TODO: We should convert to the output color space if we use a working
-                        //       color space that's not sRGB
-                        // TODO: Allow the user to customize the output color space
-
-                        // We need to clamp for the output transfer function
-                        v = glm::saturate(v);
-
-                        // Apply OETF
-                        v = c.oetf(v);
-
-                        *p++ = glm::half4{ v, 0.0f };
-                    }
-
-                }
-
-                if (converted) 
-                {
-                    uint32_t* const  dst = (uint32_t*)converted +
-                        b * config.lutDimension * config.lutDimension;
-                    glm::half4* src = (glm::half4*)data +
-                        b * config.lutDimension * config.lutDimension;
-                    // we use a vectorize width of 8 because, on ARMv8 it allows the compiler to write eight
-                    // 32-bits results in one go.
-                    const size_t count = (config.lutDimension * config.lutDimension) & ~0x7u; // tell the compiler that we're a multiple of 8
-#pragma clang loop vectorize_width(8)
-                    for (size_t i = 0; i < count; ++i) {
-                        glm::vec3 v{ src[i] };
-                        uint32_t pr = uint32_t(std::floor(v.x * 1023.0f + 0.5f));
-                        uint32_t pg = uint32_t(std::floor(v.y * 1023.0f + 0.5f));
-                        uint32_t pb = uint32_t(std::floor(v.z * 1023.0f + 0.5f));
-                        dst[i] = (pb << 20u) | (pg << 10u) | pr;
-                    }
-                }
+                buildLutSlice(*backends[i], params, stages[k], b, buffers);
             }
-        );
-        js[b].join();
+            stageMs[k] = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+            totalMs[i] += stageMs[k];
+        }
+
+        std::cout << "  " << backendNames[i] << ": " << totalMs[i] << " ms, " << lutElementCount / totalMs[i] * 1e-3f << " Mtexels/s"
+            << " (grading " << stageMs[0] << " ms, tone mapping " << stageMs[1] << " ms, output " << stageMs[2] << " ms)";
+        if (i == 1)
+        {
+            std::cout << ", x" << totalMs[0] / totalMs[1] << " vs scalar";
+        }
+        std::cout << std::endl;
+    }
+
+    float maxError = 0.0f;
+    for (size_t i = 0; i < lutElementCount; i++)
+    {
+        const glm::vec3 d = glm::abs(glm::vec3(luts[0][i]) - glm::vec3(luts[1][i]));
+        maxError = std::max(maxError, std::max(d.x, std::max(d.y, d.z)));
     }
+    std::cout << "  max |error| batched vs scalar: " << maxError << std::endl;
+
+    if (maxError > LUT_BACKEND_TOLERANCE)
+    {
+        std::cerr << "Error::ColorGrading:: batched LUT differs from the scalar LUT by " << maxError << std::endl;
+        return false;
+    }
+    return true;
+}
+
+
+//------------------------------------------------------------------------------
+// Compute shader backend
+//------------------------------------------------------------------------------
+
+// local_size of ColorGradingLut_CS.glsl on every axis
+constexpr GLuint LUT_COMPUTE_GROUP_SIZE = 4;
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdeprecated-declarations"
+// Index of the tone mapper in ColorGradingLut_CS.glsl, the same as ToneMapping.
+// -1 for a ToneMapper the shader does not know.
+static int selectComputeToneMapper(const ToneMapper& toneMapper) noexcept
+{
+    using ToneMapping = CColorGradingPass::ToneMapping;
+    if (dynamic_cast<const LinearToneMapper*>(&toneMapper))         return int(ToneMapping::LINEAR);
+    if (dynamic_cast<const ACESLegacyToneMapper*>(&toneMapper))     return int(ToneMapping::ACES_LEGACY);
+    if (dynamic_cast<const ACESToneMapper*>(&toneMapper))           return int(ToneMapping::ACES);
+    if (dynamic_cast<const FilmicToneMapper*>(&toneMapper))         return int(ToneMapping::FILMIC);
+    if (dynamic_cast<const AgxToneMapper*>(&toneMapper))            return int(ToneMapping::AGX);
+    if (dynamic_cast<const GenericToneMapper*>(&toneMapper))        return int(ToneMapping::GENERIC);
+    if (dynamic_cast<const DisplayRangeToneMapper*>(&toneMapper))   return int(ToneMapping::DISPLAY_RANGE);
+    return -1;
+}
+#pragma clang diagnostic pop
+
+// CShader has no mat3 setter, the shader reads the upper left corner of a mat4
+static void setMat3UniformValue(CShader& shader, const std::string& name, const glm::mat3& m)
+{
+    shader.setMat4UniformValue(name, glm::value_ptr(glm::mat4(m)));
+}
 
+static void setVec3UniformValue(CShader& shader, const std::string& name, glm::vec3 v)
+{
+    shader.setFloatUniformValue(name, v.x, v.y, v.z);
+}
+
+// Reads back the LUT baked by ColorGradingLut_CS.glsl and compares it with the
+// scalar chain, which stays the reference for every backend. Returns false when
+// the baked LUT is off tolerance.
+static bool validateComputeLut(const LutBuildParams& params, GLuint lutTexture, float gpuMs)
+{
+    using Clock = std::chrono::steady_clock;
+    const size_t lutDimension = params.config.lutDimension;
+    const size_t lutElementCount = lutDimension * lutDimension * lutDimension;
+    std::vector<float> graded(3 * lutElementCount);
+    std::vector<float> toneMapped(3 * lutElementCount);
+    std::vector<glm::half4> reference(lutElementCount);
+    std::vector<glm::half4> baked(lutElementCount);
+
+    const auto start = Clock::now();
+    const LutBuffers buffers = { graded.data(), toneMapped.data(), reference.data(), nullptr };
+    for (size_t b = 0; b < lutDimension; b++)
+    {
+        buildLutSlice(SCALAR_LUT_STAGES, params, CColorGradingPass::LUT_STAGE_ALL, b, buffers);
+    }
+    const float cpuMs = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
 
-    //std::chrono::duration<float, std::milli> duration = std::chrono::steady_clock::now() - now;
-    //slog.d << "LUT generation time: " << duration.count() << " ms" << io::endl;
+    glBindTexture(GL_TEXTURE_3D, lutTexture);
+    glGetTexImage(GL_TEXTURE_3D, 0, GL_RGBA, GL_HALF_FLOAT, baked.data());
+    glBindTexture(GL_TEXTURE_3D, 0);
 
+    float maxError = 0.0f;
+    for (size_t i = 0; i < lutElementCount; i++)
+    {
+        const glm::vec3 d = glm::abs(glm::vec3(reference[i]) - glm::vec3(baked[i]));
+        for (int k = 0; k < 3; k++)
+        {
+            // a NaN texel must fail the check
+            maxError = std::isnan(d[k]) ? std::numeric_limits<float>::infinity() : std::max(maxError, d[k]);
+        }
+    }
 
-    auto mLutHandle = std::make_shared<ElayGraphics::STexture>();
+    std::cout << "Color grading LUT compute bake: " << lutDimension << "^3 texels, " << gpuMs << " ms, "
+        << lutElementCount / gpuMs * 1e-3f << " Mtexels/s (scalar CPU reference " << cpuMs << " ms, 1 thread)" << std::endl;
+    std::cout << "  max |error| compute vs scalar: " << maxError << std::endl;
+    if (maxError > LUT_BACKEND_TOLERANCE)
+    {
+        std::cerr << "Error::ColorGrading:: compute LUT differs from the scalar LUT by " << maxError << std::endl;
+        return false;
+    }
+    return true;
+}
 
-    mLutHandle->TextureType = ElayGraphics::STexture::ETextureType::Texture3D;
-    mLutHandle->InternalFormat = textureFormat;
-    mLutHandle->ExternalFormat = format;
-    mLutHandle->DataType = type;
-    mLutHandle->Width = c.lutDimension;
-    mLutHandle->Height = c.lutDimension;
-    mLutHandle->Depth = c.lutDimension;
 
-    mLutHandle->pDataSet.resize(1);
-    mLutHandle->pDataSet[0] = data;
-  
+CColorGradingPass::CColorGradingPass(const std::string& vPassName, int vExcutionOrder) : IRenderPass(vPassName, vExcutionOrder)
+{
     
 
-    mLutHandle->Type4WrapS = GL_CLAMP_TO_BORDER;
-    mLutHandle->Type4WrapT = GL_CLAMP_TO_BORDER;
-    mLutHandle->BorderColor = { 0,0,0,0 };
-    genTexture(mLutHandle);
-    free(data);
 
+}
+
+CColorGradingPass::~CColorGradingPass()
+{
+    // the jobs write straight into the staging buffers
+    for (auto& staging : lutStaging)
+    {
+        if (staging.jobs)
+        {
+            staging.jobs->cancel();
+            ElayGraphics::ResourceManager::getOrCreateJobSystem()->wait(staging.jobs);
+        }
+    }
+}
+
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdeprecated-declarations"
+std::shared_ptr<const ToneMapper> CColorGradingPass::__createToneMapper() const
+{
+    // A tone mapper set through setToneMapper() is owned by the caller
+    if (this->toneMapper)
+    {
+        return std::shared_ptr<const ToneMapper>(this->toneMapper, [](const ToneMapper*) {});
+    }
 
-    ElayGraphics::ResourceManager::registerSharedData("ColorGradingTexture", mLutHandle);
-    ElayGraphics::ResourceManager::registerSharedData("mLutHandle", mLutHandle);
+    // Fallback for clients that still use the deprecated ToneMapping API
+    switch (this->toneMapping)
+    {
+    case ToneMapping::LINEAR:
+        return std::make_shared<LinearToneMapper>();
+    case ToneMapping::ACES:
+        return std::make_shared<ACESToneMapper>();
+    case ToneMapping::AGX:
+        return std::make_shared<AgxToneMapper>(agxToneMapperSetting.look);
+    case ToneMapping::GENERIC:
+        return std::make_shared<GenericToneMapper>(
+            genericToneMapperSetting.contrast,
+            genericToneMapperSetting.midGrayIn,
+            genericToneMapperSetting.midGrayOut,
+            genericToneMapperSetting.hdrMax
+        );
+    case ToneMapping::FILMIC:
+        return std::make_shared<FilmicToneMapper>();
+    case ToneMapping::DISPLAY_RANGE:
+        return std::make_shared<DisplayRangeToneMapper>();
+    case ToneMapping::ACES_LEGACY:
+    default:
+        return std::make_shared<ACESLegacyToneMapper>();
+    }
+}
 
+// Starts building the LUT for the current settings on the job system. Only the
+// dirty stages and the ones after them run, the others are read from the stage
+// caches of the staging half the build goes to. A build still in flight is
+// cancelled, its result would be stale anyway, and finishes its current slice
+// in its own half while the new one starts. The compute backend bakes the whole
+// LUT right away instead.
+void CColorGradingPass::__requestLutBuild()
+{
+    const auto& jobSystem = ElayGraphics::ResourceManager::getOrCreateJobSystem();
 
-    if (needToneMapper)
+    LutStaging& previous = lutStaging[lutBuildIndex];
+    if (previous.jobs && !previous.jobs->isDone())
     {
-        delete this->toneMapper;
-        this->toneMapper = nullptr;
+        // slices it did not reach still hold older results, so its stages must run again
+        previous.jobs->cancel();
+        previous.staleStages |= previous.stages;
     }
-   
+    previous.pendingUpload = false;
+    for (auto& half : lutStaging)
+    {
+        half.staleStages |= lutDirtyStages;
+    }
+    lutDirtyStages = 0;
+
+    auto params = std::make_shared<LutBuildParams>();
+    params->config.lutDimension = this->dimension;
+    params->config.adaptationTransform = adaptationTransform(this->whiteBalance);
+    params->config.colorGradingIn = selectColorGradingTransformIn(this->toneMapping);
+    params->config.colorGradingOut = selectColorGradingTransformOut(this->toneMapping);
+    params->config.colorGradingLuminance = selectColorGradingLuminance(this->toneMapping);
+    params->config.oetf = selectOETF(this->outputColorSpace);
+    params->toneMapper = __createToneMapper();
+    params->hasAdjustments = this->hasAdjustments;
+    params->luminanceScaling = this->luminanceScaling;
+    params->gamutMapping = this->gamutMapping;
+    params->exposure = this->exposure;
+    params->nightAdaptation = this->nightAdaptation;
+    params->outRed = this->outRed;
+    params->outGreen = this->outGreen;
+    params->outBlue = this->outBlue;
+    params->shadows = this->shadows;
+    params->midtones = this->midtones;
+    params->highlights = this->highlights;
+    params->tonalRanges = this->tonalRanges;
+    params->slope = this->slope;
+    params->offset = this->offset;
+    params->power = this->power;
+    params->contrast = this->contrast;
+    params->vibrance = this->vibrance;
+    params->saturation = this->saturation;
+    params->shadowGamma = this->shadowGamma;
+    params->midPoint = this->midPoint;
+    params->highlightScale = this->highlightScale;
+
+    if (this->lutBackend == LutBackend::COMPUTE && __bakeLutOnGpu(*params))
+    {
+        // every stage ran on the GPU, the CPU stage caches keep their stale bits
+        return;
+    }
+
+    lutBuildIndex ^= 1;
+    LutStaging& staging = lutStaging[lutBuildIndex];
+    if (staging.jobs)
+    {
+        // the build of two requests ago, almost always done by now
+        if (!staging.jobs->isDone())
+        {
+            staging.jobs->cancel();
+            staging.staleStages |= staging.stages;
+        }
+        jobSystem->wait(staging.jobs);
+    }
+
+    const size_t lutDimension = this->dimension;
+    const size_t lutElementCount = lutDimension * lutDimension * lutDimension;
+    if (staging.cachedDimension != lutDimension)
+    {
+        staging.gradedLut.resize(3 * lutElementCount);
+        staging.toneMappedLut.resize(3 * lutElementCount);
+        staging.cachedDimension = lutDimension;
+        staging.staleStages |= LUT_STAGE_ALL;
+    }
+    // every stage reads the output of the one before, rerun everything from the first stale stage on
+    const uint8_t firstDirtyStage = staging.staleStages & uint8_t(-staging.staleStages);
+    const uint8_t stages = firstDirtyStage ? uint8_t(LUT_STAGE_ALL & ~(firstDirtyStage - 1)) : uint8_t(LUT_STAGE_OUTPUT);
+    staging.staleStages = 0;
+
+    // the staging vectors only grow, so regrading at a fixed size never allocates
+    staging.data.resize(lutElementCount);
+    if (this->format == LutFormat::INTEGER)
+    {
+        staging.converted.resize(lutElementCount);
+    }
+    staging.dimension = lutDimension;
+    staging.format = this->format;
+    staging.stages = stages;
+    staging.pendingUpload = true;
+    staging.jobs = jobSystem->createGroup();
+
+    if (runLutBenchmark)
+    {
+        runLutBenchmark = false;
+        if (!benchmarkLutBackends(*params) && this->lutBackend == LutBackend::BATCHED)
+        {
+            std::cerr << "Error::ColorGrading:: falling back to the scalar LUT backend" << std::endl;
+            this->lutBackend = LutBackend::SCALAR;
+        }
+    }
+
+    const LutBuffers buffers = {
+        staging.gradedLut.data(),
+        staging.toneMappedLut.data(),
+        staging.data.data(),
+        this->format == LutFormat::INTEGER ? staging.converted.data() : nullptr
+    };
+    CJobGroup* jobs = staging.jobs.get();
+    const LutStageFunctions* functions = this->lutBackend == LutBackend::SCALAR ? &SCALAR_LUT_STAGES : &BATCHED_LUT_STAGES;
+    // one job per blue slice, idle workers steal the remaining slices
+    jobSystem->parallelFor(staging.jobs, 0, lutDimension, 1,
+        [params, buffers, stages, jobs, functions](size_t begin, size_t end)
+        {
+            for (size_t b = begin; b < end && !jobs->isCancelled(); b++)
+            {
+                buildLutSlice(*functions, *params, stages, b, buffers);
+            }
+        });
+}
+
+// Uploads the last requested LUT once all of its slices are done. The texture
+// is only recreated when the dimension or the format changes.
+void CColorGradingPass::__uploadFinishedLut()
+{
+    LutStaging& staging = lutStaging[lutBuildIndex];
+    if (!staging.pendingUpload || !staging.jobs->isDone() || staging.jobs->isCancelled())
+    {
+        return;
+    }
+    staging.pendingUpload = false;
+
+    __ensureLutTexture(staging.dimension, staging.format);
+
+    auto [textureFormat, format, type] = selectLutTextureParams(staging.format);
+    const GLsizei lutDimension = GLsizei(staging.dimension);
+    const void* pixels = staging.format == LutFormat::INTEGER ? (const void*)staging.converted.data() : (const void*)staging.data.data();
+    glBindTexture(GL_TEXTURE_3D, lutTexture->TextureID);
+    glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, lutDimension, lutDimension, lutDimension, format, type, pixels);
+    glBindTexture(GL_TEXTURE_3D, 0);
+}
+
+// Creates lutTexture, or recreates it when the dimension or the format changes
+void CColorGradingPass::__ensureLutTexture(size_t lutDimension, LutFormat lutFormat)
+{
+    auto [textureFormat, format, type] = selectLutTextureParams(lutFormat);
+    const GLsizei dimension = GLsizei(lutDimension);
+    if (!lutTexture || lutTexture->Width != dimension || lutTexture->InternalFormat != GLint(textureFormat))
+    {
+        if (lutTexture)
+            fetchGLStateCache().deleteTextures(1, &(GLuint&)lutTexture->TextureID);
+        lutTexture = std::make_shared<ElayGraphics::STexture>();
+        lutTexture->TextureType = ElayGraphics::STexture::ETextureType::Texture3D;
+        lutTexture->InternalFormat = textureFormat;
+        lutTexture->ExternalFormat = format;
+        lutTexture->DataType = type;
+        lutTexture->Width = dimension;
+        lutTexture->Height = dimension;
+        lutTexture->Depth = dimension;
+        lutTexture->Type4WrapS = GL_CLAMP_TO_BORDER;
+        lutTexture->Type4WrapT = GL_CLAMP_TO_BORDER;
+        lutTexture->BorderColor = { 0,0,0,0 };
+        genTexture(lutTexture);
+
+        ElayGraphics::ResourceManager::updateSharedDataByName("ColorGradingTexture", lutTexture);
+        ElayGraphics::ResourceManager::updateSharedDataByName("mLutHandle", lutTexture);
+    }
+}
+
+// Bakes every stage of the LUT with ColorGradingLut_CS.glsl straight into
+// lutTexture, on the GL thread. Returns false when the shader has no port of the
+// tone mapper, the caller then builds the LUT on the CPU.
+bool CColorGradingPass::__bakeLutOnGpu(const LutBuildParams& params)
+{
+    const int toneMapperIndex = selectComputeToneMapper(*params.toneMapper);
+    if (toneMapperIndex < 0)
+    {
+        return false;
+    }
+
+    if (!lutBakeShader)
+    {
+        lutBakeShader = std::make_shared<CShader>("ColorGradingLut_CS.glsl");
+    }
+    // the image is declared rgba16f, LutFormat::INTEGER bakes at the same precision
+    __ensureLutTexture(params.config.lutDimension, LutFormat::FLOAT);
+    lutTexture->ImageBindUnit = 0;
+
+    const Config& c = params.config;
+    const ScotopicConstants& sc = getScotopicConstants();
+    CShader& shader = *lutBakeShader;
+    shader.activeShader();
+    shader.setImageUniformValue(lutTexture);
+    shader.setIntUniformValue("u_LutDimension", GLint(c.lutDimension));
+    shader.setIntUniformValue("u_HasAdjustments", params.hasAdjustments);
+    shader.setFloatUniformValue("u_Exposure", params.exposure);
+    shader.setFloatUniformValue("u_NightAdaptation", params.nightAdaptation);
+    setMat3UniformValue(shader, "u_ColorGradingIn", c.colorGradingIn);
+    setMat3UniformValue(shader, "u_AdaptationTransform", c.adaptationTransform);
+    setVec3UniformValue(shader, "u_ColorGradingLuminance", c.colorGradingLuminance);
+    setVec3UniformValue(shader, "u_OutRed", params.outRed);
+    setVec3UniformValue(shader, "u_OutGreen", params.outGreen);
+    setVec3UniformValue(shader, "u_OutBlue", params.outBlue);
+    setVec3UniformValue(shader, "u_Shadows", params.shadows);
+    setVec3UniformValue(shader, "u_Midtones", params.midtones);
+    setVec3UniformValue(shader, "u_Highlights", params.highlights);
+    shader.setFloatUniformValue("u_TonalRanges", params.tonalRanges.x, params.tonalRanges.y, params.tonalRanges.z, params.tonalRanges.w);
+    setVec3UniformValue(shader, "u_Slope", params.slope);
+    setVec3UniformValue(shader, "u_Offset", params.offset);
+    setVec3UniformValue(shader, "u_Power", params.power);
+    shader.setFloatUniformValue("u_Contrast", params.contrast);
+    shader.setFloatUniformValue("u_Vibrance", params.vibrance);
+    shader.setFloatUniformValue("u_Saturation", params.saturation);
+    setVec3UniformValue(shader, "u_ShadowGamma", params.shadowGamma);
+    setVec3UniformValue(shader, "u_MidPoint", params.midPoint);
+    setVec3UniformValue(shader, "u_HighlightScale", params.highlightScale);
+
+    setVec3UniformValue(shader, "u_ScotopicL", sc.L);
+    setVec3UniformValue(shader, "u_ScotopicM", sc.M);
+    setVec3UniformValue(shader, "u_ScotopicS", sc.S);
+    setVec3UniformValue(shader, "u_ScotopicR", sc.R);
+    setVec3UniformValue(shader, "u_ScotopicConeSensitivity", sc.m);
+    setVec3UniformValue(shader, "u_ScotopicRodStrength", sc.k);
+    setMat3UniformValue(shader, "u_ScotopicLMS_to_RGB", sc.LMS_to_RGB);
+    setMat3UniformValue(shader, "u_ScotopicOpponent_to_LMS", sc.opponent_to_LMS);
+    setMat3UniformValue(shader, "u_ScotopicWeightedRodResponse", sc.weightedRodResponse);
+
+    shader.setIntUniformValue("u_ToneMapper", toneMapperIndex);
+    if (const auto* agx = dynamic_cast<const AgxToneMapper*>(params.toneMapper.get()))
+    {
+        shader.setIntUniformValue("u_AgxLook", GLint(agx->look));
+    }
+    if (const auto* generic = dynamic_cast<const GenericToneMapper*>(params.toneMapper.get()))
+    {
+        shader.setFloatUniformValue("u_GenericToneMapper",
+            generic->getContrast(), generic->getMidGrayIn(), generic->getMidGrayOut(), generic->getHdrMax());
+    }
+    shader.setIntUniformValue("u_LuminanceScaling", params.luminanceScaling);
+    shader.setIntUniformValue("u_GamutMapping", params.gamutMapping);
+    shader.setIntUniformValue("u_LinearOETF", c.oetf == OETF_Linear);
+
+    using Clock = std::chrono::steady_clock;
+    const bool isChecked = runLutBenchmark || !isComputeLutChecked;
+    if (isChecked)
+    {
+        // only time the bake itself
+        glFinish();
+    }
+    const auto start = Clock::now();
+
+    const GLuint groupCount = GLuint((c.lutDimension + LUT_COMPUTE_GROUP_SIZE - 1) / LUT_COMPUTE_GROUP_SIZE);
+    glDispatchCompute(groupCount, groupCount, groupCount);
+    // the LUT is sampled by the color grading pass and may be read back below
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+    if (isChecked)
+    {
+        glFinish();
+        const float gpuMs = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+        runLutBenchmark = false;
+        isComputeLutChecked = true;
+        if (!validateComputeLut(params, lutTexture->TextureID, gpuMs))
+        {
+            // the scalar chain is the reference, build on the CPU from now on
+            std::cerr << "Error::ColorGrading:: falling back to the batched CPU LUT backend" << std::endl;
+            this->lutBackend = LutBackend::BATCHED;
+            return false;
+        }
+    }
+    return true;
+}
+
+void CColorGradingPass::initV()
+{
+    ElayGraphics::ResourceManager::registerSharedData("ColorGradingTexture", lutTexture);
+    ElayGraphics::ResourceManager::registerSharedData("mLutHandle", lutTexture);
+
+    // the first LUT is needed before the first frame
+    __requestLutBuild();
+    if (lutStaging[lutBuildIndex].jobs)
+    {
+        ElayGraphics::ResourceManager::getOrCreateJobSystem()->wait(lutStaging[lutBuildIndex].jobs);
+    }
+    __uploadFinishedLut();
+
     m_pShader = std::make_shared<CShader>("ColorGrading_VS.glsl", "ColorGrading_FS.glsl");
     taaShader = std::make_shared<CShader>("Taa_VS.glsl", "Taa_FS.glsl");
+    SPipelineStateDesc taaPipelineDesc;
+    taaPipelineDesc.pShader = taaShader;
+    m_TaaPipeline = CPipelineState(taaPipelineDesc);
+    SPipelineStateDesc gradingPipelineDesc;
+    gradingPipelineDesc.pShader = m_pShader;
+    m_GradingPipeline = CPipelineState(gradingPipelineDesc);
 
 
     auto TextureConfig4Albedo = std::make_shared<ElayGraphics::STexture>();
@@ -812,15 +1716,26 @@ void CColorGradingPass::initV()
     taaFBO = genFBO({ TextureConfig4Albedo});
     ElayGraphics::ResourceManager::registerSharedData("TaaAlbedo", TextureConfig4Albedo);
 
+    colorGradingSettingData = ElayGraphics::ResourceManager::SharedDataHandle<ColorGradingSettings>("ColorGradingSetting");
+    albedoTextureData = ElayGraphics::ResourceManager::SharedDataHandle<std::shared_ptr<ElayGraphics::STexture>>("TextureConfig4Albedo");
+    lutTextureData = ElayGraphics::ResourceManager::SharedDataHandle<std::shared_ptr<ElayGraphics::STexture>>("mLutHandle");
+    depthTextureData = ElayGraphics::ResourceManager::SharedDataHandle<std::shared_ptr<ElayGraphics::STexture>>("DepthTexture");
+    taaAlbedoData = ElayGraphics::ResourceManager::SharedDataHandle<std::shared_ptr<ElayGraphics::STexture>>("TaaAlbedo");
+
 }
 
 
 ColorGradingSettings currentColorGradingSetting;
 void CColorGradingPass::updateV()
 {
-    auto setting = ElayGraphics::ResourceManager::getSharedDataByName<ColorGradingSettings>("ColorGradingSetting");
+    const ColorGradingSettings& setting = colorGradingSettingData.get();
     if (setting != currentColorGradingSetting)
     {
+        lutDirtyStages |= setting.getChangedLutStages(currentColorGradingSetting);
+        if (!this->hasAdjustments)
+        {
+            lutDirtyStages |= LUT_STAGE_GRADING;
+        }
         this->hasAdjustments = true;
    
 
@@ -837,6 +1752,7 @@ void CColorGradingPass::updateV()
         
         //this->linkedCurves = setting.linkedCurves;
         this->luminanceScaling = setting.luminanceScaling;
+        this->gamutMapping = setting.gamutMapping;
         
         this->shadows = setting.shadows;
         this->midtones = setting.midtones;
@@ -866,237 +1782,18 @@ void CColorGradingPass::updateV()
         this->genericToneMapperSetting = setting.genericToneMapper;
         this->agxToneMapperSetting = setting.agxToneMapper;
         currentColorGradingSetting = setting;
-
-
-
-        // Fallback for clients that still use the deprecated ToneMapping API
-        bool needToneMapper = this->toneMapper == nullptr;
-        switch (this->toneMapping)
-        {
-        case ToneMapping::LINEAR:
-            this->toneMapper = new LinearToneMapper();
-            break;
-        case ToneMapping::ACES_LEGACY:
-            this->toneMapper = new ACESLegacyToneMapper();
-            break;
-        case ToneMapping::ACES:
-            this->toneMapper = new ACESToneMapper();
-            break;
-        case ToneMapping::AGX:
-            this->toneMapper = new AgxToneMapper(agxToneMapperSetting.look);
-            break;
-        case ToneMapping::GENERIC:
-            this->toneMapper = new GenericToneMapper(
-                genericToneMapperSetting.contrast,
-                genericToneMapperSetting.midGrayIn,
-                genericToneMapperSetting.midGrayOut,
-                genericToneMapperSetting.hdrMax
-            );
-            break;
-        case ToneMapping::FILMIC:
-            this->toneMapper = new FilmicToneMapper();
-            break;
-        case ToneMapping::DISPLAY_RANGE:
-            this->toneMapper = new DisplayRangeToneMapper();
-            break;
-        }
-
-
-        Config c;
-        std::mutex configLock;
-        {
-            std::lock_guard<std::mutex> const lock(configLock);
-            c.lutDimension = this->dimension;
-            c.adaptationTransform = adaptationTransform(this->whiteBalance);
-            c.colorGradingIn = selectColorGradingTransformIn(this->toneMapping);
-            c.colorGradingOut = selectColorGradingTransformOut(this->toneMapping);
-            c.colorGradingLuminance = selectColorGradingLuminance(this->toneMapping);
-            c.oetf = selectOETF(this->outputColorSpace);
-        }
-        size_t mDimension = c.lutDimension;
-        size_t lutElementCount = c.lutDimension * c.lutDimension * c.lutDimension;
-        size_t elementSize = sizeof(glm::half4);
-
-        void* data = malloc(lutElementCount * elementSize);
-
-        auto [textureFormat, format, type] = selectLutTextureParams(this->format);
-
-
-        void* converted = nullptr;
-        if (type == GL_UNSIGNED_INT_2_10_10_10_REV)
-        {
-            // convert input to UINT_2_10_10_10_REV if needed
-            converted = malloc(lutElementCount * sizeof(uint32_t));
-        }
-
-
-        std::vector<std::thread> js(c.lutDimension);
-        for (size_t b = 0; b < c.lutDimension; b++)
-        {
-            js[b] = std::thread(
-                [data, converted, b, &c, &configLock, this]()
-                {
-                    Config config;
-                    {
-                        std::lock_guard<std::mutex> lock(configLock);
-                        config = c;
-                    }
-                    glm::half4* p = (glm::half4*)data + b * config.lutDimension * config.lutDimension;
-                    for (size_t g = 0; g < config.lutDimension; g++) {
-                        for (size_t r = 0; r < config.lutDimension; r++) {
-                            glm::vec3 v = glm::vec3{ r, g, b } *(1.0f / float(config.lutDimension - 1u));
-
-                            // LogC encoding
-                            v = LogC_to_linear(v);
-
-                            // Kill negative values near 0.0f due to imprecision in the log conversion
-                            v = max(v, 0.0f);
-
-                            if (this->hasAdjustments)
-                            {
-                                // Exposure
-                                v = adjustExposure(v, this->exposure);
-                                // Purkinje shift ("low-light" vision)
-                                v = scotopicAdaptation(v, this->nightAdaptation);
-                            }
-
-
-                            v = c.colorGradingIn * v;
-
-                            if (this->hasAdjustments)
-                            {
-                                // White balance
-                                v = chromaticAdaptation(v, config.adaptationTransform);
-                                //
-                                // Kill negative values before the next transforms
-                                v = max(v, 0.0f);
-                            
-                                // Channel mixer
-                                v = channelMixer(v, this->outRed, this->outGreen, this->outBlue);
-                                //
-                                //// Shadows/mid-tones/highlights
-                                v = tonalRangesFunc(v, c.colorGradingLuminance,
-                                    this->shadows, this->midtones, this->highlights,
-                                    this->tonalRanges);
-                            
-                                // The adjustments below behave better in log space
-                                v = linear_to_LogC(v);
-                                
-                                // ASC CDL
-                                v = colorDecisionList(v, this->slope, this->offset, this->power);
-                                
-                                // Contrast in log space
-                                v = contrastFunc(v, this->contrast);
-                                
-                                //// Back to linear space
-                                v = LogC_to_linear(v);
-                                
-                                // Vibrance in linear space
-                                v = vibranceFunc(v, c.colorGradingLuminance, this->vibrance);
-                                //
-                                // Saturation in linear space
-                                v = saturationFunc(v, c.colorGradingLuminance, this->saturation);
-                            
-                                // Kill negative values before curves
-                                v = max(v, 0.0f);
-                                
-                                // RGB curves
-                                v = curves(v,
-                                    this->shadowGamma, this->midPoint, this->highlightScale);
-                            }
-
-                            if (this->luminanceScaling)
-                            {
-                                v = luminanceScalingFunc(v, *this->toneMapper, c.colorGradingLuminance);
-                            }
-                            else
-                            {
-                                v = (*this->toneMapper)(v);
-                            }
-                            v = (*this->toneMapper)(v);
-                            // Apply gamut mapping
-                            if (this->gamutMapping)
-                            {
-                                // TODO: This should depend on the output color space
-                                v = gamutMapping_sRGB(v);
-                            }
-
-                            // TODO: We should convert to the output color space if we use a working
-                            //       color space that's not sRGB
-                            // TODO: Allow the user to customize the output color space
-
-                            // We need to clamp for the output transfer function
-                            v = glm::saturate(v);
-
-                            // Apply OETF
-                            v = c.oetf(v);
-
-                            *p++ = glm::half4{ v, 0.0f };
-                        }
-
-                    }
-
-                    if (converted)
-                    {
-                        uint32_t* const  dst = (uint32_t*)converted +
-                            b * config.lutDimension * config.lutDimension;
-                        glm::half4* src = (glm::half4*)data +
-                            b * config.lutDimension * config.lutDimension;
-                        // we use a vectorize width of 8 because, on ARMv8 it allows the compiler to write eight
-                        // 32-bits results in one go.
-                        const size_t count = (config.lutDimension * config.lutDimension) & ~0x7u; // tell the compiler that we're a multiple of 8
-#pragma clang loop vectorize_width(8)
-                        for (size_t i = 0; i < count; ++i) {
-                            glm::vec3 v{ src[i] };
-                            uint32_t pr = uint32_t(std::floor(v.x * 1023.0f + 0.5f));
-                            uint32_t pg = uint32_t(std::floor(v.y * 1023.0f + 0.5f));
-                            uint32_t pb = uint32_t(std::floor(v.z * 1023.0f + 0.5f));
-                            dst[i] = (pb << 20u) | (pg << 10u) | pr;
-                        }
-                    }
-                }
-            );
-            js[b].join();
-        }
-
-        auto mLutHandle = std::make_shared<ElayGraphics::STexture>();
-        mLutHandle->TextureType = ElayGraphics::STexture::ETextureType::Texture3D;
-        mLutHandle->InternalFormat = textureFormat;
-        mLutHandle->ExternalFormat = format;
-        mLutHandle->DataType = type;
-        mLutHandle->Width = c.lutDimension;
-        mLutHandle->Height = c.lutDimension;
-        mLutHandle->Depth = c.lutDimension;
-
-        mLutHandle->pDataSet.resize(1);
-        mLutHandle->pDataSet[0] = data;
-
-
-
-        mLutHandle->Type4WrapS = GL_CLAMP_TO_BORDER;
-        mLutHandle->Type4WrapT = GL_CLAMP_TO_BORDER;
-        mLutHandle->BorderColor = { 0,0,0,0 };
-        genTexture(mLutHandle);
-        free(data);
-
-
-        ElayGraphics::ResourceManager::updateSharedDataByName("ColorGradingTexture", mLutHandle);
-        ElayGraphics::ResourceManager::updateSharedDataByName("mLutHandle", mLutHandle);
-
-        if (needToneMapper)
-        {
-            delete this->toneMapper;
-            this->toneMapper = nullptr;
-        }
-
     }
+    if (lutDirtyStages)
+    {
+        __requestLutBuild();
+    }
+    __uploadFinishedLut();
 
 
-
-    std::shared_ptr<ElayGraphics::STexture> ComputeTexture = (ElayGraphics::ResourceManager::getSharedDataByName<std::shared_ptr<ElayGraphics::STexture>>("TextureConfig4Albedo"));
-    std::shared_ptr<ElayGraphics::STexture> mLutHandle = (ElayGraphics::ResourceManager::getSharedDataByName<std::shared_ptr<ElayGraphics::STexture>>("mLutHandle"));
-    std::shared_ptr<ElayGraphics::STexture> depthTexture = (ElayGraphics::ResourceManager::getSharedDataByName<std::shared_ptr<ElayGraphics::STexture>>("DepthTexture"));
-    std::shared_ptr<ElayGraphics::STexture> TaaAlbedo = (ElayGraphics::ResourceManager::getSharedDataByName<std::shared_ptr<ElayGraphics::STexture>>("TaaAlbedo"));
+    const auto& ComputeTexture = albedoTextureData.get();
+    const auto& mLutHandle = lutTextureData.get();
+    const auto& depthTexture = depthTextureData.get();
+    const auto& TaaAlbedo = taaAlbedoData.get();
 
     static int pre_frameId = -1;
 
@@ -1174,10 +1871,11 @@ void CColorGradingPass::updateV()
         w /= sum;
     }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, taaFBO);
+    CGLStateCache& stateCache = fetchGLStateCache();
+    stateCache.bindFramebuffer(GL_FRAMEBUFFER, taaFBO);
+    m_TaaPipeline.apply();
     glClearColor(1, 0, 0, 1);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    taaShader->activeShader();
     taaShader->setTextureUniformValue("materialParams_color", ComputeTexture);
     taaShader->setTextureUniformValue("materialParams_depth", depthTexture);
     taaShader->setTextureUniformValue("materialParams_history", histroyTexture);
@@ -1203,10 +1901,10 @@ void CColorGradingPass::updateV()
 
     GLuint tempTBO;
     glGenFramebuffers(1, &tempTBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, tempTBO);
+    stateCache.bindFramebuffer(GL_FRAMEBUFFER, tempTBO);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, histroyTexture->TextureID, 0);
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, tempTBO);
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, taaFBO);
+    stateCache.bindFramebuffer(GL_DRAW_FRAMEBUFFER, tempTBO);
+    stateCache.bindFramebuffer(GL_READ_FRAMEBUFFER, taaFBO);
     //glDrawBuffers(1, fboBuffs);
     glReadBuffer(GL_COLOR_ATTACHMENT0);
     glBlitFramebuffer(0, 0, histroyTexture->Width, histroyTexture->Height, 0, 0, histroyTexture->Width, histroyTexture->Height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
@@ -1214,16 +1912,16 @@ void CColorGradingPass::updateV()
 
 
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    stateCache.bindFramebuffer(GL_FRAMEBUFFER, 0);
+    m_GradingPipeline.apply();
     glClearColor(1, 0, 0, 1);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    m_pShader->activeShader();
-    m_pShader->setFloatUniformValue("lutSize", 0.5f / this->dimension, (this->dimension - 1.0f) / this->dimension);
+    const float lutDimension = float(lutTexture->Width);
+    m_pShader->setFloatUniformValue("lutSize", 0.5f / lutDimension, (lutDimension - 1.0f) / lutDimension);
     
     m_pShader->setTextureUniformValue("u_Texture2D", TaaAlbedo);
     m_pShader->setTextureUniformValue("u_Grading3D", mLutHandle);
 
     drawQuad();
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
 }
@@ -8,7 +8,15 @@
 #include "ColorSpace.h"
 #include "RenderPass.h"
 #include "ToneMapper.h"
+#include "glmextend.h"
+#include "Interface.h"
+#include "PipelineState.h"
+#include <memory>
+#include <vector>
 //class ToneMapper;
+class CJobGroup;
+struct LutBuildParams;
+struct ColorGradingSettings;
 
 
 struct AgxToneMapperSettings
@@ -34,7 +42,7 @@ class CColorGradingPass : public IRenderPass
 {
 public:
     CColorGradingPass(const std::string& vPassName, int vExcutionOrder);
-    ~CColorGradingPass() = default;
+    ~CColorGradingPass();
     enum class QualityLevel : uint8_t 
     {
         LOW,
@@ -49,6 +57,23 @@ public:
         FLOAT,      //!< 16 bits per component (10 bits mantissa precision)
     };
 
+    enum class LutBackend : uint8_t
+    {
+        SCALAR,     //!< Reference chain, one texel at a time
+        BATCHED,    //!< Structure-of-arrays chain on SSE2/AVX2 lanes, one tone mapper call per batch
+        COMPUTE,    //!< ColorGradingLut_CS.glsl on the GL thread, always RGBA16F; BATCHED for a custom ToneMapper
+    };
+
+    // Stages of a LUT build, in order. The outputs of the first two are cached as
+    // float LUTs, so an edit only reruns its own stage and the ones after it.
+    enum LutStage : uint8_t
+    {
+        LUT_STAGE_GRADING = 1 << 0,         //!< Exposure, white balance, ... curves
+        LUT_STAGE_TONE_MAPPING = 1 << 1,    //!< Luminance scaling and tone mapper
+        LUT_STAGE_OUTPUT = 1 << 2,          //!< Gamut mapping, OETF, conversion to the LUT format
+        LUT_STAGE_ALL = LUT_STAGE_GRADING | LUT_STAGE_TONE_MAPPING | LUT_STAGE_OUTPUT
+    };
+
 
     /**
         * List of available tone-mapping operators.
@@ -96,12 +121,50 @@ public:
     void setSaturation(float saturation) noexcept;
     void setCurves(glm::vec3 shadowGamma, glm::vec3 midPoint, glm::vec3 highlightScale) noexcept;
     void setOutputColorSpace(const ColorSpace& colorSpace) noexcept;
+    // runBenchmark: the next LUT build also times both CPU backends and logs their difference,
+    // or for COMPUTE times the bake. A backend whose LUT differs from the scalar chain by more
+    // than the tolerance is dropped for a CPU one; COMPUTE is always checked on its first bake.
+    void setLutBackend(LutBackend backend, bool runBenchmark = false) noexcept;
 
     virtual void initV();
     virtual void updateV();
 
 
 private:
+    // One half of the double-buffered LUT staging area. A build fills it on the
+    // job system while the previous result stays in the LUT texture. Each half has
+    // its own stage caches, so a new build never waits on a cancelled one.
+    struct LutStaging
+    {
+        std::vector<glm::half4> data;
+        std::vector<uint32_t> converted;    // GL_UNSIGNED_INT_2_10_10_10_REV copy for LutFormat::INTEGER
+        std::vector<float> gradedLut;       // stage caches, see LutStage
+        std::vector<float> toneMappedLut;
+        size_t cachedDimension = 0;
+        uint8_t staleStages = LUT_STAGE_ALL;    // LutStage bits whose cache is behind the settings
+        std::shared_ptr<CJobGroup> jobs;
+        size_t dimension = 0;
+        LutFormat format = LutFormat::FLOAT;
+        uint8_t stages = 0;                 // LutStage bits this build reruns
+        bool pendingUpload = false;
+    };
+
+    std::shared_ptr<const ToneMapper> __createToneMapper() const;
+    void __requestLutBuild();
+    void __uploadFinishedLut();
+    bool __bakeLutOnGpu(const LutBuildParams& params);
+    void __ensureLutTexture(size_t lutDimension, LutFormat format);
+
+    std::shared_ptr<ElayGraphics::STexture> lutTexture;
+    LutStaging lutStaging[2];
+    size_t lutBuildIndex = 0;
+    LutBackend lutBackend = LutBackend::BATCHED;
+    bool runLutBenchmark = false;
+    bool isComputeLutChecked = false;
+    std::shared_ptr<CShader> lutBakeShader;
+    // LutStage bits changed since the last build request, see LutStaging::staleStages
+    uint8_t lutDirtyStages = LUT_STAGE_ALL;
+
     const ToneMapper* toneMapper = nullptr;
     AgxToneMapperSettings agxToneMapperSetting;
     GenericToneMapperSettings genericToneMapperSetting;
@@ -150,8 +213,16 @@ private:
     // Output color space
     ColorSpace outputColorSpace = Rec709 - sRGB - D65;
     
+    ElayGraphics::ResourceManager::SharedDataHandle<ColorGradingSettings> colorGradingSettingData;
+    ElayGraphics::ResourceManager::SharedDataHandle<std::shared_ptr<ElayGraphics::STexture>> albedoTextureData;
+    ElayGraphics::ResourceManager::SharedDataHandle<std::shared_ptr<ElayGraphics::STexture>> lutTextureData;
+    ElayGraphics::ResourceManager::SharedDataHandle<std::shared_ptr<ElayGraphics::STexture>> depthTextureData;
+    ElayGraphics::ResourceManager::SharedDataHandle<std::shared_ptr<ElayGraphics::STexture>> taaAlbedoData;
+
     std::shared_ptr<CShader> taaShader;
     GLuint taaFBO;
+    CPipelineState m_TaaPipeline;
+    CPipelineState m_GradingPipeline;
     std::shared_ptr<ElayGraphics::STexture> histroyTexture;
 
 protected:
@@ -211,4 +282,6 @@ struct ColorGradingSettings
 
     bool operator!=(const ColorGradingSettings& rhs) const { return !(rhs == *this); }
     bool operator==(const ColorGradingSettings& rhs) const;
+    // CColorGradingPass::LutStage bits of the LUT stages that read a field that differs
+    uint8_t getChangedLutStages(const ColorGradingSettings& rhs) const;
 };
\ No newline at end of file
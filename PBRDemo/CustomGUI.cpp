@@ -400,6 +400,11 @@ void CCustomGUI::initV()
     ElayGraphics::ResourceManager::registerSharedData("LightSettings", light);
     ElayGraphics::ResourceManager::registerSharedData("CameraSetting", cameraSetting);
     ElayGraphics::ResourceManager::registerSharedData("ColorGradingSetting", colorGradingSetting);
+
+    materialData = ElayGraphics::ResourceManager::SharedDataHandle<MaterialSettings>("MaterialSettings");
+    lightData = ElayGraphics::ResourceManager::SharedDataHandle<LightSettings>("LightSettings");
+    cameraSettingData = ElayGraphics::ResourceManager::SharedDataHandle<CameraSetting>("CameraSetting");
+    colorGradingSettingData = ElayGraphics::ResourceManager::SharedDataHandle<ColorGradingSettings>("ColorGradingSetting");
 }
 
 void CCustomGUI::updateV()
@@ -450,7 +455,9 @@ void CCustomGUI::updateV()
             }
             else if (light.lightType == 1)
             {
-
+                PointLightSetting spotLight;
+                spotLight.isSpot = true;
+                light.pointLights.push_back(spotLight);
             }
         }
         for (int i = 0; i < light.pointLights.size(); i++)
@@ -460,6 +467,13 @@ void CCustomGUI::updateV()
                 checkBox("Enablelight##" + std::to_string(i), light.pointLights[i].enable);
                 sliderFloat("Intensity##" + std::to_string(i), &light.pointLights[i].pointlightIntensity, 0, 1);
                 inputFloat3("Position##" + std::to_string(i), light.pointLights[i].pointLightPosition);
+                sliderFloat("Radius##" + std::to_string(i), &light.pointLights[i].pointlightRadius, 0.1f, 50.0f);
+                if (light.pointLights[i].isSpot)
+                {
+                    directionWidget("Direction##" + std::to_string(i), &light.pointLights[i].spotDirection[0]);
+                    sliderFloat("Inner angle##" + std::to_string(i), &light.pointLights[i].spotInnerAngle, 0.0f, 90.0f);
+                    sliderFloat("Outer angle##" + std::to_string(i), &light.pointLights[i].spotOuterAngle, 0.0f, 90.0f);
+                }
                 if (button("DeleteLight##" + std::to_string(i)))
                 {
                     light.pointLights.erase(light.pointLights.begin() + i);
@@ -542,8 +556,8 @@ void CCustomGUI::updateV()
 
     colorGradingUI(colorGradingSetting, mRangePlot, mCurvePlot, mToneMapPlot);
 
-    ElayGraphics::ResourceManager::updateSharedDataByName("MaterialSettings", material);
-    ElayGraphics::ResourceManager::updateSharedDataByName("LightSettings", light);
-    ElayGraphics::ResourceManager::updateSharedDataByName("CameraSetting", cameraSetting);
-    ElayGraphics::ResourceManager::updateSharedDataByName("ColorGradingSetting", colorGradingSetting);
+    materialData.set(material);
+    lightData.set(light);
+    cameraSettingData.set(cameraSetting);
+    colorGradingSettingData.set(colorGradingSetting);
 }
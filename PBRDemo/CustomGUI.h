@@ -3,6 +3,7 @@
 #include <GLM/glm.hpp>
 #include "Light.h"
 #include "ColorGradingPass.h"
+#include "Interface.h"
 #include <vector>
 
 struct SunLightSetting
@@ -20,9 +21,14 @@ struct SunLightSetting
 struct PointLightSetting
 {
     bool enable = true;
+    bool isSpot = false;
     float pointlightIntensity = 100000.0f;
+    float pointlightRadius = 10.0f;     // no light reaches past it, it bounds the froxels the light is culled into
     glm::vec3 pointLightPosition = glm::vec3(0,0,0);
     glm::vec3 pointlightColor = Color::toLinear<ACCURATE>({ 0.98, 0.92, 0.89 });
+    glm::vec3 spotDirection = glm::vec3(0, -1, 0);
+    float spotInnerAngle = 20.0f;       // half angles of the cone, in degrees
+    float spotOuterAngle = 30.0f;
 };
 
 
@@ -100,6 +106,11 @@ private:
     CameraSetting cameraSetting;
 
     ColorGradingSettings colorGradingSetting;
+
+    ElayGraphics::ResourceManager::SharedDataHandle<MaterialSettings> materialData;
+    ElayGraphics::ResourceManager::SharedDataHandle<LightSettings> lightData;
+    ElayGraphics::ResourceManager::SharedDataHandle<CameraSetting> cameraSettingData;
+    ElayGraphics::ResourceManager::SharedDataHandle<ColorGradingSettings> colorGradingSettingData;
     std::vector<float> mToneMapPlot;
     std::vector<float> mRangePlot;
     std::vector<float> mCurvePlot;
@@ -1,17 +1,61 @@
 #version 430 core
-layout(location = 0) in vec3 _Position;
+#extension GL_ARB_shader_draw_parameters : enable
+layout(location = 0) in vec4 _Position;
 layout(location = 1) in vec3 _Normal;
 layout(location = 2) in vec2 _TexCoord;
 
+//SPackedMeshVertex positions are unorm in the mesh AABB, see CMesh::update
+uniform bool u_IsVertexPacked;
+uniform vec3 u_VertexPositionScale;
+uniform vec3 u_VertexPositionBias;
+uniform mat4 u_ModelMatrix;
+
+//CMultiDrawBatch: while u_IsMultiDraw is set every draw of a glMultiDrawElementsIndirect takes its
+//model matrix and vertex decode from u_DrawRecords instead of the uniforms above, see SDrawRecord
+struct SDrawRecord
+{
+	mat4 modelMatrix;
+	vec4 positionScale;		//w is 1 for packed vertices
+	vec4 positionBias;
+	uvec4 meshMaterial;		//mesh id, material index
+};
+layout(std430, binding = 7) readonly buffer u_DrawRecords
+{
+	SDrawRecord u_Draws[];
+};
+uniform bool u_IsMultiDraw;
+uniform int u_DrawRecordOffset;
+
+SDrawRecord fetchDrawRecord()
+{
+	SDrawRecord draw;
+	if (u_IsMultiDraw)
+	{
+#ifdef GL_ARB_shader_draw_parameters
+		draw = u_Draws[u_DrawRecordOffset + gl_DrawIDARB];
+#else
+		draw = u_Draws[u_DrawRecordOffset];
+#endif
+	}
+	else
+	{
+		draw.modelMatrix = u_ModelMatrix;
+		draw.positionScale = vec4(u_VertexPositionScale, u_IsVertexPacked ? 1.0 : 0.0);
+		draw.positionBias = vec4(u_VertexPositionBias, 0.0);
+		draw.meshMaterial = uvec4(0);
+	}
+	return draw;
+}
+
 layout(std140, binding = 0) uniform u_Matrices4ProjectionWorld
 {
 	mat4 u_ProjectionMatrix;
 	mat4 u_ViewMatrix;
 };
-uniform mat4 u_ModelMatrix;
 
 void main()
 {
-	vec4 FragPosInViewSpace =  u_ModelMatrix *vec4(_Position, 1.0f);
+	SDrawRecord draw = fetchDrawRecord();
+	vec4 FragPosInViewSpace =  draw.modelMatrix *vec4(draw.positionScale.w > 0.5 ? draw.positionBias.xyz + _Position.xyz * draw.positionScale.xyz : _Position.xyz, 1.0f);
 	gl_Position = u_ProjectionMatrix *u_ViewMatrix *FragPosInViewSpace;
 }
\ No newline at end of file
@@ -0,0 +1,42 @@
+#version 430 core
+
+// One level of the hierarchical-Z pyramid of CHiZCulling, every texel the farthest depth under it.
+// Level 0 is the largest power of two that fits in the depth texture and takes the max of the 1 to 3
+// depth texels along each axis its footprint touches, every later level halves the one above exactly,
+// so a texel of level L always covers the uv square [x, x + 1] / size(L) of the screen.
+
+#define LOCAL_GROUP_SIZE 8
+layout (local_size_x = LOCAL_GROUP_SIZE, local_size_y = LOCAL_GROUP_SIZE) in;
+
+uniform sampler2D u_DepthTexture;
+layout (r32f, binding = 0) uniform readonly image2D u_SourceLevel;
+layout (r32f, binding = 1) uniform writeonly image2D u_TargetLevel;
+uniform bool u_IsFirstLevel;
+
+void main()
+{
+	ivec2 Target = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 TargetSize = imageSize(u_TargetLevel);
+	if (any(greaterThanEqual(Target, TargetSize)))
+		return;
+
+	float MaxDepth = 0.0;
+	if (u_IsFirstLevel)
+	{
+		ivec2 DepthSize = textureSize(u_DepthTexture, 0);
+		ivec2 Begin = Target * DepthSize / TargetSize;
+		ivec2 End = ((Target + 1) * DepthSize + TargetSize - 1) / TargetSize;
+		for (int y = Begin.y; y < End.y; ++y)
+			for (int x = Begin.x; x < End.x; ++x)
+				MaxDepth = max(MaxDepth, texelFetch(u_DepthTexture, ivec2(x, y), 0).r);
+	}
+	else
+	{
+		// a side that already reached 1 texel stays 1, the clamp reads its texel twice
+		ivec2 SourceMax = imageSize(u_SourceLevel) - 1;
+		ivec2 Source = Target * 2;
+		MaxDepth = max(max(imageLoad(u_SourceLevel, Source).r, imageLoad(u_SourceLevel, min(Source + ivec2(1, 0), SourceMax)).r),
+			max(imageLoad(u_SourceLevel, min(Source + ivec2(0, 1), SourceMax)).r, imageLoad(u_SourceLevel, min(Source + ivec2(1, 1), SourceMax)).r));
+	}
+	imageStore(u_TargetLevel, Target, vec4(MaxDepth));
+}
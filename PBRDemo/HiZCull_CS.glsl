@@ -0,0 +1,155 @@
+#version 430 core
+
+// Frustum and hierarchical-Z test of the draws of a CMultiDrawBatch, one invocation per draw, see
+// HiZCulling.h. A surviving draw is copied to the next free slot of its draw group in the culled
+// commands and records, taken with an atomicAdd on the draw count of the group.
+
+#define LOCAL_GROUP_SIZE 64
+#define DRAW_GROUP_COUNT 4
+layout (local_size_x = LOCAL_GROUP_SIZE) in;
+
+struct SDrawCommand
+{
+	uint count;
+	uint instanceCount;
+	uint firstIndex;
+	int  baseVertex;
+	uint baseInstance;
+};
+
+// SDrawRecord and SDrawBounds of MultiDrawBatch.h
+struct SDrawRecord
+{
+	mat4 modelMatrix;
+	vec4 positionScale;
+	vec4 positionBias;
+	uvec4 meshMaterial;
+};
+
+struct SDrawBounds
+{
+	vec3 minCorner;		// minCorner.x > maxCorner.x when the mesh has no AABB
+	uint groupIndex;
+	vec3 maxCorner;
+	uint groupFirstDraw;
+};
+
+// SCullCounters of HiZCulling.h, one per phase
+struct SCullCounters
+{
+	uint drawCounts[DRAW_GROUP_COUNT];
+	uint frustumCulledCount;
+	uint occlusionCulledCount;
+	uint padding0;
+	uint padding1;
+};
+
+layout (std430, binding = 9) readonly buffer u_DrawCommands { SDrawCommand u_Commands[]; };
+layout (std430, binding = 10) readonly buffer u_DrawRecords { SDrawRecord u_Records[]; };
+layout (std430, binding = 11) readonly buffer u_DrawBounds { SDrawBounds u_Bounds[]; };
+layout (std430, binding = 12) writeonly buffer u_CulledDrawCommands { SDrawCommand u_CulledCommands[]; };
+layout (std430, binding = 13) writeonly buffer u_CulledDrawRecords { SDrawRecord u_CulledRecords[]; };
+layout (std430, binding = 14) buffer u_DrawVisibility { uint u_IsDrawnInPhaseOne[]; };
+layout (std430, binding = 15) buffer u_CullCounters { SCullCounters u_Counters[2]; };
+
+uniform int u_DrawCount;
+uniform int u_Phase;				// 0 or 1
+uniform mat4 u_ViewProjectionMatrix;
+uniform bool u_IsOcclusionTested;	// false until a pyramid exists
+uniform mat4 u_OcclusionViewProjectionMatrix;	// the camera the pyramid was built with
+uniform sampler2D u_Pyramid;
+uniform int u_PyramidLevelCount;
+
+// corners in clip space of the camera, returns false when all of them are behind one frustum plane
+bool isInFrustum(vec4 vCorners[8])
+{
+	vec3 Behind = vec3(1.0), Beyond = vec3(1.0);
+	for (int i = 0; i < 8; ++i)
+	{
+		Behind *= vec3(lessThan(vCorners[i].xyz, vec3(-vCorners[i].w)));
+		Beyond *= vec3(greaterThan(vCorners[i].xyz, vec3(vCorners[i].w)));
+	}
+	return all(equal(Behind, vec3(0.0))) && all(equal(Beyond, vec3(0.0)));
+}
+
+// conservative: a box crossing the near plane, or any doubt, is visible
+bool isOccluded(vec4 vCorners[8])
+{
+	vec2 UvMin = vec2(1.0), UvMax = vec2(0.0);
+	float NearestDepth = 1.0;
+	for (int i = 0; i < 8; ++i)
+	{
+		if (vCorners[i].w <= 1e-5)
+			return false;
+		vec3 Ndc = vCorners[i].xyz / vCorners[i].w;
+		UvMin = min(UvMin, Ndc.xy * 0.5 + 0.5);
+		UvMax = max(UvMax, Ndc.xy * 0.5 + 0.5);
+		NearestDepth = min(NearestDepth, Ndc.z * 0.5 + 0.5);
+	}
+	UvMin = clamp(UvMin, 0.0, 1.0);
+	UvMax = clamp(UvMax, 0.0, 1.0);
+
+	// the level where the rectangle spans at most 2 texels on each axis, 4 fetches cover all of it
+	ivec2 Size = textureSize(u_Pyramid, 0);
+	vec2 Extent = (UvMax - UvMin) * vec2(Size);
+	int Level = clamp(int(ceil(log2(max(max(Extent.x, Extent.y), 1.0)))), 0, u_PyramidLevelCount - 1);
+	// not textureSize(u_Pyramid, Level), some drivers report 0 for the side that already reached 1
+	ivec2 LevelMax = max(Size >> Level, ivec2(1)) - 1;
+	ivec2 Begin = min(ivec2(UvMin * vec2(LevelMax + 1)), LevelMax);
+	ivec2 End = min(ivec2(UvMax * vec2(LevelMax + 1)), LevelMax);
+	float FarthestDepth = max(max(texelFetch(u_Pyramid, Begin, Level).r, texelFetch(u_Pyramid, ivec2(End.x, Begin.y), Level).r),
+		max(texelFetch(u_Pyramid, ivec2(Begin.x, End.y), Level).r, texelFetch(u_Pyramid, End, Level).r));
+	return NearestDepth > FarthestDepth;
+}
+
+void transformCorners(SDrawBounds vBounds, mat4 vMatrix, out vec4 voCorners[8])
+{
+	for (int i = 0; i < 8; ++i)
+	{
+		vec3 Corner = vec3((i & 1) != 0 ? vBounds.maxCorner.x : vBounds.minCorner.x, (i & 2) != 0 ? vBounds.maxCorner.y : vBounds.minCorner.y,
+			(i & 4) != 0 ? vBounds.maxCorner.z : vBounds.minCorner.z);
+		voCorners[i] = vMatrix * vec4(Corner, 1.0);
+	}
+}
+
+void main()
+{
+	int DrawIndex = int(gl_GlobalInvocationID.x);
+	if (DrawIndex >= u_DrawCount)
+		return;
+	// phase 1 drew it already
+	if (u_Phase == 1 && u_IsDrawnInPhaseOne[DrawIndex] != 0u)
+		return;
+
+	SDrawBounds Bounds = u_Bounds[DrawIndex];
+	bool IsVisible = true;
+	if (Bounds.minCorner.x <= Bounds.maxCorner.x)
+	{
+		mat4 ModelMatrix = u_Records[DrawIndex].modelMatrix;
+		vec4 Corners[8];
+		transformCorners(Bounds, u_ViewProjectionMatrix * ModelMatrix, Corners);
+		if (!isInFrustum(Corners))
+		{
+			atomicAdd(u_Counters[u_Phase].frustumCulledCount, 1u);
+			IsVisible = false;
+		}
+		else if (u_IsOcclusionTested)
+		{
+			transformCorners(Bounds, u_OcclusionViewProjectionMatrix * ModelMatrix, Corners);
+			if (isOccluded(Corners))
+			{
+				atomicAdd(u_Counters[u_Phase].occlusionCulledCount, 1u);
+				IsVisible = false;
+			}
+		}
+	}
+	if (u_Phase == 0)
+		u_IsDrawnInPhaseOne[DrawIndex] = IsVisible ? 1u : 0u;
+	if (!IsVisible)
+		return;
+
+	// the culled buffers hold the draws of phase 0 first, then those of phase 1
+	uint Slot = uint(u_Phase * u_DrawCount) + Bounds.groupFirstDraw + atomicAdd(u_Counters[u_Phase].drawCounts[Bounds.groupIndex], 1u);
+	u_CulledCommands[Slot] = u_Commands[DrawIndex];
+	u_CulledRecords[Slot] = u_Records[DrawIndex];
+}
@@ -0,0 +1,289 @@
+#include "HiZCulling.h"
+#include "Shader.h"
+#include "Common.h"
+#include "Utils.h"
+#include "GLStateCache.h"
+#include <GLM/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+	// local_size of HiZCull_CS.glsl and HiZBuild_CS.glsl
+	constexpr GLuint CULL_GROUP_SIZE = 64;
+	constexpr GLuint PYRAMID_GROUP_SIZE = 8;
+
+	// storage buffer bindings of HiZCull_CS.glsl, above the ones the shading passes keep bound
+	constexpr GLuint DRAW_COMMAND_BINDING = 9;
+	constexpr GLuint DRAW_RECORD_BINDING = 10;
+	constexpr GLuint DRAW_BOUNDS_BINDING = 11;
+	constexpr GLuint CULLED_COMMAND_BINDING = 12;
+	constexpr GLuint CULLED_RECORD_BINDING = 13;
+	constexpr GLuint VISIBILITY_BINDING = 14;
+	constexpr GLuint COUNTER_BINDING = 15;
+
+	// SDrawElementsIndirectCommand of CMultiDrawBatch
+	constexpr size_t DRAW_COMMAND_SIZE = 5 * sizeof(GLuint);
+
+	GLsizei previousPowerOfTwo(GLsizei vValue)
+	{
+		GLsizei Result = 1;
+		while (Result * 2 <= vValue)
+			Result *= 2;
+		return Result;
+	}
+
+	void clearBuffer(GLuint vBuffer, GLsizeiptr vSize)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, vBuffer);
+		glClearBufferSubData(GL_COPY_WRITE_BUFFER, GL_R32UI, 0, vSize, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+}
+
+CHiZCulling::~CHiZCulling()
+{
+	GLuint Buffers[] = { m_CulledCommandBuffer, m_CulledRecordBuffer, m_VisibilityBuffer, m_CounterBuffer };
+	for (GLuint Buffer : Buffers)
+	{
+		if (Buffer)
+			glDeleteBuffers(1, &Buffer);
+	}
+	for (SReadbackSlot& Slot : m_ReadbackRing)
+	{
+		if (Slot.Fence)
+			glDeleteSync(Slot.Fence);
+		if (Slot.Buffer)
+			glDeleteBuffers(1, &Slot.Buffer);
+	}
+	if (m_pPyramid)
+	{
+		GLuint Texture = m_pPyramid->TextureID;
+		fetchGLStateCache().deleteTextures(1, &Texture);
+	}
+}
+
+void CHiZCulling::cullAndDraw(CMultiDrawBatch& vioBatch, const CShader& vShader, const glm::mat4& vViewProjectionMatrix,
+	const std::shared_ptr<ElayGraphics::STexture>& vDepthTexture)
+{
+	vioBatch.upload();
+	const size_t DrawCount = vioBatch.getDrawCount();
+	if (DrawCount == 0)
+		return;
+	if (!m_pCullShader)
+	{
+		m_pCullShader = std::make_shared<CShader>("HiZCull_CS.glsl");
+		m_pPyramidShader = std::make_shared<CShader>("HiZBuild_CS.glsl");
+	}
+	__reserveDrawBuffers(DrawCount);
+
+	// the counters restart, and without GL_ARB_indirect_parameters the slots nothing is compacted into stay empty draws
+	clearBuffer(m_CounterBuffer, 2 * sizeof(SCullCounters));
+	clearBuffer(m_CulledCommandBuffer, 2 * DrawCount * DRAW_COMMAND_SIZE);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_COMMAND_BINDING, vioBatch.getCommandBuffer());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_RECORD_BINDING, vioBatch.getRecordBuffer());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_BOUNDS_BINDING, vioBatch.getBoundsBuffer());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULLED_COMMAND_BINDING, m_CulledCommandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULLED_RECORD_BINDING, m_CulledRecordBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VISIBILITY_BINDING, m_VisibilityBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COUNTER_BINDING, m_CounterBuffer);
+
+	__dispatchCulling(DrawCount, 0, vViewProjectionMatrix);
+	vShader.activeShader();
+	vioBatch.drawCulled(vShader, m_CulledCommandBuffer, m_CulledRecordBuffer, 0, m_CounterBuffer, 0);
+
+	__buildPyramid(vDepthTexture);
+	m_PyramidViewProjectionMatrix = vViewProjectionMatrix;
+	__dispatchCulling(DrawCount, 1, vViewProjectionMatrix);
+	vShader.activeShader();
+	vioBatch.drawCulled(vShader, m_CulledCommandBuffer, m_CulledRecordBuffer, DrawCount, m_CounterBuffer, sizeof(SCullCounters));
+
+	__readbackCounters(DrawCount);
+}
+
+//************************************************************************************
+//Function: a line in progress is dropped
+void CHiZCulling::setStatsLog(bool vLogStats)
+{
+	m_LogStats = vLogStats;
+	m_StatsDrawCount = 0;
+	m_StatsPhaseOneCount = 0;
+	m_StatsPhaseTwoCount = 0;
+	m_StatsFrustumCulledCount = 0;
+	m_StatsOcclusionCulledCount = 0;
+	m_StatsLatency = 0;
+	m_StatsFrameCount = 0;
+	m_DroppedReadbackCount = 0;
+}
+
+//************************************************************************************
+//Function: grows the culled buffers to twice what is needed, so a scene that grows a little does not reallocate every frame
+void CHiZCulling::__reserveDrawBuffers(size_t vDrawCount)
+{
+	if (!m_CounterBuffer)
+	{
+		m_CounterBuffer = genBuffer(GL_SHADER_STORAGE_BUFFER, 2 * sizeof(SCullCounters), nullptr, GL_DYNAMIC_COPY);
+		for (SReadbackSlot& Slot : m_ReadbackRing)
+			Slot.Buffer = genBuffer(GL_COPY_WRITE_BUFFER, 2 * sizeof(SCullCounters), nullptr, GL_STREAM_READ);
+	}
+	if (vDrawCount <= m_DrawCapacity)
+		return;
+
+	m_DrawCapacity = std::max<size_t>(vDrawCount * 2, 256);
+	GLuint Buffers[] = { m_CulledCommandBuffer, m_CulledRecordBuffer, m_VisibilityBuffer };
+	for (GLuint Buffer : Buffers)
+	{
+		if (Buffer)
+			glDeleteBuffers(1, &Buffer);
+	}
+	m_CulledCommandBuffer = genBuffer(GL_DRAW_INDIRECT_BUFFER, 2 * m_DrawCapacity * DRAW_COMMAND_SIZE, nullptr, GL_DYNAMIC_COPY);
+	m_CulledRecordBuffer = genBuffer(GL_SHADER_STORAGE_BUFFER, 2 * m_DrawCapacity * sizeof(SDrawRecord), nullptr, GL_DYNAMIC_COPY);
+	m_VisibilityBuffer = genBuffer(GL_SHADER_STORAGE_BUFFER, m_DrawCapacity * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+}
+
+//************************************************************************************
+//Function: phase 0 tests against the pyramid of the previous frame, if any, phase 1 against the one just built
+void CHiZCulling::__dispatchCulling(size_t vDrawCount, int vPhase, const glm::mat4& vViewProjectionMatrix)
+{
+	m_pCullShader->activeShader();
+	m_pCullShader->setIntUniformValue("u_DrawCount", static_cast<GLint>(vDrawCount));
+	m_pCullShader->setIntUniformValue("u_Phase", vPhase);
+	m_pCullShader->setMat4UniformValue("u_ViewProjectionMatrix", glm::value_ptr(vViewProjectionMatrix));
+	m_pCullShader->setIntUniformValue("u_IsOcclusionTested", m_pPyramid ? 1 : 0);
+	if (m_pPyramid)
+	{
+		m_pCullShader->setMat4UniformValue("u_OcclusionViewProjectionMatrix", glm::value_ptr(m_PyramidViewProjectionMatrix));
+		m_pCullShader->setTextureUniformValue("u_Pyramid", m_pPyramid);
+		m_pCullShader->setIntUniformValue("u_PyramidLevelCount", m_PyramidLevelCount);
+	}
+	glDispatchCompute(static_cast<GLuint>((vDrawCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE), 1, 1);
+	// the culled commands and their counts feed the draws, the visibility and counters the next phase
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+//************************************************************************************
+//Function: one dispatch per level, each waits for the image stores of the level above
+void CHiZCulling::__buildPyramid(const std::shared_ptr<ElayGraphics::STexture>& vDepthTexture)
+{
+	const GLsizei Width = previousPowerOfTwo(vDepthTexture->Width);
+	const GLsizei Height = previousPowerOfTwo(vDepthTexture->Height);
+	if (!m_pPyramid || m_pPyramid->Width != Width || m_pPyramid->Height != Height)
+	{
+		if (m_pPyramid)
+		{
+			GLuint Texture = m_pPyramid->TextureID;
+			fetchGLStateCache().deleteTextures(1, &Texture);
+		}
+		m_pPyramid = std::make_shared<ElayGraphics::STexture>();
+		m_pPyramid->InternalFormat = GL_R32F;
+		m_pPyramid->ExternalFormat = GL_RED;
+		m_pPyramid->DataType = GL_FLOAT;
+		m_pPyramid->Width = Width;
+		m_pPyramid->Height = Height;
+		m_pPyramid->Type4MinFilter = GL_NEAREST_MIPMAP_NEAREST;
+		m_pPyramid->Type4MagFilter = GL_NEAREST;
+		m_pPyramid->isMipmap = GL_TRUE;
+		m_PyramidLevelCount = 1;
+		while ((std::max(Width, Height) >> m_PyramidLevelCount) > 0)
+			m_PyramidLevelCount++;
+
+		// immutable storage, image units bind single levels of it
+		GLuint Texture = 0;
+		glGenTextures(1, &Texture);
+		glBindTexture(GL_TEXTURE_2D, Texture);
+		glTexStorage2D(GL_TEXTURE_2D, m_PyramidLevelCount, GL_R32F, Width, Height);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, m_pPyramid->Type4MinFilter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, m_pPyramid->Type4MagFilter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		m_pPyramid->TextureID = static_cast<GLint>(Texture);
+	}
+
+	m_pPyramidShader->activeShader();
+	m_pPyramidShader->setTextureUniformValue("u_DepthTexture", vDepthTexture);
+	for (int Level = 0; Level < m_PyramidLevelCount; ++Level)
+	{
+		// level 0 reads the depth texture, its source binding is never touched
+		fetchGLStateCache().bindImageTexture(0, m_pPyramid->TextureID, std::max(Level - 1, 0), GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+		fetchGLStateCache().bindImageTexture(1, m_pPyramid->TextureID, Level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		m_pPyramidShader->setIntUniformValue("u_IsFirstLevel", Level == 0 ? 1 : 0);
+		const GLuint GroupCountX = (std::max(Width >> Level, 1) + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE;
+		const GLuint GroupCountY = (std::max(Height >> Level, 1) + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE;
+		glDispatchCompute(GroupCountX, GroupCountY, 1);
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	}
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+//************************************************************************************
+//Function: reports every copy whose fence signaled, oldest first, then copies this frame's counters while they are logged and the ring has room
+void CHiZCulling::__readbackCounters(size_t vDrawCount)
+{
+	while (m_ReadbackReadCount != m_ReadbackWriteCount)
+	{
+		SReadbackSlot& Slot = m_ReadbackRing[m_ReadbackReadCount % READBACK_RING_SIZE];
+		const GLenum Status = glClientWaitSync(Slot.Fence, 0, 0);
+		if (Status != GL_ALREADY_SIGNALED && Status != GL_CONDITION_SATISFIED)
+			break;
+		glDeleteSync(Slot.Fence);
+		Slot.Fence = nullptr;
+		SCullCounters Counters[2];
+		glBindBuffer(GL_COPY_READ_BUFFER, Slot.Buffer);
+		glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(Counters), Counters);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		__recordStats(Counters, Slot.DrawCount, m_Frame - Slot.Frame);
+		m_ReadbackReadCount++;
+	}
+
+	if (!m_LogStats)
+	{
+		m_Frame++;
+		return;
+	}
+	if (m_ReadbackWriteCount - m_ReadbackReadCount == READBACK_RING_SIZE)
+	{
+		m_DroppedReadbackCount++;
+	}
+	else
+	{
+		SReadbackSlot& Slot = m_ReadbackRing[m_ReadbackWriteCount % READBACK_RING_SIZE];
+		glBindBuffer(GL_COPY_READ_BUFFER, m_CounterBuffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, Slot.Buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, 2 * sizeof(SCullCounters));
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		Slot.Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		Slot.DrawCount = vDrawCount;
+		Slot.Frame = m_Frame;
+		m_ReadbackWriteCount++;
+	}
+	m_Frame++;
+}
+
+//************************************************************************************
+//Function: the first phase counts every draw outside the frustum, the second re-tests what the first dropped, so its rejects are the occluded ones
+void CHiZCulling::__recordStats(const SCullCounters vCounters[2], size_t vDrawCount, uint64_t vLatency)
+{
+	// copies made before the line was logged still drain
+	if (!m_LogStats)
+		return;
+	for (size_t i = 0; i < CMultiDrawBatch::GROUP_COUNT; ++i)
+	{
+		m_StatsPhaseOneCount += vCounters[0].DrawCounts[i];
+		m_StatsPhaseTwoCount += vCounters[1].DrawCounts[i];
+	}
+	m_StatsDrawCount += vDrawCount;
+	m_StatsFrustumCulledCount += vCounters[0].FrustumCulledCount;
+	m_StatsOcclusionCulledCount += vCounters[1].OcclusionCulledCount;
+	m_StatsLatency += vLatency;
+	if (++m_StatsFrameCount < CULL_STATS_FRAMES)
+		return;
+
+	const double Frames = m_StatsFrameCount;
+	std::cout << "HiZCulling:: " << m_StatsDrawCount / Frames << " draws per frame: " << (m_StatsPhaseOneCount + m_StatsPhaseTwoCount) / Frames
+		<< " visible, " << m_StatsPhaseTwoCount / Frames << " of them disoccluded in phase 2, " << m_StatsFrustumCulledCount / Frames
+		<< " outside the frustum, " << m_StatsOcclusionCulledCount / Frames << " occluded, counters read back " << m_StatsLatency / Frames
+		<< " frames late, " << m_DroppedReadbackCount << " frames dropped by a full ring" << std::endl;
+	setStatsLog(false);
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <GL/glew.h>
+#include <GLM/glm.hpp>
+#include <cstdint>
+#include <memory>
+#include "MultiDrawBatch.h"
+
+class CShader;
+namespace ElayGraphics
+{
+	struct STexture;
+}
+
+// GPU side of culling for the multi-draws of one camera. HiZCull_CS.glsl tests every draw of a
+// CMultiDrawBatch against the frustum and a hierarchical-Z pyramid, the max depth mip chain that
+// HiZBuild_CS.glsl reduces from the depth texture, and compacts the survivors into its own
+// indirect commands and draw records with atomic counters. A frame runs two phases:
+//   1. test against the pyramid of the previous frame, through the camera it was built with,
+//      and draw what passes
+//   2. rebuild the pyramid from that depth, re-test what phase 1 dropped against it and draw
+//      what is visible now, the objects this frame disoccluded, which would pop in otherwise
+// The pyramid of phase 2 serves phase 1 of the next frame; it lacks what phase 2 draws, which
+// only leaves that frame fewer occluders. The counters of both phases go through a ring of
+// readback buffers guarded by fences, so the CPU never waits on them. They are copied only
+// while setStatsLog() asks for one line averaged over the next CULL_STATS_FRAMES frames read back.
+class CHiZCulling
+{
+public:
+	static constexpr unsigned READBACK_RING_SIZE = 4;
+	static constexpr unsigned CULL_STATS_FRAMES = 300;
+
+	~CHiZCulling();
+
+	static bool isSupported() { return CMultiDrawBatch::isSupported(); }
+
+	// logStats: the counters of the next CULL_STATS_FRAMES frames are read back and logged once
+	void setStatsLog(bool vLogStats);
+
+	// vShader is active and the framebuffer holding vDepthTexture bound, both are again on return;
+	// vViewProjectionMatrix is the one the frame is drawn with, jitter included
+	void cullAndDraw(CMultiDrawBatch& vioBatch, const CShader& vShader, const glm::mat4& vViewProjectionMatrix,
+		const std::shared_ptr<ElayGraphics::STexture>& vDepthTexture);
+
+private:
+	// SCullCounters of HiZCull_CS.glsl, one per phase
+	struct SCullCounters
+	{
+		GLuint DrawCounts[CMultiDrawBatch::GROUP_COUNT];
+		GLuint FrustumCulledCount;
+		GLuint OcclusionCulledCount;
+		GLuint Padding[2];
+	};
+
+	struct SReadbackSlot
+	{
+		GLuint Buffer = 0;
+		GLsync Fence = nullptr;
+		size_t DrawCount = 0;
+		uint64_t Frame = 0;
+	};
+
+	void __reserveDrawBuffers(size_t vDrawCount);
+	void __dispatchCulling(size_t vDrawCount, int vPhase, const glm::mat4& vViewProjectionMatrix);
+	void __buildPyramid(const std::shared_ptr<ElayGraphics::STexture>& vDepthTexture);
+	void __readbackCounters(size_t vDrawCount);
+	void __recordStats(const SCullCounters vCounters[2], size_t vDrawCount, uint64_t vLatency);
+
+	std::shared_ptr<CShader> m_pCullShader;
+	std::shared_ptr<CShader> m_pPyramidShader;
+	std::shared_ptr<ElayGraphics::STexture> m_pPyramid;
+	int m_PyramidLevelCount = 0;
+	glm::mat4 m_PyramidViewProjectionMatrix = glm::mat4(1.0f);
+
+	// culled commands and records hold the draws of phase 1 first, then those of phase 2
+	GLuint m_CulledCommandBuffer = 0;
+	GLuint m_CulledRecordBuffer = 0;
+	GLuint m_VisibilityBuffer = 0;
+	GLuint m_CounterBuffer = 0;
+	size_t m_DrawCapacity = 0;
+
+	SReadbackSlot m_ReadbackRing[READBACK_RING_SIZE];
+	uint64_t m_ReadbackWriteCount = 0;	// the next copy goes to slot m_ReadbackWriteCount % READBACK_RING_SIZE
+	uint64_t m_ReadbackReadCount = 0;
+	uint64_t m_Frame = 0;
+
+	// sums over the frames read back since the last stats line
+	uint64_t m_StatsDrawCount = 0;
+	uint64_t m_StatsPhaseOneCount = 0;
+	uint64_t m_StatsPhaseTwoCount = 0;
+	uint64_t m_StatsFrustumCulledCount = 0;
+	uint64_t m_StatsOcclusionCulledCount = 0;
+	uint64_t m_StatsLatency = 0;
+	unsigned m_StatsFrameCount = 0;
+	unsigned m_DroppedReadbackCount = 0;	// frames whose counters found the ring full
+	bool m_LogStats = false;
+};
@@ -7,9 +7,19 @@
 #include <glm/gtc/type_ptr.hpp>
 #include "Utils.h"
 #include "Shader.h"
+#include "GLStateCache.h"
 #include "Common.h"
 #include "glmextend.h"
+#include "SHProjector.h"
+#include "IBLCache.h"
+#include "IBLBakeContext.h"
+#include "JobSystem.h"
 #include <Basetsd.h>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <filesystem>
+#include <cstring>
 
 
 IBLLigthPass::IBLLigthPass(const std::string& vPassName, int vExcutionOrder) : IRenderPass(vPassName, vExcutionOrder)
@@ -19,7 +29,26 @@ IBLLigthPass::IBLLigthPass(const std::string& vPassName, int vExcutionOrder) : I
 
 IBLLigthPass::~IBLLigthPass()
 {
-
+    if (m_PendingDecode.valid())
+    {
+        m_DecodedHDR = m_PendingDecode.get();
+    }
+    if (m_DecodedHDR.pData)
+    {
+        stbi_image_free(m_DecodedHDR.pData);
+    }
+    if (m_StagingBuffer)
+    {
+        glDeleteBuffers(1, &m_StagingBuffer);
+    }
+    for (const auto& pending : m_PendingStepQueries)
+    {
+        m_FreeStepQueries.push_back(pending.query);
+    }
+    if (!m_FreeStepQueries.empty())
+    {
+        glDeleteQueries(GLsizei(m_FreeStepQueries.size()), m_FreeStepQueries.data());
+    }
 }
 
 void IBLLigthPass::setIBLPath(const std::string& vIBLPath)
@@ -27,12 +56,22 @@ void IBLLigthPass::setIBLPath(const std::string& vIBLPath)
     IBLPath = vIBLPath;
 }
 
-template<typename T>
-static inline constexpr T log4(T x)
+void IBLLigthPass::setSHProjectionMode(ESHProjectionMode vMode, bool vRunBenchmark)
 {
-    return std::log2(x) * T(0.5);
+    m_SHProjectionMode = vMode;
+    m_RunSHBenchmark = vRunBenchmark;
 }
 
+void IBLLigthPass::setBakeSettings(const SIBLBakeSettings& vSettings)
+{
+    m_BakeSettings = vSettings;
+}
+
+void IBLLigthPass::setIBLCache(bool vEnable, const std::string& vCacheDirectory)
+{
+    m_UseIBLCache = vEnable;
+    m_IBLCacheDirectory = vCacheDirectory;
+}
 
 typedef SSIZE_T ssize_t;
 
@@ -416,6 +455,8 @@ void equirectangularToCubemap(float* imageData, int width, int height)
 
 
 
+void finalizeSH(std::vector<glm::vec3>& SH, size_t numBands, bool irradiance);
+
 std::vector<glm::vec3> computeSH(size_t numBands, bool irradiance, float *imageData, int width, int height)
 { 
     const size_t numCoefs = numBands * numBands;
@@ -504,6 +545,14 @@ std::vector<glm::vec3> computeSH(size_t numBands, bool irradiance, float *imageD
         }            
     }
 
+    finalizeSH(SH, numBands, irradiance);
+    return SH;
+}
+
+// applies the irradiance convolution and the shader-side basis scaling to a raw projection
+void finalizeSH(std::vector<glm::vec3>& SH, size_t numBands, bool irradiance)
+{
+    const size_t numCoefs = numBands * numBands;
 
     // precompute the scaling factor K
     std::vector<float> K(9, 1);
@@ -531,441 +580,512 @@ std::vector<glm::vec3> computeSH(size_t numBands, bool irradiance, float *imageD
     }
    
     preprocessSHForShader(SH);
-
-
-    return SH;
 }
 
-
-
-void DfgIBLFilter()
+void benchmarkSHProjection(float* imageData, int width, int height, int channels)
 {
-    glDisable(GL_DEPTH_TEST);
-    auto brdfLUTTexture = std::make_shared<ElayGraphics::STexture>();
-    brdfLUTTexture->TextureType = ElayGraphics::STexture::ETextureType::Texture2D;
-    brdfLUTTexture->InternalFormat = GL_RGB16F;
-    brdfLUTTexture->ExternalFormat = GL_RGB;
-    brdfLUTTexture->Width = 512;
-    brdfLUTTexture->Height = 512;
-    brdfLUTTexture->DataType = GL_FLOAT;
-
-
-    brdfLUTTexture->Type4WrapS = GL_CLAMP_TO_EDGE;
-    brdfLUTTexture->Type4WrapT = GL_CLAMP_TO_EDGE;
-    brdfLUTTexture->Type4MagFilter = GL_LINEAR;
-    brdfLUTTexture->Type4MinFilter = GL_LINEAR;
-
-    genTexture(brdfLUTTexture);
-    ElayGraphics::ResourceManager::registerSharedData("brdfLUTTexture", brdfLUTTexture);
-
+    using Clock = std::chrono::steady_clock;
+    const size_t numBands = CSHProjector::NUM_BANDS;
+
+    auto start = Clock::now();
+    const std::vector<glm::vec3> reference = computeSH(numBands, true, imageData, width, height);
+    const float serialMs = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+    std::cout << "SH projection benchmark: " << width << "x" << height << " source" << std::endl;
+    std::cout << "  serial computeSH  dim 256: " << serialMs << " ms" << std::endl;
+
+    // the projection runs on the job system workers and the calling thread
+    const size_t maxThreads = ElayGraphics::ResourceManager::getOrCreateJobSystem()->getThreadCount() + 1;
+    const size_t dims[] = { 128, 256, 512 };
+    for (size_t dim : dims)
+    {
+        float singleThreadMs = 0.0f;
+        for (size_t threads = 1; ; threads = std::min(threads * 2, maxThreads))
+        {
+            CSHProjector projector(dim, threads);
+            start = Clock::now();
+            std::vector<glm::vec3> sh = projector.project(imageData, width, height, channels);
+            const float ms = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+            finalizeSH(sh, numBands, true);
+            if (threads == 1)
+            {
+                singleThreadMs = ms;
+            }
 
-    // then re-configure capture framebuffer object and render screen-space quad with BRDF shader.
-    unsigned int captureFBO;
-    unsigned int captureRBO;
-    glGenFramebuffers(1, &captureFBO);
-    glGenRenderbuffers(1, &captureRBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 512, 512);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, captureRBO);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, brdfLUTTexture->TextureID, 0);
+            std::cout << "  parallel dim " << dim << " threads " << threads << ": " << ms << " ms"
+                << ", x" << singleThreadMs / ms << " vs 1 thread";
+            if (dim == 256)
+            {
+                float maxError = 0.0f;
+                for (size_t i = 0; i < sh.size(); i++)
+                {
+                    const glm::vec3 d = glm::abs(sh[i] - reference[i]);
+                    maxError = std::max(maxError, std::max(d.x, std::max(d.y, d.z)));
+                }
+                std::cout << ", x" << serialMs / ms << " vs serial, max |error| " << maxError;
+            }
+            std::cout << std::endl;
 
-    auto dfgIBLShader = std::make_shared<CShader>("DfgIBL_VS.glsl", "DfgIBL_FS.glsl");
-    glViewport(0, 0, 512, 512);
-    dfgIBLShader->activeShader();
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    drawQuad();
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glDeleteFramebuffers(1, &captureFBO);
-    glEnable(GL_DEPTH_TEST);
+            if (threads == maxThreads)
+            {
+                break;
+            }
+        }
+    }
 }
 
 
 
-void SpecularIBLFilter()
+std::vector<glm::vec3> projectEnvironmentSH(ESHProjectionMode mode, float* imageData, int width, int height, int channels, size_t threadCount = 0)
 {
+    if (mode == ESHProjectionMode::Parallel)
+    {
+        std::vector<glm::vec3> sh = CSHProjector(256, threadCount).project(imageData, width, height, channels);
+        finalizeSH(sh, CSHProjector::NUM_BANDS, true);
+        return sh;
+    }
+    return computeSH(3, true, imageData, width, height);
+}
 
-    glDisable(GL_DEPTH_TEST);
-    auto kernelMap = std::make_shared<ElayGraphics::STexture>();
-    kernelMap->TextureType = ElayGraphics::STexture::ETextureType::Texture2D;
-    kernelMap->InternalFormat = GL_RGBA16F;
-    kernelMap->ExternalFormat = GL_RGBA;
-
-    kernelMap->Width = 5;
-    kernelMap->Height = 1024;
-
-    kernelMap->DataType = GL_FLOAT;
-    kernelMap->Type4WrapS = GL_CLAMP_TO_EDGE;
-    kernelMap->Type4WrapT = GL_CLAMP_TO_EDGE;
-    kernelMap->Type4WrapR = GL_CLAMP_TO_EDGE;
-
-    kernelMap->Type4MagFilter = GL_NEAREST;
-    kernelMap->Type4MinFilter = GL_NEAREST;
-    genTexture(kernelMap);
+// decodes the HDR and runs every filter into the environment's textures
+bool IBLLigthPass::__bakeEnvironment(const std::string& vHDRPath, SIBLBakedEnvironment& vioEnvironment)
+{
+    //stbi_set_flip_vertically_on_load(true);
+    int width, height, nrComponents;
+    float* data = stbi_loadf(vHDRPath.c_str(), &width, &height, &nrComponents, 0);
+    if (!data)
+    {
+        std::cout << "Failed to load HDR image " << vHDRPath << "." << std::endl;
+        return false;
+    }
 
+    //unsigned int hdrTexture;
+    auto hdrTexture = std::make_shared<ElayGraphics::STexture>();
+    hdrTexture->InternalFormat = GL_RGB16F;
+    hdrTexture->ExternalFormat = GL_RGB;
+    hdrTexture->Width = width;
+    hdrTexture->Height = height;
+    hdrTexture->DataType = GL_FLOAT;
+    hdrTexture->pDataSet.resize(1);
+    hdrTexture->pDataSet[0] = data;
+
+    hdrTexture->Type4WrapS = GL_CLAMP_TO_EDGE;
+    hdrTexture->Type4WrapT = GL_CLAMP_TO_EDGE;
+    hdrTexture->Type4MagFilter = GL_LINEAR;
+    hdrTexture->Type4MinFilter = GL_LINEAR;
+
+    genTexture(hdrTexture);
+
+    if (m_RunSHBenchmark)
+    {
+        benchmarkSHProjection(data, width, height, nrComponents);
+    }
 
-    GLint kernelFBO = genFBO({ kernelMap });
-    //genGenerateMipmap(kernelMap);
-    ElayGraphics::ResourceManager::registerSharedData("kernelMap", kernelMap);
+    vioEnvironment.sh = projectEnvironmentSH(m_SHProjectionMode, data, width, height, nrComponents);
 
-    auto lodToPerceptualRoughness = [](const float lod) -> float {
-        // Inverse perceptualRoughness-to-LOD mapping:
-        // The LOD-to-perceptualRoughness mapping is a quadratic fit for
-        // log2(perceptualRoughness)+iblMaxMipLevel when iblMaxMipLevel is 4.
-        // We found empirically that this mapping works very well for a 256 cubemap with 5 levels used,
-        // but also scales well for other iblMaxMipLevel values.
-        const float a = 2.0f;
-        const float b = -1.0f;
-        return (lod != 0.0f) ? glm::saturate((sqrt(a * a + 4.0f * b * lod) - a) / (2.0f * b)) : 0.0f;
-    };
+    stbi_image_free(data);
 
-    const GLenum faces[2][3] = {
-        { GL_TEXTURE_CUBE_MAP_POSITIVE_X, GL_TEXTURE_CUBE_MAP_POSITIVE_Y, GL_TEXTURE_CUBE_MAP_POSITIVE_Z },
-        { GL_TEXTURE_CUBE_MAP_NEGATIVE_X, GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, GL_TEXTURE_CUBE_MAP_NEGATIVE_Z }
-    };
+    m_pBakeContext->bakeEnvironment(hdrTexture, vioEnvironment);
+    // the equirectangular source is only needed to fill envCubemap
+    fetchGLStateCache().deleteTextures(1, &(GLuint&)hdrTexture->TextureID);
+    return true;
+}
 
-    int mLevelCount = 5;
-    float roughnessArray[16] = {};
-    for (size_t i = 0, c = mLevelCount; i < c; i++)
+void IBLLigthPass::initV()
+{
+    if (IBLPath.empty())
     {
-        float const perceptualRoughness = lodToPerceptualRoughness(
-            glm::saturate(float(i) * (1.0f / (float(mLevelCount) - 1.0f))));
-        float const roughness = perceptualRoughness * perceptualRoughness;
-        roughnessArray[i] = roughness;
+        IBLPath = "../environments/lightroom_14b.hdr";
     }
 
-    // then re-configure capture framebuffer object and render screen-space quad with BRDF shader.
-    //int id = kernelMap->TextureID;
-    glBindFramebuffer(GL_FRAMEBUFFER, kernelFBO);
-    auto kernelFilterShader = std::make_shared<CShader>("KernelFilter_VS.glsl", "KernelFilter_FS.glsl");
-    kernelFilterShader->activeShader();
-    for (int i = 0; i < 16; i++)
+    CGLStateCache& stateCache = fetchGLStateCache();
+    stateCache.setCapability(GL_DEPTH_TEST, true);
+    stateCache.setDepthFunc(GL_LEQUAL);
+    stateCache.setCapability(GL_TEXTURE_CUBE_MAP_SEAMLESS, true);
+    stateCache.setCapability(GL_CULL_FACE, false);
+
+    const auto start = std::chrono::steady_clock::now();
+
+    m_pBakeContext = std::make_unique<CIBLBakeContext>(m_BakeSettings);
+    SIBLBakedEnvironment environment = m_pBakeContext->createEnvironment();
+    ElayGraphics::ResourceManager::registerSharedData("envCubemap", environment.envCubemap);
+    ElayGraphics::ResourceManager::registerSharedData("prefilterMap", environment.prefilterMap);
+    ElayGraphics::ResourceManager::registerSharedData("irradianceMap", environment.irradianceMap);
+    ElayGraphics::ResourceManager::registerSharedData("brdfLUTTexture", environment.brdfLUT);
+
+    CIBLCache cache(m_IBLCacheDirectory);
+    const uint64_t hdrHash = m_UseIBLCache ? CIBLCache::hashFile(IBLPath) : 0;
+    const bool warmStart = hdrHash != 0 && cache.load(hdrHash, m_BakeSettings, environment);
+    if (warmStart)
     {
-        std::string setName = "input_roughness[" + std::to_string(i) + "]";
-        kernelFilterShader->setFloatUniformValue(setName.c_str(), roughnessArray[i]);
+        // only level 0 of the source cubemap is cached, its mips are cheap to rebuild
+        genGenerateMipmap(environment.envCubemap);
+        m_pBakeContext->markDfgLUTBaked();
     }
-    //kernelFilterShader->setFloatArrayUniformValue("input_roughness", 16, roughnessArray);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glViewport(0, 0, 5, 1024);
-    drawQuad();
-
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glEnable(GL_DEPTH_TEST);
-
+    else if (__bakeEnvironment(IBLPath, environment) && hdrHash != 0)
+    {
+        if (!cache.save(hdrHash, m_BakeSettings, environment))
+        {
+            std::cerr << "Error::IBL:: Failed to write the IBL cache for " << IBLPath << std::endl;
+        }
+    }
+    environment.sh.resize(CSHProjector::NUM_COEFS);
+    ElayGraphics::ResourceManager::registerSharedData("iblSH", environment.sh);
+    m_ActiveEnvironment = environment;
 
-    auto prefilterMap = std::make_shared<ElayGraphics::STexture>();
-    prefilterMap->TextureType = ElayGraphics::STexture::ETextureType::TextureCubeMap;
-    prefilterMap->InternalFormat = GL_RGB16F;
-    prefilterMap->ExternalFormat = GL_RGB;
-    prefilterMap->Width = 256;
-    prefilterMap->Height = 256;
-    prefilterMap->DataType = GL_FLOAT;
+    glFinish();
+    const float elapsedMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "IBL " << (warmStart ? "warm start (cache hit): " : "cold start (filtered): ") << elapsedMs << " ms" << std::endl;
+    m_pBakeContext->printMemoryUsage();
 
-    prefilterMap->Type4WrapS = GL_CLAMP_TO_EDGE;
-    prefilterMap->Type4WrapT = GL_CLAMP_TO_EDGE;
-    prefilterMap->Type4WrapR = GL_CLAMP_TO_EDGE;
-    prefilterMap->Type4MagFilter = GL_LINEAR;
-    prefilterMap->Type4MinFilter = GL_LINEAR_MIPMAP_LINEAR;
-    genTexture(prefilterMap);
+    fetchGLStateCache().setViewport(0, 0, ElayGraphics::WINDOW_KEYWORD::getWindowWidth(), ElayGraphics::WINDOW_KEYWORD::getWindowHeight());
+}
 
-    glBindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap->TextureID);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, 4);
-    genGenerateMipmap(prefilterMap);
+// bakes extra environments with the pass's context, e.g. for switching skies at runtime;
+// the framebuffers, shaders and DFG LUT of the first bake are reused
+std::vector<SIBLBakedEnvironment> IBLLigthPass::bakeEnvironments(const std::vector<std::string>& vHDRPaths)
+{
+    _ASSERT(m_pBakeContext);
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<SIBLBakedEnvironment> environments;
+    environments.reserve(vHDRPaths.size());
+    for (const auto& path : vHDRPaths)
+    {
+        SIBLBakedEnvironment environment = m_pBakeContext->createEnvironment();
+        if (__bakeEnvironment(path, environment))
+        {
+            environment.sh.resize(CSHProjector::NUM_COEFS);
+            environments.push_back(environment);
+        }
+        else
+        {
+            m_pBakeContext->releaseEnvironment(environment);
+        }
+    }
 
-    ElayGraphics::ResourceManager::registerSharedData("prefilterMap", prefilterMap);
-    // pbr: run a quasi monte-carlo simulation on the environment lighting to create a prefilter (cube)map.
-    // ----------------------------------------------------------------------------------------------------
+    glFinish();
+    const float elapsedMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "IBL batch of " << environments.size() << " environments: " << elapsedMs << " ms" << std::endl;
+    m_pBakeContext->printMemoryUsage();
+    fetchGLStateCache().setViewport(0, 0, ElayGraphics::WINDOW_KEYWORD::getWindowWidth(), ElayGraphics::WINDOW_KEYWORD::getWindowHeight());
+    return environments;
+}
 
-    auto specularFilterShader = std::make_shared<CShader>("SpecularFilter_VS.glsl", "SpecularFilter_FS.glsl");
-    specularFilterShader->activeShader();
-    //prefilterShader->setIntUniformValue("environmentMap", 0);
-    //specularFilterShader->setMat4UniformValue("projection", glm::value_ptr(captureProjection));
+// runs on a worker thread: cache read, HDR decode and SH projection, no GL calls
+IBLLigthPass::SDecodedHDR IBLLigthPass::__decodeHDR(const std::string& vHDRPath, ESHProjectionMode vMode, const std::string& vCacheDirectory, const SIBLBakeSettings& vSettings)
+{
+    SDecodedHDR decoded;
+    if (!vCacheDirectory.empty())
+    {
+        decoded.hdrHash = CIBLCache::hashFile(vHDRPath);
+        // a stale or unreadable entry falls through to the decode
+        decoded.isCached = decoded.hdrHash != 0 && CIBLCache(vCacheDirectory).read(decoded.hdrHash, vSettings, decoded.cacheData);
+        if (decoded.isCached)
+        {
+            return decoded;
+        }
+    }
 
-    auto envCubemap = ElayGraphics::ResourceManager::getSharedDataByName<std::shared_ptr<ElayGraphics::STexture>>("envCubemap");
+    decoded.pData = stbi_loadf(vHDRPath.c_str(), &decoded.width, &decoded.height, &decoded.channels, 0);
+    if (decoded.pData)
+    {
+        // leave a core to the render thread
+        const size_t threadCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+        decoded.sh = projectEnvironmentSH(vMode, decoded.pData, decoded.width, decoded.height, decoded.channels, std::max<size_t>(1, threadCount));
+    }
+    return decoded;
+}
 
+// the new environment is decoded in the background and filtered over the next frames,
+// the current one stays in ResourceManager until the new set is complete
+void IBLLigthPass::requestEnvironment(const std::string& vHDRPath)
+{
+    if (!m_pBakeContext)
+    {
+        // not initialized yet, initV bakes it directly
+        IBLPath = vHDRPath;
+        return;
+    }
+    if (m_SwapStage != ESwapStage::Idle)
+    {
+        // only the latest request matters, it starts once the running swap is published
+        m_QueuedHDRPath = vHDRPath;
+        return;
+    }
+    m_SwapStart = std::chrono::steady_clock::now();
+    m_SwapWorstFrameMs = 0.0f;
+    __startEnvironmentSwap(vHDRPath, m_UseIBLCache);
+}
 
-    specularFilterShader->setTextureUniformValue("materialParams_environment", envCubemap);
-    specularFilterShader->setTextureUniformValue("materialParams_kernel", kernelMap);
-    float hdrLinear = 1024.0f;   //!< no HDR compression up to this value
-    float hdrMax = 16384.0f;     //!< HDR compression between hdrLinear and hdrMax
-    float lodOffset = 1.0f;      //!< Good values are 1.0 or 2.0. Higher values help with heavily HDR inputs.
+void IBLLigthPass::__startEnvironmentSwap(const std::string& vHDRPath, bool vUseCache)
+{
+    _ASSERT(m_pBakeContext);
+    m_SwapHDRPath = vHDRPath;
+    m_SwapStage = ESwapStage::Decoding;
+    m_PendingDecode = std::async(std::launch::async, &IBLLigthPass::__decodeHDR, vHDRPath, m_SHProjectionMode,
+        vUseCache ? m_IBLCacheDirectory : std::string(), m_pBakeContext->getSettings());
+}
 
-    const float linear = hdrLinear;
-    const float compress = hdrMax;
-    uint8_t levels = 5;
+// one slot per kind of step: upload chunk, cache entry, cubemap, irradiance, then each specular (level, side)
+size_t IBLLigthPass::__getSwapStepCostIndex() const
+{
+    switch (m_SwapStage)
+    {
+    case ESwapStage::Uploading:         return 0;
+    case ESwapStage::UploadingCache:    return 1;
+    case ESwapStage::Cubemap:           return 2;
+    case ESwapStage::Irradiance:        return 3;
+    default:                            return 4 + m_SpecularStep;
+    }
+}
 
-    uint32_t dim = 256;
-    const float omegaP = (4.0f * glm::PI) / float(6 * dim * dim);
+// the GPU time of a step comes back a frame or more later, it only ever refines the next estimate
+void IBLLigthPass::__resolveSwapStepQueries()
+{
+    while (!m_PendingStepQueries.empty())
+    {
+        const SSwapStepQuery& pending = m_PendingStepQueries.front();
+        GLint isAvailable = GL_FALSE;
+        glGetQueryObjectiv(pending.query, GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+        if (!isAvailable)
+        {
+            // queries finish in order, the later ones are not ready either
+            break;
+        }
+        GLuint64 elapsedNs = 0;
+        glGetQueryObjectui64v(pending.query, GL_QUERY_RESULT, &elapsedNs);
+        if (pending.costIndex < m_SwapStepGpuMs.size())
+        {
+            m_SwapStepGpuMs[pending.costIndex] = float(elapsedNs * 1e-6);
+        }
+        m_FreeStepQueries.push_back(pending.query);
+        m_PendingStepQueries.pop_front();
+    }
+}
 
-    specularFilterShader->setFloatUniformValue("frame_compress", linear, compress);
-    specularFilterShader->setFloatUniformValue("frame_lodOffset", lodOffset - log4(omegaP));
+void IBLLigthPass::__runSwapStep()
+{
+    // rows copied into the staging buffer per step, ~6MB for a 4k RGB32F source
+    const int uploadRowsPerStep = 256;
+    const SIBLBakeSettings& settings = m_pBakeContext->getSettings();
 
-    unsigned int sampleCount = 1024;
-    for (size_t lod = 0; lod < levels; lod++)
+    switch (m_SwapStage)
     {
-
-        specularFilterShader->setFloatUniformValue("frame_compress", linear, compress);
-        specularFilterShader->setFloatUniformValue("frame_lodOffset", lodOffset - log4(omegaP));
-        specularFilterShader->setIntUniformValue("frame_sampleCount", lod == 0 ? 1 : sampleCount);
-        specularFilterShader->setIntUniformValue("frame_attachmentLevel", lod);
-        float _load_offset = lodOffset - log4(omegaP);
-        if (lod == levels - 1)
+    case ESwapStage::Uploading:
+    {
+        const size_t rowBytes = size_t(m_DecodedHDR.width) * m_DecodedHDR.channels * sizeof(float);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_StagingBuffer);
+        if (m_UploadedRows == 0)
         {
-            // this is the last lod, use a more aggressive filtering because this level is also
-            // used for the diffuse brdf by filament, and we need it to be very smooth.
-            // So we set the lod offset to at least 2.
-            specularFilterShader->setFloatUniformValue("frame_lodOffset", std::max(2.0f, lodOffset) - log4(omegaP));
+            const GLenum format = m_DecodedHDR.channels == 4 ? GL_RGBA : GL_RGB;
+            m_pSwapHDRTexture = std::make_shared<ElayGraphics::STexture>();
+            m_pSwapHDRTexture->InternalFormat = GL_RGB16F;
+            m_pSwapHDRTexture->ExternalFormat = format;
+            m_pSwapHDRTexture->Width = m_DecodedHDR.width;
+            m_pSwapHDRTexture->Height = m_DecodedHDR.height;
+            m_pSwapHDRTexture->DataType = GL_FLOAT;
+            m_pSwapHDRTexture->Type4WrapS = GL_CLAMP_TO_EDGE;
+            m_pSwapHDRTexture->Type4WrapT = GL_CLAMP_TO_EDGE;
+            m_pSwapHDRTexture->Type4MagFilter = GL_LINEAR;
+            m_pSwapHDRTexture->Type4MinFilter = GL_LINEAR;
+            // allocate storage only, the texels come from the staging buffer once it is filled
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            genTexture(m_pSwapHDRTexture);
+
+            const GLsizeiptr size = GLsizeiptr(rowBytes * m_DecodedHDR.height);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_StagingBuffer);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+            m_pStagingData = static_cast<char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
         }
 
-        glViewport(0, 0, dim, dim);
-        for (size_t i = 0; i < 2; i++)
+        const int rows = std::min(uploadRowsPerStep, m_DecodedHDR.height - m_UploadedRows);
+        if (m_pStagingData)
+        {
+            memcpy(m_pStagingData + rowBytes * m_UploadedRows, reinterpret_cast<const char*>(m_DecodedHDR.pData) + rowBytes * m_UploadedRows, rowBytes * rows);
+        }
+        m_UploadedRows += rows;
+        if (m_UploadedRows == m_DecodedHDR.height)
         {
-            specularFilterShader->setFloatUniformValue("frame_side", i == 0 ? 1.0f : -1.0f);
-            GLuint FBO;
-            glGenFramebuffers(1, &FBO);
-            glBindFramebuffer(GL_FRAMEBUFFER, FBO);
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, faces[i][0], prefilterMap->TextureID, (int)lod);
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, faces[i][1], prefilterMap->TextureID, (int)lod);
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, faces[i][2], prefilterMap->TextureID, (int)lod);
-
-            int RenderBufferWidth = dim;
-            int RenderBufferHeight = dim;
-            auto genRenderBufferFunc = [=](GLenum vInternelFormat, GLenum vAttachmentType)
+            glBindTexture(GL_TEXTURE_2D, m_pSwapHDRTexture->TextureID);
+            if (m_pStagingData && glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER))
             {
-                GLint RenderBuffer;
-                glGenRenderbuffers(1, &(GLuint&)RenderBuffer);
-                glBindRenderbuffer(GL_RENDERBUFFER, RenderBuffer);
-                glRenderbufferStorage(GL_RENDERBUFFER, vInternelFormat, RenderBufferWidth, RenderBufferHeight);
-                glFramebufferRenderbuffer(GL_FRAMEBUFFER, vAttachmentType, GL_RENDERBUFFER, RenderBuffer);
-            };
-
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_DecodedHDR.width, m_DecodedHDR.height, m_pSwapHDRTexture->ExternalFormat, GL_FLOAT, nullptr);
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            }
+            else
             {
-                genRenderBufferFunc(GL_DEPTH_COMPONENT, GL_DEPTH_ATTACHMENT);
+                // mapping failed or the buffer got corrupted, fall back to a direct upload
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_DecodedHDR.width, m_DecodedHDR.height, m_pSwapHDRTexture->ExternalFormat, GL_FLOAT, m_DecodedHDR.pData);
             }
-            //{
-            //    genRenderBufferFunc(GL_STENCIL_INDEX, GL_STENCIL_ATTACHMENT);
-            //}
-            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            glBindTexture(GL_TEXTURE_2D, 0);
+            m_pStagingData = nullptr;
+            stbi_image_free(m_DecodedHDR.pData);
+            m_DecodedHDR.pData = nullptr;
+            m_SwapStage = ESwapStage::Cubemap;
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        break;
+    }
+    case ESwapStage::UploadingCache:
+        CIBLCache::uploadEntry(m_DecodedHDR.cacheData, settings, m_UploadedCacheEntries, m_PendingEnvironment);
+        if (++m_UploadedCacheEntries == CIBLCache::getEntryCount(settings))
+        {
+            m_DecodedHDR.cacheData.clear();
+            m_DecodedHDR.cacheData.shrink_to_fit();
+            genGenerateMipmap(m_PendingEnvironment.envCubemap);
+            __publishPendingEnvironment();
+        }
+        break;
+    case ESwapStage::Cubemap:
+        m_pBakeContext->bakeCubemap(m_pSwapHDRTexture, m_PendingEnvironment.envCubemap);
+        fetchGLStateCache().deleteTextures(1, &(GLuint&)m_pSwapHDRTexture->TextureID);
+        m_pSwapHDRTexture.reset();
+        m_SwapStage = ESwapStage::Irradiance;
+        break;
+    case ESwapStage::Irradiance:
+        m_pBakeContext->bakeIrradiance(m_PendingEnvironment.envCubemap, m_PendingEnvironment.irradianceMap);
+        m_SpecularStep = 0;
+        m_SwapStage = ESwapStage::Specular;
+        break;
+    case ESwapStage::Specular:
+        m_pBakeContext->bakeSpecularLevel(m_PendingEnvironment.envCubemap, m_PendingEnvironment.prefilterMap, m_SpecularStep / 2, m_SpecularStep % 2);
+        if (++m_SpecularStep == 2 * settings.levelCount)
+        {
+            // a cold swap is written to the cache like a cold start, the next swap to it only uploads
+            if (m_DecodedHDR.hdrHash != 0 && !CIBLCache(m_IBLCacheDirectory).save(m_DecodedHDR.hdrHash, settings, m_PendingEnvironment))
             {
-                std::cerr << "Error::FBO:: Framebuffer Is Not Complete." << glCheckFramebufferStatus(GL_FRAMEBUFFER) << std::endl;
+                std::cerr << "Error::IBL:: Failed to write the IBL cache for " << m_SwapHDRPath << std::endl;
             }
-            std::vector<GLenum> Attachments = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 ,GL_COLOR_ATTACHMENT2 };
-            glDrawBuffers(static_cast<int>(Attachments.size()), &Attachments[0]);
-            glBindFramebuffer(GL_FRAMEBUFFER, FBO);
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-            drawQuad();
-            glDeleteFramebuffers(1, &FBO);
+            __publishPendingEnvironment();
         }
-        glFlush();
-        dim >>= 1;
+        break;
+    default:
+        break;
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glEnable(GL_DEPTH_TEST);
 }
 
-
-
-
-void IrradianceIBLFilter()
+void IBLLigthPass::__advanceEnvironmentSwap()
 {
+    using Clock = std::chrono::steady_clock;
+    __resolveSwapStepQueries();
 
-    glm::mat4 captureProjection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
-    glm::mat4 captureViews[] =
+    if (m_SwapStage == ESwapStage::Decoding)
     {
-        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
-        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(-1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
-        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f,  1.0f,  0.0f), glm::vec3(0.0f,  0.0f,  1.0f)),
-        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f,  0.0f), glm::vec3(0.0f,  0.0f, -1.0f)),
-        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f,  0.0f,  1.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
-        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f,  0.0f, -1.0f), glm::vec3(0.0f, -1.0f,  0.0f))
-    };
-
-
-    glEnable(GL_DEPTH_TEST);
-    auto irradianceMap = std::make_shared<ElayGraphics::STexture>();
-    irradianceMap->TextureType = ElayGraphics::STexture::ETextureType::TextureCubeMap;
-    irradianceMap->InternalFormat = GL_RGB16F;
-    irradianceMap->ExternalFormat = GL_RGB;
-    irradianceMap->Width = 256;
-    irradianceMap->Height = 256;
-    irradianceMap->DataType = GL_FLOAT;
-
-
-    irradianceMap->Type4WrapS = GL_CLAMP_TO_EDGE;
-    irradianceMap->Type4WrapT = GL_CLAMP_TO_EDGE;
-    irradianceMap->Type4WrapR = GL_CLAMP_TO_EDGE;
-    irradianceMap->Type4MagFilter = GL_LINEAR;
-    irradianceMap->Type4MinFilter = GL_LINEAR;
-
-    genTexture(irradianceMap);
-
-    ElayGraphics::ResourceManager::registerSharedData("irradianceMap", irradianceMap);
+        if (m_PendingDecode.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            return;
+        }
+        m_DecodedHDR = m_PendingDecode.get();
+        m_SwapStepCpuMs.resize(4 + 2 * m_pBakeContext->getSettings().levelCount, 0.0f);
+        m_SwapStepGpuMs.resize(m_SwapStepCpuMs.size(), -1.0f);
 
-    auto envCubemap = ElayGraphics::ResourceManager::getSharedDataByName<std::shared_ptr<ElayGraphics::STexture>>("envCubemap");
+        if (m_DecodedHDR.isCached)
+        {
+            // the worker read and checked the file, the entries are uploaded under the frame budget
+            m_PendingEnvironment = m_pBakeContext->createEnvironment();
+            m_UploadedCacheEntries = 0;
+            m_SwapStage = ESwapStage::UploadingCache;
+            return;
+        }
+        if (!m_DecodedHDR.pData)
+        {
+            std::cout << "Failed to load HDR image " << m_SwapHDRPath << "." << std::endl;
+            m_SwapStage = ESwapStage::Idle;
+            if (!m_QueuedHDRPath.empty())
+            {
+                const std::string queuedPath = m_QueuedHDRPath;
+                m_QueuedHDRPath.clear();
+                requestEnvironment(queuedPath);
+            }
+            return;
+        }
 
-    // -----------------------------------------------------------------------------
-    auto irradianceShader = std::make_shared<CShader>("IrradianceConvolution_VS.glsl", "IrradianceConvolution_FS.glsl");
-    irradianceShader->activeShader();  
-    irradianceShader->setTextureUniformValue("environmentMap", envCubemap);
-    
-    unsigned int captureFBO;
-    unsigned int captureRBO;
-    glGenFramebuffers(1, &captureFBO);
-    glGenRenderbuffers(1, &captureRBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 256, 256);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, captureRBO);
-    
-    glViewport(0, 0, 256, 256); // don't forget to configure the viewport to the capture dimensions.
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    int id = irradianceMap->TextureID;
-    irradianceShader->setMat4UniformValue("projection", glm::value_ptr(captureProjection));
-    for (unsigned int i = 0; i < 6; ++i)
-    {    
-        irradianceShader->setMat4UniformValue("view", glm::value_ptr(captureViews[i]));
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, irradianceMap->TextureID, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        drawCube();
-        glFlush();
+        // texture allocation is the only work on the frame the decode lands
+        m_PendingEnvironment = m_pBakeContext->createEnvironment();
+        m_PendingEnvironment.sh = m_DecodedHDR.sh;
+        if (!m_StagingBuffer)
+        {
+            glGenBuffers(1, &m_StagingBuffer);
+        }
+        m_UploadedRows = 0;
+        m_SwapStage = ESwapStage::Uploading;
+        return;
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glDisable(GL_DEPTH_TEST);
 
-}
-
-
-
-void IBLLigthPass::initV()
-{
-
-    IBLPath = "../environments/lightroom_14b.hdr";
-
-
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LEQUAL);
-    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
-    glDisable(GL_CULL_FACE);
-
-    //stbi_set_flip_vertically_on_load(true);
-    int width, height, nrComponents;
-    float* data = stbi_loadf(IBLPath.c_str(), &width, &height, &nrComponents, 0);
-    //unsigned int hdrTexture;
-    auto hdrTexture = std::make_shared<ElayGraphics::STexture>();
-    if (data)
-    {      
-        hdrTexture->InternalFormat = GL_RGB16F;
-        hdrTexture->ExternalFormat = GL_RGB;
-        hdrTexture->Width = width;
-        hdrTexture->Height = height;
-        hdrTexture->DataType = GL_FLOAT;
-        hdrTexture->pDataSet.resize(1);
-        hdrTexture->pDataSet[0] = data;
-
-        hdrTexture->Type4WrapS = GL_CLAMP_TO_EDGE;
-        hdrTexture->Type4WrapT = GL_CLAMP_TO_EDGE;
-        hdrTexture->Type4MagFilter = GL_LINEAR;
-        hdrTexture->Type4MinFilter = GL_LINEAR;
-
-        genTexture(hdrTexture);
-        ElayGraphics::ResourceManager::registerSharedData("hdrTexture", hdrTexture);
-
-        std::vector<glm::vec3> sh = computeSH(3, true, data, width, height);
-        ElayGraphics::ResourceManager::registerSharedData("iblSH", sh);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Failed to load HDR image." << std::endl;
-    }
-
-    auto envCubemap = std::make_shared<ElayGraphics::STexture>();
-    envCubemap->TextureType = ElayGraphics::STexture::ETextureType::TextureCubeMap;
-    envCubemap->InternalFormat = GL_RGB16F;
-    envCubemap->ExternalFormat = GL_RGB;
-    envCubemap->Width = 256;
-    envCubemap->Height = 256;
-    envCubemap->DataType = GL_FLOAT;
-
-
-    envCubemap->Type4WrapS = GL_CLAMP_TO_EDGE;
-    envCubemap->Type4WrapT = GL_CLAMP_TO_EDGE;
-    envCubemap->Type4WrapR = GL_CLAMP_TO_EDGE;
-    envCubemap->Type4MagFilter = GL_LINEAR;
-    envCubemap->Type4MinFilter = GL_LINEAR_MIPMAP_LINEAR;
-
-    //envCubemap->Type4MinFilter = GL_LINEAR;
-    genTexture(envCubemap);
-    genGenerateMipmap(envCubemap);
-    ElayGraphics::ResourceManager::registerSharedData("envCubemap", envCubemap);
-
- 
-    auto equirectangularToCubemapShader = std::make_shared<CShader>("EquirectangularToCubeMap_VS.glsl", "EquirectangularToCubeMap_FS.glsl");
-    equirectangularToCubemapShader->activeShader();
-    equirectangularToCubemapShader->setTextureUniformValue("equirectangularMap", hdrTexture);
-    const GLenum faces[2][3] = {
-            { GL_TEXTURE_CUBE_MAP_POSITIVE_X, GL_TEXTURE_CUBE_MAP_POSITIVE_Y, GL_TEXTURE_CUBE_MAP_POSITIVE_Z },
-            { GL_TEXTURE_CUBE_MAP_NEGATIVE_X, GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, GL_TEXTURE_CUBE_MAP_NEGATIVE_Z }
-    };
-    glViewport(0, 0, 256, 256);
-    for (size_t i = 0; i < 2; i++)
-    {
-        equirectangularToCubemapShader->setFloatUniformValue("frame_side", i == 0 ? 1.0f : -1.0f);
-        GLuint FBO;
-        glGenFramebuffers(1, &FBO);
-        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, faces[i][0], envCubemap->TextureID, 0);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, faces[i][1], envCubemap->TextureID, 0);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, faces[i][2], envCubemap->TextureID, 0);
-
-        int RenderBufferWidth = 256;
-        int RenderBufferHeight = 256;
-        auto genRenderBufferFunc = [=](GLenum vInternelFormat, GLenum vAttachmentType)
+    CGLStateCache& stateCache = fetchGLStateCache();
+    GLint viewport[4] = { 0, 0, ElayGraphics::WINDOW_KEYWORD::getWindowWidth(), ElayGraphics::WINDOW_KEYWORD::getWindowHeight() };
+    stateCache.getViewport(viewport);
+    float frameCostMs = 0.0f;
+    bool hasRunStep = false;
+    while (m_SwapStage != ESwapStage::Idle && m_SwapStage != ESwapStage::Decoding)
+    {
+        // always make progress, then only take steps expected to fit in what is left of the budget;
+        // a kind of step whose GPU time is not known yet only runs first, as if it took the whole budget
+        const size_t costIndex = __getSwapStepCostIndex();
+        const float gpuMs = m_SwapStepGpuMs[costIndex];
+        const float stepCostMs = gpuMs < 0.0f ? m_SwapFrameBudgetMs : m_SwapStepCpuMs[costIndex] + gpuMs;
+        if (hasRunStep && frameCostMs + stepCostMs > m_SwapFrameBudgetMs)
         {
-            GLint RenderBuffer;
-            glGenRenderbuffers(1, &(GLuint&)RenderBuffer);
-            glBindRenderbuffer(GL_RENDERBUFFER, RenderBuffer);
-            glRenderbufferStorage(GL_RENDERBUFFER, vInternelFormat, RenderBufferWidth, RenderBufferHeight);
-            glFramebufferRenderbuffer(GL_FRAMEBUFFER, vAttachmentType, GL_RENDERBUFFER, RenderBuffer);
-        };
-
+            break;
+        }
+        GLuint query = 0;
+        if (m_FreeStepQueries.empty())
         {
-            genRenderBufferFunc(GL_DEPTH_COMPONENT, GL_DEPTH_ATTACHMENT);
+            glGenQueries(1, &query);
         }
-        //{
-        //    genRenderBufferFunc(GL_STENCIL_INDEX, GL_STENCIL_ATTACHMENT);
-        //}
-        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        else
         {
-            std::cerr << "Error::FBO:: Framebuffer Is Not Complete." << glCheckFramebufferStatus(GL_FRAMEBUFFER) << std::endl;
+            query = m_FreeStepQueries.back();
+            m_FreeStepQueries.pop_back();
         }
-        std::vector<GLenum> Attachments = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 ,GL_COLOR_ATTACHMENT2 };
-        glDrawBuffers(static_cast<int>(Attachments.size()), &Attachments[0]);
-
-        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glBeginQuery(GL_TIME_ELAPSED, query);
+        const auto stepStart = Clock::now();
+        __runSwapStep();
+        m_SwapStepCpuMs[costIndex] = std::chrono::duration<float, std::milli>(Clock::now() - stepStart).count();
+        glEndQuery(GL_TIME_ELAPSED);
+        m_PendingStepQueries.push_back({ query, costIndex });
+        frameCostMs += m_SwapStepCpuMs[costIndex] + std::max(gpuMs, 0.0f);
+        hasRunStep = true;
+    }
+    m_SwapWorstFrameMs = std::max(m_SwapWorstFrameMs, frameCostMs);
 
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        drawQuad();
+    stateCache.bindFramebuffer(GL_FRAMEBUFFER, 0);
+    stateCache.setCapability(GL_DEPTH_TEST, true);
+    stateCache.setViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
 
-        glDeleteFramebuffers(1, &FBO);
+// swaps every IBL resource in one go, readers never see a half filtered environment
+void IBLLigthPass::__publishPendingEnvironment()
+{
+    m_PendingEnvironment.sh.resize(CSHProjector::NUM_COEFS);
+    ElayGraphics::ResourceManager::updateSharedDataByName("envCubemap", m_PendingEnvironment.envCubemap);
+    ElayGraphics::ResourceManager::updateSharedDataByName("prefilterMap", m_PendingEnvironment.prefilterMap);
+    ElayGraphics::ResourceManager::updateSharedDataByName("irradianceMap", m_PendingEnvironment.irradianceMap);
+    ElayGraphics::ResourceManager::updateSharedDataByName("brdfLUTTexture", m_PendingEnvironment.brdfLUT);
+    ElayGraphics::ResourceManager::updateSharedDataByName("iblSH", m_PendingEnvironment.sh);
+
+    m_pBakeContext->releaseEnvironment(m_ActiveEnvironment);
+    m_ActiveEnvironment = m_PendingEnvironment;
+    m_PendingEnvironment = SIBLBakedEnvironment();
+    IBLPath = m_SwapHDRPath;
+    m_SwapStage = ESwapStage::Idle;
+
+    const float elapsedMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_SwapStart).count();
+    std::cout << "IBL environment swapped to " << IBLPath << " in " << elapsedMs << " ms, worst frame estimate "
+        << m_SwapWorstFrameMs << " ms (budget " << m_SwapFrameBudgetMs << " ms)" << std::endl;
+
+    if (!m_QueuedHDRPath.empty())
+    {
+        const std::string queuedPath = m_QueuedHDRPath;
+        m_QueuedHDRPath.clear();
+        requestEnvironment(queuedPath);
     }
-    genGenerateMipmap(envCubemap);
-    glFlush();
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    
-    DfgIBLFilter();
-    IrradianceIBLFilter();
-    SpecularIBLFilter();
-
-    glViewport(0, 0, ElayGraphics::WINDOW_KEYWORD::getWindowWidth(), ElayGraphics::WINDOW_KEYWORD::getWindowHeight());
 }
 
 void IBLLigthPass::updateV()
 {
-
-
-
+    if (m_SwapStage != ESwapStage::Idle)
+    {
+        __advanceEnvironmentSwap();
+    }
 }
-
-
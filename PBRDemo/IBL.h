@@ -1,5 +1,13 @@
 #pragma once
 #include "RenderPass.h"
+#include "SHProjector.h"
+#include "IBLCache.h"
+#include "IBLBakeContext.h"
+#include <memory>
+#include <vector>
+#include <deque>
+#include <future>
+#include <chrono>
 class IBLLigthPass : public IRenderPass
 {
 public:
@@ -7,9 +15,81 @@ public:
 	~IBLLigthPass();
 
 	void setIBLPath(const std::string& vIBLPath);
+	void setSHProjectionMode(ESHProjectionMode vMode, bool vRunBenchmark = false);
+	void setBakeSettings(const SIBLBakeSettings& vSettings);
+	void setIBLCache(bool vEnable, const std::string& vCacheDirectory = "../cache/ibl/");
+	std::vector<SIBLBakedEnvironment> bakeEnvironments(const std::vector<std::string>& vHDRPaths);
+	void requestEnvironment(const std::string& vHDRPath);
+	bool isEnvironmentSwapPending() const { return m_SwapStage != ESwapStage::Idle; }
+	void setSwapFrameBudget(float vMilliseconds) { m_SwapFrameBudgetMs = vMilliseconds; }
 	virtual void initV();
 	virtual void updateV();
 
 private:
+	enum class ESwapStage
+	{
+		Idle,
+		Decoding,
+		Uploading,
+		UploadingCache,
+		Cubemap,
+		Irradiance,
+		Specular,
+	};
+
+	struct SDecodedHDR
+	{
+		float* pData = nullptr;
+		int width = 0;
+		int height = 0;
+		int channels = 0;
+		std::vector<glm::vec3> sh;
+		uint64_t hdrHash = 0;
+		bool isCached = false;
+		std::vector<char> cacheData;    //the whole cache file when isCached, uploaded one entry per step
+	};
+
+	struct SSwapStepQuery
+	{
+		GLuint query;
+		size_t costIndex;
+	};
+
+	bool __bakeEnvironment(const std::string& vHDRPath, SIBLBakedEnvironment& vioEnvironment);
+	static SDecodedHDR __decodeHDR(const std::string& vHDRPath, ESHProjectionMode vMode, const std::string& vCacheDirectory, const SIBLBakeSettings& vSettings);
+	void __startEnvironmentSwap(const std::string& vHDRPath, bool vUseCache);
+	void __advanceEnvironmentSwap();
+	void __runSwapStep();
+	size_t __getSwapStepCostIndex() const;
+	void __resolveSwapStepQueries();
+	void __publishPendingEnvironment();
+
 	std::string IBLPath;
+	SIBLBakeSettings m_BakeSettings;
+	bool m_UseIBLCache = true;
+	std::string m_IBLCacheDirectory = "../cache/ibl/";
+	ESHProjectionMode m_SHProjectionMode = ESHProjectionMode::Parallel;
+	bool m_RunSHBenchmark = false;
+	std::unique_ptr<CIBLBakeContext> m_pBakeContext;
+	SIBLBakedEnvironment m_ActiveEnvironment;
+
+	ESwapStage m_SwapStage = ESwapStage::Idle;
+	std::string m_SwapHDRPath;
+	std::string m_QueuedHDRPath;
+	std::future<SDecodedHDR> m_PendingDecode;
+	SDecodedHDR m_DecodedHDR;
+	SIBLBakedEnvironment m_PendingEnvironment;
+	std::shared_ptr<ElayGraphics::STexture> m_pSwapHDRTexture;
+	GLuint m_StagingBuffer = 0;
+	char* m_pStagingData = nullptr;
+	int m_UploadedRows = 0;
+	uint32_t m_SpecularStep = 0;
+	size_t m_UploadedCacheEntries = 0;
+	float m_SwapFrameBudgetMs = 4.0f;
+	float m_SwapWorstFrameMs = 0.0f;
+	std::vector<float> m_SwapStepCpuMs;
+	std::vector<float> m_SwapStepGpuMs;     //negative until a timer query of that kind of step came back
+	std::deque<SSwapStepQuery> m_PendingStepQueries;
+	std::vector<GLuint> m_FreeStepQueries;
+	std::chrono::steady_clock::time_point m_SwapStart;
 };
\ No newline at end of file
@@ -0,0 +1,460 @@
+#include "IBLBakeContext.h"
+#include "Shader.h"
+#include "Utils.h"
+#include "GLStateCache.h"
+#include "glmextend.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <iostream>
+#include <string>
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    template<typename T>
+    inline constexpr T log4(T x)
+    {
+        return std::log2(x) * T(0.5);
+    }
+
+    const GLenum CUBE_FACES[2][3] =
+    {
+        { GL_TEXTURE_CUBE_MAP_POSITIVE_X, GL_TEXTURE_CUBE_MAP_POSITIVE_Y, GL_TEXTURE_CUBE_MAP_POSITIVE_Z },
+        { GL_TEXTURE_CUBE_MAP_NEGATIVE_X, GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, GL_TEXTURE_CUBE_MAP_NEGATIVE_Z }
+    };
+
+    const GLenum COLOR_ATTACHMENTS[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+
+    // attaches vCount targets of vTexture (level vLevel) and detaches the remaining color attachments,
+    // so a pooled framebuffer never carries attachments over from a previous filter
+    void attachTargets(const GLenum* vTargets, GLsizei vCount, GLuint vTexture, GLint vLevel)
+    {
+        for (GLsizei i = 0; i < 3; i++)
+        {
+            if (i < vCount)
+                glFramebufferTexture2D(GL_FRAMEBUFFER, COLOR_ATTACHMENTS[i], vTargets[i], vTexture, vLevel);
+            else
+                glFramebufferTexture2D(GL_FRAMEBUFFER, COLOR_ATTACHMENTS[i], GL_TEXTURE_2D, 0, 0);
+        }
+        glDrawBuffers(vCount, COLOR_ATTACHMENTS);
+    }
+
+    size_t bytesPerTexel(GLint vInternalFormat)
+    {
+        switch (vInternalFormat)
+        {
+        case GL_RGB16F:             return 6;
+        case GL_RGBA16F:            return 8;
+        case GL_RGB32F:             return 12;
+        case GL_RGBA32F:            return 16;
+        case GL_DEPTH_COMPONENT24:  return 4;
+        default:                    return 4;
+        }
+    }
+}
+
+CIBLBakeContext::CIBLBakeContext(const SIBLBakeSettings& vSettings) : m_Settings(vSettings)
+{
+}
+
+CIBLBakeContext::~CIBLBakeContext()
+{
+    for (const auto& Framebuffer : m_FramebufferPool)
+    {
+        fetchGLStateCache().deleteFramebuffers(1, &Framebuffer.fbo);
+        glDeleteRenderbuffers(1, &Framebuffer.depthRBO);
+    }
+    if (m_pKernelMap)
+        fetchGLStateCache().deleteTextures(1, &(GLuint&)m_pKernelMap->TextureID);
+    if (m_pDfgLUT)
+        fetchGLStateCache().deleteTextures(1, &(GLuint&)m_pDfgLUT->TextureID);
+}
+
+//************************************************************************************
+//Function: one framebuffer + depth renderbuffer per size, created on first use.
+GLuint CIBLBakeContext::__fetchFramebuffer(GLsizei vWidth, GLsizei vHeight)
+{
+    for (const auto& Framebuffer : m_FramebufferPool)
+    {
+        if (Framebuffer.width == vWidth && Framebuffer.height == vHeight)
+        {
+            fetchGLStateCache().bindFramebuffer(GL_FRAMEBUFFER, Framebuffer.fbo);
+            return Framebuffer.fbo;
+        }
+    }
+
+    SFramebuffer Framebuffer = { 0, 0, vWidth, vHeight };
+    glGenFramebuffers(1, &Framebuffer.fbo);
+    glGenRenderbuffers(1, &Framebuffer.depthRBO);
+    fetchGLStateCache().bindFramebuffer(GL_FRAMEBUFFER, Framebuffer.fbo);
+    glBindRenderbuffer(GL_RENDERBUFFER, Framebuffer.depthRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, vWidth, vHeight);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, Framebuffer.depthRBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    __addAllocatedBytes(size_t(vWidth) * vHeight * bytesPerTexel(GL_DEPTH_COMPONENT24));
+    m_FramebufferPool.push_back(Framebuffer);
+    return Framebuffer.fbo;
+}
+
+size_t CIBLBakeContext::__computeTextureBytes(const std::shared_ptr<ElayGraphics::STexture>& vTexture, uint32_t vLevelCount)
+{
+    const size_t Faces = vTexture->TextureType == ElayGraphics::STexture::ETextureType::TextureCubeMap ? 6 : 1;
+    size_t Bytes = 0;
+    for (uint32_t Level = 0; Level < vLevelCount; Level++)
+    {
+        const size_t Width = std::max(1, vTexture->Width >> Level);
+        const size_t Height = std::max(1, vTexture->Height >> Level);
+        Bytes += Width * Height * Faces * bytesPerTexel(vTexture->InternalFormat);
+    }
+    return Bytes;
+}
+
+void CIBLBakeContext::__addAllocatedBytes(size_t vBytes)
+{
+    m_AllocatedBytes += vBytes;
+    m_PeakAllocatedBytes = std::max(m_PeakAllocatedBytes, m_AllocatedBytes);
+}
+
+void CIBLBakeContext::__trackTexture(const std::shared_ptr<ElayGraphics::STexture>& vTexture, uint32_t vLevelCount)
+{
+    __addAllocatedBytes(__computeTextureBytes(vTexture, vLevelCount));
+}
+
+void CIBLBakeContext::__untrackTexture(const std::shared_ptr<ElayGraphics::STexture>& vTexture, uint32_t vLevelCount)
+{
+    m_AllocatedBytes -= std::min(m_AllocatedBytes, __computeTextureBytes(vTexture, vLevelCount));
+}
+
+void CIBLBakeContext::printMemoryUsage() const
+{
+    std::cout << "IBL bake context: " << m_FramebufferPool.size() << " pooled framebuffers, "
+        << m_AllocatedBytes / (1024.0f * 1024.0f) << " MB allocated (peak "
+        << m_PeakAllocatedBytes / (1024.0f * 1024.0f) << " MB)" << std::endl;
+}
+
+//************************************************************************************
+//Function: allocates the output textures of one environment; the DFG LUT is shared.
+SIBLBakedEnvironment CIBLBakeContext::createEnvironment()
+{
+    const uint32_t Dim = m_Settings.cubemapDim;
+    const uint32_t FullMipCount = 1 + uint32_t(std::floor(std::log2(float(Dim))));
+    SIBLBakedEnvironment Environment;
+
+    auto envCubemap = std::make_shared<ElayGraphics::STexture>();
+    envCubemap->TextureType = ElayGraphics::STexture::ETextureType::TextureCubeMap;
+    envCubemap->InternalFormat = GL_RGB16F;
+    envCubemap->ExternalFormat = GL_RGB;
+    envCubemap->Width = Dim;
+    envCubemap->Height = Dim;
+    envCubemap->DataType = GL_FLOAT;
+    envCubemap->Type4WrapS = GL_CLAMP_TO_EDGE;
+    envCubemap->Type4WrapT = GL_CLAMP_TO_EDGE;
+    envCubemap->Type4WrapR = GL_CLAMP_TO_EDGE;
+    envCubemap->Type4MagFilter = GL_LINEAR;
+    envCubemap->Type4MinFilter = GL_LINEAR_MIPMAP_LINEAR;
+    genTexture(envCubemap);
+    genGenerateMipmap(envCubemap);
+    __trackTexture(envCubemap, FullMipCount);
+    Environment.envCubemap = envCubemap;
+
+    auto prefilterMap = std::make_shared<ElayGraphics::STexture>();
+    prefilterMap->TextureType = ElayGraphics::STexture::ETextureType::TextureCubeMap;
+    prefilterMap->InternalFormat = GL_RGB16F;
+    prefilterMap->ExternalFormat = GL_RGB;
+    prefilterMap->Width = Dim;
+    prefilterMap->Height = Dim;
+    prefilterMap->DataType = GL_FLOAT;
+    prefilterMap->Type4WrapS = GL_CLAMP_TO_EDGE;
+    prefilterMap->Type4WrapT = GL_CLAMP_TO_EDGE;
+    prefilterMap->Type4WrapR = GL_CLAMP_TO_EDGE;
+    prefilterMap->Type4MagFilter = GL_LINEAR;
+    prefilterMap->Type4MinFilter = GL_LINEAR_MIPMAP_LINEAR;
+    genTexture(prefilterMap);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap->TextureID);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, m_Settings.levelCount - 1);
+    genGenerateMipmap(prefilterMap);
+    __trackTexture(prefilterMap, FullMipCount);
+    Environment.prefilterMap = prefilterMap;
+
+    auto irradianceMap = std::make_shared<ElayGraphics::STexture>();
+    irradianceMap->TextureType = ElayGraphics::STexture::ETextureType::TextureCubeMap;
+    irradianceMap->InternalFormat = GL_RGB16F;
+    irradianceMap->ExternalFormat = GL_RGB;
+    irradianceMap->Width = Dim;
+    irradianceMap->Height = Dim;
+    irradianceMap->DataType = GL_FLOAT;
+    irradianceMap->Type4WrapS = GL_CLAMP_TO_EDGE;
+    irradianceMap->Type4WrapT = GL_CLAMP_TO_EDGE;
+    irradianceMap->Type4WrapR = GL_CLAMP_TO_EDGE;
+    irradianceMap->Type4MagFilter = GL_LINEAR;
+    irradianceMap->Type4MinFilter = GL_LINEAR;
+    genTexture(irradianceMap);
+    __trackTexture(irradianceMap, 1);
+    Environment.irradianceMap = irradianceMap;
+
+    if (!m_pDfgLUT)
+    {
+        m_pDfgLUT = std::make_shared<ElayGraphics::STexture>();
+        m_pDfgLUT->TextureType = ElayGraphics::STexture::ETextureType::Texture2D;
+        m_pDfgLUT->InternalFormat = GL_RGB16F;
+        m_pDfgLUT->ExternalFormat = GL_RGB;
+        m_pDfgLUT->Width = m_Settings.dfgDim;
+        m_pDfgLUT->Height = m_Settings.dfgDim;
+        m_pDfgLUT->DataType = GL_FLOAT;
+        m_pDfgLUT->Type4WrapS = GL_CLAMP_TO_EDGE;
+        m_pDfgLUT->Type4WrapT = GL_CLAMP_TO_EDGE;
+        m_pDfgLUT->Type4MagFilter = GL_LINEAR;
+        m_pDfgLUT->Type4MinFilter = GL_LINEAR;
+        genTexture(m_pDfgLUT);
+        __trackTexture(m_pDfgLUT, 1);
+    }
+    Environment.brdfLUT = m_pDfgLUT;
+    return Environment;
+}
+
+void CIBLBakeContext::releaseEnvironment(SIBLBakedEnvironment& vioEnvironment)
+{
+    const uint32_t FullMipCount = 1 + uint32_t(std::floor(std::log2(float(m_Settings.cubemapDim))));
+    if (vioEnvironment.envCubemap)
+    {
+        __untrackTexture(vioEnvironment.envCubemap, FullMipCount);
+        fetchGLStateCache().deleteTextures(1, &(GLuint&)vioEnvironment.envCubemap->TextureID);
+    }
+    if (vioEnvironment.prefilterMap)
+    {
+        __untrackTexture(vioEnvironment.prefilterMap, FullMipCount);
+        fetchGLStateCache().deleteTextures(1, &(GLuint&)vioEnvironment.prefilterMap->TextureID);
+    }
+    if (vioEnvironment.irradianceMap)
+    {
+        __untrackTexture(vioEnvironment.irradianceMap, 1);
+        fetchGLStateCache().deleteTextures(1, &(GLuint&)vioEnvironment.irradianceMap->TextureID);
+    }
+    vioEnvironment = SIBLBakedEnvironment();
+}
+
+//************************************************************************************
+//Function:
+const std::shared_ptr<ElayGraphics::STexture>& CIBLBakeContext::getOrBakeDfgLUT()
+{
+    _ASSERT(m_pDfgLUT);    // allocated by createEnvironment()
+    if (m_IsDfgLUTBaked)
+        return m_pDfgLUT;
+
+    fetchGLStateCache().setCapability(GL_DEPTH_TEST, false);
+    const GLsizei Dim = m_Settings.dfgDim;
+    const GLenum Target = GL_TEXTURE_2D;
+    __fetchFramebuffer(Dim, Dim);
+    attachTargets(&Target, 1, m_pDfgLUT->TextureID, 0);
+
+    // used once per context, no need to keep the program around
+    CShader DfgIBLShader("DfgIBL_VS.glsl", "DfgIBL_FS.glsl");
+    fetchGLStateCache().setViewport(0, 0, Dim, Dim);
+    DfgIBLShader.activeShader();
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    drawQuad();
+    fetchGLStateCache().bindFramebuffer(GL_FRAMEBUFFER, 0);
+    fetchGLStateCache().setCapability(GL_DEPTH_TEST, true);
+
+    m_IsDfgLUTBaked = true;
+    return m_pDfgLUT;
+}
+
+//************************************************************************************
+//Function:
+void CIBLBakeContext::bakeCubemap(const std::shared_ptr<ElayGraphics::STexture>& vHDRTexture, const std::shared_ptr<ElayGraphics::STexture>& vEnvCubemap)
+{
+    if (!m_pEquirectangularShader)
+        m_pEquirectangularShader = std::make_shared<CShader>("EquirectangularToCubeMap_VS.glsl", "EquirectangularToCubeMap_FS.glsl");
+
+    const GLsizei Dim = m_Settings.cubemapDim;
+    m_pEquirectangularShader->activeShader();
+    m_pEquirectangularShader->setTextureUniformValue("equirectangularMap", vHDRTexture);
+    __fetchFramebuffer(Dim, Dim);
+    fetchGLStateCache().setViewport(0, 0, Dim, Dim);
+    for (size_t i = 0; i < 2; i++)
+    {
+        m_pEquirectangularShader->setFloatUniformValue("frame_side", i == 0 ? 1.0f : -1.0f);
+        attachTargets(CUBE_FACES[i], 3, vEnvCubemap->TextureID, 0);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        drawQuad();
+    }
+    fetchGLStateCache().bindFramebuffer(GL_FRAMEBUFFER, 0);
+    genGenerateMipmap(vEnvCubemap);
+    glFlush();
+}
+
+//************************************************************************************
+//Function:
+void CIBLBakeContext::bakeIrradiance(const std::shared_ptr<ElayGraphics::STexture>& vEnvCubemap, const std::shared_ptr<ElayGraphics::STexture>& vIrradianceMap)
+{
+    glm::mat4 captureProjection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
+    glm::mat4 captureViews[] =
+    {
+        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
+        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(-1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
+        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f,  1.0f,  0.0f), glm::vec3(0.0f,  0.0f,  1.0f)),
+        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f,  0.0f), glm::vec3(0.0f,  0.0f, -1.0f)),
+        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f,  0.0f,  1.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
+        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f,  0.0f, -1.0f), glm::vec3(0.0f, -1.0f,  0.0f))
+    };
+
+    if (!m_pIrradianceShader)
+        m_pIrradianceShader = std::make_shared<CShader>("IrradianceConvolution_VS.glsl", "IrradianceConvolution_FS.glsl");
+
+    fetchGLStateCache().setCapability(GL_DEPTH_TEST, true);
+    const GLsizei Dim = vIrradianceMap->Width;
+    m_pIrradianceShader->activeShader();
+    m_pIrradianceShader->setTextureUniformValue("environmentMap", vEnvCubemap);
+    m_pIrradianceShader->setMat4UniformValue("projection", glm::value_ptr(captureProjection));
+    __fetchFramebuffer(Dim, Dim);
+    fetchGLStateCache().setViewport(0, 0, Dim, Dim); // don't forget to configure the viewport to the capture dimensions.
+    for (unsigned int i = 0; i < 6; ++i)
+    {
+        const GLenum Target = GL_TEXTURE_CUBE_MAP_POSITIVE_X + i;
+        m_pIrradianceShader->setMat4UniformValue("view", glm::value_ptr(captureViews[i]));
+        attachTargets(&Target, 1, vIrradianceMap->TextureID, 0);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        drawCube();
+    }
+    glFlush();
+    fetchGLStateCache().bindFramebuffer(GL_FRAMEBUFFER, 0);
+    fetchGLStateCache().setCapability(GL_DEPTH_TEST, false);
+}
+
+//************************************************************************************
+//Function: the roughness -> sample kernel table shared by every specular bake.
+void CIBLBakeContext::__bakeKernelMap()
+{
+    auto lodToPerceptualRoughness = [](const float lod) -> float {
+        // Inverse perceptualRoughness-to-LOD mapping:
+        // The LOD-to-perceptualRoughness mapping is a quadratic fit for
+        // log2(perceptualRoughness)+iblMaxMipLevel when iblMaxMipLevel is 4.
+        // We found empirically that this mapping works very well for a 256 cubemap with 5 levels used,
+        // but also scales well for other iblMaxMipLevel values.
+        const float a = 2.0f;
+        const float b = -1.0f;
+        return (lod != 0.0f) ? glm::saturate((sqrt(a * a + 4.0f * b * lod) - a) / (2.0f * b)) : 0.0f;
+    };
+
+    m_pKernelMap = std::make_shared<ElayGraphics::STexture>();
+    m_pKernelMap->TextureType = ElayGraphics::STexture::ETextureType::Texture2D;
+    m_pKernelMap->InternalFormat = GL_RGBA16F;
+    m_pKernelMap->ExternalFormat = GL_RGBA;
+    m_pKernelMap->Width = m_Settings.levelCount;
+    m_pKernelMap->Height = m_Settings.sampleCount;
+    m_pKernelMap->DataType = GL_FLOAT;
+    m_pKernelMap->Type4WrapS = GL_CLAMP_TO_EDGE;
+    m_pKernelMap->Type4WrapT = GL_CLAMP_TO_EDGE;
+    m_pKernelMap->Type4WrapR = GL_CLAMP_TO_EDGE;
+    m_pKernelMap->Type4MagFilter = GL_NEAREST;
+    m_pKernelMap->Type4MinFilter = GL_NEAREST;
+    genTexture(m_pKernelMap);
+    __trackTexture(m_pKernelMap, 1);
+
+    const int LevelCount = m_Settings.levelCount;
+    float roughnessArray[16] = {};
+    for (int i = 0; i < std::min(LevelCount, 16); i++)
+    {
+        float const perceptualRoughness = lodToPerceptualRoughness(
+            glm::saturate(float(i) * (1.0f / (float(LevelCount) - 1.0f))));
+        roughnessArray[i] = perceptualRoughness * perceptualRoughness;
+    }
+
+    fetchGLStateCache().setCapability(GL_DEPTH_TEST, false);
+    const GLenum Target = GL_TEXTURE_2D;
+    __fetchFramebuffer(m_pKernelMap->Width, m_pKernelMap->Height);
+    attachTargets(&Target, 1, m_pKernelMap->TextureID, 0);
+    CShader KernelFilterShader("KernelFilter_VS.glsl", "KernelFilter_FS.glsl");
+    KernelFilterShader.activeShader();
+    for (int i = 0; i < 16; i++)
+    {
+        std::string setName = "input_roughness[" + std::to_string(i) + "]";
+        KernelFilterShader.setFloatUniformValue(setName.c_str(), roughnessArray[i]);
+    }
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    fetchGLStateCache().setViewport(0, 0, m_pKernelMap->Width, m_pKernelMap->Height);
+    drawQuad();
+    fetchGLStateCache().bindFramebuffer(GL_FRAMEBUFFER, 0);
+    fetchGLStateCache().setCapability(GL_DEPTH_TEST, true);
+}
+
+//************************************************************************************
+//Function: filters one mip level of one cube side (+ or - faces, drawn as MRT).
+void CIBLBakeContext::bakeSpecularLevel(const std::shared_ptr<ElayGraphics::STexture>& vEnvCubemap, const std::shared_ptr<ElayGraphics::STexture>& vPrefilterMap, uint32_t vLevel, uint32_t vSide)
+{
+    if (!m_pKernelMap)
+        __bakeKernelMap();
+    if (!m_pSpecularShader)
+    {
+        m_pSpecularShader = std::make_shared<CShader>("SpecularFilter_VS.glsl", "SpecularFilter_FS.glsl");
+        m_pSpecularShader->activeShader();
+        m_pSpecularShader->setTextureUniformValue("materialParams_kernel", m_pKernelMap);
+    }
+
+    const uint32_t BaseDim = m_Settings.cubemapDim;
+    const GLsizei Dim = std::max(1u, BaseDim >> vLevel);
+    const float omegaP = (4.0f * glm::PI) / float(6 * BaseDim * BaseDim);
+    float lodOffset = m_Settings.lodOffset;
+    if (vLevel == m_Settings.levelCount - 1)
+    {
+        // this is the last lod, use a more aggressive filtering because this level is also
+        // used for the diffuse brdf by filament, and we need it to be very smooth.
+        // So we set the lod offset to at least 2.
+        lodOffset = std::max(2.0f, lodOffset);
+    }
+
+    fetchGLStateCache().setCapability(GL_DEPTH_TEST, false);
+    m_pSpecularShader->activeShader();
+    m_pSpecularShader->setTextureUniformValue("materialParams_environment", vEnvCubemap);
+    m_pSpecularShader->setFloatUniformValue("frame_compress", m_Settings.hdrLinear, m_Settings.hdrMax);
+    m_pSpecularShader->setFloatUniformValue("frame_lodOffset", lodOffset - log4(omegaP));
+    m_pSpecularShader->setIntUniformValue("frame_sampleCount", vLevel == 0 ? 1 : m_Settings.sampleCount);
+    m_pSpecularShader->setIntUniformValue("frame_attachmentLevel", vLevel);
+    m_pSpecularShader->setFloatUniformValue("frame_side", vSide == 0 ? 1.0f : -1.0f);
+
+    __fetchFramebuffer(Dim, Dim);
+    attachTargets(CUBE_FACES[vSide], 3, vPrefilterMap->TextureID, vLevel);
+    fetchGLStateCache().setViewport(0, 0, Dim, Dim);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    drawQuad();
+    fetchGLStateCache().bindFramebuffer(GL_FRAMEBUFFER, 0);
+    fetchGLStateCache().setCapability(GL_DEPTH_TEST, true);
+}
+
+//************************************************************************************
+//Function: pbr: run a quasi monte-carlo simulation on the environment lighting to create a prefilter (cube)map.
+void CIBLBakeContext::bakeSpecular(const std::shared_ptr<ElayGraphics::STexture>& vEnvCubemap, const std::shared_ptr<ElayGraphics::STexture>& vPrefilterMap)
+{
+    for (uint32_t Level = 0; Level < m_Settings.levelCount; Level++)
+    {
+        bakeSpecularLevel(vEnvCubemap, vPrefilterMap, Level, 0);
+        bakeSpecularLevel(vEnvCubemap, vPrefilterMap, Level, 1);
+        glFlush();
+    }
+}
+
+//************************************************************************************
+//Function:
+void CIBLBakeContext::bakeEnvironment(const std::shared_ptr<ElayGraphics::STexture>& vHDRTexture, SIBLBakedEnvironment& vioEnvironment)
+{
+    bakeCubemap(vHDRTexture, vioEnvironment.envCubemap);
+    vioEnvironment.brdfLUT = getOrBakeDfgLUT();
+    bakeIrradiance(vioEnvironment.envCubemap, vioEnvironment.irradianceMap);
+    bakeSpecular(vioEnvironment.envCubemap, vioEnvironment.prefilterMap);
+}
+
+//************************************************************************************
+//Function: bakes several environments through the same pooled framebuffers and shaders.
+std::vector<SIBLBakedEnvironment> CIBLBakeContext::bakeBatch(const std::vector<std::shared_ptr<ElayGraphics::STexture>>& vHDRTextures)
+{
+    std::vector<SIBLBakedEnvironment> Environments;
+    Environments.reserve(vHDRTextures.size());
+    for (const auto& pHDRTexture : vHDRTextures)
+    {
+        Environments.push_back(createEnvironment());
+        bakeEnvironment(pHDRTexture, Environments.back());
+    }
+    return Environments;
+}
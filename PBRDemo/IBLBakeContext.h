@@ -0,0 +1,74 @@
+#pragma once
+#include "IBLCache.h"
+#include <GL/glew.h>
+#include <memory>
+#include <vector>
+
+class CShader;
+
+// Owns everything needed to bake IBL environments on the GPU: the filter
+// shaders, the specular kernel map, the DFG LUT (environment independent, so
+// baked once) and a small pool of framebuffers with depth renderbuffers, one per
+// render-target size. Nothing is created per face or per mip level, so baking a
+// batch of environments allocates only the output textures.
+//
+// All GL objects it creates are released by the destructor; output textures are
+// released through releaseEnvironment(). Texture/renderbuffer bytes are tracked
+// as an estimate of the GPU memory held by the context and its environments.
+class CIBLBakeContext
+{
+public:
+    explicit CIBLBakeContext(const SIBLBakeSettings& vSettings);
+    ~CIBLBakeContext();
+
+    CIBLBakeContext(const CIBLBakeContext&) = delete;
+    CIBLBakeContext& operator=(const CIBLBakeContext&) = delete;
+
+    SIBLBakedEnvironment createEnvironment();
+    void releaseEnvironment(SIBLBakedEnvironment& vioEnvironment);
+
+    void bakeEnvironment(const std::shared_ptr<ElayGraphics::STexture>& vHDRTexture, SIBLBakedEnvironment& vioEnvironment);
+    std::vector<SIBLBakedEnvironment> bakeBatch(const std::vector<std::shared_ptr<ElayGraphics::STexture>>& vHDRTextures);
+
+    void bakeCubemap(const std::shared_ptr<ElayGraphics::STexture>& vHDRTexture, const std::shared_ptr<ElayGraphics::STexture>& vEnvCubemap);
+    void bakeIrradiance(const std::shared_ptr<ElayGraphics::STexture>& vEnvCubemap, const std::shared_ptr<ElayGraphics::STexture>& vIrradianceMap);
+    void bakeSpecularLevel(const std::shared_ptr<ElayGraphics::STexture>& vEnvCubemap, const std::shared_ptr<ElayGraphics::STexture>& vPrefilterMap, uint32_t vLevel, uint32_t vSide);
+    void bakeSpecular(const std::shared_ptr<ElayGraphics::STexture>& vEnvCubemap, const std::shared_ptr<ElayGraphics::STexture>& vPrefilterMap);
+    const std::shared_ptr<ElayGraphics::STexture>& getOrBakeDfgLUT();
+    void markDfgLUTBaked() { m_IsDfgLUTBaked = true; }
+
+    const SIBLBakeSettings& getSettings() const { return m_Settings; }
+    size_t getAllocatedBytes() const { return m_AllocatedBytes; }
+    size_t getPeakAllocatedBytes() const { return m_PeakAllocatedBytes; }
+    size_t getFramebufferCount() const { return m_FramebufferPool.size(); }
+    void printMemoryUsage() const;
+
+private:
+    struct SFramebuffer
+    {
+        GLuint fbo;
+        GLuint depthRBO;
+        GLsizei width;
+        GLsizei height;
+    };
+
+    GLuint __fetchFramebuffer(GLsizei vWidth, GLsizei vHeight);
+    void __bakeKernelMap();
+    void __trackTexture(const std::shared_ptr<ElayGraphics::STexture>& vTexture, uint32_t vLevelCount);
+    void __untrackTexture(const std::shared_ptr<ElayGraphics::STexture>& vTexture, uint32_t vLevelCount);
+    void __addAllocatedBytes(size_t vBytes);
+    static size_t __computeTextureBytes(const std::shared_ptr<ElayGraphics::STexture>& vTexture, uint32_t vLevelCount);
+
+    SIBLBakeSettings m_Settings;
+    std::vector<SFramebuffer> m_FramebufferPool;
+
+    std::shared_ptr<CShader> m_pEquirectangularShader;
+    std::shared_ptr<CShader> m_pIrradianceShader;
+    std::shared_ptr<CShader> m_pSpecularShader;
+    std::shared_ptr<ElayGraphics::STexture> m_pKernelMap;
+    std::shared_ptr<ElayGraphics::STexture> m_pDfgLUT;
+    bool m_IsDfgLUTBaked = false;
+
+    size_t m_AllocatedBytes = 0;
+    size_t m_PeakAllocatedBytes = 0;
+};
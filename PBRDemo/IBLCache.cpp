@@ -0,0 +1,341 @@
+#include "IBLCache.h"
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <cstring>
+
+namespace
+{
+    constexpr char     CACHE_MAGIC[8] = { 'P', 'B', 'R', 'I', 'B', 'L', 'C', '1' };
+    constexpr uint32_t CACHE_VERSION = 1;
+    constexpr uint64_t CACHE_ALIGNMENT = 16;
+    constexpr uint64_t BYTES_PER_TEXEL = 3 * sizeof(uint16_t);   // RGB16F
+
+    constexpr uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ull;
+    constexpr uint64_t FNV_PRIME = 0x100000001b3ull;
+
+    inline uint64_t fnv1a(const void* data, size_t size, uint64_t hash = FNV_OFFSET_BASIS)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= FNV_PRIME;
+        }
+        return hash;
+    }
+
+    inline uint64_t alignOffset(uint64_t offset)
+    {
+        return (offset + CACHE_ALIGNMENT - 1) & ~(CACHE_ALIGNMENT - 1);
+    }
+}
+
+CIBLCache::CIBLCache(const std::string& vCacheDirectory) : m_CacheDirectory(vCacheDirectory)
+{
+}
+
+//************************************************************************************
+//Function: 64-bit FNV-1a of the file content, 0 if the file can't be read.
+uint64_t CIBLCache::hashFile(const std::string& vFilePath)
+{
+    std::error_code ErrorCode;
+    const uintmax_t FileSize = std::filesystem::file_size(vFilePath, ErrorCode);
+    if (ErrorCode || FileSize == 0)
+    {
+        return 0;
+    }
+
+    try
+    {
+        boost::interprocess::file_mapping File(vFilePath.c_str(), boost::interprocess::read_only);
+        boost::interprocess::mapped_region Region(File, boost::interprocess::read_only);
+        return fnv1a(Region.get_address(), Region.get_size());
+    }
+    catch (const boost::interprocess::interprocess_exception& vException)
+    {
+        std::cerr << "Error::IBLCache:: Failed to map " << vFilePath << ": " << vException.what() << std::endl;
+        return 0;
+    }
+}
+
+uint64_t CIBLCache::__hashSettings(uint64_t vHDRHash, const SIBLBakeSettings& vSettings)
+{
+    uint64_t Hash = fnv1a(&vHDRHash, sizeof(vHDRHash));
+    Hash = fnv1a(&CACHE_VERSION, sizeof(CACHE_VERSION), Hash);
+    Hash = fnv1a(&vSettings.hdrLinear, sizeof(vSettings.hdrLinear), Hash);
+    Hash = fnv1a(&vSettings.hdrMax, sizeof(vSettings.hdrMax), Hash);
+    Hash = fnv1a(&vSettings.lodOffset, sizeof(vSettings.lodOffset), Hash);
+    Hash = fnv1a(&vSettings.sampleCount, sizeof(vSettings.sampleCount), Hash);
+    Hash = fnv1a(&vSettings.cubemapDim, sizeof(vSettings.cubemapDim), Hash);
+    Hash = fnv1a(&vSettings.levelCount, sizeof(vSettings.levelCount), Hash);
+    Hash = fnv1a(&vSettings.dfgDim, sizeof(vSettings.dfgDim), Hash);
+    return Hash;
+}
+
+std::string CIBLCache::getCacheFilePath(uint64_t vHDRHash, const SIBLBakeSettings& vSettings) const
+{
+    std::ostringstream FileName;
+    FileName << std::hex << std::setw(16) << std::setfill('0') << __hashSettings(vHDRHash, vSettings) << ".iblcache";
+    return (std::filesystem::path(m_CacheDirectory) / FileName.str()).string();
+}
+
+//************************************************************************************
+//Function: entry table in file order; the layout only depends on the settings.
+std::vector<CIBLCache::SEntry> CIBLCache::__buildLayout(const SIBLBakeSettings& vSettings, uint64_t& voFileSize)
+{
+    std::vector<SEntry> Entries;
+    auto addEntry = [&Entries](EEntryKind vKind, uint32_t vLevel, uint32_t vFace, uint32_t vWidth, uint32_t vHeight, uint64_t vSize)
+    {
+        Entries.push_back({ vKind, vLevel, vFace, vWidth, vHeight, 0, 0, vSize });
+    };
+
+    const uint32_t Dim = vSettings.cubemapDim;
+    for (uint32_t Face = 0; Face < 6; Face++)
+    {
+        addEntry(EEntryKind::EnvCubemap, 0, Face, Dim, Dim, uint64_t(Dim) * Dim * BYTES_PER_TEXEL);
+    }
+    for (uint32_t Level = 0; Level < vSettings.levelCount; Level++)
+    {
+        const uint32_t LevelDim = std::max(1u, Dim >> Level);
+        for (uint32_t Face = 0; Face < 6; Face++)
+        {
+            addEntry(EEntryKind::PrefilterMap, Level, Face, LevelDim, LevelDim, uint64_t(LevelDim) * LevelDim * BYTES_PER_TEXEL);
+        }
+    }
+    for (uint32_t Face = 0; Face < 6; Face++)
+    {
+        addEntry(EEntryKind::IrradianceMap, 0, Face, Dim, Dim, uint64_t(Dim) * Dim * BYTES_PER_TEXEL);
+    }
+    addEntry(EEntryKind::BRDFLUT, 0, 0, vSettings.dfgDim, vSettings.dfgDim, uint64_t(vSettings.dfgDim) * vSettings.dfgDim * BYTES_PER_TEXEL);
+    addEntry(EEntryKind::SphericalHarmonics, 0, 0, 9, 1, 9 * sizeof(glm::vec3));
+
+    uint64_t Offset = alignOffset(sizeof(SHeader) + Entries.size() * sizeof(SEntry));
+    for (auto& Entry : Entries)
+    {
+        Entry.offset = Offset;
+        Offset = alignOffset(Offset + Entry.size);
+    }
+    voFileSize = Offset;
+    return Entries;
+}
+
+GLenum CIBLCache::__getTarget(const SEntry& vEntry)
+{
+    return vEntry.kind == EEntryKind::BRDFLUT ? GL_TEXTURE_2D : GL_TEXTURE_CUBE_MAP_POSITIVE_X + vEntry.face;
+}
+
+std::shared_ptr<ElayGraphics::STexture> CIBLCache::__getTexture(const SEntry& vEntry, const SIBLBakedEnvironment& vEnvironment)
+{
+    switch (vEntry.kind)
+    {
+    case EEntryKind::EnvCubemap:    return vEnvironment.envCubemap;
+    case EEntryKind::PrefilterMap:  return vEnvironment.prefilterMap;
+    case EEntryKind::IrradianceMap: return vEnvironment.irradianceMap;
+    case EEntryKind::BRDFLUT:       return vEnvironment.brdfLUT;
+    default:                        return nullptr;
+    }
+}
+
+//************************************************************************************
+//Function: uploads a cache hit straight from the mapped file into vioEnvironment's textures.
+bool CIBLCache::load(uint64_t vHDRHash, const SIBLBakeSettings& vSettings, SIBLBakedEnvironment& vioEnvironment) const
+{
+    const std::string FilePath = getCacheFilePath(vHDRHash, vSettings);
+    std::error_code ErrorCode;
+    if (vHDRHash == 0 || !std::filesystem::exists(FilePath, ErrorCode))
+    {
+        return false;
+    }
+
+    uint64_t ExpectedSize = 0;
+    const std::vector<SEntry> Layout = __buildLayout(vSettings, ExpectedSize);
+
+    try
+    {
+        boost::interprocess::file_mapping File(FilePath.c_str(), boost::interprocess::read_only);
+        boost::interprocess::mapped_region Region(File, boost::interprocess::read_only);
+        const char* pBase = static_cast<const char*>(Region.get_address());
+        if (!__checkFile(pBase, Region.get_size(), vHDRHash, Layout, ExpectedSize, FilePath))
+        {
+            return false;
+        }
+        for (const auto& Entry : Layout)
+        {
+            __uploadEntry(Entry, pBase + Entry.offset, vioEnvironment);
+        }
+    }
+    catch (const boost::interprocess::interprocess_exception& vException)
+    {
+        std::cerr << "Error::IBLCache:: Failed to map " << FilePath << ": " << vException.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+//************************************************************************************
+//Function: reads and checks a cache hit without any GL call, so a worker can do it. The entries are
+//uploaded one by one with uploadEntry(), which lets a runtime swap spread them over frames.
+bool CIBLCache::read(uint64_t vHDRHash, const SIBLBakeSettings& vSettings, std::vector<char>& voFileData) const
+{
+    const std::string FilePath = getCacheFilePath(vHDRHash, vSettings);
+    std::error_code ErrorCode;
+    if (vHDRHash == 0 || !std::filesystem::exists(FilePath, ErrorCode))
+    {
+        return false;
+    }
+
+    uint64_t ExpectedSize = 0;
+    const std::vector<SEntry> Layout = __buildLayout(vSettings, ExpectedSize);
+    std::ifstream File(FilePath, std::ios::binary);
+    voFileData.resize(ExpectedSize);
+    if (!File.read(voFileData.data(), ExpectedSize) || !__checkFile(voFileData.data(), voFileData.size(), vHDRHash, Layout, ExpectedSize, FilePath))
+    {
+        if (!File)
+        {
+            std::cerr << "Error::IBLCache:: " << FilePath << " is truncated." << std::endl;
+        }
+        voFileData.clear();
+        return false;
+    }
+    return true;
+}
+
+//************************************************************************************
+//Function:
+size_t CIBLCache::getEntryCount(const SIBLBakeSettings& vSettings)
+{
+    uint64_t FileSize = 0;
+    return __buildLayout(vSettings, FileSize).size();
+}
+
+//************************************************************************************
+//Function: vFileData is the content read() returned for the same settings.
+void CIBLCache::uploadEntry(const std::vector<char>& vFileData, const SIBLBakeSettings& vSettings, size_t vEntryIndex, SIBLBakedEnvironment& vioEnvironment)
+{
+    uint64_t FileSize = 0;
+    const std::vector<SEntry> Layout = __buildLayout(vSettings, FileSize);
+    _ASSERT(vEntryIndex < Layout.size() && vFileData.size() >= FileSize);
+    __uploadEntry(Layout[vEntryIndex], vFileData.data() + Layout[vEntryIndex].offset, vioEnvironment);
+}
+
+//************************************************************************************
+//Function: size, header and entry table against the layout the settings give.
+bool CIBLCache::__checkFile(const char* vData, size_t vSize, uint64_t vHDRHash, const std::vector<SEntry>& vLayout, uint64_t vExpectedSize, const std::string& vFilePath)
+{
+    if (vSize < vExpectedSize)
+    {
+        std::cerr << "Error::IBLCache:: " << vFilePath << " is truncated." << std::endl;
+        return false;
+    }
+
+    SHeader Header;
+    std::memcpy(&Header, vData, sizeof(Header));
+    if (std::memcmp(Header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || Header.version != CACHE_VERSION ||
+        Header.hdrHash != vHDRHash || Header.entryCount != vLayout.size())
+    {
+        std::cerr << "Error::IBLCache:: " << vFilePath << " does not match the requested environment." << std::endl;
+        return false;
+    }
+
+    const SEntry* pEntries = reinterpret_cast<const SEntry*>(vData + sizeof(SHeader));
+    for (size_t i = 0; i < vLayout.size(); i++)
+    {
+        if (std::memcmp(&pEntries[i], &vLayout[i], sizeof(SEntry)) != 0)
+        {
+            std::cerr << "Error::IBLCache:: " << vFilePath << " has an unexpected layout." << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+//************************************************************************************
+//Function: one face/level of a texture, or the SH coefficients.
+void CIBLCache::__uploadEntry(const SEntry& vEntry, const char* vData, SIBLBakedEnvironment& vioEnvironment)
+{
+    if (vEntry.kind == EEntryKind::SphericalHarmonics)
+    {
+        vioEnvironment.sh.resize(vEntry.width);
+        std::memcpy(vioEnvironment.sh.data(), vData, vEntry.size);
+        return;
+    }
+
+    auto pTexture = __getTexture(vEntry, vioEnvironment);
+    _ASSERT(pTexture);
+    const GLenum BindTarget = vEntry.kind == EEntryKind::BRDFLUT ? GL_TEXTURE_2D : GL_TEXTURE_CUBE_MAP;
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glBindTexture(BindTarget, pTexture->TextureID);
+    glTexSubImage2D(__getTarget(vEntry), vEntry.level, 0, 0, vEntry.width, vEntry.height, GL_RGB, GL_HALF_FLOAT, vData);
+    glBindTexture(BindTarget, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+//************************************************************************************
+//Function: reads the baked textures back and writes them to a new cache file.
+bool CIBLCache::save(uint64_t vHDRHash, const SIBLBakeSettings& vSettings, const SIBLBakedEnvironment& vEnvironment) const
+{
+    if (vHDRHash == 0 || vEnvironment.sh.size() != 9)
+    {
+        return false;
+    }
+
+    uint64_t FileSize = 0;
+    const std::vector<SEntry> Layout = __buildLayout(vSettings, FileSize);
+
+    std::vector<char> Buffer(FileSize, 0);
+    SHeader Header = {};
+    std::memcpy(Header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    Header.version = CACHE_VERSION;
+    Header.entryCount = static_cast<uint32_t>(Layout.size());
+    Header.hdrHash = vHDRHash;
+    Header.settings = vSettings;
+    std::memcpy(Buffer.data(), &Header, sizeof(Header));
+    std::memcpy(Buffer.data() + sizeof(Header), Layout.data(), Layout.size() * sizeof(SEntry));
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    for (const auto& Entry : Layout)
+    {
+        char* pData = Buffer.data() + Entry.offset;
+        if (Entry.kind == EEntryKind::SphericalHarmonics)
+        {
+            std::memcpy(pData, vEnvironment.sh.data(), Entry.size);
+            continue;
+        }
+
+        auto pTexture = __getTexture(Entry, vEnvironment);
+        _ASSERT(pTexture);
+        const GLenum BindTarget = Entry.kind == EEntryKind::BRDFLUT ? GL_TEXTURE_2D : GL_TEXTURE_CUBE_MAP;
+        glBindTexture(BindTarget, pTexture->TextureID);
+        glGetTexImage(__getTarget(Entry), Entry.level, GL_RGB, GL_HALF_FLOAT, pData);
+    }
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+    // write to a temporary file first so a crash never leaves a half-written cache behind
+    std::error_code ErrorCode;
+    std::filesystem::create_directories(m_CacheDirectory, ErrorCode);
+    const std::string FilePath = getCacheFilePath(vHDRHash, vSettings);
+    const std::string TempPath = FilePath + ".tmp";
+    {
+        std::ofstream File(TempPath, std::ios::binary | std::ios::trunc);
+        if (!File.write(Buffer.data(), Buffer.size()))
+        {
+            std::cerr << "Error::IBLCache:: Failed to write " << TempPath << std::endl;
+            return false;
+        }
+    }
+    std::filesystem::remove(FilePath, ErrorCode);
+    std::filesystem::rename(TempPath, FilePath, ErrorCode);
+    if (ErrorCode)
+    {
+        std::cerr << "Error::IBLCache:: Failed to move " << TempPath << " to " << FilePath << ": " << ErrorCode.message() << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include "Common.h"
+#include <GLM/glm.hpp>
+#include <GL/glew.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Everything the IBL bake output depends on besides the HDR file itself.
+struct SIBLBakeSettings
+{
+    float hdrLinear = 1024.0f;      //!< no HDR compression up to this value
+    float hdrMax = 16384.0f;        //!< HDR compression between hdrLinear and hdrMax
+    float lodOffset = 1.0f;         //!< Good values are 1.0 or 2.0. Higher values help with heavily HDR inputs.
+    uint32_t sampleCount = 1024;    //!< specular prefilter samples per texel
+    uint32_t cubemapDim = 256;      //!< envCubemap / prefilterMap / irradianceMap face size
+    uint32_t levelCount = 5;        //!< prefilterMap mip levels
+    uint32_t dfgDim = 512;          //!< brdfLUTTexture size
+};
+
+// Textures (already allocated with the sizes given by SIBLBakeSettings) and SH
+// the cache reads into or writes out of.
+struct SIBLBakedEnvironment
+{
+    std::shared_ptr<ElayGraphics::STexture> envCubemap;
+    std::shared_ptr<ElayGraphics::STexture> prefilterMap;
+    std::shared_ptr<ElayGraphics::STexture> irradianceMap;
+    std::shared_ptr<ElayGraphics::STexture> brdfLUT;
+    std::vector<glm::vec3> sh;
+};
+
+// Content-addressed on-disk cache of the filtered IBL artifacts.
+//
+// One file per (HDR content hash, bake settings) holds a fixed header, an entry
+// table and the RGB16F texel data of every face/level plus the 9 SH coefficients.
+// Offsets are 16 bytes aligned so the file is uploaded straight from a read-only
+// mapping, without any parsing or intermediate copy.
+class CIBLCache
+{
+public:
+    explicit CIBLCache(const std::string& vCacheDirectory);
+
+    static uint64_t hashFile(const std::string& vFilePath);
+
+    std::string getCacheFilePath(uint64_t vHDRHash, const SIBLBakeSettings& vSettings) const;
+    bool load(uint64_t vHDRHash, const SIBLBakeSettings& vSettings, SIBLBakedEnvironment& vioEnvironment) const;
+    bool read(uint64_t vHDRHash, const SIBLBakeSettings& vSettings, std::vector<char>& voFileData) const;
+    static size_t getEntryCount(const SIBLBakeSettings& vSettings);
+    static void uploadEntry(const std::vector<char>& vFileData, const SIBLBakeSettings& vSettings, size_t vEntryIndex, SIBLBakedEnvironment& vioEnvironment);
+    bool save(uint64_t vHDRHash, const SIBLBakeSettings& vSettings, const SIBLBakedEnvironment& vEnvironment) const;
+
+private:
+    enum class EEntryKind : uint32_t
+    {
+        EnvCubemap = 0,
+        PrefilterMap,
+        IrradianceMap,
+        BRDFLUT,
+        SphericalHarmonics,
+    };
+
+    struct SEntry
+    {
+        EEntryKind kind;
+        uint32_t level;
+        uint32_t face;
+        uint32_t width;
+        uint32_t height;
+        uint32_t reserved;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    struct SHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t entryCount;
+        uint64_t hdrHash;
+        SIBLBakeSettings settings;
+    };
+
+    static std::vector<SEntry> __buildLayout(const SIBLBakeSettings& vSettings, uint64_t& voFileSize);
+    static uint64_t __hashSettings(uint64_t vHDRHash, const SIBLBakeSettings& vSettings);
+    static GLenum __getTarget(const SEntry& vEntry);
+    static std::shared_ptr<ElayGraphics::STexture> __getTexture(const SEntry& vEntry, const SIBLBakedEnvironment& vEnvironment);
+    static bool __checkFile(const char* vData, size_t vSize, uint64_t vHDRHash, const std::vector<SEntry>& vLayout, uint64_t vExpectedSize, const std::string& vFilePath);
+    static void __uploadEntry(const SEntry& vEntry, const char* vData, SIBLBakedEnvironment& vioEnvironment);
+
+    std::string m_CacheDirectory;
+};
@@ -0,0 +1,196 @@
+#include "LightClusterGrid.h"
+#include "SimdFloat.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <iostream>
+
+namespace
+{
+	constexpr unsigned LIGHT_INDEX_BITS = 20;
+	constexpr uint32_t LIGHT_INDEX_MASK = (1u << LIGHT_INDEX_BITS) - 1;
+	static_assert(LIGHT_CLUSTER_COUNT <= (1u << (32 - LIGHT_INDEX_BITS)), "cluster index does not fit next to the light index");
+	static_assert(simd::floatN::WIDTH <= 8, "a row is padded to a multiple of 8 tiles");
+
+	// distance from x to [vMin, vMax], 0 inside
+	inline float distanceToRange(float vX, float vMin, float vMax)
+	{
+		return std::max(0.0f, std::max(vMin - vX, vX - vMax));
+	}
+}
+
+//************************************************************************************
+//Function: froxel bound tables sized once, build() only refills them
+CLightClusterGrid::CLightClusterGrid()
+{
+	m_TileMinX.resize(LIGHT_CLUSTER_COUNT_Z * ROW_STRIDE, FLT_MAX);
+	m_TileMaxX.resize(LIGHT_CLUSTER_COUNT_Z * ROW_STRIDE, -FLT_MAX);
+	m_TileMinY.resize(LIGHT_CLUSTER_COUNT_Z * LIGHT_CLUSTER_COUNT_Y);
+	m_TileMaxY.resize(LIGHT_CLUSTER_COUNT_Z * LIGHT_CLUSTER_COUNT_Y);
+	m_SliceNear.resize(LIGHT_CLUSTER_COUNT_Z);
+	m_SliceFar.resize(LIGHT_CLUSTER_COUNT_Z);
+	m_ClusterRecords.resize(LIGHT_CLUSTER_COUNT);
+}
+
+//************************************************************************************
+//Function: assign every light to the froxels its sphere touches, froxel bounds are recomputed only when the projection changes
+void CLightClusterGrid::build(const std::vector<SPunctualLight>& vLights, const glm::mat4& vViewMatrix, const glm::mat4& vProjectionMatrix,
+	float vNear, float vFar, unsigned vViewportWidth, unsigned vViewportHeight)
+{
+	m_TileScale = glm::vec2(float(LIGHT_CLUSTER_COUNT_X) / std::max(vViewportWidth, 1u), float(LIGHT_CLUSTER_COUNT_Y) / std::max(vViewportHeight, 1u));
+
+	// the TAA jitter moves P20 and P21 every frame, the bounds are cheap enough to follow it
+	const glm::vec4 FroxelKey(vProjectionMatrix[0][0], vProjectionMatrix[1][1], vProjectionMatrix[2][0], vProjectionMatrix[2][1]);
+	if (FroxelKey != m_FroxelKey || vNear != m_Near || vFar != m_Far)
+	{
+		m_FroxelKey = FroxelKey;
+		__computeFroxelBounds(vProjectionMatrix, vNear, vFar);
+	}
+
+	size_t LightCount = vLights.size();
+	if (LightCount > LIGHT_INDEX_MASK)
+	{
+		static bool s_IsReported = false;
+		if (!s_IsReported)
+			std::cerr << "Error::LightClusterGrid:: only the first " << LIGHT_INDEX_MASK << " of " << LightCount << " punctual lights are clustered" << std::endl;
+		s_IsReported = true;
+		LightCount = LIGHT_INDEX_MASK;
+	}
+
+	m_Hits.clear();
+	for (size_t i = 0; i < LightCount; i++)
+	{
+		const glm::vec4& PositionFalloff = vLights[i].positionFalloff;
+		const glm::vec3 ViewCenter = glm::vec3(vViewMatrix * glm::vec4(glm::vec3(PositionFalloff), 1.0f));
+		const float Radius = PositionFalloff.w > 0.0f ? 1.0f / std::sqrt(PositionFalloff.w) : FLT_MAX;
+		__assignLight(static_cast<uint32_t>(i), ViewCenter, Radius);
+	}
+	__sortHitsIntoClusters();
+}
+
+//************************************************************************************
+//Function: grid dimensions, light count and the z slice and tile parameters the shader needs to find a froxel
+void CLightClusterGrid::fillLightBlock(SLightBlock& voBlock, unsigned vLightCount) const
+{
+	voBlock.clusterDimensions = glm::uvec4(LIGHT_CLUSTER_COUNT_X, LIGHT_CLUSTER_COUNT_Y, LIGHT_CLUSTER_COUNT_Z, vLightCount);
+	voBlock.clusterZParams = glm::vec4(m_ZScale, m_ZBias, m_Near, m_Far);
+	voBlock.clusterTileScale = m_TileScale;
+}
+
+//************************************************************************************
+//Function: view space bounds of every froxel, x and y per (slice, tile) since a froxel is a frustum slab
+void CLightClusterGrid::__computeFroxelBounds(const glm::mat4& vProjectionMatrix, float vNear, float vFar)
+{
+	m_Near = vNear;
+	m_Far = vFar;
+	m_ZScale = LIGHT_CLUSTER_COUNT_Z / std::log2(vFar / vNear);
+	m_ZBias = -std::log2(vNear) * m_ZScale;
+
+	// ndc.x = P00 * x / depth - P20, so x = (ndc.x + P20) * depth / P00
+	const float P00 = vProjectionMatrix[0][0], P11 = vProjectionMatrix[1][1];
+	const float P20 = vProjectionMatrix[2][0], P21 = vProjectionMatrix[2][1];
+	for (unsigned Slice = 0; Slice < LIGHT_CLUSTER_COUNT_Z; Slice++)
+	{
+		const float SliceNear = vNear * std::pow(vFar / vNear, float(Slice) / LIGHT_CLUSTER_COUNT_Z);
+		const float SliceFar = vNear * std::pow(vFar / vNear, float(Slice + 1) / LIGHT_CLUSTER_COUNT_Z);
+		m_SliceNear[Slice] = SliceNear;
+		m_SliceFar[Slice] = SliceFar;
+
+		for (unsigned X = 0; X < LIGHT_CLUSTER_COUNT_X; X++)
+		{
+			const float Left = (-1.0f + 2.0f * X / LIGHT_CLUSTER_COUNT_X + P20) / P00;
+			const float Right = (-1.0f + 2.0f * (X + 1) / LIGHT_CLUSTER_COUNT_X + P20) / P00;
+			m_TileMinX[Slice * ROW_STRIDE + X] = std::min(Left * SliceNear, Left * SliceFar);
+			m_TileMaxX[Slice * ROW_STRIDE + X] = std::max(Right * SliceNear, Right * SliceFar);
+		}
+		for (unsigned Y = 0; Y < LIGHT_CLUSTER_COUNT_Y; Y++)
+		{
+			const float Bottom = (-1.0f + 2.0f * Y / LIGHT_CLUSTER_COUNT_Y + P21) / P11;
+			const float Top = (-1.0f + 2.0f * (Y + 1) / LIGHT_CLUSTER_COUNT_Y + P21) / P11;
+			m_TileMinY[Slice * LIGHT_CLUSTER_COUNT_Y + Y] = std::min(Bottom * SliceNear, Bottom * SliceFar);
+			m_TileMaxY[Slice * LIGHT_CLUSTER_COUNT_Y + Y] = std::max(Top * SliceNear, Top * SliceFar);
+		}
+	}
+}
+
+//************************************************************************************
+//Function: sphere against froxel bounds, z and y per slice and row, then one SIMD batch of x tiles at a time
+void CLightClusterGrid::__assignLight(uint32_t vLightIndex, const glm::vec3& vViewCenter, float vRadius)
+{
+	const float Depth = -vViewCenter.z;
+	if (Depth + vRadius < m_Near || Depth - vRadius > m_Far)
+		return;
+
+	auto computeSlice = [this](float vDepth)
+	{
+		const float Slice = std::floor(std::log2(vDepth) * m_ZScale + m_ZBias);
+		return static_cast<unsigned>(std::min(std::max(Slice, 0.0f), float(LIGHT_CLUSTER_COUNT_Z - 1)));
+	};
+	const unsigned FirstSlice = computeSlice(std::max(Depth - vRadius, m_Near));
+	const unsigned LastSlice = computeSlice(std::min(Depth + vRadius, m_Far));
+
+	const float RadiusSquare = vRadius * vRadius;
+	const simd::floatN CenterX = simd::splat(vViewCenter.x);
+	constexpr unsigned Width = static_cast<unsigned>(simd::floatN::WIDTH);
+	for (unsigned Slice = FirstSlice; Slice <= LastSlice; Slice++)
+	{
+		const float Dz = distanceToRange(Depth, m_SliceNear[Slice], m_SliceFar[Slice]);
+		const float SliceRemaining = RadiusSquare - Dz * Dz;
+		if (SliceRemaining < 0.0f)
+			continue;
+
+		const float* pMinX = &m_TileMinX[Slice * ROW_STRIDE];
+		const float* pMaxX = &m_TileMaxX[Slice * ROW_STRIDE];
+		for (unsigned Y = 0; Y < LIGHT_CLUSTER_COUNT_Y; Y++)
+		{
+			const float Dy = distanceToRange(vViewCenter.y, m_TileMinY[Slice * LIGHT_CLUSTER_COUNT_Y + Y], m_TileMaxY[Slice * LIGHT_CLUSTER_COUNT_Y + Y]);
+			const float RowRemaining = SliceRemaining - Dy * Dy;
+			if (RowRemaining < 0.0f)
+				continue;
+
+			const simd::floatN Remaining = simd::splat(RowRemaining);
+			const uint32_t RowCluster = (Slice * LIGHT_CLUSTER_COUNT_Y + Y) * LIGHT_CLUSTER_COUNT_X;
+			for (unsigned X = 0; X < LIGHT_CLUSTER_COUNT_X; X += Width)
+			{
+				const simd::floatN Dx = simd::max(simd::max(simd::load(pMinX + X) - CenterX, CenterX - simd::load(pMaxX + X)), simd::splat(0.0f));
+				unsigned Bits = simd::laneBits(simd::lessEqual(Dx * Dx, Remaining));
+				if (X + Width > LIGHT_CLUSTER_COUNT_X)
+					Bits &= (1u << (LIGHT_CLUSTER_COUNT_X - X)) - 1;
+				for (unsigned Lane = 0; Bits != 0; Lane++, Bits >>= 1)
+				{
+					if (Bits & 1)
+						m_Hits.push_back((RowCluster + X + Lane) << LIGHT_INDEX_BITS | vLightIndex);
+				}
+			}
+		}
+	}
+}
+
+//************************************************************************************
+//Function: counting sort of the hits, each cluster gets its lights in ascending order
+void CLightClusterGrid::__sortHitsIntoClusters()
+{
+	for (SLightClusterRecord& Record : m_ClusterRecords)
+		Record = { 0, 0 };
+	for (uint32_t Hit : m_Hits)
+		m_ClusterRecords[Hit >> LIGHT_INDEX_BITS].count++;
+
+	uint32_t Offset = 0;
+	m_MaxLightsPerCluster = 0;
+	m_OccupiedClusterCount = 0;
+	for (SLightClusterRecord& Record : m_ClusterRecords)
+	{
+		m_MaxLightsPerCluster = std::max(m_MaxLightsPerCluster, Record.count);
+		m_OccupiedClusterCount += Record.count != 0;
+		Record.offset = Offset;
+		Offset += Record.count;
+		Record.count = 0;
+	}
+
+	m_LightIndices.resize(m_Hits.size());
+	for (uint32_t Hit : m_Hits)
+	{
+		SLightClusterRecord& Record = m_ClusterRecords[Hit >> LIGHT_INDEX_BITS];
+		m_LightIndices[Record.offset + Record.count++] = Hit & LIGHT_INDEX_MASK;
+	}
+}
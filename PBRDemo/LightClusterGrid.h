@@ -0,0 +1,53 @@
+#pragma once
+#include <GLM/glm.hpp>
+#include <vector>
+#include "ShadingUniforms.h"
+
+// Assigns punctual lights to a LIGHT_CLUSTER_COUNT_X * _Y * _Z froxel grid:
+// screen tiles in x and y, exponential view depth slices in z. Every light is
+// a sphere of radius 1 / sqrt(positionFalloff.w), tested against the view space
+// bounds of the froxels it can reach, a row of x tiles per SIMD batch.
+// The output is what u_LightClusters and u_LightIndices expect.
+class CLightClusterGrid
+{
+public:
+	CLightClusterGrid();
+
+	// vProjectionMatrix is the one the frame is drawn with, jitter included
+	void build(const std::vector<SPunctualLight>& vLights, const glm::mat4& vViewMatrix, const glm::mat4& vProjectionMatrix,
+		float vNear, float vFar, unsigned vViewportWidth, unsigned vViewportHeight);
+
+	const std::vector<SLightClusterRecord>& getClusterRecords() const { return m_ClusterRecords; }
+	const std::vector<uint32_t>& getLightIndices() const { return m_LightIndices; }
+	// clusterDimensions, clusterZParams and clusterTileScale of u_LightBlock
+	void fillLightBlock(SLightBlock& voBlock, unsigned vLightCount) const;
+
+	uint32_t getMaxLightsPerCluster() const { return m_MaxLightsPerCluster; }
+	uint32_t getOccupiedClusterCount() const { return m_OccupiedClusterCount; }
+
+private:
+	void __computeFroxelBounds(const glm::mat4& vProjectionMatrix, float vNear, float vFar);
+	void __assignLight(uint32_t vLightIndex, const glm::vec3& vViewCenter, float vRadius);
+	void __sortHitsIntoClusters();
+
+	// x bounds of every (slice, x tile), padded to a multiple of the SIMD width with empty ranges
+	static constexpr unsigned ROW_STRIDE = (LIGHT_CLUSTER_COUNT_X + 7) & ~7u;
+	std::vector<float> m_TileMinX;
+	std::vector<float> m_TileMaxX;
+	std::vector<float> m_TileMinY;		// per (slice, y tile)
+	std::vector<float> m_TileMaxY;
+	std::vector<float> m_SliceNear;		// view depth range of each slice
+	std::vector<float> m_SliceFar;
+	glm::vec4 m_FroxelKey = glm::vec4(0.0f);	// P00, P11, P20, P21 the bounds were computed with
+	float m_Near = 0.0f;
+	float m_Far = 0.0f;
+	float m_ZScale = 0.0f;
+	float m_ZBias = 0.0f;
+	glm::vec2 m_TileScale = glm::vec2(0.0f);
+
+	std::vector<uint32_t> m_Hits;		// cluster << LIGHT_INDEX_BITS | light
+	std::vector<SLightClusterRecord> m_ClusterRecords;
+	std::vector<uint32_t> m_LightIndices;
+	uint32_t m_MaxLightsPerCluster = 0;
+	uint32_t m_OccupiedClusterCount = 0;
+};
@@ -11,6 +11,141 @@
 #include "CustomGUI.h"
 #include "AABB.h"
 #include "GroundObject.h"
+#include "ShadingUniforms.h"
+#include "Mesh.h"
+#include "GLStateCache.h"
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <random>
+namespace
+{
+	// the buffer always holds vioUploaded, so an unchanged block costs a memcmp and no driver call
+	template <typename TBlock>
+	void uploadBlockIfChanged(GLint vBuffer, const TBlock& vBlock, TBlock& vioUploaded)
+	{
+		if (std::memcmp(&vBlock, &vioUploaded, sizeof(TBlock)) == 0)
+			return;
+		vioUploaded = vBlock;
+		updateUniformBuffer(vBuffer, sizeof(TBlock), &vBlock);
+	}
+
+	// a storage buffer is never left empty, the shaders index it before checking any count
+	template <typename TElement>
+	void uploadStorageBuffer(GLint vBuffer, const std::vector<TElement>& vElements)
+	{
+		static const TElement s_Empty = {};
+		if (vElements.empty())
+			updateSSBOBuffer(vBuffer, sizeof(TElement), &s_Empty, GL_STREAM_DRAW);
+		else
+			updateSSBOBuffer(vBuffer, vElements.size() * sizeof(TElement), vElements.data(), GL_STREAM_DRAW);
+	}
+
+	SPunctualLight toPunctualLight(const PointLightSetting& vSetting)
+	{
+		SPunctualLight Light = {};
+		const float Radius = std::max(vSetting.pointlightRadius, 1e-3f);
+		Light.positionFalloff = glm::vec4(vSetting.pointLightPosition, 1.0f / (Radius * Radius));
+		Light.color = glm::vec4(vSetting.pointlightColor, vSetting.pointlightIntensity);
+		Light.type = PUNCTUAL_LIGHT_POINT;
+		if (vSetting.isSpot)
+		{
+			const float CosOuter = std::cos(vSetting.spotOuterAngle * glm::DEG_TO_RAD);
+			const float CosInner = std::cos(std::min(vSetting.spotInnerAngle, vSetting.spotOuterAngle) * glm::DEG_TO_RAD);
+			const float Scale = 1.0f / std::max(CosInner - CosOuter, 1e-4f);
+			Light.direction = glm::normalize(vSetting.spotDirection);
+			Light.scaleOffset = glm::vec2(Scale, -CosOuter * Scale);
+			Light.type = PUNCTUAL_LIGHT_SPOT;
+		}
+		return Light;
+	}
+
+	// light counts the stress scene steps through
+	const unsigned STRESS_LIGHT_COUNTS[] = { 0, 256, 1024, 4096, 16384 };
+	const int STRESS_WARMUP_FRAMES = 8;
+	const int STRESS_MEASURED_FRAMES = 32;
+
+	// copies of the model the draw call stress scene steps through
+	const unsigned STRESS_COPY_COUNTS[] = { 64, 512, 4096 };
+
+	// bits of the shading model permutation keys, in the order of SHADING_FEATURE_DEFINES
+	const uint32_t SHADING_FEATURE_CLEAR_COAT = 1u << 0;
+	const uint32_t SHADING_FEATURE_ANISOTROPY = 1u << 1;
+	const uint32_t SHADING_FEATURE_SHEEN_COLOR = 1u << 2;
+	const uint32_t SHADING_FEATURE_PUNCTUAL_LIGHTS = 1u << 3;
+	const std::vector<std::string> SHADING_FEATURE_DEFINES = { "MATERIAL_HAS_CLEAR_COAT", "MATERIAL_HAS_ANISOTROPY", "MATERIAL_HAS_SHEEN_COLOR", "HAS_PUNCTUAL_LIGHTS" };
+	const char* SHADING_MODEL_NAMES[] = { "ShadingModelStandard", "ShadingModelCloth", "ShadingModelSubSurface" };
+
+	// a feature whose parameters leave it without effect stays out of the key; cloth and subsurface shade
+	// with the sheen color always, so only the standard model has a sheen variant. The specular lobe stays
+	// isotropic, anisotropy only feeds anisotropicLobe, so its variant would shade like the one without it
+	uint32_t computeShadingPermutationKey(const MaterialSettings& vMaterial, bool vHasPunctualLights)
+	{
+		uint32_t Key = 0;
+		if (vMaterial.clearCoat > 0.0f)
+			Key |= SHADING_FEATURE_CLEAR_COAT;
+		if (vMaterial.materialType == 0 && std::max({ vMaterial.sheenColor.r, vMaterial.sheenColor.g, vMaterial.sheenColor.b }) > 0.0f)
+			Key |= SHADING_FEATURE_SHEEN_COLOR;
+		if (vHasPunctualLights)
+			Key |= SHADING_FEATURE_PUNCTUAL_LIGHTS;
+		return Key;
+	}
+
+	// reports every active block member whose offset differs from ShadingUniforms.h
+	void validateShadingBlocks(const CShader& vShader, const std::string& vShaderName)
+	{
+		const std::pair<const char*, size_t> Members[] =
+		{
+			{ "directLight.sun", offsetof(SLightBlock, directLight) + offsetof(SDirectLightStd140, sun) },
+			{ "directLight.lightDirection", offsetof(SLightBlock, directLight) + offsetof(SDirectLightStd140, lightDirection) },
+			{ "clusterDimensions", offsetof(SLightBlock, clusterDimensions) },
+			{ "clusterZParams", offsetof(SLightBlock, clusterZParams) },
+			{ "clusterTileScale", offsetof(SLightBlock, clusterTileScale) },
+			{ "iblLuminance", offsetof(SLightBlock, iblLuminance) },
+			{ "lightFarAttenuationParams", offsetof(SLightBlock, lightFarAttenuationParams) },
+			{ "material_baseColor", offsetof(SMaterialBlock, baseColor) },
+			{ "material_emissive", offsetof(SMaterialBlock, emissive) },
+			{ "material_sheenColor", offsetof(SMaterialBlock, sheenColor) },
+			{ "material_metallic", offsetof(SMaterialBlock, metallic) },
+			{ "material_anisotropyDirection", offsetof(SMaterialBlock, anisotropyDirection) },
+			{ "material_roughness", offsetof(SMaterialBlock, roughness) },
+			{ "material_subsurfaceColor", offsetof(SMaterialBlock, subsurfaceColor) },
+			{ "material_reflectance", offsetof(SMaterialBlock, reflectance) },
+			{ "material_ambientOcclusion", offsetof(SMaterialBlock, ambientOcclusion) },
+			{ "material_sheenRoughness", offsetof(SMaterialBlock, sheenRoughness) },
+			{ "material_clearCoat", offsetof(SMaterialBlock, clearCoat) },
+			{ "material_clearCoatRoughness", offsetof(SMaterialBlock, clearCoatRoughness) },
+			{ "material_anisotropy", offsetof(SMaterialBlock, anisotropy) },
+			{ "material_thickness", offsetof(SMaterialBlock, thickness) },
+			{ "material_subsurfacePower", offsetof(SMaterialBlock, subsurfacePower) },
+			{ "frame_iblSH[1]", offsetof(SSHBlock, sh) + sizeof(glm::vec4) },
+		};
+		for (const auto& Member : Members)
+		{
+			const GLint Offset = vShader.getUniformBlockMemberOffset(Member.first);
+			if (Offset != -1 && static_cast<size_t>(Offset) != Member.second)
+				std::cerr << "Error::ModelRenderPass:: " << vShaderName << ": " << Member.first << " is at offset " << Offset
+					<< " in the shader and " << Member.second << " in ShadingUniforms.h" << std::endl;
+		}
+
+		const std::pair<const char*, size_t> Blocks[] =
+		{
+			{ "u_LightBlock", sizeof(SLightBlock) },
+			{ "u_MaterialBlock", sizeof(SMaterialBlock) },
+			{ "u_SHBlock", sizeof(SSHBlock) },
+		};
+		for (const auto& Block : Blocks)
+		{
+			const GLint Size = vShader.getUniformBlockSize(Block.first);
+			if (Size != -1 && static_cast<size_t>(Size) != Block.second)
+				std::cerr << "Error::ModelRenderPass:: " << vShaderName << ": " << Block.first << " is " << Size
+					<< " bytes in the shader and " << Block.second << " in ShadingUniforms.h" << std::endl;
+		}
+	}
+}
+
 CModelRenderPass::CModelRenderPass(const std::string& vPassName, int vExcutionOrder) : IRenderPass(vPassName, vExcutionOrder)
 {
 
@@ -22,14 +157,255 @@ CModelRenderPass::~CModelRenderPass()
 }
 
 
+//************************************************************************************
+//Function: times the shared data reads of one updateV, through the string lookups it used to do and through the handles
+void CModelRenderPass::__benchmarkSharedDataReads() const
+{
+	using Clock = std::chrono::steady_clock;
+	using Texture = std::shared_ptr<ElayGraphics::STexture>;
+	const int Frames = 10000;
+	const int ReadsPerFrame = 13;
+
+	auto readByName = []()
+	{
+		using namespace ElayGraphics::ResourceManager;
+		float Sum = float(getSharedDataByName<Texture>("TextureConfig4Albedo")->Width);
+		Sum += getSharedDataByName<MaterialSettings>("MaterialSettings").metallic;
+		Sum += getSharedDataByName<LightSettings>("LightSettings").iblIntensity;
+		Sum += getSharedDataByName<CameraSetting>("CameraSetting").cameraISO;
+		Sum += float(getSharedDataByName<Texture>("irradianceMap")->Width);
+		Sum += float(getSharedDataByName<Texture>("prefilterMap")->Width);
+		Sum += float(getSharedDataByName<Texture>("brdfLUTTexture")->Width);
+		Sum += float(getSharedDataByName<Texture>("envCubemap")->Width);
+		Sum += getSharedDataByName<std::vector<glm::vec3>>("iblSH")[0].x;
+		Sum += getSharedDataByName<glm::vec3>("u_LightPos").x;
+		Sum += getSharedDataByName<std::shared_ptr<CShader>>("GroundShader") ? 1.0f : 0.0f;
+		Sum += float(getSharedDataByName<Texture>("LightDepthTexture")->Width);
+		Sum += getSharedDataByName<glm::mat4>("u_LightVPMatrix")[0][0];
+		return Sum;
+	};
+	auto readByHandle = [this]()
+	{
+		float Sum = float(m_AlbedoTexture.get()->Width);
+		Sum += m_MaterialSettings->metallic;
+		Sum += m_LightSettings->iblIntensity;
+		Sum += m_CameraSetting->cameraISO;
+		Sum += float(m_IrradianceMap.get()->Width);
+		Sum += float(m_PrefilterMap.get()->Width);
+		Sum += float(m_BRDFLUT.get()->Width);
+		Sum += float(m_EnvCubemap.get()->Width);
+		Sum += (*m_IBLSH)[0].x;
+		Sum += m_LightPos->x;
+		Sum += *m_GroundShader ? 1.0f : 0.0f;
+		Sum += float(m_LightDepthTexture.get()->Width);
+		Sum += (*m_LightVPMatrix)[0][0];
+		return Sum;
+	};
+
+	float NameSum = 0.0f, HandleSum = 0.0f;
+	auto Start = Clock::now();
+	for (int i = 0; i < Frames; i++)
+		NameSum += readByName();
+	const float NameMs = std::chrono::duration<float, std::milli>(Clock::now() - Start).count();
+
+	Start = Clock::now();
+	for (int i = 0; i < Frames; i++)
+		HandleSum += readByHandle();
+	const float HandleMs = std::chrono::duration<float, std::milli>(Clock::now() - Start).count();
+
+	std::cout << "Shared data benchmark: " << ReadsPerFrame << " reads per frame, " << Frames << " frames" << std::endl;
+	std::cout << "  by name:   " << NameMs * 1000.0f / Frames << " us per frame" << std::endl;
+	std::cout << "  by handle: " << HandleMs * 1000.0f / Frames << " us per frame, x" << NameMs / std::max(HandleMs, 1e-6f) << std::endl;
+	if (NameSum != HandleSum)
+		std::cerr << "Error::ModelRenderPass:: shared data handles read other values than the name lookups" << std::endl;
+}
+
+//************************************************************************************
+//Function: regenerates the stress lights when the sweep enters a new light count
+void CModelRenderPass::__stepLightStressScene()
+{
+	if (m_LightStressFrame != 0)
+		return;
+
+	const unsigned Count = STRESS_LIGHT_COUNTS[m_LightStressStep];
+	const glm::vec3 Center = m_pMonkey->getAABB()->getCentre();
+	const glm::vec3 HalfSize = m_pMonkey->getAABB()->getHalfSize();
+	const float Extent = std::max(HalfSize.x, std::max(HalfSize.y, HalfSize.z));
+	std::mt19937 Generator(Count);
+	std::uniform_real_distribution<float> Unit(-1.0f, 1.0f);
+
+	//a fixed radius over a volume much larger than the view, so the shading cost follows the lights per froxel, not the total
+	PointLightSetting Setting;
+	Setting.pointlightRadius = Extent * 0.5f;
+	Setting.pointlightIntensity *= 0.01f;
+	m_StressLights.resize(Count);
+	for (unsigned i = 0; i < Count; i++)
+	{
+		Setting.pointLightPosition = Center + glm::vec3(Unit(Generator), Unit(Generator), Unit(Generator)) * (Extent * 6.0f);
+		Setting.pointlightColor = glm::vec3(Unit(Generator), Unit(Generator), Unit(Generator)) * 0.5f + 0.5f;
+		Setting.isSpot = i % 2 == 1;
+		Setting.spotDirection = glm::vec3(Unit(Generator) * 0.3f, -1.0f, Unit(Generator) * 0.3f);
+		m_StressLights[i] = toPunctualLight(Setting);
+	}
+	m_StressClusterMs = 0.0;
+	m_StressShadingMs = 0.0;
+}
+
+//************************************************************************************
+//Function: waits for the timer query on purpose, the sweep measures and does not care about its own stalls
+void CModelRenderPass::__recordLightStressFrame(float vClusterMs)
+{
+	GLuint64 ShadingNs = 0;
+	glGetQueryObjectui64v(m_ShadingTimeQuery, GL_QUERY_RESULT, &ShadingNs);
+	if (m_LightStressFrame >= STRESS_WARMUP_FRAMES)
+	{
+		m_StressClusterMs += vClusterMs;
+		m_StressShadingMs += ShadingNs * 1e-6;
+	}
+
+	if (++m_LightStressFrame < STRESS_WARMUP_FRAMES + STRESS_MEASURED_FRAMES)
+		return;
+
+	std::cout << "LightClusters:: " << STRESS_LIGHT_COUNTS[m_LightStressStep] << " stress lights: clustering and upload "
+		<< m_StressClusterMs / STRESS_MEASURED_FRAMES << " ms, model shading " << m_StressShadingMs / STRESS_MEASURED_FRAMES << " ms GPU, "
+		<< m_LightClusterGrid.getLightIndices().size() << " light indices, at most " << m_LightClusterGrid.getMaxLightsPerCluster()
+		<< " in a froxel, " << m_LightClusterGrid.getOccupiedClusterCount() << " of " << LIGHT_CLUSTER_COUNT << " froxels lit" << std::endl;
+	m_LightStressFrame = 0;
+	if (++m_LightStressStep == sizeof(STRESS_LIGHT_COUNTS) / sizeof(STRESS_LIGHT_COUNTS[0]))
+	{
+		m_StressLights.clear();
+		m_RunLightStressScene = false;
+	}
+}
+
+//************************************************************************************
+//Function: draws the copies of the stress step after the scene, per mesh on even frames and as multi-draws on odd ones
+void CModelRenderPass::__drawCallStressFrame(const SLodSelection& vLodSelection)
+{
+	if (!CMultiDrawBatch::isSupported())
+	{
+		std::cerr << "Error::ModelRenderPass:: the draw call stress scene needs GL_ARB_shader_draw_parameters" << std::endl;
+		m_RunDrawCallStressScene = false;
+		return;
+	}
+
+	const unsigned CopyCount = STRESS_COPY_COUNTS[m_DrawCallStressStep];
+	if (m_DrawCallStressFrame == 0)
+	{
+		//a grid behind the model, spaced so the copies do not overlap
+		const glm::vec3 Center = m_pMonkey->getAABB()->getCentre();
+		const glm::vec3 HalfSize = m_pMonkey->getAABB()->getHalfSize();
+		const float Spacing = std::max(HalfSize.x, std::max(HalfSize.y, HalfSize.z)) * 2.5f;
+		const unsigned Side = static_cast<unsigned>(std::ceil(std::sqrt(static_cast<float>(CopyCount))));
+		m_StressModelMatrices.resize(CopyCount);
+		for (unsigned i = 0; i < CopyCount; i++)
+		{
+			const glm::vec3 Offset((i % Side - Side * 0.5f) * Spacing, 0.0f, -(i / Side + 1.0f) * Spacing);
+			m_StressModelMatrices[i] = glm::translate(glm::mat4(1.0f), Offset) * m_pMonkey->getModelMatrix();
+		}
+		m_StressMeshIndices.resize(m_pMonkey->getMeshCount());
+		for (uint32_t i = 0; i < m_StressMeshIndices.size(); i++)
+			m_StressMeshIndices[i] = i;
+		for (int i = 0; i < 2; i++)
+		{
+			m_StressSubmitMs[i] = 0.0;
+			m_StressDrawGpuMs[i] = 0.0;
+		}
+	}
+
+	const int IsMultiDraw = m_DrawCallStressFrame % 2;
+	const ElayGraphics::SDriverCallCounters CallsStart = fetchDriverCallCounters();
+	glBeginQuery(GL_TIME_ELAPSED, m_ShadingTimeQuery);
+	const auto Start = std::chrono::steady_clock::now();
+	if (IsMultiDraw)
+	{
+		m_MultiDrawBatch.clear();
+		for (const glm::mat4& ModelMatrix : m_StressModelMatrices)
+			m_pMonkey->appendModelDraws(m_MultiDrawBatch, m_StressMeshIndices, vLodSelection, ModelMatrix);
+		m_MultiDrawBatch.draw(*m_pShader);
+	}
+	else
+	{
+		//both paths pick the LOD of a copy with its own model matrix
+		SLodSelection CopyLodSelection = vLodSelection;
+		for (const glm::mat4& ModelMatrix : m_StressModelMatrices)
+		{
+			m_pShader->setMat4UniformValue("u_ModelMatrix", glm::value_ptr(ModelMatrix));
+			CopyLodSelection.ViewProjectionMatrix = vLodSelection.ViewProjectionMatrix * ModelMatrix;
+			m_pMonkey->updateModel(*m_pShader, m_StressMeshIndices, CopyLodSelection);
+		}
+	}
+	const double SubmitMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - Start).count();
+	glEndQuery(GL_TIME_ELAPSED);
+	const ElayGraphics::SDriverCallCounters Calls = fetchDriverCallCounters() - CallsStart;
+
+	//waits for the timer query on purpose, like the light sweep
+	GLuint64 DrawNs = 0;
+	glGetQueryObjectui64v(m_ShadingTimeQuery, GL_QUERY_RESULT, &DrawNs);
+	if (m_DrawCallStressFrame >= STRESS_WARMUP_FRAMES)
+	{
+		m_StressSubmitMs[IsMultiDraw] += SubmitMs;
+		m_StressDrawGpuMs[IsMultiDraw] += DrawNs * 1e-6;
+		m_StressDriverCalls[IsMultiDraw] = Calls.total();
+		m_StressDrawCalls[IsMultiDraw] = Calls.DrawCalls;
+	}
+
+	//the measured frames alternate, so each path gets STRESS_MEASURED_FRAMES of them
+	if (++m_DrawCallStressFrame < STRESS_WARMUP_FRAMES + STRESS_MEASURED_FRAMES * 2)
+		return;
+
+	std::cout << "DrawCallStress:: " << CopyCount << " copies, " << CopyCount * m_StressMeshIndices.size() << " meshes: per mesh "
+		<< m_StressSubmitMs[0] / STRESS_MEASURED_FRAMES << " ms CPU, " << m_StressDrawGpuMs[0] / STRESS_MEASURED_FRAMES << " ms GPU, "
+		<< m_StressDrawCalls[0] << " draws, " << m_StressDriverCalls[0] << " driver calls; multi-draw "
+		<< m_StressSubmitMs[1] / STRESS_MEASURED_FRAMES << " ms CPU, " << m_StressDrawGpuMs[1] / STRESS_MEASURED_FRAMES << " ms GPU, "
+		<< m_StressDrawCalls[1] << " draws, " << m_StressDriverCalls[1] << " driver calls" << std::endl;
+	m_DrawCallStressFrame = 0;
+	if (++m_DrawCallStressStep == sizeof(STRESS_COPY_COUNTS) / sizeof(STRESS_COPY_COUNTS[0]))
+	{
+		m_StressModelMatrices.clear();
+		m_RunDrawCallStressScene = false;
+	}
+}
+
+//************************************************************************************
+//Function: vViewProjectionMatrix is the jittered one the frame is drawn with, the depth the GPU culling tests against comes from it
+void CModelRenderPass::__drawScene(const SLodSelection& vLodSelection, const glm::mat4& vViewProjectionMatrix)
+{
+	const auto& sceneBvh = m_SceneBvh.get();
+	sceneBvh->update(ElayGraphics::ResourceManager::getGameObjects());
+	if (m_IsGpuCulling && CHiZCulling::isSupported())
+	{
+		sceneBvh->collectAll(m_DrawItems);
+		CSceneBvh::appendDraws(m_DrawItems, vLodSelection, m_MultiDrawBatch);
+		m_HiZCulling.cullAndDraw(m_MultiDrawBatch, *m_pShader, vViewProjectionMatrix, m_DepthTexture.get());
+	}
+	else
+	{
+		sceneBvh->cull(vLodSelection.ViewProjectionMatrix, "MainCamera", m_DrawItems);
+		CSceneBvh::draw(m_DrawItems, *m_pShader, vLodSelection, m_MultiDrawBatch);
+	}
+}
+
 void CModelRenderPass::initV()
 {
 	m_FBO = ElayGraphics::ResourceManager::getSharedDataByName<GLuint>("mFBO");
 	//m_pShader = std::make_shared<CShader>("ModelRender_VS.glsl", "ModelRender_FS.glsl");
 
-	standardModelShader = std::make_shared<CShader>("ShadingModelStandard_VS.glsl", "ShadingModelStandard_FS.glsl");
-	clothModelShader = std::make_shared<CShader>("ShadingModelCloth_VS.glsl", "ShadingModelCloth_FS.glsl");
-	subsurafceModelShader = std::make_shared<CShader>("ShadingModelSubSurface_VS.glsl", "ShadingModelSubSurface_FS.glsl");
+	// variants are compiled when a material first needs them
+	for (int i = 0; i < 3; ++i)
+	{
+		const std::string Name = SHADING_MODEL_NAMES[i];
+		m_ShadingModels[i] = CShaderPermutationSet(Name + "_VS.glsl", Name + "_FS.glsl", SHADING_FEATURE_DEFINES);
+	}
+	m_LightUBO = genBuffer(GL_UNIFORM_BUFFER, sizeof(SLightBlock), &m_UploadedLightBlock, GL_DYNAMIC_DRAW, SHADING_LIGHT_BLOCK_BINDING);
+	m_MaterialUBO = genBuffer(GL_UNIFORM_BUFFER, sizeof(SMaterialBlock), &m_UploadedMaterialBlock, GL_DYNAMIC_DRAW, SHADING_MATERIAL_BLOCK_BINDING);
+	m_SHUBO = genBuffer(GL_UNIFORM_BUFFER, sizeof(SSHBlock), &m_UploadedSHBlock, GL_DYNAMIC_DRAW, SHADING_SH_BLOCK_BINDING);
+	const SPunctualLight EmptyLight = {};
+	const uint32_t EmptyIndex = 0;
+	m_PunctualLightBuffer = genBuffer(GL_SHADER_STORAGE_BUFFER, sizeof(SPunctualLight), &EmptyLight, GL_STREAM_DRAW, SHADING_PUNCTUAL_LIGHT_BUFFER_BINDING);
+	m_LightClusterBuffer = genBuffer(GL_SHADER_STORAGE_BUFFER, LIGHT_CLUSTER_COUNT * sizeof(SLightClusterRecord), m_LightClusterGrid.getClusterRecords().data(), GL_STREAM_DRAW, SHADING_LIGHT_CLUSTER_BUFFER_BINDING);
+	m_LightIndexBuffer = genBuffer(GL_SHADER_STORAGE_BUFFER, sizeof(uint32_t), &EmptyIndex, GL_STREAM_DRAW, SHADING_LIGHT_INDEX_BUFFER_BINDING);
+	glGenQueries(1, &m_ShadingTimeQuery);
 
 	m_pMonkey = std::dynamic_pointer_cast<CModelLoad>(ElayGraphics::ResourceManager::getGameObjectByName("Monkey"));
 	glm::vec3 center = m_pMonkey->getAABB()->getCentre();
@@ -38,6 +414,31 @@ void CModelRenderPass::initV()
 	auto groundShader = std::make_shared<CShader>("GroundShadow_VS.glsl", "GroundShadow_FS.glsl");
 	ElayGraphics::ResourceManager::registerSharedData("GroundShader", groundShader);
 
+	SPipelineStateDesc ScenePipelineDesc;
+	ScenePipelineDesc.IsDepthTest = true;
+	ScenePipelineDesc.IsCullFace = true;
+	m_ScenePipeline = CPipelineState(ScenePipelineDesc);
+	SPipelineStateDesc GroundPipelineDesc;
+	GroundPipelineDesc.IsDepthTest = true;
+	GroundPipelineDesc.pShader = groundShader;
+	m_GroundPipeline = CPipelineState(GroundPipelineDesc);
+
+	m_AlbedoTexture = TextureData("TextureConfig4Albedo");
+	m_MaterialSettings = SharedData<MaterialSettings>("MaterialSettings");
+	m_LightSettings = SharedData<LightSettings>("LightSettings");
+	m_CameraSetting = SharedData<CameraSetting>("CameraSetting");
+	m_IrradianceMap = TextureData("irradianceMap");
+	m_PrefilterMap = TextureData("prefilterMap");
+	m_BRDFLUT = TextureData("brdfLUTTexture");
+	m_EnvCubemap = TextureData("envCubemap");
+	m_IBLSH = SharedData<std::vector<glm::vec3>>("iblSH");
+	m_LightPos = SharedData<glm::vec3>("u_LightPos");
+	m_GroundShader = SharedData<std::shared_ptr<CShader>>("GroundShader");
+	m_LightDepthTexture = TextureData("LightDepthTexture");
+	m_LightVPMatrix = SharedData<glm::mat4>("u_LightVPMatrix");
+	m_SceneBvh = SharedData<std::shared_ptr<CSceneBvh>>("SceneBvh");
+	m_DepthTexture = TextureData("DepthTexture");
+
 	
 
 
@@ -45,19 +446,23 @@ void CModelRenderPass::initV()
 
 void CModelRenderPass::updateV()
 {
-	auto albeo = ElayGraphics::ResourceManager::getSharedDataByName<std::shared_ptr<ElayGraphics::STexture>>("TextureConfig4Albedo");
-	glViewport( 0, 0,  albeo->Width, albeo->Height);
-	glBindFramebuffer(GL_FRAMEBUFFER, m_FBO);
+	if (m_RunSharedDataBenchmark)
+	{
+		__benchmarkSharedDataReads();
+		m_RunSharedDataBenchmark = false;
+	}
+
+	const auto& albeo = m_AlbedoTexture.get();
+	CGLStateCache& StateCache = fetchGLStateCache();
+	StateCache.setViewport( 0, 0,  albeo->Width, albeo->Height);
+	StateCache.bindFramebuffer(GL_FRAMEBUFFER, m_FBO);
 	//glClearColor(1.0f, 0.0f, 0.0f, 1.0f);
 	//glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glEnable(GL_DEPTH_TEST);
-	glDepthFunc(GL_LESS);
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_BACK);
+	m_ScenePipeline.apply();
 
-	auto material = ElayGraphics::ResourceManager::getSharedDataByName<MaterialSettings>("MaterialSettings");
-	auto light = ElayGraphics::ResourceManager::getSharedDataByName<LightSettings>("LightSettings");
-	auto cameraSet = ElayGraphics::ResourceManager::getSharedDataByName<CameraSetting>("CameraSetting");
+	const MaterialSettings& material = m_MaterialSettings.get();
+	const LightSettings& light = m_LightSettings.get();
+	const CameraSetting& cameraSet = m_CameraSetting.get();
 
 	float mAperture = cameraSet.cameraAperture;
 	float mShutterSpeed = 1.0f / cameraSet.cameraSpeed;
@@ -88,17 +493,26 @@ void CModelRenderPass::updateV()
 	float iblIntensity = light.iblIntensity;
 	iblIntensity *= exposure;
 
-	if (material.materialType == 0)
+	if (m_RunLightStressScene)
+		__stepLightStressScene();
+	m_PunctualLights.clear();
+	for (const PointLightSetting& pointLight : light.pointLights)
 	{
-		m_pShader = standardModelShader;
+		if (pointLight.enable)
+			m_PunctualLights.push_back(toPunctualLight(pointLight));
 	}
-	else if (material.materialType == 1)
+	m_PunctualLights.insert(m_PunctualLights.end(), m_StressLights.begin(), m_StressLights.end());
+
+	const int ShadingModel = std::min(std::max(material.materialType, 0), 2);
+	CShaderPermutationSet& ShadingModelSet = m_ShadingModels[ShadingModel];
+	const uint32_t PermutationKey = computeShadingPermutationKey(material, !m_PunctualLights.empty());
+	const std::shared_ptr<CShader>& pVariant = ShadingModelSet.fetchOrCreateShader(PermutationKey);
+	// a variant the driver is still linking would stall the frame, the previous one draws until it is ready
+	if (pVariant != m_pShader && (!m_pShader || pVariant->isReady()))
 	{
-		m_pShader = clothModelShader;
-	}
-	else if (material.materialType == 2)
-	{
-		m_pShader = subsurafceModelShader;
+		m_pShader = pVariant;
+		if (m_ValidatedVariants.insert(m_pShader.get()).second)
+			validateShadingBlocks(*m_pShader, std::string(SHADING_MODEL_NAMES[ShadingModel]) + " (" + ShadingModelSet.getFeatureNames(PermutationKey) + ")");
 	}
 
 	m_pShader->activeShader();	
@@ -106,44 +520,32 @@ void CModelRenderPass::updateV()
 	m_pShader->setMat4UniformValue("u_ModelMatrix", glm::value_ptr(glm::mat4(1.0f)));
 
 	
-	m_pShader->setFloatUniformValue("directLight.lightDirection", lightDir.x, lightDir.y, lightDir.z);
-	m_pShader->setFloatUniformValue("directLight.sun", sun.x, sun.y, sun.z, sun.w);
-	m_pShader->setFloatUniformValue("directLight.lightColor", lightColor.x, lightColor.y, lightColor.z, lightIdentity);
-	
+	SLightBlock lightBlock = {};
+	lightBlock.directLight.lightColor = glm::vec4(lightColor, lightIdentity);
+	lightBlock.directLight.sun = sun;
+	lightBlock.directLight.lightDirection = lightDir;
+	lightBlock.iblLuminance = iblIntensity;
+	m_pShader->setFloatUniformValue("exposure", exposure);
 
-	for (int i = 0; i < light.pointLights.size(); i++)
-	{
-		m_pShader->setFloatUniformValue("punctualLight[" + std::to_string(i) + "].positionFalloff", 
-			light.pointLights[i].pointLightPosition.x, light.pointLights[i].pointLightPosition.y, 
-			light.pointLights[i].pointLightPosition.z);
-
-		m_pShader->setFloatUniformValue("punctualLight[" + std::to_string(i) + "].color", light.pointLights[i].pointlightColor.x, 
-			light.pointLights[i].pointlightColor.y, 
-			light.pointLights[i].pointlightColor.z, light.pointLights[i].pointlightIntensity);
-		m_pShader->setIntUniformValue("punctualLight[" + std::to_string(i) + "].type", 0);
-	}
-	m_pShader->setIntUniformValue("punctualLight_Num", light.pointLights.size());
-	
-	m_pShader->setFloatUniformValue("iblLuminance", iblIntensity);
 
 	LinearColorA mcolor = Color::toLinear<ACCURATE>(sRGBColorA(material.baseColor.r, material.baseColor.g, material.baseColor.b, material.baseColor.a));
-	m_pShader->setFloatUniformValue("material_baseColor", mcolor.r, mcolor.g, mcolor.b, mcolor.a);
-	m_pShader->setFloatUniformValue("material_metallic", material.metallic);
-	m_pShader->setFloatUniformValue("material_roughness", material.roughness);
-	m_pShader->setFloatUniformValue("material_reflectance", material.reflectance);
-	m_pShader->setFloatUniformValue("material_emissive", material.emissive.r, material.emissive.g, material.emissive.b, material.emissive.a);
-	m_pShader->setFloatUniformValue("material_ambientOcclusion", material.ambientOcclusion);
-	
-	m_pShader->setFloatUniformValue("material_sheenColor", material.sheenColor.r, material.sheenColor.g, material.sheenColor.b);
-	m_pShader->setFloatUniformValue("material_sheenRoughness", material.sheenRoughness);
-	m_pShader->setFloatUniformValue("material_clearCoat", material.clearCoat);
-	m_pShader->setFloatUniformValue("material_clearCoatRoughness", material.clearCoatRoughness);
-	m_pShader->setFloatUniformValue("material_anisotropyDirection", material.anisotropyDirection.x, material.anisotropyDirection.y, material.anisotropyDirection.z);
-	m_pShader->setFloatUniformValue("material_anisotropy", material.anisotropy);
-	m_pShader->setFloatUniformValue("material_subsurfaceColor", material.subSurfaceColor.r, material.subSurfaceColor.g, material.subSurfaceColor.b);
-	
-	m_pShader->setFloatUniformValue("material_thickness", material.thickness);
-	m_pShader->setFloatUniformValue("material_subsurfacePower", material.subsurfacePower);
+	SMaterialBlock materialBlock = {};
+	materialBlock.baseColor = glm::vec4(mcolor.r, mcolor.g, mcolor.b, mcolor.a);
+	materialBlock.emissive = material.emissive;
+	materialBlock.sheenColor = glm::vec3(material.sheenColor);
+	materialBlock.metallic = material.metallic;
+	materialBlock.anisotropyDirection = material.anisotropyDirection;
+	materialBlock.roughness = material.roughness;
+	materialBlock.subsurfaceColor = glm::vec3(material.subSurfaceColor);
+	materialBlock.reflectance = material.reflectance;
+	materialBlock.ambientOcclusion = material.ambientOcclusion;
+	materialBlock.sheenRoughness = material.sheenRoughness;
+	materialBlock.clearCoat = material.clearCoat;
+	materialBlock.clearCoatRoughness = material.clearCoatRoughness;
+	materialBlock.anisotropy = material.anisotropy;
+	materialBlock.thickness = material.thickness;
+	materialBlock.subsurfacePower = material.subsurfacePower;
+	uploadBlockIfChanged(m_MaterialUBO, materialBlock, m_UploadedMaterialBlock);
 
 
 	glm::mat4 u_ProjectionMatrix = ElayGraphics::Camera::getMainCameraProjectionMatrix();
@@ -176,36 +578,71 @@ void CModelRenderPass::updateV()
 	jitterMat[2][1] += jitter.y;
 
 
+	//clustered with the jittered projection, the one gl_FragCoord comes from
+	const float cameraNear = static_cast<float>(ElayGraphics::Camera::getMainCameraNear());
+	const float cameraFar = static_cast<float>(ElayGraphics::Camera::getMainCameraFar());
+	auto clusterStart = std::chrono::steady_clock::now();
+	if (m_PunctualLights.size() != m_UploadedPunctualLights.size()
+		|| std::memcmp(m_PunctualLights.data(), m_UploadedPunctualLights.data(), m_PunctualLights.size() * sizeof(SPunctualLight)) != 0)
+	{
+		uploadStorageBuffer(m_PunctualLightBuffer, m_PunctualLights);
+		m_UploadedPunctualLights = m_PunctualLights;
+	}
+	m_LightClusterGrid.build(m_PunctualLights, u_ViewMatrix, jitterMat, cameraNear, cameraFar, albeo->Width, albeo->Height);
+	uploadStorageBuffer(m_LightClusterBuffer, m_LightClusterGrid.getClusterRecords());
+	uploadStorageBuffer(m_LightIndexBuffer, m_LightClusterGrid.getLightIndices());
+	m_LightClusterGrid.fillLightBlock(lightBlock, static_cast<unsigned>(m_PunctualLights.size()));
+	//fades the punctual lights out over the last 10% of the camera range
+	lightBlock.lightFarAttenuationParams = 0.5f * glm::vec2(10.0f, 10.0f / (cameraFar * cameraFar));
+	uploadBlockIfChanged(m_LightUBO, lightBlock, m_UploadedLightBlock);
+	const float clusterMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - clusterStart).count();
+
 	m_pShader->setMat4UniformValue("u_ProjectionMatrix", glm::value_ptr(jitterMat));
 	m_pShader->setMat4UniformValue("u_ViewMatrix", glm::value_ptr(u_ViewMatrix));
+
+	//the SSAO depth pass selects with the same camera and viewport, so both draw the same LOD
+	SLodSelection lodSelection;
+	lodSelection.ViewProjectionMatrix = u_ProjectionMatrix * u_ViewMatrix;
+	lodSelection.ViewportSize = glm::vec2(ElayGraphics::WINDOW_KEYWORD::getWindowWidth(), ElayGraphics::WINDOW_KEYWORD::getWindowHeight());
 	
-	auto irradianceMap = ElayGraphics::ResourceManager::getSharedDataByName<std::shared_ptr<ElayGraphics::STexture>>("irradianceMap");
-	auto prefilterMap = ElayGraphics::ResourceManager::getSharedDataByName<std::shared_ptr<ElayGraphics::STexture>>("prefilterMap");
-	auto brdfLUT = ElayGraphics::ResourceManager::getSharedDataByName<std::shared_ptr<ElayGraphics::STexture>>("brdfLUTTexture");
-	auto envCubemap = ElayGraphics::ResourceManager::getSharedDataByName<std::shared_ptr<ElayGraphics::STexture>>("envCubemap");
+	const auto& irradianceMap = m_IrradianceMap.get();
+	const auto& prefilterMap = m_PrefilterMap.get();
+	const auto& brdfLUT = m_BRDFLUT.get();
+	const auto& envCubemap = m_EnvCubemap.get();
 	m_pShader->setTextureUniformValue("irradianceMap", irradianceMap);
 	m_pShader->setTextureUniformValue("prefilterMap", prefilterMap);
 	m_pShader->setTextureUniformValue("brdfLUT", brdfLUT);
 	m_pShader->setTextureUniformValue("environmentCubeMap", envCubemap);
 
-	std::vector<glm::vec3> frame_iblSH = ElayGraphics::ResourceManager::getSharedDataByName<std::vector<glm::vec3>>("iblSH");
-	for (int i = 0; i < 9; i++)
+	const std::vector<glm::vec3>& frame_iblSH = m_IBLSH.get();
+	SSHBlock shBlock = {};
+	for (size_t i = 0; i < std::min<size_t>(frame_iblSH.size(), SH_COEFFICIENT_COUNT); i++)
 	{
-		std::string name = "frame_iblSH[" + std::to_string(i) + "]";
-		m_pShader->setFloatUniformValue(name.c_str(), frame_iblSH[i].x, frame_iblSH[i].y, frame_iblSH[i].z);
-		//m_pShader->setFloatUniformValue(name.c_str(), 0, 0, 0);
+		shBlock.sh[i] = glm::vec4(frame_iblSH[i], 0.0f);
 	}
-	m_pMonkey->updateModel(*m_pShader);
+	uploadBlockIfChanged(m_SHUBO, shBlock, m_UploadedSHBlock);
+	if (m_RunLightStressScene)
+	{
+		glBeginQuery(GL_TIME_ELAPSED, m_ShadingTimeQuery);
+		__drawScene(lodSelection, jitterMat * u_ViewMatrix);
+		glEndQuery(GL_TIME_ELAPSED);
+		__recordLightStressFrame(clusterMs);
+	}
+	else
+	{
+		__drawScene(lodSelection, jitterMat * u_ViewMatrix);
+	}
+	if (m_RunDrawCallStressScene)
+		__drawCallStressFrame(lodSelection);
 	
 
-	glDisable(GL_CULL_FACE);
 	glm::vec3 center = m_pMonkey->getAABB()->getCentre();
-	auto lightPosition = ElayGraphics::ResourceManager::getSharedDataByName<glm::vec3>("u_LightPos");
+	const glm::vec3& lightPosition = m_LightPos.get();
 
 	//auto groundShader = std::make_shared<CShader>("GroundShadow_VS.glsl", "GroundShadow_FS.glsl");
-	auto groundShader = ElayGraphics::ResourceManager::getSharedDataByName<std::shared_ptr<CShader>>("GroundShader");
-	auto TextureConfig4Depth = ElayGraphics::ResourceManager::getSharedDataByName<std::shared_ptr<ElayGraphics::STexture>>("LightDepthTexture");
-	groundShader->activeShader();
+	const auto& groundShader = m_GroundShader.get();
+	const auto& TextureConfig4Depth = m_LightDepthTexture.get();
+	m_GroundPipeline.apply();
 	groundShader->setTextureUniformValue("shadowMap", TextureConfig4Depth);
 	groundShader->setFloatUniformValue("lightPos", lightPosition.x, lightPosition.y, lightPosition.z);
 	groundShader->setFloatUniformValue("viewPos", cameraPos.x, cameraPos.y, cameraPos.z);
@@ -214,7 +651,7 @@ void CModelRenderPass::updateV()
 	//modelMatrix = glm::scale(modelMatrix, glm::vec3(100, 0, 100));
 
 	groundShader->setMat4UniformValue("u_ModelMatrix", glm::value_ptr(modelMatrix));
-	auto u_LightVPMatrix = ElayGraphics::ResourceManager::getSharedDataByName<glm::mat4>("u_LightVPMatrix");
+	const glm::mat4& u_LightVPMatrix = m_LightVPMatrix.get();
 	groundShader->setMat4UniformValue("u_LightVPMatrix", glm::value_ptr(u_LightVPMatrix));
 
 	auto m_GroundObject = std::dynamic_pointer_cast<CGroundObject>(ElayGraphics::ResourceManager::getGameObjectByName("GroundObject"));
@@ -223,11 +660,6 @@ void CModelRenderPass::updateV()
 	glBindVertexArray(0);
 
 
-	glDisable(GL_CULL_FACE);
-	glDisable(GL_DEPTH_TEST);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-
 
 
 	
@@ -1,24 +1,119 @@
 #pragma once
 #include "RenderPass.h"
+#include "Interface.h"
+#include "ShadingUniforms.h"
+#include "LightClusterGrid.h"
+#include "SceneBvh.h"
+#include "MultiDrawBatch.h"
+#include "HiZCulling.h"
+#include "ShaderPermutationSet.h"
+#include "PipelineState.h"
+#include <unordered_set>
+#include <vector>
 
 class CModelLoad;
+class CShader;
+struct MaterialSettings;
+struct LightSettings;
+struct CameraSetting;
 class CModelRenderPass : public IRenderPass
 {
 public:
 	CModelRenderPass(const std::string& vPassName, int vExcutionOrder);
 	virtual ~CModelRenderPass();
 
+	// runBenchmark: the next frame times its shared data reads through names and through handles
+	void setSharedDataBenchmark(bool vRunBenchmark) { m_RunSharedDataBenchmark = vRunBenchmark; }
+	// runStressScene: the next frames add growing numbers of punctual lights around the model
+	// and log what clustering and shading each count costs, then the scene goes back to the GUI lights
+	void setLightStressScene(bool vRunStressScene) { m_RunLightStressScene = vRunStressScene; m_LightStressStep = 0; m_LightStressFrame = 0; }
+	// runStressScene: the next frames draw growing numbers of copies of the model, alternately per mesh and
+	// as multi-draws, and log the CPU submission time, GPU time and driver calls of both paths
+	void setDrawCallStressScene(bool vRunStressScene) { m_RunDrawCallStressScene = vRunStressScene; m_DrawCallStressStep = 0; m_DrawCallStressFrame = 0; }
+	// isGpuCulling: the frustum and occlusion tests of the model draws run in HiZCull_CS.glsl instead of the scene BVH
+	void setGpuCulling(bool vIsGpuCulling) { m_IsGpuCulling = vIsGpuCulling; }
+	// logStats: the GPU culling counters of the next frames are read back and logged once
+	void setGpuCullingStatsLog(bool vLogStats) { m_HiZCulling.setStatsLog(vLogStats); }
+
 	virtual void initV();
 	virtual void updateV();
 
 private:
+	template <typename TDataType>
+	using SharedData = ElayGraphics::ResourceManager::SharedDataHandle<TDataType>;
+	using TextureData = SharedData<std::shared_ptr<ElayGraphics::STexture>>;
+
+	void __benchmarkSharedDataReads() const;
+	void __stepLightStressScene();
+	void __recordLightStressFrame(float vClusterMs);
+	void __drawCallStressFrame(const SLodSelection& vLodSelection);
+	void __drawScene(const SLodSelection& vLodSelection, const glm::mat4& vViewProjectionMatrix);
+
 	std::shared_ptr<CModelLoad> m_pMonkey;
 	int m_FBO = 0;
 	glm::mat4 modelMatrix = glm::mat4(1.0);
 
-	std::shared_ptr<CShader> standardModelShader;
-	std::shared_ptr<CShader> clothModelShader;
-	std::shared_ptr<CShader> subsurafceModelShader;
+	// feature variants of the standard, cloth and subsurface shading models, indexed by MaterialSettings::materialType
+	CShaderPermutationSet m_ShadingModels[3];
+	std::unordered_set<const CShader*> m_ValidatedVariants;	// their blocks checked once they first drew
+	CPipelineState m_ScenePipeline;	// without a shader, the variant is picked every frame
+	CPipelineState m_GroundPipeline;
+
+	TextureData m_AlbedoTexture;
+	SharedData<MaterialSettings> m_MaterialSettings;
+	SharedData<LightSettings> m_LightSettings;
+	SharedData<CameraSetting> m_CameraSetting;
+	TextureData m_IrradianceMap;
+	TextureData m_PrefilterMap;
+	TextureData m_BRDFLUT;
+	TextureData m_EnvCubemap;
+	SharedData<std::vector<glm::vec3>> m_IBLSH;
+	SharedData<glm::vec3> m_LightPos;
+	SharedData<std::shared_ptr<CShader>> m_GroundShader;
+	TextureData m_LightDepthTexture;
+	SharedData<glm::mat4> m_LightVPMatrix;
+	SharedData<std::shared_ptr<CSceneBvh>> m_SceneBvh;
+	TextureData m_DepthTexture;
+	std::vector<SSceneDrawItem> m_DrawItems;
+	CMultiDrawBatch m_MultiDrawBatch;
+	CHiZCulling m_HiZCulling;
+	bool m_IsGpuCulling = true;
+	bool m_RunSharedDataBenchmark = false;
+
+	// std140 blocks of the shading model shaders, with the last contents sent to each buffer
+	GLint m_LightUBO = 0;
+	GLint m_MaterialUBO = 0;
+	GLint m_SHUBO = 0;
+	SLightBlock m_UploadedLightBlock = {};
+	SMaterialBlock m_UploadedMaterialBlock = {};
+	SSHBlock m_UploadedSHBlock = {};
+
+	// punctual lights of the frame, GUI lights first, and their froxel grid
+	CLightClusterGrid m_LightClusterGrid;
+	std::vector<SPunctualLight> m_PunctualLights;
+	std::vector<SPunctualLight> m_UploadedPunctualLights;
+	GLint m_PunctualLightBuffer = 0;
+	GLint m_LightClusterBuffer = 0;
+	GLint m_LightIndexBuffer = 0;
+
+	std::vector<SPunctualLight> m_StressLights;
+	bool m_RunLightStressScene = false;
+	size_t m_LightStressStep = 0;
+	int m_LightStressFrame = 0;
+	double m_StressClusterMs = 0.0;
+	double m_StressShadingMs = 0.0;
+	GLuint m_ShadingTimeQuery = 0;
+
+	// copies of the model the draw call stress scene submits, both paths are indexed by IsMultiDraw
+	std::vector<glm::mat4> m_StressModelMatrices;
+	std::vector<uint32_t> m_StressMeshIndices;
+	bool m_RunDrawCallStressScene = false;
+	size_t m_DrawCallStressStep = 0;
+	int m_DrawCallStressFrame = 0;
+	double m_StressSubmitMs[2] = {};
+	double m_StressDrawGpuMs[2] = {};
+	unsigned m_StressDriverCalls[2] = {};	// of the last measured frame
+	unsigned m_StressDrawCalls[2] = {};
 
 	
 };
\ No newline at end of file
@@ -0,0 +1,100 @@
+//punctual light attenuation, the froxel lookup and the loop over the lights of a froxel, included by the
+//ShadingModel*_FS.glsl programs after their surfaceShading(); reads the buffers of ShadingUniforms.glsl
+
+float computePreExposedIntensity(const highp float intensity, const highp float exposure) 
+{
+    return intensity * exposure;
+}
+
+float getSquareFalloffAttenuation(float distanceSquare, float falloff) 
+{
+    float factor = distanceSquare * falloff;
+    float smoothFactor = saturate(1.0 - factor * factor);
+    // We would normally divide by the square distance here
+    // but we do it at the call site
+    return smoothFactor * smoothFactor;
+}
+
+float getDistanceAttenuation(const highp vec3 posToLight, float falloff) 
+{
+    float distanceSquare = dot(posToLight, posToLight);
+    float attenuation = getSquareFalloffAttenuation(distanceSquare, falloff);
+    // light far attenuation
+    highp vec3 v = getWorldPosition() - getWorldCameraPosition();
+    attenuation *= saturate(lightFarAttenuationParams.x - dot(v, v) * lightFarAttenuationParams.y);
+    // Assume a punctual light occupies a volume of 1cm to avoid a division by 0
+    return attenuation / max(distanceSquare, 1e-4);
+}
+
+float getAngleAttenuation(const highp vec3 lightDir, const highp vec3 l, const highp vec2 scaleOffset) 
+{
+    float cd = dot(lightDir, l);
+    float attenuation = saturate(cd * scaleOffset.x + scaleOffset.y);
+    return attenuation * attenuation;
+}
+
+//froxel of this fragment, the same slicing as CLightClusterGrid::build
+uint getLightClusterIndex()
+{
+    uvec2 tile = min(uvec2(gl_FragCoord.xy * clusterTileScale), clusterDimensions.xy - 1u);
+    float near = clusterZParams.z;
+    float far = clusterZParams.w;
+    float ndcZ = gl_FragCoord.z * 2.0 - 1.0;
+    float viewZ = 2.0 * near * far / (far + near - ndcZ * (far - near));
+    uint slice = min(uint(max(log2(viewZ) * clusterZParams.x + clusterZParams.y, 0.0)), clusterDimensions.z - 1u);
+    return (slice * clusterDimensions.y + tile.y) * clusterDimensions.x + tile.x;
+}
+
+Light getLight(const uint lightIndex) 
+{
+    
+    highp vec4 positionFalloff = punctualLights[lightIndex].positionFalloff;
+    highp vec3 direction = punctualLights[lightIndex].direction;
+
+    vec4 colorIES = punctualLights[lightIndex].color;
+    highp vec2 scaleOffset = punctualLights[lightIndex].scaleOffset;
+    highp float intensity = colorIES.w;
+    highp uint typeShadow = punctualLights[lightIndex].type;
+
+
+    // poition-to-light vector
+    highp vec3 worldPosition = getWorldPosition();
+    highp vec3 posToLight = positionFalloff.xyz - worldPosition;
+
+    // and populate the Light structure
+    Light light;
+    light.colorIntensity.rgb = colorIES.rgb;
+    light.colorIntensity.w = computePreExposedIntensity(intensity, exposure);
+    light.l = normalize(posToLight);
+    light.attenuation = getDistanceAttenuation(posToLight, positionFalloff.w);
+    if (typeShadow == 1u)
+    {
+        light.attenuation *= getAngleAttenuation(-direction, light.l, scaleOffset);
+    }
+    light.direction = direction;
+    light.NoL = saturate(dot(shading_normal, light.l));
+    light.worldPosition = positionFalloff.xyz;
+    return light;
+}
+
+void evaluatePunctualLights(const MaterialInputs material,
+        const PixelParams pixel, inout vec3 color) 
+{
+
+    // Iterate the point and spot lights of this froxel
+    uvec2 cluster = lightClusters[getLightClusterIndex()];
+    for(uint i = 0u; i < cluster.y; i++)
+    {
+        Light light = getLight(lightIndices[cluster.x + i]);
+        float visibility = 1.0;
+        if (light.NoL > 0.0) 
+        {     
+            if (visibility <= 0.0) 
+            {
+                continue;
+            }
+            color.rgb += surfaceShading(pixel, light, visibility);
+        }
+    }
+   
+}
@@ -0,0 +1,323 @@
+#include "SHProjector.h"
+#include "glmextend.h"
+#include "Interface.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SH_PROJECTOR_USE_SSE 1
+#include <emmintrin.h>
+#else
+#define SH_PROJECTOR_USE_SSE 0
+#endif
+
+namespace
+{
+    // rows handed out to a worker per fetch; rows near the poles need many more
+    // source samples than the others, so keep the chunks small to balance the load
+    constexpr size_t ROWS_PER_FETCH = 4;
+
+    // SH basis normalization constants (signs included) for the polynomial terms
+    // { 1, y, z, x, xy, zy, 2zz-xx-yy, zx, xx-yy }, see getBasis() in IBL.cpp
+    const float kBasis[CSHProjector::NUM_COEFS] =
+    {
+         0.50f * std::sqrt(1.0f  / float(glm::F_PI)),
+        -0.50f * std::sqrt(3.0f  / float(glm::F_PI)),
+         0.50f * std::sqrt(3.0f  / float(glm::F_PI)),
+        -0.50f * std::sqrt(3.0f  / float(glm::F_PI)),
+         0.50f * std::sqrt(15.0f / float(glm::F_PI)),
+        -0.50f * std::sqrt(15.0f / float(glm::F_PI)),
+         0.25f * std::sqrt(5.0f  / float(glm::F_PI)),
+        -0.50f * std::sqrt(15.0f / float(glm::F_PI)),
+         0.25f * std::sqrt(15.0f / float(glm::F_PI)),
+    };
+
+    inline float sphereQuadrantArea(float x, float y)
+    {
+        return std::atan2(x * y, std::sqrt(x * x + y * y + 1));
+    }
+
+    inline glm::vec2 hammersley(uint32_t i, float iN)
+    {
+        constexpr float tof = 0.5f / 0x80000000U;
+        uint32_t bits = i;
+        bits = (bits << 16u) | (bits >> 16u);
+        bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+        bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+        bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+        bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+        return { i * iN, bits * tof };
+    }
+
+    // face-local (u, v, w) -> world direction, in GL face order +X -X +Y -Y +Z -Z
+    inline glm::vec3 orientFace(size_t face, float u, float v, float w)
+    {
+        switch (face)
+        {
+            case 0:  return {  w,  v, -u };
+            case 1:  return { -w,  v,  u };
+            case 2:  return {  u,  w, -v };
+            case 3:  return {  u, -w,  v };
+            case 4:  return {  u,  v,  w };
+            default: return { -u,  v, -w };
+        }
+    }
+
+    // accumulates sum(P_k(dir) * color) over one row stored as SoA, count is a multiple of 4
+    void accumulateRow(const float* r, const float* g, const float* b,
+            const float* x, const float* y, const float* z, size_t count, double* accum)
+    {
+#if SH_PROJECTOR_USE_SSE
+        __m128 acc[CSHProjector::NUM_COEFS][3];
+        for (size_t k = 0; k < CSHProjector::NUM_COEFS; k++)
+        {
+            acc[k][0] = acc[k][1] = acc[k][2] = _mm_setzero_ps();
+        }
+
+        const __m128 two = _mm_set1_ps(2.0f);
+        for (size_t i = 0; i < count; i += 4)
+        {
+            const __m128 cr = _mm_loadu_ps(r + i);
+            const __m128 cg = _mm_loadu_ps(g + i);
+            const __m128 cb = _mm_loadu_ps(b + i);
+            const __m128 dx = _mm_loadu_ps(x + i);
+            const __m128 dy = _mm_loadu_ps(y + i);
+            const __m128 dz = _mm_loadu_ps(z + i);
+            const __m128 xx = _mm_mul_ps(dx, dx);
+            const __m128 yy = _mm_mul_ps(dy, dy);
+            const __m128 zz = _mm_mul_ps(dz, dz);
+
+            const __m128 P[CSHProjector::NUM_COEFS] =
+            {
+                _mm_set1_ps(1.0f),
+                dy,
+                dz,
+                dx,
+                _mm_mul_ps(dx, dy),
+                _mm_mul_ps(dz, dy),
+                _mm_sub_ps(_mm_mul_ps(two, zz), _mm_add_ps(xx, yy)),
+                _mm_mul_ps(dz, dx),
+                _mm_sub_ps(xx, yy),
+            };
+
+            for (size_t k = 0; k < CSHProjector::NUM_COEFS; k++)
+            {
+                acc[k][0] = _mm_add_ps(acc[k][0], _mm_mul_ps(P[k], cr));
+                acc[k][1] = _mm_add_ps(acc[k][1], _mm_mul_ps(P[k], cg));
+                acc[k][2] = _mm_add_ps(acc[k][2], _mm_mul_ps(P[k], cb));
+            }
+        }
+
+        alignas(16) float lanes[4];
+        for (size_t k = 0; k < CSHProjector::NUM_COEFS; k++)
+        {
+            for (size_t c = 0; c < 3; c++)
+            {
+                _mm_store_ps(lanes, acc[k][c]);
+                accum[k * 3 + c] += double(lanes[0]) + double(lanes[1]) + double(lanes[2]) + double(lanes[3]);
+            }
+        }
+#else
+        float acc[CSHProjector::NUM_COEFS][3] = {};
+        for (size_t i = 0; i < count; i++)
+        {
+            const float dx = x[i], dy = y[i], dz = z[i];
+            const float P[CSHProjector::NUM_COEFS] =
+            {
+                1.0f, dy, dz, dx, dx * dy, dz * dy, 2.0f * dz * dz - dx * dx - dy * dy, dz * dx, dx * dx - dy * dy
+            };
+            for (size_t k = 0; k < CSHProjector::NUM_COEFS; k++)
+            {
+                acc[k][0] += P[k] * r[i];
+                acc[k][1] += P[k] * g[i];
+                acc[k][2] += P[k] * b[i];
+            }
+        }
+        for (size_t k = 0; k < CSHProjector::NUM_COEFS; k++)
+        {
+            for (size_t c = 0; c < 3; c++)
+            {
+                accum[k * 3 + c] += acc[k][c];
+            }
+        }
+#endif
+    }
+}
+
+CSHProjector::CSHProjector(size_t vDim, size_t vThreadCount) : m_Dim(std::max<size_t>(vDim, 1)), m_ThreadCount(vThreadCount)
+{
+    if (m_ThreadCount == 0)
+    {
+        // every worker of the job system plus the calling thread
+        m_ThreadCount = ElayGraphics::ResourceManager::getOrCreateJobSystem()->getThreadCount() + 1;
+    }
+    __buildFaceTable();
+}
+
+void CSHProjector::__buildFaceTable()
+{
+    m_FaceTable.resize(m_Dim * m_Dim);
+    const float iDim = 1.0f / m_Dim;
+    const float scale = 2.0f / m_Dim;
+    for (size_t y = 0; y < m_Dim; y++)
+    {
+        for (size_t x = 0; x < m_Dim; x++)
+        {
+            SFaceTexel& texel = m_FaceTable[y * m_Dim + x];
+
+            // direction through the texel corner, as computeSH() evaluates the basis there
+            const float cx = (x * scale) - 1;
+            const float cy = 1 - (y * scale);
+            const float il = 1.0f / std::sqrt(cx * cx + cy * cy + 1);
+            texel.u = cx * il;
+            texel.v = cy * il;
+            texel.w = il;
+
+            const float s = ((x + 0.5f) * 2 * iDim) - 1;
+            const float t = ((y + 0.5f) * 2 * iDim) - 1;
+            const float x0 = s - iDim;
+            const float y0 = t - iDim;
+            const float x1 = s + iDim;
+            const float y1 = t + iDim;
+            texel.solidAngle = sphereQuadrantArea(x0, y0) -
+                sphereQuadrantArea(x0, y1) -
+                sphereQuadrantArea(x1, y0) +
+                sphereQuadrantArea(x1, y1);
+        }
+    }
+}
+
+glm::vec3 CSHProjector::__faceDirection(size_t vFace, float vX, float vY) const
+{
+    const float scale = 2.0f / m_Dim;
+    const float cx = (vX * scale) - 1;
+    const float cy = 1 - (vY * scale);
+    const float il = 1.0f / std::sqrt(cx * cx + cy * cy + 1);
+    return orientFace(vFace, cx * il, cy * il, il);
+}
+
+glm::vec3 CSHProjector::__sampleTexel(const SSource& vSource, size_t vFace, size_t vX, size_t vY) const
+{
+    const int width = vSource.width;
+    const int height = vSource.height;
+    auto toRectilinear = [width, height](const glm::vec3& s) -> glm::vec2
+    {
+        float xf = std::atan2(s.x, s.z) * float(glm::F_1_PI);   // range [-1.0, 1.0]
+        float yf = std::asin(s.y) * float(2 * glm::F_1_PI);     // range [-1.0, 1.0]
+        xf = (xf + 1.0f) * 0.5f * (width - 1);                  // range [0, width [
+        yf = (1.0f - yf) * 0.5f * (height - 1);                 // range [0, height[
+        return glm::vec2(xf, yf);
+    };
+
+    // number of source samples from the footprint of the texel in the equirectangular image
+    const glm::vec2 pos0 = toRectilinear(__faceDirection(vFace, vX + 0.0f, vY + 0.0f));
+    const glm::vec2 pos1 = toRectilinear(__faceDirection(vFace, vX + 1.0f, vY + 0.0f));
+    const glm::vec2 pos2 = toRectilinear(__faceDirection(vFace, vX + 0.0f, vY + 1.0f));
+    const glm::vec2 pos3 = toRectilinear(__faceDirection(vFace, vX + 1.0f, vY + 1.0f));
+    const float minx = std::min(pos0.x, std::min(pos1.x, std::min(pos2.x, pos3.x)));
+    const float maxx = std::max(pos0.x, std::max(pos1.x, std::max(pos2.x, pos3.x)));
+    const float miny = std::min(pos0.y, std::min(pos1.y, std::min(pos2.y, pos3.y)));
+    const float maxy = std::max(pos0.y, std::max(pos1.y, std::max(pos2.y, pos3.y)));
+    const float dx = std::max(1.0f, maxx - minx);
+    const float dy = std::max(1.0f, maxy - miny);
+    const size_t numSamples = size_t(dx * dy);
+
+    const float iNumSamples = 1.0f / numSamples;
+    glm::vec3 color(0.0f);
+    for (size_t sample = 0; sample < numSamples; sample++)
+    {
+        const glm::vec2 h = hammersley(uint32_t(sample), iNumSamples);
+        const glm::vec2 pos = toRectilinear(__faceDirection(vFace, vX + h.x, vY + h.y));
+        const size_t px = std::min<size_t>(uint32_t(pos.x), size_t(width - 1));
+        const size_t py = std::min<size_t>(uint32_t(pos.y), size_t(height - 1));
+        const float* pixel = vSource.pData + (py * width + px) * vSource.channels;
+        color += glm::vec3(pixel[0], pixel[1], pixel[2]);
+    }
+    return color * iNumSamples;
+}
+
+void CSHProjector::__projectRows(const SSource& vSource, std::atomic<size_t>& vioNextRow, double* voAccum) const
+{
+    // one SoA row (r, g, b, x, y, z) per worker, padded with zero weights to the SIMD width
+    const size_t paddedDim = (m_Dim + 3) & ~size_t(3);
+    std::vector<float> rowData(paddedDim * 6, 0.0f);
+    float* r = rowData.data();
+    float* g = r + paddedDim;
+    float* b = g + paddedDim;
+    float* x = b + paddedDim;
+    float* y = x + paddedDim;
+    float* z = y + paddedDim;
+
+    const size_t totalRows = 6 * m_Dim;
+    for (;;)
+    {
+        const size_t first = vioNextRow.fetch_add(ROWS_PER_FETCH);
+        if (first >= totalRows)
+        {
+            break;
+        }
+        const size_t last = std::min(first + ROWS_PER_FETCH, totalRows);
+        for (size_t row = first; row < last; row++)
+        {
+            const size_t face = row / m_Dim;
+            const size_t ty = row % m_Dim;
+            const SFaceTexel* texels = &m_FaceTable[ty * m_Dim];
+            for (size_t tx = 0; tx < m_Dim; tx++)
+            {
+                const glm::vec3 color = __sampleTexel(vSource, face, tx, ty) * texels[tx].solidAngle;
+                const glm::vec3 dir = orientFace(face, texels[tx].u, texels[tx].v, texels[tx].w);
+                r[tx] = color.r;
+                g[tx] = color.g;
+                b[tx] = color.b;
+                x[tx] = dir.x;
+                y[tx] = dir.y;
+                z[tx] = dir.z;
+            }
+            accumulateRow(r, g, b, x, y, z, paddedDim, voAccum);
+        }
+    }
+}
+
+std::vector<glm::vec3> CSHProjector::project(const float* vImageData, int vWidth, int vHeight, int vChannels) const
+{
+    std::vector<glm::vec3> SH(NUM_COEFS, glm::vec3(0.0f));
+    if (!vImageData || vWidth <= 0 || vHeight <= 0 || vChannels < 3)
+    {
+        return SH;
+    }
+
+    const SSource source = { vImageData, vWidth, vHeight, vChannels };
+    const size_t threadCount = std::min(m_ThreadCount, 6 * m_Dim);
+    std::vector<std::array<double, NUM_COEFS * 3>> partials(threadCount);
+    for (auto& partial : partials)
+    {
+        partial.fill(0.0);
+    }
+
+    // the calling thread fills partials[0], a job that starts after the rows ran out adds nothing
+    std::atomic<size_t> nextRow(0);
+    const auto& jobSystem = ElayGraphics::ResourceManager::getOrCreateJobSystem();
+    const auto jobs = jobSystem->createGroup();
+    jobSystem->parallelFor(jobs, 1, threadCount, 1, [this, &source, &nextRow, &partials](size_t vBegin, size_t)
+    {
+        __projectRows(source, nextRow, partials[vBegin].data());
+    });
+    __projectRows(source, nextRow, partials[0].data());
+    jobSystem->wait(jobs);
+
+    for (size_t k = 0; k < NUM_COEFS; k++)
+    {
+        double sum[3] = { 0.0, 0.0, 0.0 };
+        for (const auto& partial : partials)
+        {
+            sum[0] += partial[k * 3 + 0];
+            sum[1] += partial[k * 3 + 1];
+            sum[2] += partial[k * 3 + 2];
+        }
+        SH[k] = glm::vec3(float(sum[0]), float(sum[1]), float(sum[2])) * kBasis[k];
+    }
+    return SH;
+}
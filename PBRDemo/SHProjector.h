@@ -0,0 +1,61 @@
+#pragma once
+#include <GLM/glm.hpp>
+#include <vector>
+#include <atomic>
+#include <cstddef>
+
+enum class ESHProjectionMode
+{
+    Serial,     // reference single-threaded computeSH()
+    Parallel,   // CSHProjector, job system + SIMD basis
+};
+
+// Projects an equirectangular HDR image onto the first 3 SH bands by walking
+// a virtual cubemap of dim x dim texels per face.
+//
+// Rows of all 6 faces are handed out through an atomic counter to the calling
+// thread and jobs on the shared CJobSystem; each of them owns its accumulators
+// and the partial sums are reduced once at the end. The per-texel geometry (face-local direction and solid angle)
+// is identical for all faces up to a signed axis permutation, so it is
+// precomputed once in a dim x dim table and shared by every face.
+//
+// The result is the raw projection (no K / truncated-cos / shader scaling), i.e.
+// the same value computeSH() holds before its post-processing.
+class CSHProjector
+{
+public:
+    static constexpr size_t NUM_BANDS = 3;
+    static constexpr size_t NUM_COEFS = NUM_BANDS * NUM_BANDS;
+
+    // vThreadCount: how many threads share a projection, the caller included; 0 for every job system worker
+    explicit CSHProjector(size_t vDim = 256, size_t vThreadCount = 0);
+
+    std::vector<glm::vec3> project(const float* vImageData, int vWidth, int vHeight, int vChannels = 3) const;
+
+    size_t getDim() const noexcept { return m_Dim; }
+    size_t getThreadCount() const noexcept { return m_ThreadCount; }
+
+private:
+    struct SFaceTexel
+    {
+        float u, v, w;      // normalized face-local direction of the texel corner
+        float solidAngle;
+    };
+
+    struct SSource
+    {
+        const float* pData;
+        int width;
+        int height;
+        int channels;
+    };
+
+    void __buildFaceTable();
+    void __projectRows(const SSource& vSource, std::atomic<size_t>& vioNextRow, double* voAccum) const;
+    glm::vec3 __sampleTexel(const SSource& vSource, size_t vFace, size_t vX, size_t vY) const;
+    glm::vec3 __faceDirection(size_t vFace, float vX, float vY) const;
+
+    size_t m_Dim;
+    size_t m_ThreadCount;
+    std::vector<SFaceTexel> m_FaceTable;
+};
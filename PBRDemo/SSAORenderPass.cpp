@@ -3,7 +3,9 @@
 #include "Interface.h"
 #include "Common.h"
 #include "Utils.h"
+#include "GLStateCache.h"
 #include "ModelLoad.h"
+#include "Mesh.h"
 #include <GLM/gtc/matrix_transform.hpp>
 #include <GLM/gtc/type_ptr.hpp>
 #include "Color.h"
@@ -68,10 +70,21 @@ void CSSAORenderPass::initV()
 	
 	ssaoFBO = genFBO({ TextureSSAO });
 	ElayGraphics::ResourceManager::registerSharedData("SSAOTexture", TextureSSAO);
+	m_DepthTexture = ElayGraphics::ResourceManager::SharedDataHandle<std::shared_ptr<ElayGraphics::STexture>>("SSAODepthTexture");
+	m_SceneBvh = ElayGraphics::ResourceManager::SharedDataHandle<std::shared_ptr<CSceneBvh>>("SceneBvh");
 
 	depthShader = std::make_shared<CShader>("Depth_VS.glsl", "Depth_FS.glsl");
 	ssaoShader = std::make_shared<CShader>("SSAO_VS.glsl", "SSAO_FS.glsl");
 
+	SPipelineStateDesc DepthPipelineDesc;
+	DepthPipelineDesc.IsDepthTest = true;
+	DepthPipelineDesc.IsCullFace = true;
+	DepthPipelineDesc.pShader = depthShader;
+	m_DepthPipeline = CPipelineState(DepthPipelineDesc);
+	SPipelineStateDesc SSAOPipelineDesc;
+	SSAOPipelineDesc.pShader = ssaoShader;
+	m_SSAOPipeline = CPipelineState(SSAOPipelineDesc);
+
 
 
 }
@@ -79,21 +92,23 @@ void CSSAORenderPass::initV()
 void CSSAORenderPass::updateV()
 {
 
-	auto depthmap = ElayGraphics::ResourceManager::getSharedDataByName<std::shared_ptr<ElayGraphics::STexture>>("SSAODepthTexture");
+	const auto& depthmap = m_DepthTexture.get();
 
-	glViewport(0, 0, 1280, 760);
-	glBindFramebuffer(GL_FRAMEBUFFER, depthFBO);
+	CGLStateCache& StateCache = fetchGLStateCache();
+	StateCache.setViewport(0, 0, 1280, 760);
+	StateCache.bindFramebuffer(GL_FRAMEBUFFER, depthFBO);
+	m_DepthPipeline.apply();
 	glClearColor(1.0f, 0.0f, 0.0f, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glEnable(GL_DEPTH_TEST);
-	glDepthFunc(GL_LESS);
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_BACK);
-	depthShader->activeShader();
 	depthShader->setMat4UniformValue("u_ModelMatrix", glm::value_ptr(glm::mat4(1)));
 
-	auto m_pMonkey = std::dynamic_pointer_cast<CModelLoad>(ElayGraphics::ResourceManager::getGameObjectByName("Monkey"));
-	m_pMonkey->updateModel(*depthShader);
+	SLodSelection lodSelection;
+	lodSelection.ViewProjectionMatrix = ElayGraphics::Camera::getMainCameraProjectionMatrix() * ElayGraphics::Camera::getMainCameraViewMatrix();
+	lodSelection.ViewportSize = glm::vec2(ElayGraphics::WINDOW_KEYWORD::getWindowWidth(), ElayGraphics::WINDOW_KEYWORD::getWindowHeight());
+	const auto& sceneBvh = m_SceneBvh.get();
+	sceneBvh->update(ElayGraphics::ResourceManager::getGameObjects());
+	sceneBvh->cull(lodSelection.ViewProjectionMatrix, "SSAODepth", m_DrawItems);
+	CSceneBvh::draw(m_DrawItems, *depthShader, lodSelection, m_MultiDrawBatch);
 	genGenerateMipmap(depthmap);
 
 
@@ -110,14 +125,11 @@ void CSSAORenderPass::updateV()
 	//float standardDeviation = standardDeviation;
 	//float scale = 1.0f;
 
-	glBindFramebuffer(GL_FRAMEBUFFER, ssaoFBO);
+	StateCache.bindFramebuffer(GL_FRAMEBUFFER, ssaoFBO);
+	m_SSAOPipeline.apply();
 	glClearColor(1.0f, 0.0f, 0.0f, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	
-	glDisable(GL_DEPTH_TEST);
-	glDisable(GL_CULL_FACE);
-	ssaoShader->activeShader();
 	ssaoShader->setTextureUniformValue("materialParams_depth", depthmap);
 	
 	double width = 1280;
@@ -163,9 +175,4 @@ void CSSAORenderPass::updateV()
 	ssaoShader->setFloatUniformValue("far_plane", zfar);
 	ssaoShader->setFloatUniformValue("near_plane", znear);
 	drawQuad();
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-
-
-
 }
@@ -1,5 +1,9 @@
 #pragma once
 #include "RenderPass.h"
+#include "Interface.h"
+#include "SceneBvh.h"
+#include "MultiDrawBatch.h"
+#include "PipelineState.h"
 
 class CSSAORenderPass : public IRenderPass
 {
@@ -13,5 +17,11 @@ private:
 	std::shared_ptr<CShader> ssaoShader;
 	GLuint depthFBO;
 	GLuint ssaoFBO;
+	CPipelineState m_DepthPipeline;
+	CPipelineState m_SSAOPipeline;
+	ElayGraphics::ResourceManager::SharedDataHandle<std::shared_ptr<ElayGraphics::STexture>> m_DepthTexture;
+	ElayGraphics::ResourceManager::SharedDataHandle<std::shared_ptr<CSceneBvh>> m_SceneBvh;
+	std::vector<SSceneDrawItem> m_DrawItems;
+	CMultiDrawBatch m_MultiDrawBatch;
 
 };
\ No newline at end of file
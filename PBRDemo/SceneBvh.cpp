@@ -0,0 +1,414 @@
+#include "SceneBvh.h"
+#include "SimdFloat.h"
+#include "GameObject.h"
+#include "Mesh.h"
+#include "MultiDrawBatch.h"
+#include "AABB.h"
+#include "Shader.h"
+#include <GLM/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <iostream>
+#include <numeric>
+
+namespace
+{
+	static_assert(CSceneBvh::BRANCH_COUNT % simd::floatN::WIDTH == 0, "a node holds whole SIMD batches");
+
+	double elapsedMs(std::chrono::steady_clock::time_point vStart)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - vStart).count();
+	}
+
+	// calls vFunction(pGameObject, meshIndices) once per run of draw items of the same object
+	template <typename TFunction>
+	void forEachObjectRun(const std::vector<SSceneDrawItem>& vDrawItems, TFunction vFunction)
+	{
+		std::vector<uint32_t> MeshIndices;
+		for (size_t i = 0; i < vDrawItems.size();)
+		{
+			IGameObject* pGameObject = vDrawItems[i].pGameObject;
+			MeshIndices.clear();
+			for (; i < vDrawItems.size() && vDrawItems[i].pGameObject == pGameObject; i++)
+				MeshIndices.push_back(vDrawItems[i].MeshIndex);
+			vFunction(pGameObject, MeshIndices);
+		}
+	}
+}
+
+//************************************************************************************
+//Function: refits the items of the objects that moved, rebuilds when the set of objects or their mesh counts changed
+void CSceneBvh::update(const std::vector<std::shared_ptr<IGameObject>>& vGameObjects)
+{
+	const auto Start = std::chrono::steady_clock::now();
+	// a model loading on the job system reports its meshes once they are created, which rebuilds
+	if (__isObjectSetChanged(vGameObjects))
+	{
+		__rebuild(vGameObjects);
+		return;
+	}
+
+	for (auto& Object : m_Objects)
+	{
+		const glm::mat4& ModelMatrix = Object.pGameObject->getModelMatrix();
+		if (ModelMatrix == Object.ModelMatrix)
+			continue;
+		Object.ModelMatrix = ModelMatrix;
+		for (uint32_t i = Object.FirstItem; i < Object.FirstItem + Object.MeshCount; i++)
+		{
+			__transformItem(m_Items[i], ModelMatrix);
+			__refitItem(i);
+		}
+		m_RefitObjectCount++;
+	}
+
+	if (!m_LogStats)
+		return;
+	m_UpdateMs += elapsedMs(Start);
+	if (++m_UpdateCount < CULL_STATS_FRAMES)
+		return;
+	__logStats();
+	setStatsLog(false);
+}
+
+//************************************************************************************
+//Function: depth first, each node tests its children against the six planes one SIMD batch at a time
+void CSceneBvh::cull(const glm::mat4& vViewProjectionMatrix, const std::string& vViewName, std::vector<SSceneDrawItem>& voDrawItems)
+{
+	const auto Start = std::chrono::steady_clock::now();
+	voDrawItems.clear();
+	m_VisibleItems.clear();
+	size_t TestedNodeCount = 0;
+	if (!m_Nodes.empty())
+	{
+		// Gribb-Hartmann: row 3 plus or minus rows 0, 1 and 2, a point is inside where all six are >= 0
+		const glm::mat4& M = vViewProjectionMatrix;
+		const glm::vec4 Row0(M[0][0], M[1][0], M[2][0], M[3][0]);
+		const glm::vec4 Row1(M[0][1], M[1][1], M[2][1], M[3][1]);
+		const glm::vec4 Row2(M[0][2], M[1][2], M[2][2], M[3][2]);
+		const glm::vec4 Row3(M[0][3], M[1][3], M[2][3], M[3][3]);
+		const glm::vec4 Planes[] = { Row3 + Row0, Row3 - Row0, Row3 + Row1, Row3 - Row1, Row3 + Row2, Row3 - Row2 };
+
+		const unsigned Width = static_cast<unsigned>(simd::floatN::WIDTH);
+		m_Stack.clear();
+		m_Stack.push_back(0);
+		while (!m_Stack.empty())
+		{
+			const SNode& Node = m_Nodes[m_Stack.back()];
+			m_Stack.pop_back();
+			TestedNodeCount++;
+			for (unsigned Batch = 0; Batch < Node.ChildCount; Batch += Width)
+			{
+				// a box is outside once its corner furthest along the normal of one plane is still behind it
+				unsigned Bits = (1u << Width) - 1;
+				for (const glm::vec4& Plane : Planes)
+				{
+					const simd::floatN X = simd::load((Plane.x > 0.0f ? Node.MaxX : Node.MinX) + Batch);
+					const simd::floatN Y = simd::load((Plane.y > 0.0f ? Node.MaxY : Node.MinY) + Batch);
+					const simd::floatN Z = simd::load((Plane.z > 0.0f ? Node.MaxZ : Node.MinZ) + Batch);
+					const simd::floatN Distance = X * simd::splat(Plane.x) + Y * simd::splat(Plane.y) + Z * simd::splat(Plane.z) + simd::splat(Plane.w);
+					Bits &= ~simd::laneBits(simd::greater(simd::splat(0.0f), Distance));
+					if (Bits == 0)
+						break;
+				}
+				if (Batch + Width > Node.ChildCount)
+					Bits &= (1u << (Node.ChildCount - Batch)) - 1;
+				for (unsigned Lane = 0; Bits != 0; Lane++, Bits >>= 1)
+				{
+					if (!(Bits & 1))
+						continue;
+					const int32_t Child = Node.Children[Batch + Lane];
+					if (Child >= 0)
+						m_Stack.push_back(static_cast<uint32_t>(Child));
+					else
+						m_VisibleItems.push_back(static_cast<uint32_t>(~Child));
+				}
+			}
+		}
+
+		// items are laid out object by object, so the sorted list draws every object in one run
+		std::sort(m_VisibleItems.begin(), m_VisibleItems.end());
+		voDrawItems.reserve(m_VisibleItems.size());
+		for (uint32_t ItemIndex : m_VisibleItems)
+		{
+			const SItem& Item = m_Items[ItemIndex];
+			voDrawItems.push_back({ Item.pGameObject, Item.MeshIndex });
+		}
+	}
+	__recordCullStats(vViewName, elapsedMs(Start), voDrawItems.size(), TestedNodeCount);
+}
+
+//************************************************************************************
+//Function:
+void CSceneBvh::collectAll(std::vector<SSceneDrawItem>& voDrawItems) const
+{
+	voDrawItems.clear();
+	voDrawItems.reserve(m_Items.size());
+	for (const SItem& Item : m_Items)
+		voDrawItems.push_back({ Item.pGameObject, Item.MeshIndex });
+}
+
+//************************************************************************************
+//Function: u_ModelMatrix and the LOD selection follow each object as the multi-draw path does, u_ModelMatrix is identity again on return
+void CSceneBvh::draw(const std::vector<SSceneDrawItem>& vDrawItems, const CShader& vShader, const SLodSelection& vLodSelection)
+{
+	SLodSelection ObjectLodSelection = vLodSelection;
+	forEachObjectRun(vDrawItems, [&](IGameObject* vGameObject, const std::vector<uint32_t>& vMeshIndices)
+	{
+		const glm::mat4& ModelMatrix = vGameObject->getModelMatrix();
+		ObjectLodSelection.ViewProjectionMatrix = vLodSelection.ViewProjectionMatrix * ModelMatrix;
+		vShader.setMat4UniformValue("u_ModelMatrix", glm::value_ptr(ModelMatrix));
+		vGameObject->updateModel(vShader, vMeshIndices, ObjectLodSelection);
+	});
+	vShader.setMat4UniformValue("u_ModelMatrix", glm::value_ptr(glm::mat4(1.0f)));
+}
+
+//************************************************************************************
+//Function:
+void CSceneBvh::draw(const std::vector<SSceneDrawItem>& vDrawItems, const CShader& vShader, const SLodSelection& vLodSelection, CMultiDrawBatch& vioBatch)
+{
+	if (!CMultiDrawBatch::isSupported())
+	{
+		draw(vDrawItems, vShader, vLodSelection);
+		return;
+	}
+	appendDraws(vDrawItems, vLodSelection, vioBatch);
+	vioBatch.draw(vShader);
+}
+
+//************************************************************************************
+//Function:
+void CSceneBvh::appendDraws(const std::vector<SSceneDrawItem>& vDrawItems, const SLodSelection& vLodSelection, CMultiDrawBatch& vioBatch)
+{
+	vioBatch.clear();
+	forEachObjectRun(vDrawItems, [&](IGameObject* vGameObject, const std::vector<uint32_t>& vMeshIndices)
+	{
+		vGameObject->appendModelDraws(vioBatch, vMeshIndices, vLodSelection);
+	});
+}
+
+//************************************************************************************
+//Function: a log in progress is dropped
+void CSceneBvh::setStatsLog(bool vLogStats)
+{
+	m_LogStats = vLogStats;
+	m_CullStats.clear();
+	m_UpdateMs = 0.0;
+	m_UpdateCount = 0;
+	m_RefitObjectCount = 0;
+}
+
+//************************************************************************************
+//Function: objects without meshes yet are skipped, they are not in the hierarchy
+bool CSceneBvh::__isObjectSetChanged(const std::vector<std::shared_ptr<IGameObject>>& vGameObjects) const
+{
+	size_t ObjectIndex = 0;
+	for (const auto& pGameObject : vGameObjects)
+	{
+		const size_t MeshCount = pGameObject->getMeshCount();
+		if (MeshCount == 0)
+			continue;
+		if (ObjectIndex == m_Objects.size() || m_Objects[ObjectIndex].pGameObject != pGameObject || m_Objects[ObjectIndex].MeshCount != MeshCount)
+			return true;
+		ObjectIndex++;
+	}
+	return ObjectIndex != m_Objects.size();
+}
+
+//************************************************************************************
+//Function:
+void CSceneBvh::__rebuild(const std::vector<std::shared_ptr<IGameObject>>& vGameObjects)
+{
+	const auto Start = std::chrono::steady_clock::now();
+	m_Objects.clear();
+	m_Items.clear();
+	m_Nodes.clear();
+	for (const auto& pGameObject : vGameObjects)
+	{
+		const size_t MeshCount = pGameObject->getMeshCount();
+		if (MeshCount == 0)
+			continue;
+		SObjectState Object;
+		Object.pGameObject = pGameObject;
+		Object.ModelMatrix = pGameObject->getModelMatrix();
+		Object.MeshCount = MeshCount;
+		Object.FirstItem = static_cast<uint32_t>(m_Items.size());
+		for (size_t i = 0; i < MeshCount; i++)
+		{
+			const std::shared_ptr<CAABB> pBounding = pGameObject->getMeshAABB(i);
+			SItem Item;
+			Item.pGameObject = pGameObject.get();
+			Item.MeshIndex = static_cast<uint32_t>(i);
+			Item.LocalMin = pBounding->getMin();
+			Item.LocalMax = pBounding->getMax();
+			__transformItem(Item, Object.ModelMatrix);
+			m_Items.push_back(Item);
+		}
+		m_Objects.push_back(Object);
+	}
+	if (m_Items.empty())
+		return;
+
+	m_ItemOrder.resize(m_Items.size());
+	std::iota(m_ItemOrder.begin(), m_ItemOrder.end(), 0u);
+	m_Nodes.reserve(m_Items.size());
+	__buildNode(0, static_cast<uint32_t>(m_Items.size()), NO_PARENT, 0);
+	std::cout << "SceneBvh:: built over " << m_Items.size() << " meshes of " << m_Objects.size() << " game objects, "
+		<< m_Nodes.size() << " nodes in " << elapsedMs(Start) << " ms" << std::endl;
+}
+
+//************************************************************************************
+//Function: top down, splits its range into up to BRANCH_COUNT groups and recurses into those holding more than one item
+uint32_t CSceneBvh::__buildNode(uint32_t vBegin, uint32_t vEnd, uint32_t vParent, uint32_t vParentSlot)
+{
+	const uint32_t NodeIndex = static_cast<uint32_t>(m_Nodes.size());
+	m_Nodes.emplace_back();
+	m_Nodes[NodeIndex].Parent = vParent;
+	m_Nodes[NodeIndex].ParentSlot = vParentSlot;
+	for (unsigned Slot = 0; Slot < BRANCH_COUNT; Slot++)
+	{
+		__setSlotBounds(m_Nodes[NodeIndex], Slot, glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX));
+		m_Nodes[NodeIndex].Children[Slot] = EMPTY_CHILD;
+	}
+
+	// halve the largest group at the median centroid of its longest axis until there is one group per slot
+	std::pair<uint32_t, uint32_t> Groups[BRANCH_COUNT] = { { vBegin, vEnd } };
+	unsigned GroupCount = 1;
+	while (GroupCount < BRANCH_COUNT)
+	{
+		unsigned Largest = 0;
+		for (unsigned i = 1; i < GroupCount; i++)
+		{
+			if (Groups[i].second - Groups[i].first > Groups[Largest].second - Groups[Largest].first)
+				Largest = i;
+		}
+		const uint32_t First = Groups[Largest].first;
+		const uint32_t Last = Groups[Largest].second;
+		if (Last - First <= 1)
+			break;
+
+		glm::vec3 CentroidMin(FLT_MAX), CentroidMax(-FLT_MAX);
+		for (uint32_t i = First; i < Last; i++)
+		{
+			const SItem& Item = m_Items[m_ItemOrder[i]];
+			CentroidMin = glm::min(CentroidMin, Item.Min + Item.Max);
+			CentroidMax = glm::max(CentroidMax, Item.Min + Item.Max);
+		}
+		const glm::vec3 Extent = CentroidMax - CentroidMin;
+		const int Axis = Extent.x >= Extent.y && Extent.x >= Extent.z ? 0 : (Extent.y >= Extent.z ? 1 : 2);
+		const uint32_t Middle = First + (Last - First) / 2;
+		std::nth_element(m_ItemOrder.begin() + First, m_ItemOrder.begin() + Middle, m_ItemOrder.begin() + Last, [&](uint32_t vLeft, uint32_t vRight)
+		{
+			return m_Items[vLeft].Min[Axis] + m_Items[vLeft].Max[Axis] < m_Items[vRight].Min[Axis] + m_Items[vRight].Max[Axis];
+		});
+		Groups[Largest].second = Middle;
+		Groups[GroupCount++] = { Middle, Last };
+	}
+
+	for (unsigned Slot = 0; Slot < GroupCount; Slot++)
+	{
+		if (Groups[Slot].second - Groups[Slot].first == 1)
+		{
+			const uint32_t ItemIndex = m_ItemOrder[Groups[Slot].first];
+			SItem& Item = m_Items[ItemIndex];
+			Item.Node = NodeIndex;
+			Item.Slot = Slot;
+			m_Nodes[NodeIndex].Children[Slot] = ~static_cast<int32_t>(ItemIndex);
+			__setSlotBounds(m_Nodes[NodeIndex], Slot, Item.Min, Item.Max);
+		}
+		else
+		{
+			// the child fits its own slot here once its subtree is built
+			const uint32_t ChildIndex = __buildNode(Groups[Slot].first, Groups[Slot].second, NodeIndex, Slot);
+			m_Nodes[NodeIndex].Children[Slot] = static_cast<int32_t>(ChildIndex);
+		}
+	}
+	m_Nodes[NodeIndex].ChildCount = GroupCount;
+	__fitParentSlot(NodeIndex);
+	return NodeIndex;
+}
+
+//************************************************************************************
+//Function: world space AABB of the eight transformed corners of the model space one
+void CSceneBvh::__transformItem(SItem& vioItem, const glm::mat4& vModelMatrix)
+{
+	vioItem.Min = glm::vec3(FLT_MAX);
+	vioItem.Max = glm::vec3(-FLT_MAX);
+	for (int Corner = 0; Corner < 8; Corner++)
+	{
+		const glm::vec3 LocalCorner((Corner & 1) ? vioItem.LocalMax.x : vioItem.LocalMin.x, (Corner & 2) ? vioItem.LocalMax.y : vioItem.LocalMin.y,
+			(Corner & 4) ? vioItem.LocalMax.z : vioItem.LocalMin.z);
+		const glm::vec3 WorldCorner = glm::vec3(vModelMatrix * glm::vec4(LocalCorner, 1.0f));
+		vioItem.Min = glm::min(vioItem.Min, WorldCorner);
+		vioItem.Max = glm::max(vioItem.Max, WorldCorner);
+	}
+}
+
+//************************************************************************************
+//Function:
+void CSceneBvh::__setSlotBounds(SNode& vioNode, unsigned vSlot, const glm::vec3& vMin, const glm::vec3& vMax)
+{
+	vioNode.MinX[vSlot] = vMin.x;
+	vioNode.MinY[vSlot] = vMin.y;
+	vioNode.MinZ[vSlot] = vMin.z;
+	vioNode.MaxX[vSlot] = vMax.x;
+	vioNode.MaxY[vSlot] = vMax.y;
+	vioNode.MaxZ[vSlot] = vMax.z;
+}
+
+//************************************************************************************
+//Function: the bounds of the slot of vNodeIndex in its parent become the union of its children
+void CSceneBvh::__fitParentSlot(uint32_t vNodeIndex)
+{
+	const SNode& Node = m_Nodes[vNodeIndex];
+	if (Node.Parent == NO_PARENT)
+		return;
+	glm::vec3 Min(FLT_MAX), Max(-FLT_MAX);
+	for (unsigned Slot = 0; Slot < Node.ChildCount; Slot++)
+	{
+		Min = glm::min(Min, glm::vec3(Node.MinX[Slot], Node.MinY[Slot], Node.MinZ[Slot]));
+		Max = glm::max(Max, glm::vec3(Node.MaxX[Slot], Node.MaxY[Slot], Node.MaxZ[Slot]));
+	}
+	__setSlotBounds(m_Nodes[Node.Parent], Node.ParentSlot, Min, Max);
+}
+
+//************************************************************************************
+//Function:
+void CSceneBvh::__refitItem(uint32_t vItemIndex)
+{
+	const SItem& Item = m_Items[vItemIndex];
+	__setSlotBounds(m_Nodes[Item.Node], Item.Slot, Item.Min, Item.Max);
+	for (uint32_t NodeIndex = Item.Node; m_Nodes[NodeIndex].Parent != NO_PARENT; NodeIndex = m_Nodes[NodeIndex].Parent)
+		__fitParentSlot(NodeIndex);
+}
+
+//************************************************************************************
+//Function:
+void CSceneBvh::__recordCullStats(const std::string& vViewName, double vCullMs, size_t vVisibleCount, size_t vTestedNodeCount)
+{
+	if (!m_LogStats)
+		return;
+	SCullStats& Stats = m_CullStats[vViewName];
+	Stats.CullMs += vCullMs;
+	Stats.VisibleCount += vVisibleCount;
+	Stats.CulledCount += m_Items.size() - vVisibleCount;
+	Stats.TestedNodeCount += vTestedNodeCount;
+	Stats.FrameCount++;
+}
+
+//************************************************************************************
+//Function: a view culls a varying number of times per update, so each line is averaged over its own frames
+void CSceneBvh::__logStats() const
+{
+	std::cout << "SceneBvh:: update " << m_UpdateMs / m_UpdateCount << " ms per call, " << m_RefitObjectCount << " moved objects refitted in "
+		<< m_UpdateCount << " calls" << std::endl;
+	for (const auto& View : m_CullStats)
+	{
+		const SCullStats& Stats = View.second;
+		const double FrameCount = Stats.FrameCount;
+		std::cout << "SceneBvh:: " << View.first << ": " << Stats.VisibleCount / FrameCount << " meshes visible, " << Stats.CulledCount / FrameCount
+			<< " culled, " << Stats.TestedNodeCount / FrameCount << " of " << m_Nodes.size() << " nodes tested, culling "
+			<< Stats.CullMs / FrameCount << " ms per frame" << std::endl;
+	}
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include <GLM/glm.hpp>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+class IGameObject;
+class CShader;
+class CMultiDrawBatch;
+struct SLodSelection;
+
+// One mesh that survived culling, pGameObject lives as long as the object set the BVH was updated with
+struct SSceneDrawItem
+{
+	IGameObject* pGameObject = nullptr;
+	uint32_t MeshIndex = 0;
+};
+
+// 8-wide bounding volume hierarchy over the world space AABB of every mesh of every game object
+// that has a model. update() rebuilds it when meshes come or go and otherwise only refits the
+// leaves of the objects whose model matrix changed, walking up their ancestors. cull() tests the
+// 8 children of a node against the frustum planes in SIMD batches and returns the visible meshes
+// sorted by object, draw() issues them. Once setStatsLog() asks for it, the updates and the
+// culling of every view are timed for CULL_STATS_FRAMES updates and logged once, averaged.
+class CSceneBvh
+{
+public:
+	static constexpr unsigned BRANCH_COUNT = 8;
+	static constexpr unsigned CULL_STATS_FRAMES = 300;
+
+	void update(const std::vector<std::shared_ptr<IGameObject>>& vGameObjects);
+	// vViewProjectionMatrix maps to the OpenGL clip cube, vViewName keys the stats of the camera
+	void cull(const glm::mat4& vViewProjectionMatrix, const std::string& vViewName, std::vector<SSceneDrawItem>& voDrawItems);
+	// every mesh, in the order cull() returns them, for a pass that culls on the GPU
+	void collectAll(std::vector<SSceneDrawItem>& voDrawItems) const;
+	static void draw(const std::vector<SSceneDrawItem>& vDrawItems, const CShader& vShader, const SLodSelection& vLodSelection);
+	// one glMultiDrawElementsIndirect per vertex layout and index type, the per mesh draw above when the driver cannot
+	static void draw(const std::vector<SSceneDrawItem>& vDrawItems, const CShader& vShader, const SLodSelection& vLodSelection, CMultiDrawBatch& vioBatch);
+	// clears vioBatch and appends the items without drawing them
+	static void appendDraws(const std::vector<SSceneDrawItem>& vDrawItems, const SLodSelection& vLodSelection, CMultiDrawBatch& vioBatch);
+	// logStats: the next CULL_STATS_FRAMES updates, and the culls between them, are logged once
+	void setStatsLog(bool vLogStats);
+
+	size_t getItemCount() const { return m_Items.size(); }
+	size_t getNodeCount() const { return m_Nodes.size(); }
+
+private:
+	static constexpr int32_t EMPTY_CHILD = INT32_MIN;
+	static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+	// child bounds in SoA so a batch of them loads straight into SIMD registers,
+	// a child >= 0 is a node, ~child an item, unused slots are EMPTY_CHILD with inverted bounds
+	struct SNode
+	{
+		float MinX[BRANCH_COUNT], MinY[BRANCH_COUNT], MinZ[BRANCH_COUNT];
+		float MaxX[BRANCH_COUNT], MaxY[BRANCH_COUNT], MaxZ[BRANCH_COUNT];
+		int32_t Children[BRANCH_COUNT];
+		uint32_t ChildCount = 0;
+		uint32_t Parent = NO_PARENT;
+		uint32_t ParentSlot = 0;
+	};
+
+	struct SItem
+	{
+		IGameObject* pGameObject = nullptr;
+		uint32_t MeshIndex = 0;
+		glm::vec3 LocalMin, LocalMax;	// model space, as CMesh reports it
+		glm::vec3 Min, Max;				// world space
+		uint32_t Node = 0;
+		uint32_t Slot = 0;
+	};
+
+	struct SObjectState
+	{
+		std::shared_ptr<IGameObject> pGameObject;
+		glm::mat4 ModelMatrix;
+		size_t MeshCount = 0;
+		uint32_t FirstItem = 0;
+	};
+
+	struct SCullStats
+	{
+		double CullMs = 0.0;
+		uint64_t VisibleCount = 0;
+		uint64_t CulledCount = 0;
+		uint64_t TestedNodeCount = 0;
+		unsigned FrameCount = 0;
+	};
+
+	bool __isObjectSetChanged(const std::vector<std::shared_ptr<IGameObject>>& vGameObjects) const;
+	void __rebuild(const std::vector<std::shared_ptr<IGameObject>>& vGameObjects);
+	uint32_t __buildNode(uint32_t vBegin, uint32_t vEnd, uint32_t vParent, uint32_t vParentSlot);
+	static void __transformItem(SItem& vioItem, const glm::mat4& vModelMatrix);
+	static void __setSlotBounds(SNode& vioNode, unsigned vSlot, const glm::vec3& vMin, const glm::vec3& vMax);
+	void __fitParentSlot(uint32_t vNodeIndex);
+	void __refitItem(uint32_t vItemIndex);
+	void __recordCullStats(const std::string& vViewName, double vCullMs, size_t vVisibleCount, size_t vTestedNodeCount);
+	void __logStats() const;
+
+	std::vector<SNode> m_Nodes;				// m_Nodes[0] is the root
+	std::vector<SItem> m_Items;
+	std::vector<uint32_t> m_ItemOrder;		// scratch of the build
+	std::vector<SObjectState> m_Objects;
+	std::vector<uint32_t> m_Stack;
+	std::vector<uint32_t> m_VisibleItems;
+	std::map<std::string, SCullStats> m_CullStats;
+	double m_UpdateMs = 0.0;			// since the last update stats line
+	unsigned m_UpdateCount = 0;
+	size_t m_RefitObjectCount = 0;
+	bool m_LogStats = false;
+};
@@ -8,6 +8,9 @@
 #define MIN_ROUGHNESS            0.002025
 #define MIN_N_DOT_V 1e-4
 
+//features CShaderPermutationSet defines for the variant the material and the lights need, each compiled out when unused:
+//MATERIAL_HAS_CLEAR_COAT, MATERIAL_HAS_ANISOTROPY, MATERIAL_HAS_SHEEN_COLOR, HAS_PUNCTUAL_LIGHTS
+
 in  vec3 v2f_FragPosInViewSpace;
 in  vec2 v2f_TexCoords;
 in  vec3 v2f_Normal;
@@ -16,51 +19,13 @@ out vec4 Albedo_;
 
 
 
-struct DirectLight
-{   
-    vec4 lightColor;
-    vec4 sun;
-    vec3 lightDirection;
-    float use_light;
-};
-
-
-struct PunctualLight
-{
-    vec4 positionFalloff;
-    vec3 direction;
-    vec4 color;
-    vec2 scaleOffset;
-    int type;
-};
-
-
-
-
-//light
-uniform DirectLight directLight;
-uniform PunctualLight punctualLight[10];
-uniform int punctualLight_Num;
-uniform vec2 lightFarAttenuationParams;
+#include "ShadingUniforms.glsl"
 
 
 uniform vec3 cameraPos;
 uniform float exposure;
-uniform float iblLuminance;
 
 
-uniform vec4  material_baseColor;
-uniform float material_metallic;
-uniform float material_roughness;
-uniform float material_reflectance;
-uniform vec4  material_emissive;
-uniform float material_ambientOcclusion;
-uniform vec3  material_sheenColor;
-uniform float material_sheenRoughness;
-uniform float material_clearCoat;
-uniform float material_clearCoatRoughness;
-uniform vec3  material_anisotropyDirection;
-uniform float material_anisotropy;
 
 
 
@@ -69,7 +34,6 @@ uniform samplerCube irradianceMap;
 uniform samplerCube prefilterMap;
 uniform sampler2D brdfLUT;
 uniform samplerCube environmentCubeMap;
-uniform vec3 frame_iblSH[9];
 
 //shader parameter
 highp mat3  shading_tangentToWorld;   // TBN matrix
@@ -556,15 +520,19 @@ vec3 surfaceShading(const PixelParams pixel, const Light light, float occlusion)
     vec3 Fd = diffuseLobe(pixel, NoV, NoL, LoH);
     vec3 color = Fd + Fr * pixel.energyCompensation;
 
+#if defined(MATERIAL_HAS_SHEEN_COLOR)
     color *= pixel.sheenScaling;
     color += sheenLobe(pixel, NoV, NoL, NoH);
+#endif
 
+#if defined(MATERIAL_HAS_CLEAR_COAT)
     float Fcc;
     float clearCoat = clearCoatLobe(pixel, h, NoH, LoH, Fcc);
     float attenuation = 1.0 - Fcc;
 
     color *= attenuation;
     color += clearCoat;
+#endif
 
     return (color * light.colorIntensity.rgb)*(light.colorIntensity.w * NoL *light.attenuation);
 
@@ -590,8 +558,10 @@ void getRoughnessPixelParams(const MaterialInputs material, inout PixelParams pi
     float perceptualRoughness = material.roughness;
     pixel.perceptualRoughnessUnclamped = perceptualRoughness;
 
+#if defined(MATERIAL_HAS_CLEAR_COAT)
     float basePerceptualRoughness = max(perceptualRoughness, pixel.clearCoatPerceptualRoughness);
     perceptualRoughness = mix(perceptualRoughness, basePerceptualRoughness, pixel.clearCoat);
+#endif
 
     pixel.perceptualRoughness = clamp(perceptualRoughness, MIN_PERCEPTUAL_ROUGHNESS, 1.0);
     pixel.roughness = perceptualRoughnessToRoughness(pixel.perceptualRoughness);
@@ -650,8 +620,10 @@ void getEnergyCompensationPixelParams(inout PixelParams pixel)
 #else
     pixel.energyCompensation = vec3(1.0);
 #endif
+#if defined(MATERIAL_HAS_SHEEN_COLOR)
     pixel.sheenDFG = prefilteredDFG(pixel.sheenPerceptualRoughness, shading_NoV).z;
     pixel.sheenScaling = 1.0 - max3(pixel.sheenColor) * pixel.sheenDFG;
+#endif
 }
 
 
@@ -666,11 +638,17 @@ void getAnisotropyPixelParams(const MaterialInputs material, inout PixelParams p
 void getPixelParams(const MaterialInputs material, out PixelParams pixel) 
 {
     getCommonPixelParams(material, pixel);
+#if defined(MATERIAL_HAS_SHEEN_COLOR)
     getSheenPixelParams(material, pixel);
+#endif
+#if defined(MATERIAL_HAS_CLEAR_COAT)
     getClearCoatPixelParams(material, pixel);
+#endif
     getRoughnessPixelParams(material, pixel);
     getSubsurfacePixelParams(material, pixel);
+#if defined(MATERIAL_HAS_ANISOTROPY)
     getAnisotropyPixelParams(material, pixel);
+#endif
     getEnergyCompensationPixelParams(pixel);
 }
 
@@ -709,79 +687,7 @@ void evaluateDirectionalLight(const MaterialInputs material,
 }
 
 
-float computePreExposedIntensity(const highp float intensity, const highp float exposure) 
-{
-    return intensity * exposure;
-}
-
-float getSquareFalloffAttenuation(float distanceSquare, float falloff) 
-{
-    float factor = distanceSquare * falloff;
-    float smoothFactor = saturate(1.0 - factor * factor);
-    // We would normally divide by the square distance here
-    // but we do it at the call site
-    return smoothFactor * smoothFactor;
-}
-
-float getDistanceAttenuation(const highp vec3 posToLight, float falloff) 
-{
-    float distanceSquare = dot(posToLight, posToLight);
-    float attenuation = getSquareFalloffAttenuation(distanceSquare, falloff);
-    // light far attenuation
-    highp vec3 v = getWorldPosition() - getWorldCameraPosition();
-    attenuation *= saturate(lightFarAttenuationParams.x - dot(v, v) * lightFarAttenuationParams.y);
-    // Assume a punctual light occupies a volume of 1cm to avoid a division by 0
-    return attenuation / max(distanceSquare, 1e-4);
-}
-
-Light getLight(const uint lightIndex) 
-{
-    
-    highp vec4 positionFalloff = punctualLight[lightIndex].positionFalloff;
-    highp vec3 direction = punctualLight[lightIndex].direction;
-
-    vec4 colorIES = punctualLight[lightIndex].color;
-    highp vec2 scaleOffset = punctualLight[lightIndex].scaleOffset;
-    highp float intensity = colorIES.w;
-    highp uint typeShadow = punctualLight[lightIndex].type;
-
-
-    // poition-to-light vector
-    highp vec3 worldPosition = getWorldPosition();
-    highp vec3 posToLight = positionFalloff.xyz - worldPosition;
-
-    // and populate the Light structure
-    Light light;
-    light.colorIntensity.rgb = colorIES.rgb;
-    light.colorIntensity.w = computePreExposedIntensity(intensity, exposure);
-    light.l = normalize(posToLight);
-    light.attenuation = getDistanceAttenuation(posToLight, positionFalloff.w);
-    light.direction = direction;
-    light.NoL = saturate(dot(shading_normal, light.l));
-    light.worldPosition = positionFalloff.xyz;
-    return light;
-}
-
-void evaluatePunctualLights(const MaterialInputs material,
-        const PixelParams pixel, inout vec3 color) 
-{
-
-    // Iterate point lights
-    for(uint lightIndex = 0; lightIndex < punctualLight_Num; lightIndex++)
-    {
-        Light light = getLight(lightIndex);
-        float visibility = 1.0;
-        if (light.NoL > 0.0) 
-        {     
-            if (visibility <= 0.0) 
-            {
-                continue;
-            }
-            color.rgb += surfaceShading(pixel, light, visibility);
-        }
-    }
-   
-}
+#include "PunctualLights.glsl"
 
 
 
@@ -837,12 +743,14 @@ float singleBounceAO(float visibility)
 void evaluateSheenIBL(const PixelParams pixel, float diffuseAO,
         const in SSAOInterpolationCache cache, inout vec3 Fd, inout vec3 Fr) 
 {
+#if defined(MATERIAL_HAS_SHEEN_COLOR)
     // Albedo scaling of the base layer before we layer sheen on top
     Fd *= pixel.sheenScaling;
     Fr *= pixel.sheenScaling;
     vec3 reflectance = pixel.sheenDFG * pixel.sheenColor;
     reflectance *= specularAO(shading_NoV, diffuseAO, pixel.sheenRoughness, cache);
     Fr += reflectance * prefilteredRadiance(shading_reflected, pixel.sheenPerceptualRoughness);
+#endif
 
 }
 
@@ -850,7 +758,7 @@ void evaluateSheenIBL(const PixelParams pixel, float diffuseAO,
 void evaluateClearCoatIBL(const PixelParams pixel, float diffuseAO,
         const in SSAOInterpolationCache cache, inout vec3 Fd, inout vec3 Fr) 
 {
-
+#if defined(MATERIAL_HAS_CLEAR_COAT)
     if (pixel.clearCoat > 0.0) 
     {
 
@@ -866,7 +774,7 @@ void evaluateClearCoatIBL(const PixelParams pixel, float diffuseAO,
         float specularAO = specularAO(clearCoatNoV, diffuseAO, pixel.clearCoatRoughness, cache);
         Fr += prefilteredRadiance(clearCoatR, pixel.clearCoatPerceptualRoughness) * (specularAO * Fc);
     }
-
+#endif
 }
 
 void evaluateIBL(const MaterialInputs material, const PixelParams pixel, inout vec3 color) 
@@ -935,7 +843,9 @@ vec4 evaluateLights(const MaterialInputs material)
     evaluateDirectionalLight(material, pixel, color);
 
     //߾۹
+#if defined(HAS_PUNCTUAL_LIGHTS)
     evaluatePunctualLights(material, pixel, color);
+#endif
 
     color *= material.baseColor.a;
 
@@ -1,9 +1,72 @@
 #version 430 core
-layout(location = 0) in vec3 _Position;
+#extension GL_ARB_shader_draw_parameters : enable
+layout(location = 0) in vec4 _Position;
 layout(location = 1) in vec3 _Normal;
 layout(location = 2) in vec2 _TexCoord;
 layout(location = 3) in vec3 _Tangent;
 
+//SPackedMeshVertex is decoded here when CMesh sets u_IsVertexPacked: unorm positions in the
+//mesh AABB with the tangent handedness in w, octahedral normals and tangents
+uniform bool u_IsVertexPacked;
+uniform vec3 u_VertexPositionScale;
+uniform vec3 u_VertexPositionBias;
+uniform mat4 u_ModelMatrix;
+
+//CMultiDrawBatch: while u_IsMultiDraw is set every draw of a glMultiDrawElementsIndirect takes its
+//model matrix and vertex decode from u_DrawRecords instead of the uniforms above, see SDrawRecord
+struct SDrawRecord
+{
+	mat4 modelMatrix;
+	vec4 positionScale;		//w is 1 for packed vertices
+	vec4 positionBias;
+	uvec4 meshMaterial;		//mesh id, material index
+};
+layout(std430, binding = 7) readonly buffer u_DrawRecords
+{
+	SDrawRecord u_Draws[];
+};
+uniform bool u_IsMultiDraw;
+uniform int u_DrawRecordOffset;
+
+SDrawRecord fetchDrawRecord()
+{
+	SDrawRecord draw;
+	if (u_IsMultiDraw)
+	{
+#ifdef GL_ARB_shader_draw_parameters
+		draw = u_Draws[u_DrawRecordOffset + gl_DrawIDARB];
+#else
+		draw = u_Draws[u_DrawRecordOffset];
+#endif
+	}
+	else
+	{
+		draw.modelMatrix = u_ModelMatrix;
+		draw.positionScale = vec4(u_VertexPositionScale, u_IsVertexPacked ? 1.0 : 0.0);
+		draw.positionBias = vec4(u_VertexPositionBias, 0.0);
+		draw.meshMaterial = uvec4(0);
+	}
+	return draw;
+}
+
+vec3 decodeOctahedral(vec2 e)
+{
+	vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (v.z < 0.0)
+		v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(v);
+}
+
+vec3 decodePosition(SDrawRecord vDraw)
+{
+	return vDraw.positionScale.w > 0.5 ? vDraw.positionBias.xyz + _Position.xyz * vDraw.positionScale.xyz : _Position.xyz;
+}
+
+vec3 decodeDirection(SDrawRecord vDraw, vec3 vDirection)
+{
+	return vDraw.positionScale.w > 0.5 ? decodeOctahedral(vDirection.xy) : vDirection;
+}
+
 
 uniform mat4 u_ProjectionMatrix;
 uniform mat4 u_ViewMatrix;
@@ -23,7 +86,6 @@ void toTangentFrame(const highp vec4 q, out highp vec3 n, out highp vec3 t)
         vec3(-2.0,  2.0,  2.0) * q.z * q.zwx;
 }
 
-uniform mat4 u_ModelMatrix;
 out vec2 v2f_TexCoords;
 out vec3 v2f_Normal;
 out vec3 v2f_FragPosInViewSpace;
@@ -31,15 +93,16 @@ out vec4 vertex_worldTangent;
 
 void main()
 {
-	vec4 FragPosInViewSpace =  u_ModelMatrix *vec4(_Position, 1.0f);
+	SDrawRecord draw = fetchDrawRecord();
+	vec4 FragPosInViewSpace =  draw.modelMatrix *vec4(decodePosition(draw), 1.0f);
 	gl_Position = u_ProjectionMatrix *u_ViewMatrix *FragPosInViewSpace;
 
 	v2f_TexCoords = _TexCoord;
-	v2f_Normal = normalize(mat3(transpose(inverse(u_ModelMatrix))) * _Normal); //˴
+	v2f_Normal = normalize(mat3(transpose(inverse(draw.modelMatrix))) * decodeDirection(draw, _Normal)); //˴
 
 	vec3 worldNormal;
-	toTangentFrame(vec4(_Tangent, 1.0f), worldNormal, vertex_worldTangent.xyz);
-	vertex_worldTangent.w = 1.0f;
+	toTangentFrame(vec4(decodeDirection(draw, _Tangent), 1.0f), worldNormal, vertex_worldTangent.xyz);
+	vertex_worldTangent.w = _Position.w * 2.0f - 1.0f;
 	v2f_FragPosInViewSpace = vec3(FragPosInViewSpace);
 
 }
\ No newline at end of file
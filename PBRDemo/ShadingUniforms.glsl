@@ -0,0 +1,72 @@
+//light, material and SH blocks and the punctual light buffers of the ShadingModel*_FS.glsl programs,
+//included by each so the layouts ShadingUniforms.h mirrors are written once
+
+struct DirectLight
+{   
+    vec4 lightColor;
+    vec4 sun;
+    vec3 lightDirection;
+    float use_light;
+};
+
+
+struct PunctualLight
+{
+    vec4 positionFalloff;
+    vec3 direction;
+    vec4 color;
+    vec2 scaleOffset;
+    int type;
+};
+
+//light
+//one std140 buffer per block, ShadingUniforms.h mirrors the layouts
+layout(std140, binding = 1) uniform u_LightBlock
+{
+    DirectLight directLight;
+    uvec4 clusterDimensions;
+    vec4 clusterZParams;
+    vec2 clusterTileScale;
+    vec2 lightFarAttenuationParams;
+    float iblLuminance;
+};
+
+//punctual lights, culled per froxel on the CPU by CLightClusterGrid
+layout(std430, binding = 4) readonly buffer u_PunctualLights
+{
+    PunctualLight punctualLights[];
+};
+
+layout(std430, binding = 5) readonly buffer u_LightClusters
+{
+    uvec2 lightClusters[];  //offset and count in lightIndices
+};
+
+layout(std430, binding = 6) readonly buffer u_LightIndices
+{
+    uint lightIndices[];
+};
+
+layout(std140, binding = 2) uniform u_MaterialBlock
+{
+    vec4  material_baseColor;
+    vec4  material_emissive;
+    vec3  material_sheenColor;
+    float material_metallic;
+    vec3  material_anisotropyDirection;
+    float material_roughness;
+    vec3  material_subsurfaceColor;
+    float material_reflectance;
+    float material_ambientOcclusion;
+    float material_sheenRoughness;
+    float material_clearCoat;
+    float material_clearCoatRoughness;
+    float material_anisotropy;
+    float material_thickness;
+    float material_subsurfacePower;
+};
+
+layout(std140, binding = 3) uniform u_SHBlock
+{
+    vec3 frame_iblSH[9];
+};
@@ -0,0 +1,114 @@
+#pragma once
+#include <GLM/glm.hpp>
+#include <stddef.h>
+#include <stdint.h>
+
+// CPU copies of the std140 uniform blocks and std430 light buffers declared in ShadingUniforms.glsl.
+// A vec3 takes 16 bytes unless a scalar fills its last 4, hence the pad members.
+// CModelRenderPass checks these offsets against the linked program at startup.
+
+constexpr unsigned SH_COEFFICIENT_COUNT = 9;
+
+// froxel grid of the clustered punctual lights, see CLightClusterGrid
+constexpr unsigned LIGHT_CLUSTER_COUNT_X = 16;
+constexpr unsigned LIGHT_CLUSTER_COUNT_Y = 9;
+constexpr unsigned LIGHT_CLUSTER_COUNT_Z = 24;
+constexpr unsigned LIGHT_CLUSTER_COUNT = LIGHT_CLUSTER_COUNT_X * LIGHT_CLUSTER_COUNT_Y * LIGHT_CLUSTER_COUNT_Z;
+
+enum EShadingUniformBinding : unsigned
+{
+    SHADING_LIGHT_BLOCK_BINDING = 1,
+    SHADING_MATERIAL_BLOCK_BINDING = 2,
+    SHADING_SH_BLOCK_BINDING = 3,
+};
+
+// shader storage binding points, a namespace of their own
+enum EShadingStorageBinding : unsigned
+{
+    SHADING_PUNCTUAL_LIGHT_BUFFER_BINDING = 4,
+    SHADING_LIGHT_CLUSTER_BUFFER_BINDING = 5,
+    SHADING_LIGHT_INDEX_BUFFER_BINDING = 6,
+};
+
+enum EPunctualLightType : int32_t
+{
+    PUNCTUAL_LIGHT_POINT = 0,
+    PUNCTUAL_LIGHT_SPOT = 1,
+};
+
+struct SDirectLightStd140
+{
+    glm::vec4 lightColor;
+    glm::vec4 sun;
+    glm::vec3 lightDirection;
+    float useLight;
+};
+
+// element of u_PunctualLights, std430 gives it the same layout as std140 would
+struct SPunctualLight
+{
+    glm::vec4 positionFalloff;      // w = 1 / radius^2, 0 for an unbounded light
+    glm::vec3 direction;            // spot axis
+    float pad0;
+    glm::vec4 color;                // w = intensity
+    glm::vec2 scaleOffset;          // spot cone, saturate(cos * scale + offset)
+    int32_t type;                   // EPunctualLightType
+    float pad1;
+};
+
+// element of u_LightClusters: a range of u_LightIndices
+struct SLightClusterRecord
+{
+    uint32_t offset;
+    uint32_t count;
+};
+
+// u_LightBlock
+struct SLightBlock
+{
+    SDirectLightStd140 directLight;
+    glm::uvec4 clusterDimensions;       // x, y, z, punctual light count
+    glm::vec4 clusterZParams;           // slice = log2(viewZ) * x + y, near, far
+    glm::vec2 clusterTileScale;         // clusters per pixel
+    glm::vec2 lightFarAttenuationParams;
+    float iblLuminance;
+    float pad0;
+    float pad1;
+    float pad2;
+};
+
+// u_MaterialBlock
+struct SMaterialBlock
+{
+    glm::vec4 baseColor;
+    glm::vec4 emissive;
+    glm::vec3 sheenColor;
+    float metallic;
+    glm::vec3 anisotropyDirection;
+    float roughness;
+    glm::vec3 subsurfaceColor;
+    float reflectance;
+    float ambientOcclusion;
+    float sheenRoughness;
+    float clearCoat;
+    float clearCoatRoughness;
+    float anisotropy;
+    float thickness;
+    float subsurfacePower;
+    float pad0;
+};
+
+// u_SHBlock, vec3 array elements have a 16 byte stride
+struct SSHBlock
+{
+    glm::vec4 sh[SH_COEFFICIENT_COUNT];
+};
+
+static_assert(sizeof(SDirectLightStd140) == 48, "std140 DirectLight is 48 bytes");
+static_assert(sizeof(SPunctualLight) == 64, "std430 PunctualLight is 64 bytes");
+static_assert(sizeof(SLightClusterRecord) == 8, "std430 uvec2");
+static_assert(offsetof(SLightBlock, iblLuminance) == 96, "u_LightBlock layout");
+static_assert(sizeof(SLightBlock) == 112, "u_LightBlock layout");
+static_assert(offsetof(SMaterialBlock, ambientOcclusion) == 80, "u_MaterialBlock layout");
+static_assert(sizeof(SMaterialBlock) == 112, "u_MaterialBlock layout");
+static_assert(sizeof(SSHBlock) == 144, "u_SHBlock layout");
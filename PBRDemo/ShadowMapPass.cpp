@@ -3,7 +3,9 @@
 #include "Interface.h"
 #include "Common.h"
 #include "Utils.h"
+#include "GLStateCache.h"
 #include "ModelLoad.h"
+#include "Mesh.h"
 #include <GLM/gtc/matrix_transform.hpp>
 #include <GLM/gtc/type_ptr.hpp>
 #include "Color.h"
@@ -85,29 +87,38 @@ void CShadowMapPass::initV()
 	glm::mat4 lightView = glm::lookAt(lightPosition, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
 	ElayGraphics::ResourceManager::registerSharedData("u_LightVPMatrix", lightProjection * lightView);
 	ElayGraphics::ResourceManager::registerSharedData("u_LightPos", lightPosition);
+	m_LightSettings = ElayGraphics::ResourceManager::SharedDataHandle<LightSettings>("LightSettings");
+	m_LightVPMatrix = ElayGraphics::ResourceManager::SharedDataHandle<glm::mat4>("u_LightVPMatrix");
+	m_LightPos = ElayGraphics::ResourceManager::SharedDataHandle<glm::vec3>("u_LightPos");
+	m_SceneBvh = ElayGraphics::ResourceManager::SharedDataHandle<std::shared_ptr<CSceneBvh>>("SceneBvh");
 	
 	m_pShader->setMat4UniformValue("u_LightVPMatrix", glm::value_ptr(lightProjection * lightView));
 	Monkey->initModel(*m_pShader);
 
+	SPipelineStateDesc PipelineDesc;
+	PipelineDesc.IsDepthTest = true;
+	PipelineDesc.IsCullFace = true;
+	PipelineDesc.pShader = m_pShader;
+	m_Pipeline = CPipelineState(PipelineDesc);
+
 
 }
 
 void CShadowMapPass::updateV()
 {
 
-	glBindFramebuffer(GL_FRAMEBUFFER, m_FBO);
+	CGLStateCache& StateCache = fetchGLStateCache();
+	StateCache.bindFramebuffer(GL_FRAMEBUFFER, m_FBO);
+	StateCache.setViewport(0, 0, 1024, 1024);
+	m_Pipeline.apply();
 	glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
 	glClear( GL_DEPTH_BUFFER_BIT|GL_COLOR_BUFFER_BIT);
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_BACK);
-	glViewport(0, 0, 1024, 1024);
 	
-	m_pShader->activeShader();
+	m_pShader->setMat4UniformValue("u_ModelMatrix", glm::value_ptr(glm::mat4(1.0f)));
 	GLfloat near_plane = 1.0f, far_plane = 7.5f;
 	
 	glm::mat4 lightProjection = glm::ortho(-1.0f, 1.0f, -1.0f, 1.0f, 0.1f, 100.0f);
-	auto light = ElayGraphics::ResourceManager::getSharedDataByName<LightSettings>("LightSettings");
+	const LightSettings& light = m_LightSettings.get();
 	
 	auto  Monkey = std::dynamic_pointer_cast<CModelLoad>(ElayGraphics::ResourceManager::getGameObjectByName("Monkey"));
 	glm::vec3 center = Monkey->getAABB()->getCentre();
@@ -115,16 +126,17 @@ void CShadowMapPass::updateV()
 	glm::mat4 lightView = glm::lookAt(lightPosition, lightPosition + light.sunLight.sunlightDirection, glm::vec3(0.0f, 1.0f, 0.0f));
 	m_pShader->setMat4UniformValue("u_LightVPMatrix", glm::value_ptr(lightProjection * lightView));
 	
-	ElayGraphics::ResourceManager::updateSharedDataByName("u_LightVPMatrix", lightProjection * lightView);
-	ElayGraphics::ResourceManager::updateSharedDataByName("u_LightPos", lightPosition);
-	
-	Monkey->updateModel(*m_pShader);
+	m_LightVPMatrix.set(lightProjection * lightView);
+	m_LightPos.set(lightPosition);
 	
-	
-	glViewport(0, 0, ElayGraphics::WINDOW_KEYWORD::getWindowWidth(), ElayGraphics::WINDOW_KEYWORD::getWindowHeight());
-	glDisable(GL_CULL_FACE);
-	glDisable(GL_DEPTH_TEST);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
+	//a shadow map texel is blurred by the filtering anyway, so the shadow caster can be twice as coarse
+	SLodSelection lodSelection;
+	lodSelection.ViewProjectionMatrix = lightProjection * lightView;
+	lodSelection.ViewportSize = glm::vec2(1024.0f, 1024.0f);
+	lodSelection.Bias = 1.0f;
+	const auto& sceneBvh = m_SceneBvh.get();
+	sceneBvh->update(ElayGraphics::ResourceManager::getGameObjects());
+	sceneBvh->cull(lodSelection.ViewProjectionMatrix, "ShadowMap", m_DrawItems);
+	CSceneBvh::draw(m_DrawItems, *m_pShader, lodSelection, m_MultiDrawBatch);
 }
 
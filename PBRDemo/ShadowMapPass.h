@@ -1,7 +1,12 @@
 #pragma once
 #include "RenderPass.h"
+#include "Interface.h"
+#include "SceneBvh.h"
+#include "MultiDrawBatch.h"
+#include "PipelineState.h"
 
 class CModelLoad;
+struct LightSettings;
 class CShadowMapPass : public IRenderPass
 {
 public:
@@ -13,5 +18,13 @@ public:
 
 private:
 	GLuint m_FBO = 0;
+	CPipelineState m_Pipeline;
 	glm::mat4 modelMatrix = glm::mat4(1.0);
+
+	ElayGraphics::ResourceManager::SharedDataHandle<LightSettings> m_LightSettings;
+	ElayGraphics::ResourceManager::SharedDataHandle<glm::mat4> m_LightVPMatrix;
+	ElayGraphics::ResourceManager::SharedDataHandle<glm::vec3> m_LightPos;
+	ElayGraphics::ResourceManager::SharedDataHandle<std::shared_ptr<CSceneBvh>> m_SceneBvh;
+	std::vector<SSceneDrawItem> m_DrawItems;
+	CMultiDrawBatch m_MultiDrawBatch;
 };
\ No newline at end of file
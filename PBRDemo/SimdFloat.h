@@ -0,0 +1,207 @@
+#pragma once
+#include <cmath>
+#include <cfloat>
+#include <cstddef>
+
+// A handful of float lanes processed together, for structure-of-arrays code
+// such as the batched color-grading LUT. 8 lanes with AVX2, 4 with SSE2, and a
+// single plain float everywhere else so the same code compiles on any target.
+//
+// Comparisons return a lane mask that is only meant to be consumed by select(),
+// or by laneBits(), which packs it into one bit per lane.
+// exp2/log2 are Cephes-style polynomial fits with a few ulp of error, which is
+// far below what the half float LUT can store.
+
+#if defined(__AVX2__)
+#define SIMD_FLOAT_USE_AVX2 1
+#define SIMD_FLOAT_USE_SSE 0
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_FLOAT_USE_AVX2 0
+#define SIMD_FLOAT_USE_SSE 1
+#include <emmintrin.h>
+#else
+#define SIMD_FLOAT_USE_AVX2 0
+#define SIMD_FLOAT_USE_SSE 0
+#endif
+
+namespace simd
+{
+#if SIMD_FLOAT_USE_AVX2
+
+    struct floatN
+    {
+        static constexpr size_t WIDTH = 8;
+        __m256 v;
+    };
+
+    inline floatN splat(float x) { return { _mm256_set1_ps(x) }; }
+    inline floatN load(const float* p) { return { _mm256_loadu_ps(p) }; }
+    inline void store(float* p, floatN a) { _mm256_storeu_ps(p, a.v); }
+
+    inline floatN operator+(floatN a, floatN b) { return { _mm256_add_ps(a.v, b.v) }; }
+    inline floatN operator-(floatN a, floatN b) { return { _mm256_sub_ps(a.v, b.v) }; }
+    inline floatN operator*(floatN a, floatN b) { return { _mm256_mul_ps(a.v, b.v) }; }
+    inline floatN operator/(floatN a, floatN b) { return { _mm256_div_ps(a.v, b.v) }; }
+    inline floatN min(floatN a, floatN b) { return { _mm256_min_ps(a.v, b.v) }; }
+    inline floatN max(floatN a, floatN b) { return { _mm256_max_ps(a.v, b.v) }; }
+    inline floatN sqrt(floatN a) { return { _mm256_sqrt_ps(a.v) }; }
+    inline floatN round(floatN a) { return { _mm256_round_ps(a.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC) }; }
+
+    inline floatN lessEqual(floatN a, floatN b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) }; }
+    inline floatN greater(floatN a, floatN b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+    inline floatN select(floatN mask, floatN a, floatN b) { return { _mm256_blendv_ps(b.v, a.v, mask.v) }; }
+    inline unsigned laneBits(floatN mask) { return unsigned(_mm256_movemask_ps(mask.v)); }
+
+    // 2^n for integral n in [-126, 127]
+    inline floatN pow2i(floatN n)
+    {
+        const __m256i e = _mm256_add_epi32(_mm256_cvtps_epi32(n.v), _mm256_set1_epi32(127));
+        return { _mm256_castsi256_ps(_mm256_slli_epi32(e, 23)) };
+    }
+
+    // x = mantissa * 2^exponent with the mantissa in [1, 2), for positive normal x
+    inline void decompose(floatN x, floatN& mantissa, floatN& exponent)
+    {
+        const __m256i bits = _mm256_castps_si256(x.v);
+        const __m256i e = _mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127));
+        const __m256i m = _mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)), _mm256_set1_epi32(0x3f800000));
+        exponent = { _mm256_cvtepi32_ps(e) };
+        mantissa = { _mm256_castsi256_ps(m) };
+    }
+
+#elif SIMD_FLOAT_USE_SSE
+
+    struct floatN
+    {
+        static constexpr size_t WIDTH = 4;
+        __m128 v;
+    };
+
+    inline floatN splat(float x) { return { _mm_set1_ps(x) }; }
+    inline floatN load(const float* p) { return { _mm_loadu_ps(p) }; }
+    inline void store(float* p, floatN a) { _mm_storeu_ps(p, a.v); }
+
+    inline floatN operator+(floatN a, floatN b) { return { _mm_add_ps(a.v, b.v) }; }
+    inline floatN operator-(floatN a, floatN b) { return { _mm_sub_ps(a.v, b.v) }; }
+    inline floatN operator*(floatN a, floatN b) { return { _mm_mul_ps(a.v, b.v) }; }
+    inline floatN operator/(floatN a, floatN b) { return { _mm_div_ps(a.v, b.v) }; }
+    inline floatN min(floatN a, floatN b) { return { _mm_min_ps(a.v, b.v) }; }
+    inline floatN max(floatN a, floatN b) { return { _mm_max_ps(a.v, b.v) }; }
+    inline floatN sqrt(floatN a) { return { _mm_sqrt_ps(a.v) }; }
+    // cvtps rounds to nearest even under the default MXCSR; only used on |x| < 2^31
+    inline floatN round(floatN a) { return { _mm_cvtepi32_ps(_mm_cvtps_epi32(a.v)) }; }
+
+    inline floatN lessEqual(floatN a, floatN b) { return { _mm_cmple_ps(a.v, b.v) }; }
+    inline floatN greater(floatN a, floatN b) { return { _mm_cmpgt_ps(a.v, b.v) }; }
+    inline floatN select(floatN mask, floatN a, floatN b) { return { _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)) }; }
+    inline unsigned laneBits(floatN mask) { return unsigned(_mm_movemask_ps(mask.v)); }
+
+    inline floatN pow2i(floatN n)
+    {
+        const __m128i e = _mm_add_epi32(_mm_cvtps_epi32(n.v), _mm_set1_epi32(127));
+        return { _mm_castsi128_ps(_mm_slli_epi32(e, 23)) };
+    }
+
+    inline void decompose(floatN x, floatN& mantissa, floatN& exponent)
+    {
+        const __m128i bits = _mm_castps_si128(x.v);
+        const __m128i e = _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127));
+        const __m128i m = _mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000));
+        exponent = { _mm_cvtepi32_ps(e) };
+        mantissa = { _mm_castsi128_ps(m) };
+    }
+
+#else
+
+    struct floatN
+    {
+        static constexpr size_t WIDTH = 1;
+        float v;
+    };
+
+    inline floatN splat(float x) { return { x }; }
+    inline floatN load(const float* p) { return { *p }; }
+    inline void store(float* p, floatN a) { *p = a.v; }
+
+    inline floatN operator+(floatN a, floatN b) { return { a.v + b.v }; }
+    inline floatN operator-(floatN a, floatN b) { return { a.v - b.v }; }
+    inline floatN operator*(floatN a, floatN b) { return { a.v * b.v }; }
+    inline floatN operator/(floatN a, floatN b) { return { a.v / b.v }; }
+    inline floatN min(floatN a, floatN b) { return { b.v < a.v ? b.v : a.v }; }
+    inline floatN max(floatN a, floatN b) { return { a.v < b.v ? b.v : a.v }; }
+    inline floatN sqrt(floatN a) { return { std::sqrt(a.v) }; }
+
+    inline floatN lessEqual(floatN a, floatN b) { return { a.v <= b.v ? 1.0f : 0.0f }; }
+    inline floatN greater(floatN a, floatN b) { return { a.v > b.v ? 1.0f : 0.0f }; }
+    inline floatN select(floatN mask, floatN a, floatN b) { return mask.v != 0.0f ? a : b; }
+    inline unsigned laneBits(floatN mask) { return mask.v != 0.0f ? 1u : 0u; }
+
+#endif
+
+    inline floatN operator+(floatN a, float b) { return a + splat(b); }
+    inline floatN operator-(floatN a, float b) { return a - splat(b); }
+    inline floatN operator*(floatN a, float b) { return a * splat(b); }
+    inline floatN operator+(float a, floatN b) { return splat(a) + b; }
+    inline floatN operator-(float a, floatN b) { return splat(a) - b; }
+    inline floatN operator*(float a, floatN b) { return splat(a) * b; }
+    inline floatN operator/(float a, floatN b) { return splat(a) / b; }
+
+    inline floatN clamp(floatN x, float lo, float hi) { return min(max(x, splat(lo)), splat(hi)); }
+    inline floatN saturate(floatN x) { return clamp(x, 0.0f, 1.0f); }
+
+#if SIMD_FLOAT_USE_AVX2 || SIMD_FLOAT_USE_SSE
+
+    inline floatN exp2(floatN x)
+    {
+        x = clamp(x, -126.0f, 127.0f);
+        const floatN n = round(x);
+        const floatN f = x - n;     // [-0.5, 0.5]
+        floatN p = splat(1.535336188319500e-4f);
+        p = p * f + 1.339887440266574e-3f;
+        p = p * f + 9.618437357674640e-3f;
+        p = p * f + 5.550332471162809e-2f;
+        p = p * f + 2.402264791363012e-1f;
+        p = p * f + 6.931472028550421e-1f;
+        return (p * f + 1.0f) * pow2i(n);
+    }
+
+    // Non-positive inputs are treated as FLT_MIN, so pow(0, y) ends up as a
+    // denormal-sized value instead of NaN.
+    inline floatN log2(floatN x)
+    {
+        floatN m, e;
+        decompose(max(x, splat(FLT_MIN)), m, e);
+
+        // move the mantissa to [sqrt(2)/2, sqrt(2)) so the polynomial is centered on 0
+        const floatN big = greater(m, splat(1.41421356f));
+        m = select(big, m * 0.5f, m);
+        e = select(big, e + 1.0f, e);
+
+        const floatN f = m - 1.0f;
+        const floatN z = f * f;
+        floatN p = splat(7.0376836292e-2f);
+        p = p * f - 1.1514610310e-1f;
+        p = p * f + 1.1676998740e-1f;
+        p = p * f - 1.2420140846e-1f;
+        p = p * f + 1.4249322787e-1f;
+        p = p * f - 1.6668057665e-1f;
+        p = p * f + 2.0000714765e-1f;
+        p = p * f - 2.4999993993e-1f;
+        p = p * f + 3.3333331174e-1f;
+        const floatN ln = f + p * f * z - z * 0.5f;
+        return ln * 1.44269504f + e;
+    }
+
+#else
+
+    inline floatN exp2(floatN x) { return { std::exp2(x.v) }; }
+    inline floatN log2(floatN x) { return { std::log2(x.v > FLT_MIN ? x.v : FLT_MIN) }; }
+
+#endif
+
+    inline floatN exp(floatN x) { return exp2(x * 1.44269504f); }
+    inline floatN log10(floatN x) { return log2(x) * 0.30102999566f; }
+    inline floatN pow(floatN x, floatN y) { return exp2(y * log2(x)); }
+    inline floatN pow(floatN x, float y) { return exp2(log2(x) * y); }
+}
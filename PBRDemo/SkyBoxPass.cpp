@@ -2,6 +2,7 @@
 #include "Interface.h"
 #include "Common.h"
 #include "Utils.h"
+#include "GLStateCache.h"
 #include <GLM/gtc/matrix_transform.hpp>
 #include <GLM/gtc/type_ptr.hpp>
 #include <vector>
@@ -48,6 +49,15 @@ void CSkyboxPass::initV()
 	auto envCubemap = ElayGraphics::ResourceManager::getSharedDataByName<std::shared_ptr<ElayGraphics::STexture>>("envCubemap");
 	m_pShader->activeShader();
 	m_pShader->setTextureUniformValue("u_Skybox", envCubemap);
+
+	SPipelineStateDesc PipelineDesc;
+	PipelineDesc.IsDepthTest = true;
+	PipelineDesc.DepthFunc = GL_LEQUAL;
+	PipelineDesc.pShader = m_pShader;
+	m_Pipeline = CPipelineState(PipelineDesc);
+
+	m_AlbedoTexture = ElayGraphics::ResourceManager::SharedDataHandle<std::shared_ptr<ElayGraphics::STexture>>("TextureConfig4Albedo");
+	m_EnvCubemap = ElayGraphics::ResourceManager::SharedDataHandle<std::shared_ptr<ElayGraphics::STexture>>("envCubemap");
 }
 
 
@@ -55,15 +65,14 @@ void CSkyboxPass::initV()
 //Function:
 void CSkyboxPass::updateV()
 {
-	auto albeo = ElayGraphics::ResourceManager::getSharedDataByName<std::shared_ptr<ElayGraphics::STexture>>("TextureConfig4Albedo");
-	glViewport(0, 0, albeo->Width, albeo->Height);
-	glBindFramebuffer(GL_FRAMEBUFFER, m_FBO);
+	const auto& albeo = m_AlbedoTexture.get();
+	CGLStateCache& StateCache = fetchGLStateCache();
+	StateCache.setViewport(0, 0, albeo->Width, albeo->Height);
+	StateCache.bindFramebuffer(GL_FRAMEBUFFER, m_FBO);
+	m_Pipeline.apply();
 	glClearColor(0.2f, 0.3f, 0.4f, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glEnable(GL_DEPTH_TEST);
-	glDepthFunc(GL_LEQUAL);
-	m_pShader->activeShader();
+	// IBLLightPass can swap the environment at runtime
+	m_pShader->setTextureUniformValue("u_Skybox", m_EnvCubemap.get());
 	drawCube();
-	glDepthFunc(GL_LESS);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
\ No newline at end of file
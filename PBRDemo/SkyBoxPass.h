@@ -1,5 +1,7 @@
 #pragma once
 #include "RenderPass.h"
+#include "Interface.h"
+#include "PipelineState.h"
 #include <memory>
 #include <GL/glew.h>
 
@@ -13,4 +15,7 @@ public:
 	virtual void updateV() override;
 private:
 	GLuint m_FBO;
+	CPipelineState m_Pipeline;
+	ElayGraphics::ResourceManager::SharedDataHandle<std::shared_ptr<ElayGraphics::STexture>> m_AlbedoTexture;
+	ElayGraphics::ResourceManager::SharedDataHandle<std::shared_ptr<ElayGraphics::STexture>> m_EnvCubemap;
 };
\ No newline at end of file
@@ -1,6 +1,7 @@
 
 #include "ToneMapper.h"
 #include "ColorSpaceUtils.h"
+#include "SimdFloat.h"
 
 
 
@@ -185,6 +186,60 @@ glm::vec3 ACES(glm::vec3 color, float brightness) noexcept
 
 DEFAULT_CONSTRUCTORS(ToneMapper)
 
+void ToneMapper::apply(const float* r, const float* g, const float* b, size_t n,
+        float* outR, float* outG, float* outB) const noexcept
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        glm::vec3 c = (*this)(glm::vec3{ r[i], g[i], b[i] });
+        outR[i] = c.r;
+        outG[i] = c.g;
+        outB[i] = c.b;
+    }
+}
+
+// Batch loop for the tone mappers without a vectorized curve. T is final, so
+// operator() is bound statically here instead of going through the vtable.
+template<typename T>
+static void applyPerColor(const T& toneMapper, const float* r, const float* g, const float* b, size_t n,
+        float* outR, float* outG, float* outB) noexcept
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        glm::vec3 c = toneMapper.T::operator()(glm::vec3{ r[i], g[i], b[i] });
+        outR[i] = c.r;
+        outG[i] = c.g;
+        outB[i] = c.b;
+    }
+}
+
+// Batch loop for tone mappers that apply the same curve to each channel. The
+// tail shorter than a full set of lanes goes through a padded copy so every
+// color sees exactly the same math.
+template<typename Curve>
+static void applyPerChannel(Curve curve, const float* r, const float* g, const float* b, size_t n,
+        float* outR, float* outG, float* outB) noexcept
+{
+    constexpr size_t W = simd::floatN::WIDTH;
+    const float* in[3] = { r, g, b };
+    float* out[3] = { outR, outG, outB };
+    for (size_t channel = 0; channel < 3; channel++)
+    {
+        size_t i = 0;
+        for (; i + W <= n; i += W)
+        {
+            simd::store(out[channel] + i, curve(simd::load(in[channel] + i)));
+        }
+        if (i < n)
+        {
+            float tail[W] = {};
+            for (size_t j = i; j < n; j++) tail[j - i] = in[channel][j];
+            simd::store(tail, curve(simd::load(tail)));
+            for (size_t j = i; j < n; j++) out[channel][j] = tail[j - i];
+        }
+    }
+}
+
     //------------------------------------------------------------------------------
     // Linear tone mapper
     //------------------------------------------------------------------------------
@@ -195,6 +250,12 @@ DEFAULT_CONSTRUCTORS(ToneMapper)
     return saturate(v);
 }
 
+void LinearToneMapper::apply(const float* r, const float* g, const float* b, size_t n,
+        float* outR, float* outG, float* outB) const noexcept
+{
+    applyPerChannel([](simd::floatN x) { return simd::saturate(x); }, r, g, b, n, outR, outG, outB);
+}
+
 //------------------------------------------------------------------------------
 // ACES tone mappers
 //------------------------------------------------------------------------------
@@ -206,14 +267,27 @@ DEFAULT_CONSTRUCTORS(ACESToneMapper)
     return ACES(c, 1.0f);
 }
 
+void ACESToneMapper::apply(const float* r, const float* g, const float* b, size_t n,
+        float* outR, float* outG, float* outB) const noexcept
+{
+    applyPerColor(*this, r, g, b, n, outR, outG, outB);
+}
+
 DEFAULT_CONSTRUCTORS(ACESLegacyToneMapper)
     glm::vec3 ACESLegacyToneMapper::operator()(glm::vec3 c) const noexcept 
 {
     return ACES(c, 1.0f / 0.6f);
 }
 
-DEFAULT_CONSTRUCTORS(FilmicToneMapper)
-    glm::vec3 FilmicToneMapper::operator()(glm::vec3 x) const noexcept 
+void ACESLegacyToneMapper::apply(const float* r, const float* g, const float* b, size_t n,
+        float* outR, float* outG, float* outB) const noexcept
+{
+    applyPerColor(*this, r, g, b, n, outR, outG, outB);
+}
+
+// Works on glm::vec3 as well as on simd::floatN lanes
+template<typename T>
+inline T filmicCurve(T x) noexcept
 {
     // Narkowicz 2015, "ACES Filmic Tone Mapping Curve"
     constexpr float a = 2.51f;
@@ -224,6 +298,18 @@ DEFAULT_CONSTRUCTORS(FilmicToneMapper)
     return (x * (a * x + b)) / (x * (c * x + d) + e);
 }
 
+DEFAULT_CONSTRUCTORS(FilmicToneMapper)
+    glm::vec3 FilmicToneMapper::operator()(glm::vec3 x) const noexcept 
+{
+    return filmicCurve(x);
+}
+
+void FilmicToneMapper::apply(const float* r, const float* g, const float* b, size_t n,
+        float* outR, float* outG, float* outB) const noexcept
+{
+    applyPerChannel([](simd::floatN x) { return filmicCurve(x); }, r, g, b, n, outR, outG, outB);
+}
+
 //------------------------------------------------------------------------------
 // AgX tone mapper
 //------------------------------------------------------------------------------
@@ -334,6 +420,12 @@ glm::vec3 AgxToneMapper::operator()(glm::vec3 v) const noexcept
     return v;
 }
 
+void AgxToneMapper::apply(const float* r, const float* g, const float* b, size_t n,
+        float* outR, float* outG, float* outB) const noexcept
+{
+    applyPerColor(*this, r, g, b, n, outR, outG, outB);
+}
+
 //------------------------------------------------------------------------------
 // Display range tone mapper
 //------------------------------------------------------------------------------
@@ -373,6 +465,12 @@ DEFAULT_CONSTRUCTORS(DisplayRangeToneMapper)
     return mix(debugColors[index], debugColors[index + 1], glm::saturate(v - float(index)));
 }
 
+void DisplayRangeToneMapper::apply(const float* r, const float* g, const float* b, size_t n,
+        float* outR, float* outG, float* outB) const noexcept
+{
+    applyPerColor(*this, r, g, b, n, outR, outG, outB);
+}
+
 //------------------------------------------------------------------------------
 // Generic tone mapper
 //------------------------------------------------------------------------------
@@ -446,6 +544,19 @@ glm::vec3 GenericToneMapper::operator()(glm::vec3 x) const noexcept
     return mOptions->outputScale * x / (x + mOptions->inputScale);
 }
 
+void GenericToneMapper::apply(const float* r, const float* g, const float* b, size_t n,
+        float* outR, float* outG, float* outB) const noexcept
+{
+    const float contrast = mOptions->contrast;
+    const float inputScale = mOptions->inputScale;
+    const float outputScale = mOptions->outputScale;
+    applyPerChannel([=](simd::floatN x)
+        {
+            x = simd::pow(x, contrast);
+            return outputScale * x / (x + inputScale);
+        }, r, g, b, n, outR, outG, outB);
+}
+
 float GenericToneMapper::getContrast() const noexcept { return  mOptions->contrast; }
 float GenericToneMapper::getMidGrayIn() const noexcept { return  mOptions->midGrayIn; }
 float GenericToneMapper::getMidGrayOut() const noexcept { return  mOptions->midGrayOut; }
@@ -1,5 +1,6 @@
 #pragma once
 #include <stdint.h>
+#include <stddef.h>
 #include <GLM/glm.hpp>
 
 struct ToneMapper 
@@ -20,6 +21,17 @@ struct ToneMapper
         *         function applied ("linear")
         */
     virtual glm::vec3 operator()(glm::vec3 c) const noexcept = 0;
+
+    /**
+        * Batch variant of operator() for structure-of-arrays data, so a caller
+        * tone mapping many colors pays for a single virtual call.
+        *
+        * @param r, g, b Input channels of n colors, same space as operator()
+        * @param n Number of colors
+        * @param outR, outG, outB Output channels, may alias the inputs
+        */
+    virtual void apply(const float* r, const float* g, const float* b, size_t n,
+            float* outR, float* outG, float* outB) const noexcept;
 };
 
 /**
@@ -31,6 +43,8 @@ struct LinearToneMapper final : public ToneMapper {
     ~LinearToneMapper() noexcept final;
 
     glm::vec3 operator()(glm::vec3 c) const noexcept override;
+    void apply(const float* r, const float* g, const float* b, size_t n,
+            float* outR, float* outG, float* outB) const noexcept override;
 };
 
 /**
@@ -44,6 +58,8 @@ struct ACESToneMapper final : public ToneMapper
     ~ACESToneMapper() noexcept final;
 
     glm::vec3 operator()(glm::vec3 c) const noexcept override;
+    void apply(const float* r, const float* g, const float* b, size_t n,
+            float* outR, float* outG, float* outB) const noexcept override;
 };
 
 /**
@@ -58,6 +74,8 @@ struct ACESLegacyToneMapper final : public ToneMapper
     ~ACESLegacyToneMapper() noexcept final;
 
     glm::vec3 operator()(glm::vec3 c) const noexcept override;
+    void apply(const float* r, const float* g, const float* b, size_t n,
+            float* outR, float* outG, float* outB) const noexcept override;
 };
 
 /**
@@ -72,6 +90,8 @@ struct FilmicToneMapper final : public ToneMapper
     ~FilmicToneMapper() noexcept final;
 
     glm::vec3 operator()(glm::vec3 x) const noexcept override;
+    void apply(const float* r, const float* g, const float* b, size_t n,
+            float* outR, float* outG, float* outB) const noexcept override;
 };
 
 /**
@@ -96,6 +116,8 @@ struct AgxToneMapper final : public ToneMapper
     ~AgxToneMapper() noexcept final;
 
     glm::vec3 operator()(glm::vec3 x) const noexcept override;
+    void apply(const float* r, const float* g, const float* b, size_t n,
+            float* outR, float* outG, float* outB) const noexcept override;
 
     AgxLook look;
 };
@@ -141,6 +163,8 @@ struct GenericToneMapper final : public ToneMapper
     GenericToneMapper& operator=(GenericToneMapper&& rhs) noexcept;
 
     glm::vec3 operator()(glm::vec3 x) const noexcept override;
+    void apply(const float* r, const float* g, const float* b, size_t n,
+            float* outR, float* outG, float* outB) const noexcept override;
 
     /** Returns the contrast of the curve as a strictly positive value. */
     float getContrast() const noexcept;
@@ -206,6 +230,8 @@ struct DisplayRangeToneMapper final : public ToneMapper {
     ~DisplayRangeToneMapper() noexcept override;
 
     glm::vec3 operator()(glm::vec3 c) const noexcept override;
+    void apply(const float* r, const float* g, const float* b, size_t n,
+            float* outR, float* outG, float* outB) const noexcept override;
 };
 
 
@@ -10,6 +10,7 @@
 #include "ShadowMapPass.h"
 #include "GroundObject.h"
 #include "SSAORenderPass.h"
+#include "SceneBvh.h"
 int main()
 {
 
@@ -18,9 +19,13 @@ int main()
 	//ElayGraphics::WINDOW_KEYWORD::setIsCursorDisable(true);
 	ElayGraphics::WINDOW_KEYWORD::setIsCursorDisable(false);
 	ElayGraphics::COMPONENT_CONFIG::setIsEnableGUI(true);
+	//turn on once MeshConverter has written the DDS caches of the models, the demo never transcodes
+	ElayGraphics::COMPONENT_CONFIG::setIsCompressTextures(false);
 
 	ElayGraphics::ResourceManager::registerGameObject(std::make_shared<CModelLoad>("Monkey", 1));
 	ElayGraphics::ResourceManager::registerGameObject(std::make_shared<CGroundObject>("GroundObject", 2));
+	//shared by the shadow, SSAO and model passes, each culls it with its own camera
+	ElayGraphics::ResourceManager::registerSharedData("SceneBvh", std::make_shared<CSceneBvh>());
 
 	ElayGraphics::ResourceManager::registerRenderPass(std::make_shared<IBLLigthPass>("IBLLightPass", 0));
 	ElayGraphics::ResourceManager::registerRenderPass(std::make_shared<CShadowMapPass>("CShadowMapPass", 1));